@@ -7,12 +7,16 @@
 #include "AddressBar.h"
 
 #include "util/shell_helpers.h"
+#include "util/trace.h"
+#include "util/diagnostics.h"
+#include "util/drop_parsing.h"
+#include "util/tab_order.h"
+#include "util/id_list.h"
 
 #include <shobjidl.h>
 
 #include <algorithm>
 #include <array>
-#include <numeric>
 
 namespace
 {
@@ -36,6 +40,40 @@ namespace
         {
                 return GetSystemMetrics(SM_CYDRAG);
         }
+
+        const int kDetachThreshold = 40;
+
+        RECT ToRect(const TabLayout::Rect &rect)
+        {
+                RECT result = { rect.left, rect.top, rect.right, rect.bottom };
+                return result;
+        }
+
+        TabLayout::Rect ToLayoutRect(const RECT &rect)
+        {
+                TabLayout::Rect result;
+                result.left = static_cast<int>(rect.left);
+                result.top = static_cast<int>(rect.top);
+                result.right = static_cast<int>(rect.right);
+                result.bottom = static_cast<int>(rect.bottom);
+                return result;
+        }
+
+        DragPacer::Point ToPacerPoint(const POINT &pt)
+        {
+                DragPacer::Point point;
+                point.x = static_cast<int>(pt.x);
+                point.y = static_cast<int>(pt.y);
+                return point;
+        }
+
+        // Identifies the font (and DPI) a title was measured with. The DPI is the window's, since
+        // a DC reports the system DPI whichever monitor the window is on.
+        unsigned long long GetFontKey(HDC hdc, UINT dpi)
+        {
+                unsigned long long font = reinterpret_cast<UINT_PTR>(GetCurrentObject(hdc, OBJ_FONT));
+                return (font << 16) ^ static_cast<unsigned long long>(dpi);
+        }
 }
 
 // ============================================================================
@@ -162,7 +200,21 @@ HRESULT CAddressBar::InitializeTabs()
 
 void CAddressBar::OnExplorerNavigate()
 {
+        CE_TRACE_SCOPE_RECORD("TabBar.Navigate", CEDiagnostics::NavigationLatency());
+        unsigned long long workStart = CETrace::Now();
+
         UpdateActiveTabFromExplorer();
+
+        // Navigations which Explorer started itself (the address bar, the folder tree...) are
+        // only attributed to a tab now that we know which one it landed on.
+        NavigationTracer &navigations = CEDiagnostics::Navigations();
+        uintptr_t windowKey = GetNavigationWindowKey();
+        if (m_activeGroup >= 0 && m_activeGroup < static_cast<int>(m_groups.size()) &&
+                m_activeTab >= 0 && m_activeTab < static_cast<int>(m_groups[m_activeGroup].tabs.size()))
+        {
+                navigations.AttributeToTab(windowKey, m_groups[m_activeGroup].tabs[m_activeTab].id);
+        }
+        navigations.AddOwnWork(windowKey, CETrace::Now() - workStart);
 }
 
 SIZE CAddressBar::GetDesiredSize() const
@@ -274,6 +326,8 @@ LRESULT CAddressBar::OnCreate(UINT, WPARAM, LPARAM, BOOL &)
         m_dropTarget.Attach(new ExplorerTabDropTarget(this));
         RegisterDragDrop(m_hWnd, m_dropTarget);
 
+        m_settingsSubscription = CEUtil::SubscribeToCESettings(m_hWnd);
+
         UpdateActiveTabFromExplorer();
         LayoutTabs();
         return 0;
@@ -281,15 +335,42 @@ LRESULT CAddressBar::OnCreate(UINT, WPARAM, LPARAM, BOOL &)
 
 LRESULT CAddressBar::OnDestroy(UINT, WPARAM, LPARAM, BOOL &)
 {
+        CEUtil::UnsubscribeFromCESettings(m_settingsSubscription);
+        m_settingsSubscription = 0;
+
         RevokeDragDrop(m_hWnd);
         m_dropTarget.Release();
         CancelDrag();
         m_groups.clear();
+        m_tabRenderCache.Clear();
+        return 0;
+}
+
+/*
+ * OnSettingsChanged: The settings were changed, possibly by another window. Only a change to
+ *                    the tab sizing needs any work here.
+ */
+LRESULT CAddressBar::OnSettingsChanged(UINT, WPARAM, LPARAM, BOOL &)
+{
+        int previousHeight = m_fixedTabSize.cy;
+        if (!ApplySettings(*CEUtil::GetCESettingsSnapshot()))
+                return 0;
+
+        m_layoutDirty = true;
+        LayoutTabs();
+        InvalidateRect(nullptr, TRUE);
+
+        if (m_fixedTabSize.cy != previousHeight && m_onDesiredSizeChanged)
+        {
+                m_onDesiredSizeChanged();
+        }
         return 0;
 }
 
 LRESULT CAddressBar::OnPaint(UINT, WPARAM, LPARAM, BOOL &)
 {
+        CE_TRACE_SCOPE_RECORD("TabBar.Paint", CEDiagnostics::PaintLatency());
+
         LayoutTabsIfNeeded();
 
         PAINTSTRUCT ps;
@@ -299,14 +380,39 @@ LRESULT CAddressBar::OnPaint(UINT, WPARAM, LPARAM, BOOL &)
 
         DrawBackground(hdc, clientRect);
 
-        for (const TabGroup &group : m_groups)
+        // Only what is visible is painted, so the cost of a paint depends on the number of
+        // visible tabs rather than on the total. The overflowing row is cut off by the chevron.
+        int savedDc = SaveDC(hdc);
+        if (m_stripLayout.IsOverflowing())
+        {
+                RECT chevronRect = ToRect(m_stripLayout.GetChevronRect());
+                ExcludeClipRect(hdc, chevronRect.left, chevronRect.top, chevronRect.right, chevronRect.bottom);
+        }
+
+        for (int groupIndex : m_stripLayout.GetVisibleGroups())
+        {
+                if (groupIndex >= 0 && groupIndex < static_cast<int>(m_groups.size()))
+                {
+                        DrawGroupHandle(hdc, m_groups[groupIndex]);
+                }
+        }
+
+        for (const TabRef &ref : m_stripLayout.GetVisibleTabs())
         {
-                if (!group.tabs.empty())
+                if (IsValidTabRef(ref))
                 {
-                        DrawGroup(hdc, group);
+                        const TabGroup &group = m_groups[ref.groupIndex];
+                        DrawTab(hdc, group.tabs[ref.tabIndex], group.color);
                 }
         }
 
+        RestoreDC(hdc, savedDc);
+
+        if (m_stripLayout.IsOverflowing())
+        {
+                DrawChevron(hdc);
+        }
+
         if (m_dropHoverGroup >= 0)
         {
                 DrawDropHover(hdc);
@@ -317,6 +423,11 @@ LRESULT CAddressBar::OnPaint(UINT, WPARAM, LPARAM, BOOL &)
                 DrawGhost(hdc);
         }
 
+        if (CEDiagnostics::IsOverlayEnabled())
+        {
+                DrawLatencyOverlay(hdc, clientRect);
+        }
+
         EndPaint(&ps);
         return 0;
 }
@@ -339,7 +450,13 @@ LRESULT CAddressBar::OnLButtonDown(UINT, WPARAM, LPARAM lParam, BOOL &)
         POINT pt = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
         HitTestResult result = HitTest(pt);
 
-        if (result.groupHandle)
+        if (result.chevron)
+        {
+                POINT screenPt = pt;
+                ClientToScreen(&screenPt);
+                ShowOverflowMenu(screenPt);
+        }
+        else if (result.groupHandle)
         {
                 StartGroupDrag(result.groupIndex, pt);
         }
@@ -354,6 +471,7 @@ LRESULT CAddressBar::OnLButtonDown(UINT, WPARAM, LPARAM lParam, BOOL &)
 LRESULT CAddressBar::OnLButtonUp(UINT, WPARAM, LPARAM lParam, BOOL &)
 {
         POINT pt = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+        FlushPendingDrag();
         CommitDrag(pt);
         return 0;
 }
@@ -361,7 +479,37 @@ LRESULT CAddressBar::OnLButtonUp(UINT, WPARAM, LPARAM lParam, BOOL &)
 LRESULT CAddressBar::OnMouseMove(UINT, WPARAM, LPARAM lParam, BOOL &)
 {
         POINT pt = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-        UpdateDrag(pt);
+        if (!m_draggingTab && !m_draggingGroup)
+                return 0;
+
+        // High polling rate mice send far more moves than we can paint, so only the first move
+        // of each frame is processed right away; the latest of the rest is picked up by the
+        // frame timer.
+        if (m_dragPacer.Push(ToPacerPoint(pt), IsOutsideDetachZone(pt), GetTickCount64()))
+        {
+                UpdateDrag(pt);
+        }
+        else
+        {
+                ArmDragFrameTimer();
+        }
+        return 0;
+}
+
+LRESULT CAddressBar::OnMouseWheel(UINT uMsg, WPARAM wParam, LPARAM, BOOL &bHandled)
+{
+        if (m_stripLayout.GetMaxScrollOffset() <= 0)
+        {
+                bHandled = FALSE;
+                return 0;
+        }
+
+        // Wheel up (or tilt left) scrolls towards the start of the strip.
+        int delta = GET_WHEEL_DELTA_WPARAM(wParam);
+        if (uMsg == WM_MOUSEWHEEL)
+                delta = -delta;
+
+        ScrollBy(MulDiv(delta, m_fixedTabSize.cx, WHEEL_DELTA));
         return 0;
 }
 
@@ -395,12 +543,27 @@ LRESULT CAddressBar::OnCaptureChanged(UINT, WPARAM, LPARAM, BOOL &)
 
 void CAddressBar::LoadSettings()
 {
-        CEUtil::CESettings settings = CEUtil::GetCESettings();
-        m_autoSizeTabs = settings.tabAutoSize != 0;
+        ApplySettings(*CEUtil::GetCESettingsSnapshot());
+}
+
+/*
+ * ApplySettings: Take the tab sizing settings. Returns true if any of them changed.
+ */
+bool CAddressBar::ApplySettings(const CEUtil::CESettings &settings)
+{
+        bool autoSize = settings.tabAutoSize != 0;
+        SIZE fixedSize = m_fixedTabSize;
         if (settings.tabFixedWidth > 0)
-                m_fixedTabSize.cx = static_cast<int>(settings.tabFixedWidth);
+                fixedSize.cx = static_cast<int>(settings.tabFixedWidth);
         if (settings.tabFixedHeight > 0)
-                m_fixedTabSize.cy = static_cast<int>(settings.tabFixedHeight);
+                fixedSize.cy = static_cast<int>(settings.tabFixedHeight);
+
+        if (autoSize == m_autoSizeTabs && fixedSize.cx == m_fixedTabSize.cx && fixedSize.cy == m_fixedTabSize.cy)
+                return false;
+
+        m_autoSizeTabs = autoSize;
+        m_fixedTabSize = fixedSize;
+        return true;
 }
 
 void CAddressBar::EnsureDefaultGroup()
@@ -424,75 +587,238 @@ void CAddressBar::LayoutTabsIfNeeded()
         }
 }
 
+/*
+ * LayoutTabs: Compute the geometry of every tab and group, and the set of those visible.
+ *
+ * The geometry and the rules for what is visible live in TabLayout::StripLayout. Text is only
+ * measured for tabs which are visible: other tabs use their cached measurement if they have
+ * one, or an estimate from the average character width otherwise.
+ */
 void CAddressBar::LayoutTabs()
 {
+        CE_TRACE_SCOPE_RECORD("TabBar.Layout", CEDiagnostics::LayoutLatency());
+
         RECT clientRect;
         GetClientRect(&clientRect);
-        int rowHeight = m_fixedTabSize.cy;
 
-        int x = clientRect.left + m_tabMargin;
-        int y = clientRect.top + m_tabMargin;
-        int currentRow = 0;
+        // Every tab is clamped to m_maxTabWidth, so that is all the room a cached tab needs.
+        m_tabRenderCache.Configure(m_maxTabWidth, m_fixedTabSize.cy);
 
         HDC hdc = GetDC();
-        for (auto &group : m_groups)
-        {
-                if (group.tabs.empty())
-                        continue;
+        unsigned long long fontKey = GetFontKey(hdc, GetDpiForWindow(m_hWnd));
+        TEXTMETRICW textMetrics = { 0 };
+        GetTextMetricsW(hdc, &textMetrics);
 
-                std::vector<int> tabWidths;
-                tabWidths.reserve(group.tabs.size());
+        std::vector<int> groupSizes;
+        std::vector<int> tabWidths;
+        groupSizes.reserve(m_groups.size());
+        for (const TabGroup &group : m_groups)
+        {
+                groupSizes.push_back(static_cast<int>(group.tabs.size()));
                 for (const Tab &tab : group.tabs)
                 {
-                        int width = m_autoSizeTabs ? CalculateTabWidth(hdc, tab.title) : m_fixedTabSize.cx;
-                        width = std::min(std::max(width, m_minTabWidth), m_maxTabWidth);
-                        tabWidths.push_back(width);
+                        tabWidths.push_back(GetLayoutTabWidth(tab, fontKey, textMetrics.tmAveCharWidth));
                 }
+        }
+
+        TabLayout::Metrics metrics = GetLayoutMetrics();
+        TabLayout::Rect client = ToLayoutRect(clientRect);
+        m_stripLayout.Compute(metrics, client, groupSizes, tabWidths, m_scrollOffset);
 
-                int groupWidth = m_groupHandleWidth;
-                if (!tabWidths.empty())
+        // Measure the visible tabs which were placed with an estimate, and place everything
+        // again with their real widths.
+        if (m_autoSizeTabs)
+        {
+                bool measured = false;
+                for (const TabRef &ref : m_stripLayout.GetVisibleTabs())
                 {
-                        groupWidth += std::accumulate(tabWidths.begin(), tabWidths.end(), 0);
-                        groupWidth += static_cast<int>((tabWidths.size() - 1)) * m_tabSpacing;
+                        const Tab &tab = m_groups[ref.groupIndex].tabs[ref.tabIndex];
+                        if (tab.titleMetrics.IsValidFor(fontKey, tab.title.length()))
+                                continue;
+
+                        CalculateTabWidth(hdc, tab);
+                        tabWidths[m_stripLayout.GetFlatTabIndex(ref.groupIndex, ref.tabIndex)] = GetLayoutTabWidth(tab, fontKey, textMetrics.tmAveCharWidth);
+                        measured = true;
                 }
 
-                if (x + groupWidth > clientRect.right - m_tabMargin && currentRow < (m_maxRows - 1))
+                if (measured)
                 {
-                        currentRow++;
-                        x = clientRect.left + m_tabMargin;
-                        y += rowHeight + m_rowSpacing;
+                        m_stripLayout.Compute(metrics, client, groupSizes, tabWidths, m_scrollOffset);
                 }
+        }
+        ReleaseDC(hdc);
 
-                group.bounds.left = x;
-                group.bounds.top = y;
-                group.bounds.right = x + groupWidth;
-                group.bounds.bottom = y + rowHeight;
+        m_scrollOffset = m_stripLayout.GetScrollOffset();
+        m_totalHeight = m_stripLayout.GetHeight();
 
-                int tabX = x + m_groupHandleWidth;
-                for (size_t idx = 0; idx < group.tabs.size(); ++idx)
+        for (size_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
+        {
+                TabGroup &group = m_groups[groupIndex];
+                group.bounds = ToRect(m_stripLayout.GetGroupRect(static_cast<int>(groupIndex)));
+                for (size_t tabIndex = 0; tabIndex < group.tabs.size(); ++tabIndex)
                 {
-                        RECT tabRect = { tabX, y, tabX + tabWidths[idx], y + rowHeight };
-                        group.tabs[idx].bounds = tabRect;
-                        tabX += tabWidths[idx] + m_tabSpacing;
+                        group.tabs[tabIndex].bounds = ToRect(m_stripLayout.GetTabRect(static_cast<int>(groupIndex), static_cast<int>(tabIndex)));
                 }
+        }
 
-                x = group.bounds.right + m_groupSpacing;
+        // If the new widths revealed tabs which were laid out with an estimated width, lay out
+        // again on the next paint to measure them.
+        bool needsMeasuring = false;
+        if (m_autoSizeTabs)
+        {
+                for (const TabRef &ref : m_stripLayout.GetVisibleTabs())
+                {
+                        const Tab &tab = m_groups[ref.groupIndex].tabs[ref.tabIndex];
+                        if (!tab.titleMetrics.IsValidFor(fontKey, tab.title.length()))
+                        {
+                                needsMeasuring = true;
+                                break;
+                        }
+                }
         }
-        ReleaseDC(hdc);
 
-        m_totalHeight = (currentRow + 1) * rowHeight + (m_tabMargin * 2) + (currentRow * m_rowSpacing);
-        m_layoutDirty = false;
+        m_layoutDirty = needsMeasuring;
         RefreshActiveState();
 }
 
-int CAddressBar::CalculateTabWidth(HDC hdc, const std::wstring &text) const
+/*
+ * GetLayoutTabWidth: Get the width of a tab without measuring its text: the fixed width, the
+ *                    cached measurement, or an estimate if the title was never measured.
+ */
+int CAddressBar::GetLayoutTabWidth(const Tab &tab, unsigned long long fontKey, int averageCharWidth) const
+{
+        int width = m_fixedTabSize.cx;
+        if (m_autoSizeTabs)
+        {
+                if (tab.titleMetrics.IsValidFor(fontKey, tab.title.length()))
+                        width = tab.titleMetrics.GetWidth() + (m_tabPaddingX * 2);
+                else
+                        width = static_cast<int>(tab.title.length()) * averageCharWidth + (m_tabPaddingX * 2);
+        }
+        return std::min(std::max(width, m_minTabWidth), m_maxTabWidth);
+}
+
+TabLayout::Metrics CAddressBar::GetLayoutMetrics() const
+{
+        TabLayout::Metrics metrics;
+        metrics.margin = m_tabMargin;
+        metrics.tabSpacing = m_tabSpacing;
+        metrics.groupSpacing = m_groupSpacing;
+        metrics.groupHandleWidth = m_groupHandleWidth;
+        metrics.rowHeight = m_fixedTabSize.cy;
+        metrics.rowSpacing = m_rowSpacing;
+        metrics.maxRows = m_maxRows;
+        metrics.chevronWidth = m_chevronWidth;
+        return metrics;
+}
+
+bool CAddressBar::IsValidTabRef(const TabRef &ref) const
+{
+        return ref.groupIndex >= 0 && ref.groupIndex < static_cast<int>(m_groups.size()) &&
+                ref.tabIndex >= 0 && ref.tabIndex < static_cast<int>(m_groups[ref.groupIndex].tabs.size());
+}
+
+void CAddressBar::ScrollBy(int delta)
+{
+        int newOffset = std::clamp(m_scrollOffset + delta, 0, m_stripLayout.GetMaxScrollOffset());
+        if (newOffset == m_scrollOffset)
+                return;
+
+        m_scrollOffset = newOffset;
+        LayoutTabs();
+        InvalidateRect(nullptr, FALSE);
+}
+
+/*
+ * EnsureTabVisible: Adjust the scroll offset so that the given tab is entirely within the
+ *                   viewport. Returns true if the offset changed and a layout is needed.
+ */
+bool CAddressBar::EnsureTabVisible(int groupIndex, int tabIndex)
+{
+        if (!IsValidTabRef({ groupIndex, tabIndex }))
+                return false;
+
+        int newOffset = m_stripLayout.GetOffsetToReveal(groupIndex, tabIndex);
+        if (newOffset == m_scrollOffset)
+                return false;
+
+        m_scrollOffset = newOffset;
+        return true;
+}
+
+/*
+ * ShowOverflowMenu: Show a menu of every tab which isn't entirely visible, and activate the
+ *                   chosen one.
+ */
+void CAddressBar::ShowOverflowMenu(POINT screenPoint)
 {
-        RECT rc = { 0,0,0,0 };
-        DrawTextW(hdc, text.c_str(), static_cast<int>(text.length()), &rc, DT_CALCRECT | DT_SINGLELINE);
-        int width = rc.right - rc.left + (m_tabPaddingX * 2);
+        std::vector<TabRef> hiddenTabs;
+        HMENU menu = CreatePopupMenu();
+        for (size_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
+        {
+                const TabGroup &group = m_groups[groupIndex];
+                for (size_t tabIndex = 0; tabIndex < group.tabs.size(); ++tabIndex)
+                {
+                        if (m_stripLayout.IsTabFullyVisible(static_cast<int>(groupIndex), static_cast<int>(tabIndex)))
+                                continue;
+
+                        const Tab &tab = group.tabs[tabIndex];
+
+                        UINT flags = MF_STRING | (tab.active ? MF_CHECKED : MF_UNCHECKED);
+                        AppendMenuW(menu, flags, 7500 + static_cast<UINT>(hiddenTabs.size()), tab.title.c_str());
+                        hiddenTabs.push_back({ static_cast<int>(groupIndex), static_cast<int>(tabIndex) });
+                }
+        }
+
+        UINT command = TrackPopupMenu(menu, TPM_RETURNCMD | TPM_RIGHTALIGN | TPM_TOPALIGN, screenPoint.x, screenPoint.y, 0, m_hWnd, nullptr);
+        DestroyMenu(menu);
+
+        if (command >= 7500 && command < 7500 + hiddenTabs.size())
+        {
+                const TabRef &ref = hiddenTabs[command - 7500];
+                ActivateTab(ref.groupIndex, ref.tabIndex, true);
+        }
+}
+
+int CAddressBar::CalculateTabWidth(HDC hdc, const Tab &tab) const
+{
+        EnsureTitleMetrics(hdc, tab);
+        int width = tab.titleMetrics.GetWidth() + (m_tabPaddingX * 2);
         return width;
 }
 
+/*
+ * EnsureTitleMetrics: Measure the cumulative advances of a tab title, unless they were already
+ *                     measured with the font currently selected into the DC.
+ *
+ * This is the only place tab titles are measured; widths and ellipsis fitting are derived
+ * from the cached advances afterwards.
+ */
+void CAddressBar::EnsureTitleMetrics(HDC hdc, const Tab &tab) const
+{
+        unsigned long long fontKey = GetFontKey(hdc, GetDpiForWindow(m_hWnd));
+        TextFit::TitleMetrics &metrics = tab.titleMetrics;
+        if (metrics.IsValidFor(fontKey, tab.title.length()))
+                return;
+
+        metrics.Reset(fontKey);
+
+        int length = static_cast<int>(tab.title.length());
+        if (length > 0)
+        {
+                SIZE extent = { 0 };
+                metrics.advances.resize(length);
+                if (!GetTextExtentExPointW(hdc, tab.title.c_str(), length, 0, nullptr, metrics.advances.data(), &extent))
+                {
+                        metrics.advances.clear();
+                }
+        }
+
+        SIZE ellipsisExtent = { 0 };
+        GetTextExtentPoint32W(hdc, L"...", 3, &ellipsisExtent);
+        metrics.ellipsisWidth = ellipsisExtent.cx;
+}
+
 void CAddressBar::RefreshActiveState()
 {
         for (size_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
@@ -516,35 +842,53 @@ void CAddressBar::DrawBackground(HDC hdc, const RECT &clientRect) const
         DeleteObject(background);
 }
 
-void CAddressBar::DrawGroup(HDC hdc, const TabGroup &group) const
+void CAddressBar::DrawTab(HDC hdc, const Tab &tab, COLORREF groupColor) const
 {
-        DrawGroupHandle(hdc, group);
-        for (const Tab &tab : group.tabs)
+        TabRenderCache::Key key;
+        key.title = tab.title;
+        key.width = tab.bounds.right - tab.bounds.left;
+        key.height = tab.bounds.bottom - tab.bounds.top;
+        key.color = groupColor;
+        key.active = tab.active;
+
+        POINT destination = { tab.bounds.left, tab.bounds.top };
+        bool drawn = m_tabRenderCache.Draw(hdc, GetDpiForWindow(m_hWnd), key, destination, [this, &tab, groupColor](HDC targetDc, const RECT &rect)
         {
-                        DrawTab(hdc, tab, group.color);
+                RenderTab(targetDc, rect, tab, groupColor);
+        });
+
+        // Fall back to painting directly if the tab couldn't be cached.
+        if (!drawn)
+        {
+                RenderTab(hdc, tab.bounds, tab, groupColor);
         }
 }
 
-void CAddressBar::DrawTab(HDC hdc, const Tab &tab, COLORREF groupColor) const
+void CAddressBar::RenderTab(HDC hdc, const RECT &bounds, const Tab &tab, COLORREF groupColor) const
 {
         COLORREF baseColor = tab.active ? AdjustColor(groupColor, 1.2) : groupColor;
         HBRUSH brush = CreateSolidBrush(baseColor);
-        FillRect(hdc, &tab.bounds, brush);
+        FillRect(hdc, &bounds, brush);
         DeleteObject(brush);
 
         HPEN pen = CreatePen(PS_SOLID, 1, m_borderColor);
         HPEN oldPen = (HPEN)SelectObject(hdc, pen);
         HBRUSH oldBrush = (HBRUSH)SelectObject(hdc, GetStockObject(NULL_BRUSH));
-        Rectangle(hdc, tab.bounds.left, tab.bounds.top, tab.bounds.right, tab.bounds.bottom);
+        Rectangle(hdc, bounds.left, bounds.top, bounds.right, bounds.bottom);
         SelectObject(hdc, oldBrush);
         SelectObject(hdc, oldPen);
         DeleteObject(pen);
 
-        RECT textRect = tab.bounds;
+        RECT textRect = bounds;
         InflateRect(&textRect, -m_tabPaddingX, -m_tabPaddingY);
         SetBkMode(hdc, TRANSPARENT);
         SetTextColor(hdc, RGB(40, 40, 40));
-        DrawTextW(hdc, tab.title.c_str(), static_cast<int>(tab.title.length()), &textRect, DT_SINGLELINE | DT_VCENTER | DT_LEFT | DT_END_ELLIPSIS);
+
+        // The title is fitted from its cached advances rather than by DT_END_ELLIPSIS, which
+        // would lay out the whole string again on every paint.
+        EnsureTitleMetrics(hdc, tab);
+        const std::wstring &displayText = TextFit::GetDisplayText(tab.titleMetrics, tab.title, textRect.right - textRect.left);
+        DrawTextW(hdc, displayText.c_str(), static_cast<int>(displayText.length()), &textRect, DT_SINGLELINE | DT_VCENTER | DT_LEFT | DT_NOPREFIX);
 }
 
 void CAddressBar::DrawGroupHandle(HDC hdc, const TabGroup &group) const
@@ -556,6 +900,26 @@ void CAddressBar::DrawGroupHandle(HDC hdc, const TabGroup &group) const
         DeleteObject(brush);
 }
 
+void CAddressBar::DrawChevron(HDC hdc) const
+{
+        RECT chevronRect = ToRect(m_stripLayout.GetChevronRect());
+        HBRUSH brush = CreateSolidBrush(AdjustColor(m_backgroundColor, 0.92));
+        FillRect(hdc, &chevronRect, brush);
+        DeleteObject(brush);
+
+        HPEN pen = CreatePen(PS_SOLID, 1, m_borderColor);
+        HPEN oldPen = (HPEN)SelectObject(hdc, pen);
+        MoveToEx(hdc, chevronRect.left, chevronRect.top, nullptr);
+        LineTo(hdc, chevronRect.left, chevronRect.bottom);
+        SelectObject(hdc, oldPen);
+        DeleteObject(pen);
+
+        RECT textRect = chevronRect;
+        SetBkMode(hdc, TRANSPARENT);
+        SetTextColor(hdc, RGB(40, 40, 40));
+        DrawTextW(hdc, L"\u00BB", 1, &textRect, DT_SINGLELINE | DT_VCENTER | DT_CENTER | DT_NOPREFIX);
+}
+
 void CAddressBar::DrawGhost(HDC hdc) const
 {
         if (!m_showGhost)
@@ -594,6 +958,91 @@ void CAddressBar::DrawGhost(HDC hdc) const
         DeleteObject(bitmap);
 }
 
+/*
+ * DrawLatencyOverlay: Draw the recorded paint, layout and navigation latencies over the tab
+ *                     strip, followed by the navigation timings of the active tab. One line per
+ *                     source if they fit, otherwise a single line.
+ */
+void CAddressBar::DrawLatencyOverlay(HDC hdc, const RECT &clientRect) const
+{
+        const struct
+        {
+                const wchar_t *label;
+                const LatencyHistogram &histogram;
+        } sources[] = {
+                { L"Paint", CEDiagnostics::PaintLatency() },
+                { L"Layout", CEDiagnostics::LayoutLatency() },
+                { L"Navigate", CEDiagnostics::NavigationLatency() },
+        };
+
+        std::vector<std::wstring> lines;
+        for (const auto &source : sources)
+        {
+                LatencyHistogram::Summary summary = source.histogram.Summarize();
+                wchar_t line[160];
+                swprintf_s(line, L"%s p50 %llu  p95 %llu  p99 %llu  max %llu \u00b5s (%llu)",
+                        source.label,
+                        summary.p50 / 1000, summary.p95 / 1000, summary.p99 / 1000, summary.max / 1000,
+                        summary.count);
+                lines.push_back(line);
+        }
+
+        TabRenderCache::Stats cacheStats = m_tabRenderCache.GetStats();
+        unsigned long long lookups = cacheStats.hits + cacheStats.misses;
+        wchar_t cacheLine[80];
+        swprintf_s(cacheLine, L"Tab cache %llu%% hits, %zu KB",
+                lookups ? (cacheStats.hits * 100) / lookups : 0ULL,
+                cacheStats.bytesInUse / 1024);
+        lines.push_back(cacheLine);
+
+        NavigationTracer::TabTimings timings;
+        if (m_activeGroup >= 0 && m_activeGroup < static_cast<int>(m_groups.size()) &&
+                m_activeTab >= 0 && m_activeTab < static_cast<int>(m_groups[m_activeGroup].tabs.size()) &&
+                CEDiagnostics::Navigations().GetTabTimings(GetNavigationWindowKey(), m_groups[m_activeGroup].tabs[m_activeTab].id, timings))
+        {
+                wchar_t tabLine[160];
+                swprintf_s(tabLine, L"This tab: last %llu \u00b5s (own %llu), avg %llu \u00b5s (own %llu) over %llu, %llu failed",
+                        timings.last.GetTotalNs() / 1000, timings.last.ownNs / 1000,
+                        timings.count ? timings.totalNs / timings.count / 1000 : 0ULL,
+                        timings.count ? timings.ownNs / timings.count / 1000 : 0ULL,
+                        timings.count, timings.failed);
+                lines.push_back(tabLine);
+        }
+
+        HFONT oldFont = static_cast<HFONT>(SelectObject(hdc, GetStockObject(DEFAULT_GUI_FONT)));
+        TEXTMETRICW textMetrics = {};
+        GetTextMetricsW(hdc, &textMetrics);
+        int lineHeight = std::max(1, static_cast<int>(textMetrics.tmHeight));
+
+        int availableHeight = clientRect.bottom - clientRect.top;
+        if (static_cast<int>(lines.size()) * lineHeight > availableHeight)
+        {
+                std::wstring joined;
+                for (const std::wstring &line : lines)
+                {
+                        if (!joined.empty())
+                                joined += L"  |  ";
+                        joined += line;
+                }
+                lines.assign(1, joined);
+        }
+
+        SetBkMode(hdc, OPAQUE);
+        SetBkColor(hdc, GetSysColor(COLOR_INFOBK));
+        SetTextColor(hdc, GetSysColor(COLOR_INFOTEXT));
+
+        RECT lineRect = clientRect;
+        for (const std::wstring &line : lines)
+        {
+                lineRect.bottom = lineRect.top + lineHeight;
+                DrawTextW(hdc, line.c_str(), static_cast<int>(line.length()), &lineRect,
+                        DT_RIGHT | DT_SINGLELINE | DT_NOPREFIX | DT_END_ELLIPSIS);
+                lineRect.top = lineRect.bottom;
+        }
+
+        SelectObject(hdc, oldFont);
+}
+
 void CAddressBar::DrawDropHover(HDC hdc) const
 {
         if (m_dropHoverGroup < 0 || m_dropHoverGroup >= static_cast<int>(m_groups.size()))
@@ -640,6 +1089,7 @@ HRESULT CAddressBar::AddTabForLocation(PIDLIST_ABSOLUTE pidl, bool makeActive, b
         Tab newTab;
         newTab.pidl.reset(pidl);
         newTab.active = false;
+        newTab.id = m_nextTabId++;
 
         CComHeapPtr<wchar_t> name;
         if (SUCCEEDED(SHGetNameFromIDList(pidl, SIGDN_NORMALDISPLAY, &name)))
@@ -712,45 +1162,102 @@ void CAddressBar::ActivateTab(int groupIndex, int tabIndex, bool navigate)
         if (tabIndex < 0 || tabIndex >= static_cast<int>(m_groups[groupIndex].tabs.size()))
                 return;
 
+        // Time spent in BrowseObject is the Shell's; only what surrounds it is ours.
+        NavigationTracer &navigations = CEDiagnostics::Navigations();
+        uintptr_t windowKey = GetNavigationWindowKey();
+        unsigned long long workStart = CETrace::Now();
+        unsigned long long ownWork = 0;
+
+        Tab &tab = m_groups[groupIndex].tabs[tabIndex];
+        bool requested = navigate && m_pShellBrowser && tab.pidl.pidl;
+        if (requested)
+        {
+                navigations.Request(windowKey, tab.id, workStart);
+        }
+
         m_activeGroup = groupIndex;
         m_activeTab = tabIndex;
         RefreshActiveState();
 
-        if (navigate && m_pShellBrowser)
+        if (requested)
         {
-                Tab &tab = m_groups[groupIndex].tabs[tabIndex];
-                if (tab.pidl.pidl)
-                {
-                        m_pShellBrowser->BrowseObject(tab.pidl.pidl, SBSP_SAMEBROWSER | SBSP_ABSOLUTE);
-                }
+                unsigned long long browseStart = CETrace::Now();
+                ownWork += browseStart - workStart;
+                m_pShellBrowser->BrowseObject(tab.pidl.pidl, SBSP_SAMEBROWSER | SBSP_ABSOLUTE);
+                workStart = CETrace::Now();
         }
 
         m_layoutDirty = true;
         LayoutTabs();
+        if (EnsureTabVisible(groupIndex, tabIndex))
+        {
+                LayoutTabs();
+        }
         InvalidateRect(nullptr, FALSE);
+
+        // Without a request this is part of handling a navigation; OnExplorerNavigate counts it.
+        if (requested)
+        {
+                navigations.AddOwnWork(windowKey, ownWork + (CETrace::Now() - workStart));
+        }
 }
 
-void CAddressBar::ActivateTabByPidl(PIDLIST_ABSOLUTE pidl)
+/*
+ * FindTabByPidl: Find the tab showing a location.
+ *
+ * ILIsEqual asks the Shell to compare the two lists, which is slow with many tabs. The list
+ * of the current folder usually has the same bytes as the one the tab was created from, so
+ * tabs are compared by key first, and ILIsEqual is only used if none matches.
+ */
+CAddressBar::TabRef CAddressBar::FindTabByPidl(PCIDLIST_ABSOLUTE pidl) const
 {
-        if (!pidl)
-                return;
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(pidl);
+        IdList::Key key = IdList::MakeKey(bytes);
+        for (size_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
+        {
+                const auto &tabs = m_groups[groupIndex].tabs;
+                for (size_t tabIndex = 0; tabIndex < tabs.size(); ++tabIndex)
+                {
+                        const UniquePidl &tabPidl = tabs[tabIndex].pidl;
+                        if (tabPidl.pidl && IdList::IsSameBytes(reinterpret_cast<const unsigned char *>(tabPidl.pidl), tabPidl.key, bytes, key))
+                                return { static_cast<int>(groupIndex), static_cast<int>(tabIndex) };
+                }
+        }
 
         for (size_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
         {
-                auto &group = m_groups[groupIndex];
-                for (size_t tabIndex = 0; tabIndex < group.tabs.size(); ++tabIndex)
+                const auto &tabs = m_groups[groupIndex].tabs;
+                for (size_t tabIndex = 0; tabIndex < tabs.size(); ++tabIndex)
                 {
-                        if (group.tabs[tabIndex].pidl.pidl && ILIsEqual(group.tabs[tabIndex].pidl.pidl, pidl))
-                        {
-                                ActivateTab(static_cast<int>(groupIndex), static_cast<int>(tabIndex), false);
-                                return;
-                        }
+                        if (tabs[tabIndex].pidl.pidl && ILIsEqual(tabs[tabIndex].pidl.pidl, pidl))
+                                return { static_cast<int>(groupIndex), static_cast<int>(tabIndex) };
                 }
         }
+
+        return {};
+}
+
+/*
+ * ActivateTabByPidl: Activate the tab showing a location, without navigating. Returns false if
+ *                    there is no such tab.
+ */
+bool CAddressBar::ActivateTabByPidl(PIDLIST_ABSOLUTE pidl)
+{
+        if (!pidl)
+                return false;
+
+        TabRef ref = FindTabByPidl(pidl);
+        if (!IsValidTabRef(ref))
+                return false;
+
+        ActivateTab(ref.groupIndex, ref.tabIndex, false);
+        return true;
 }
 
 void CAddressBar::UpdateActiveTabFromExplorer()
 {
+        CE_TRACE_SCOPE("TabBar.UpdateActiveTabFromExplorer");
+
         if (!m_pShellBrowser)
                 return;
 
@@ -758,23 +1265,7 @@ void CAddressBar::UpdateActiveTabFromExplorer()
         if (FAILED(CEUtil::GetCurrentFolderPidl(m_pShellBrowser, &pidl)))
                 return;
 
-        ActivateTabByPidl(pidl);
-
-        bool alreadyPresent = false;
-        for (const auto &group : m_groups)
-        {
-                for (const auto &tab : group.tabs)
-                {
-                        if (tab.pidl.pidl && ILIsEqual(tab.pidl.pidl, pidl))
-                        {
-                                alreadyPresent = true;
-                                break;
-                        }
-                }
-                if (alreadyPresent)
-                        break;
-        }
-
+        bool alreadyPresent = ActivateTabByPidl(pidl);
         if (!alreadyPresent)
         {
                 AddTabForLocation(pidl, true, false, m_groups[m_activeGroup].color);
@@ -786,6 +1277,15 @@ void CAddressBar::UpdateActiveTabFromExplorer()
         InvalidateRect(nullptr, FALSE);
 }
 
+/*
+ * GetNavigationWindowKey: Get the key which identifies this Explorer window to the navigation
+ *                         tracer. The other bands and the BHO use the same root window.
+ */
+uintptr_t CAddressBar::GetNavigationWindowKey() const
+{
+        return reinterpret_cast<uintptr_t>(::GetAncestor(m_hWnd, GA_ROOT));
+}
+
 void CAddressBar::CreateNewWindowForTab(const Tab &tab)
 {
         std::wstring path = GetTabFilesystemPath(tab);
@@ -876,6 +1376,7 @@ void CAddressBar::ShowContextMenuForTab(int groupIndex, int tabIndex, POINT scre
                 auto &group = m_groups[groupIndex];
                 if (tabIndex >= 0 && tabIndex < static_cast<int>(group.tabs.size()))
                 {
+                        CEDiagnostics::Navigations().ForgetTab(GetNavigationWindowKey(), group.tabs[tabIndex].id);
                         group.tabs.erase(group.tabs.begin() + tabIndex);
                         if (m_activeGroup == groupIndex)
                         {
@@ -936,66 +1437,23 @@ void CAddressBar::EnsureGhostRect(const POINT &pt)
         }
 }
 
+/*
+ * UpdatePendingDropTarget: Find where the dragged tab or group would go if dropped at a point.
+ *                          Uses the same visibility rules as hit-testing, so nothing hidden
+ *                          behind the chevron can be a target.
+ */
 void CAddressBar::UpdatePendingDropTarget(const POINT &pt)
 {
-        m_pendingDropGroup = -1;
-        m_pendingDropTab = -1;
-
-        for (size_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
-        {
-                const TabGroup &group = m_groups[groupIndex];
-                if (!PtInRect(&group.bounds, pt))
-                        continue;
-
-                if (m_draggingGroup)
-                {
-                        int midpoint = group.bounds.left + ((group.bounds.right - group.bounds.left) / 2);
-                        if (pt.x < midpoint)
-                                m_pendingDropGroup = static_cast<int>(groupIndex);
-                        else
-                                m_pendingDropGroup = static_cast<int>(groupIndex + 1);
-                        return;
-                }
-
-                for (size_t tabIndex = 0; tabIndex < group.tabs.size(); ++tabIndex)
-                {
-                        const RECT &bounds = group.tabs[tabIndex].bounds;
-                        if (pt.x <= bounds.left + ((bounds.right - bounds.left) / 2))
-                        {
-                                m_pendingDropGroup = static_cast<int>(groupIndex);
-                                m_pendingDropTab = static_cast<int>(tabIndex);
-                                return;
-                        }
-                }
-
-                m_pendingDropGroup = static_cast<int>(groupIndex);
-                m_pendingDropTab = static_cast<int>(group.tabs.size());
-                return;
-        }
+        TabRef slot = m_stripLayout.FindDropSlot(pt.x, pt.y, m_draggingGroup);
+        m_pendingDropGroup = slot.groupIndex;
+        m_pendingDropTab = slot.tabIndex;
 }
 
 void CAddressBar::UpdateDropHover(const POINT &pt)
 {
-        m_dropHoverGroup = -1;
-        m_dropHoverTab = -1;
-
-        for (size_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
-        {
-                const TabGroup &group = m_groups[groupIndex];
-                if (!PtInRect(&group.bounds, pt))
-                        continue;
-
-                m_dropHoverGroup = static_cast<int>(groupIndex);
-                for (size_t tabIndex = 0; tabIndex < group.tabs.size(); ++tabIndex)
-                {
-                        if (PtInRect(&group.tabs[tabIndex].bounds, pt))
-                        {
-                                m_dropHoverTab = static_cast<int>(tabIndex);
-                                break;
-                        }
-                }
-                break;
-        }
+        TabRef hover = m_stripLayout.FindDropHover(pt.x, pt.y);
+        m_dropHoverGroup = hover.groupIndex;
+        m_dropHoverTab = hover.tabIndex;
         InvalidateRect(nullptr, FALSE);
 }
 
@@ -1005,34 +1463,11 @@ void CAddressBar::UpdateDropHover(const POINT &pt)
 
 CAddressBar::HitTestResult CAddressBar::HitTest(const POINT &pt) const
 {
-        HitTestResult result;
-        for (size_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
-        {
-                const TabGroup &group = m_groups[groupIndex];
-                if (group.tabs.empty())
-                        continue;
-
-                RECT handleRect = group.bounds;
-                handleRect.right = handleRect.left + m_groupHandleWidth;
-                if (PtInRect(&handleRect, pt))
-                {
-                        result.valid = true;
-                        result.groupHandle = true;
-                        result.groupIndex = static_cast<int>(groupIndex);
-                        return result;
-                }
-
-                for (size_t tabIndex = 0; tabIndex < group.tabs.size(); ++tabIndex)
-                {
-                        if (PtInRect(&group.tabs[tabIndex].bounds, pt))
-                        {
-                                result.valid = true;
-                                result.groupIndex = static_cast<int>(groupIndex);
-                                result.tabIndex = static_cast<int>(tabIndex);
-                                return result;
-                        }
-                }
-        }
+        HitTestResult result = m_stripLayout.HitTest(pt.x, pt.y);
+        if (result.groupHandle && (result.groupIndex < 0 || result.groupIndex >= static_cast<int>(m_groups.size())))
+                return HitTestResult();
+        if (result.valid && !result.groupHandle && !IsValidTabRef({ result.groupIndex, result.tabIndex }))
+                return HitTestResult();
         return result;
 }
 
@@ -1052,6 +1487,7 @@ void CAddressBar::StartTabDrag(int groupIndex, int tabIndex, const POINT &pt)
         m_dragStart = pt;
         m_dragPoint = pt;
         m_showGhost = false;
+        m_dragPacer.Reset();
         SetCapture();
 }
 
@@ -1069,6 +1505,7 @@ void CAddressBar::StartGroupDrag(int groupIndex, const POINT &pt)
         m_dragStart = pt;
         m_dragPoint = pt;
         m_showGhost = false;
+        m_dragPacer.Reset();
         SetCapture();
 }
 
@@ -1093,17 +1530,59 @@ void CAddressBar::UpdateDrag(const POINT &pt)
                 InvalidateRect(nullptr, FALSE);
         }
 
-        RECT clientRect;
-        GetClientRect(&clientRect);
-        int detachThreshold = 40;
-        if (pt.y < clientRect.top - detachThreshold || pt.y > clientRect.bottom + detachThreshold)
+        m_detachPending = IsOutsideDetachZone(pt);
+}
+
+/*
+ * FlushPendingDrag: Process the latest coalesced mouse move, if any, so that a drop sees the
+ *                   same state the user last saw.
+ */
+void CAddressBar::FlushPendingDrag()
+{
+        DragPacer::Point point;
+        if (m_dragPacer.TakePending(point))
         {
-                m_detachPending = true;
+                POINT pt = { point.x, point.y };
+                UpdateDrag(pt);
         }
-        else
+}
+
+void CAddressBar::ArmDragFrameTimer()
+{
+        if (m_dragFrameTimer)
+                return;
+
+        m_dragFrameTimer = CEUtil::ScheduleUiTimer(m_dragPacer.GetDelayUntilDue(GetTickCount64()), [this]()
+        {
+                OnDragFrameTimer();
+        });
+}
+
+/*
+ * OnDragFrameTimer: Deliver the latest coalesced mouse move once its frame is due.
+ */
+void CAddressBar::OnDragFrameTimer()
+{
+        m_dragFrameTimer = 0;
+
+        DragPacer::Point point;
+        if (m_dragPacer.TakeDue(GetTickCount64(), point))
         {
-                m_detachPending = false;
+                POINT pt = { point.x, point.y };
+                UpdateDrag(pt);
         }
+
+        if (m_dragPacer.HasPending())
+        {
+                ArmDragFrameTimer();
+        }
+}
+
+bool CAddressBar::IsOutsideDetachZone(const POINT &pt) const
+{
+        RECT clientRect;
+        GetClientRect(&clientRect);
+        return pt.y < clientRect.top - kDetachThreshold || pt.y > clientRect.bottom + kDetachThreshold;
 }
 
 void CAddressBar::CommitDrag(const POINT &pt)
@@ -1148,6 +1627,13 @@ void CAddressBar::CommitDrag(const POINT &pt)
 
 void CAddressBar::CancelDrag()
 {
+        m_dragPacer.Reset();
+        if (m_dragFrameTimer)
+        {
+                CEUtil::CancelUiTimer(m_dragFrameTimer);
+                m_dragFrameTimer = 0;
+        }
+
         m_draggingTab = false;
         m_draggingGroup = false;
         m_dragClickCandidate = false;
@@ -1168,7 +1654,10 @@ void CAddressBar::DetachDraggedTab()
 
         Tab tab = std::move(m_groups[m_draggedGroupIndex].tabs[m_draggedTabIndex]);
         m_groups[m_draggedGroupIndex].tabs.erase(m_groups[m_draggedGroupIndex].tabs.begin() + m_draggedTabIndex);
+        CEDiagnostics::Navigations().ForgetTab(GetNavigationWindowKey(), tab.id);
         RemoveEmptyGroups();
+        m_layoutDirty = true;
+        InvalidateRect(nullptr, TRUE);
         CreateNewWindowForTab(tab);
 }
 
@@ -1179,27 +1668,9 @@ void CAddressBar::ReorderTab(int targetGroup, int targetIndex)
         if (m_draggedTabIndex < 0 || m_draggedTabIndex >= static_cast<int>(m_groups[m_draggedGroupIndex].tabs.size()))
                 return;
 
-        Tab movingTab = std::move(m_groups[m_draggedGroupIndex].tabs[m_draggedTabIndex]);
-        m_groups[m_draggedGroupIndex].tabs.erase(m_groups[m_draggedGroupIndex].tabs.begin() + m_draggedTabIndex);
-
-        if (targetGroup == m_draggedGroupIndex && targetIndex > m_draggedTabIndex)
-                --targetIndex;
-
-        if (m_groups[m_draggedGroupIndex].tabs.empty() && m_groups.size() > 1)
-        {
-                if (targetGroup > m_draggedGroupIndex)
-                        --targetGroup;
-                m_groups.erase(m_groups.begin() + m_draggedGroupIndex);
-                if (m_activeGroup > m_draggedGroupIndex && m_activeGroup > 0)
-                        --m_activeGroup;
-        }
-
-        targetGroup = std::clamp(targetGroup, 0, static_cast<int>(m_groups.size() - 1));
-        targetIndex = std::clamp(targetIndex, 0, static_cast<int>(m_groups[targetGroup].tabs.size()));
-
-        m_groups[targetGroup].tabs.insert(m_groups[targetGroup].tabs.begin() + targetIndex, std::move(movingTab));
-        m_activeGroup = targetGroup;
-        m_activeTab = targetIndex;
+        TabRef moved = TabOrder::MoveTab(m_groups, { m_draggedGroupIndex, m_draggedTabIndex }, { targetGroup, targetIndex });
+        m_activeGroup = moved.groupIndex;
+        m_activeTab = moved.tabIndex;
         RefreshActiveState();
 }
 
@@ -1208,15 +1679,7 @@ void CAddressBar::ReorderGroup(int targetIndex)
         if (m_draggedGroupIndex < 0 || m_draggedGroupIndex >= static_cast<int>(m_groups.size()))
                 return;
 
-        TabGroup movingGroup = std::move(m_groups[m_draggedGroupIndex]);
-        m_groups.erase(m_groups.begin() + m_draggedGroupIndex);
-
-        if (targetIndex > m_draggedGroupIndex)
-                --targetIndex;
-        targetIndex = std::clamp(targetIndex, 0, static_cast<int>(m_groups.size()));
-
-        m_groups.insert(m_groups.begin() + targetIndex, std::move(movingGroup));
-        m_activeGroup = targetIndex;
+        m_activeGroup = TabOrder::MoveGroup(m_groups, m_draggedGroupIndex, targetIndex);
         m_activeTab = std::clamp(m_activeTab, 0, static_cast<int>(m_groups[m_activeGroup].tabs.size()) - 1);
         RefreshActiveState();
 }
@@ -1235,16 +1698,22 @@ std::vector<std::wstring> CAddressBar::ExtractFilePathsFromDataObject(IDataObjec
         STGMEDIUM medium = {};
         if (SUCCEEDED(dataObject->GetData(&fmt, &medium)))
         {
-                HDROP drop = static_cast<HDROP>(GlobalLock(medium.hGlobal));
+                const BYTE *drop = static_cast<const BYTE *>(GlobalLock(medium.hGlobal));
                 if (drop)
                 {
-                        UINT count = DragQueryFileW(drop, 0xFFFFFFFF, nullptr, 0);
-                        for (UINT i = 0; i < count; ++i)
+                        // Read the whole list in one pass; only ANSI lists need DragQueryFileW.
+                        if (!DropParsing::ParseDropFiles(drop, GlobalSize(medium.hGlobal), paths))
                         {
-                        UINT length = DragQueryFileW(drop, i, nullptr, 0);
-                        std::wstring buffer(length + 1, L'\0');
-                        DragQueryFileW(drop, i, buffer.data(), length + 1);
-                        paths.push_back(buffer.c_str());
+                                paths.clear();
+                                HDROP hDrop = reinterpret_cast<HDROP>(const_cast<BYTE *>(drop));
+                                UINT count = DragQueryFileW(hDrop, 0xFFFFFFFF, nullptr, 0);
+                                for (UINT i = 0; i < count; ++i)
+                                {
+                                        UINT length = DragQueryFileW(hDrop, i, nullptr, 0);
+                                        std::wstring buffer(length + 1, L'\0');
+                                        DragQueryFileW(hDrop, i, buffer.data(), length + 1);
+                                        paths.push_back(buffer.c_str());
+                                }
                         }
                         GlobalUnlock(medium.hGlobal);
                 }
@@ -1256,13 +1725,15 @@ std::vector<std::wstring> CAddressBar::ExtractFilePathsFromDataObject(IDataObjec
         FORMATETC fmtShell = { RegisterClipboardFormat(CFSTR_SHELLIDLIST), nullptr, DVASPECT_CONTENT, -1, TYMED_HGLOBAL };
         if (SUCCEEDED(dataObject->GetData(&fmtShell, &medium)))
         {
-                CIDA *cIda = static_cast<CIDA *>(GlobalLock(medium.hGlobal));
-                if (cIda)
+                const BYTE *cIda = static_cast<const BYTE *>(GlobalLock(medium.hGlobal));
+                size_t folderOffset = 0;
+                std::vector<size_t> itemOffsets;
+                if (cIda && DropParsing::ParseCida(cIda, GlobalSize(medium.hGlobal), folderOffset, itemOffsets))
                 {
-                        for (UINT i = 0; i < cIda->cidl; ++i)
+                        LPCITEMIDLIST folder = reinterpret_cast<LPCITEMIDLIST>(cIda + folderOffset);
+                        for (size_t itemOffset : itemOffsets)
                         {
-                                LPCITEMIDLIST folder = reinterpret_cast<LPCITEMIDLIST>(reinterpret_cast<const BYTE *>(cIda) + cIda->aoffset[0]);
-                                LPCITEMIDLIST relative = reinterpret_cast<LPCITEMIDLIST>(reinterpret_cast<const BYTE *>(cIda) + cIda->aoffset[i + 1]);
+                                LPCITEMIDLIST relative = reinterpret_cast<LPCITEMIDLIST>(cIda + itemOffset);
                                 PIDLIST_ABSOLUTE absolute = ILCombine(folder, relative);
                                 if (absolute)
                                 {
@@ -1274,8 +1745,9 @@ std::vector<std::wstring> CAddressBar::ExtractFilePathsFromDataObject(IDataObjec
                                         CoTaskMemFree(absolute);
                                 }
                         }
-                        GlobalUnlock(medium.hGlobal);
                 }
+                if (cIda)
+                        GlobalUnlock(medium.hGlobal);
                 ReleaseStgMedium(&medium);
         }
 
@@ -6,12 +6,19 @@
 #include "ClassicExplorer_i.h"
 #include "dllmain.h"
 #include "util/util.h"
+#include "util/text_fit.h"
+#include "util/tab_layout.h"
+#include "util/id_list.h"
+#include "util/drag_pacer.h"
+#include "util/ui_timers.h"
+#include "TabRenderCache.h"
 
 #include <shlobj.h>
 #include <shlwapi.h>
 #include <shellapi.h>
 #include <vector>
 #include <array>
+#include <functional>
 #include <memory>
 
 class CAddressBar;
@@ -47,6 +54,9 @@ private:
         {
                 PIDLIST_ABSOLUTE pidl = nullptr;
 
+                // Lets FindTabByPidl compare bytes before asking the Shell.
+                IdList::Key key;
+
                 UniquePidl() = default;
                 explicit UniquePidl(PIDLIST_ABSOLUTE source)
                 {
@@ -56,13 +66,18 @@ private:
                 UniquePidl(const UniquePidl &other)
                 {
                         if (other.pidl)
+                        {
                                 pidl = ILCloneFull(other.pidl);
+                                key = other.key;
+                        }
                 }
 
                 UniquePidl(UniquePidl &&other) noexcept
                 {
                         pidl = other.pidl;
+                        key = other.key;
                         other.pidl = nullptr;
+                        other.key = IdList::Key();
                 }
 
                 UniquePidl &operator=(const UniquePidl &other)
@@ -80,7 +95,9 @@ private:
                         {
                                 reset();
                                 pidl = other.pidl;
+                                key = other.key;
                                 other.pidl = nullptr;
+                                other.key = IdList::Key();
                         }
                         return *this;
                 }
@@ -101,6 +118,7 @@ private:
                         {
                                 pidl = ILCloneFull(source);
                         }
+                        key = pidl ? IdList::MakeKey(reinterpret_cast<const unsigned char *>(pidl)) : IdList::Key();
                 }
         };
 
@@ -110,6 +128,12 @@ private:
                 std::wstring title;
                 RECT bounds = {0};
                 bool active = false;
+
+                // Identifies the tab to the navigation tracer. Never reused within a window.
+                unsigned int id = 0;
+
+                // Measured lazily by EnsureTitleMetrics.
+                mutable TextFit::TitleMetrics titleMetrics;
         };
 
         struct TabGroup
@@ -120,13 +144,8 @@ private:
                 RECT bounds = {0};
         };
 
-        struct HitTestResult
-        {
-                bool valid = false;
-                bool groupHandle = false;
-                int groupIndex = -1;
-                int tabIndex = -1;
-        };
+        using HitTestResult = TabLayout::HitTestResult;
+        using TabRef = TabLayout::TabRef;
 
 public:
         DECLARE_WND_CLASS(L"ClassicExplorer.TabBar")
@@ -140,8 +159,11 @@ public:
                 MESSAGE_HANDLER(WM_LBUTTONDOWN, OnLButtonDown)
                 MESSAGE_HANDLER(WM_LBUTTONUP, OnLButtonUp)
                 MESSAGE_HANDLER(WM_MOUSEMOVE, OnMouseMove)
+                MESSAGE_HANDLER(WM_MOUSEWHEEL, OnMouseWheel)
+                MESSAGE_HANDLER(WM_MOUSEHWHEEL, OnMouseWheel)
                 MESSAGE_HANDLER(WM_CONTEXTMENU, OnContextMenu)
                 MESSAGE_HANDLER(WM_CAPTURECHANGED, OnCaptureChanged)
+                MESSAGE_HANDLER(CE_WM_SETTINGSCHANGED, OnSettingsChanged)
         END_MSG_MAP()
 
         HWND GetToolbar() const { return m_hWnd; }
@@ -151,6 +173,9 @@ public:
         void OnExplorerNavigate();
         SIZE GetDesiredSize() const;
 
+        // Called when GetDesiredSize changes, so the host band can ask for a new band size.
+        void SetDesiredSizeChangedHandler(std::function<void()> handler) { m_onDesiredSizeChanged = std::move(handler); }
+
         void HandleExternalDragEnter(DWORD keyState, POINTL pt, IDataObject *pDataObject);
         void HandleExternalDragOver(DWORD keyState, POINTL pt);
         void HandleExternalDragLeave();
@@ -167,23 +192,35 @@ private:
         LRESULT OnLButtonDown(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
         LRESULT OnLButtonUp(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
         LRESULT OnMouseMove(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+        LRESULT OnMouseWheel(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
         LRESULT OnContextMenu(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
         LRESULT OnCaptureChanged(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+        LRESULT OnSettingsChanged(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
 
         // layout helpers
         void LoadSettings();
+        bool ApplySettings(const CEUtil::CESettings &settings);
         void EnsureDefaultGroup();
         void LayoutTabs();
         void LayoutTabsIfNeeded();
-        int CalculateTabWidth(HDC hdc, const std::wstring &text) const;
+        int CalculateTabWidth(HDC hdc, const Tab &tab) const;
+        void EnsureTitleMetrics(HDC hdc, const Tab &tab) const;
+        int GetLayoutTabWidth(const Tab &tab, unsigned long long fontKey, int averageCharWidth) const;
+        TabLayout::Metrics GetLayoutMetrics() const;
+        bool IsValidTabRef(const TabRef &ref) const;
+        void ScrollBy(int delta);
+        bool EnsureTabVisible(int groupIndex, int tabIndex);
+        void ShowOverflowMenu(POINT screenPoint);
         void RefreshActiveState();
 
         // painting helpers
         void DrawBackground(HDC hdc, const RECT &clientRect) const;
-        void DrawGroup(HDC hdc, const TabGroup &group) const;
         void DrawTab(HDC hdc, const Tab &tab, COLORREF groupColor) const;
+        void RenderTab(HDC hdc, const RECT &bounds, const Tab &tab, COLORREF groupColor) const;
         void DrawGroupHandle(HDC hdc, const TabGroup &group) const;
+        void DrawChevron(HDC hdc) const;
         void DrawGhost(HDC hdc) const;
+        void DrawLatencyOverlay(HDC hdc, const RECT &clientRect) const;
         void DrawDropHover(HDC hdc) const;
         static COLORREF AdjustColor(COLORREF color, double factor);
 
@@ -191,8 +228,10 @@ private:
         HRESULT AddTabForLocation(PIDLIST_ABSOLUTE pidl, bool makeActive, bool navigate, COLORREF colorOverride = RGB(180, 200, 235));
         void RemoveEmptyGroups();
         void ActivateTab(int groupIndex, int tabIndex, bool navigate);
-        void ActivateTabByPidl(PIDLIST_ABSOLUTE pidl);
+        TabRef FindTabByPidl(PCIDLIST_ABSOLUTE pidl) const;
+        bool ActivateTabByPidl(PIDLIST_ABSOLUTE pidl);
         void UpdateActiveTabFromExplorer();
+        uintptr_t GetNavigationWindowKey() const;
         void CreateNewWindowForTab(const Tab &tab);
         std::wstring GetTabFilesystemPath(const Tab &tab) const;
         void SetGroupColor(int groupIndex, COLORREF color);
@@ -207,6 +246,10 @@ private:
         void StartTabDrag(int groupIndex, int tabIndex, const POINT &pt);
         void StartGroupDrag(int groupIndex, const POINT &pt);
         void UpdateDrag(const POINT &pt);
+        void FlushPendingDrag();
+        void ArmDragFrameTimer();
+        void OnDragFrameTimer();
+        bool IsOutsideDetachZone(const POINT &pt) const;
         void CommitDrag(const POINT &pt);
         void CancelDrag();
         void DetachDraggedTab();
@@ -223,6 +266,7 @@ private:
         CComPtr<ExplorerTabDropTarget> m_dropTarget;
 
         std::vector<TabGroup> m_groups;
+        mutable TabRenderCache m_tabRenderCache;
         bool m_layoutDirty = true;
         bool m_autoSizeTabs = true;
         SIZE m_fixedTabSize = {180, 32};
@@ -239,6 +283,16 @@ private:
         int m_activeGroup = 0;
         int m_activeTab = 0;
         int m_totalHeight = 0;
+        unsigned int m_nextTabId = 1;
+
+        unsigned long long m_settingsSubscription = 0;
+        std::function<void()> m_onDesiredSizeChanged;
+
+        // Virtualisation: only tabs visible in m_stripLayout are measured, painted and hit-tested.
+        // When the strip overflows, its last row scrolls horizontally.
+        TabLayout::StripLayout m_stripLayout;
+        int m_chevronWidth = 16;
+        int m_scrollOffset = 0;
 
         bool m_draggingTab = false;
         bool m_draggingGroup = false;
@@ -253,6 +307,10 @@ private:
         int m_pendingDropGroup = -1;
         int m_pendingDropTab = -1;
 
+        // Mouse moves during a drag are coalesced to one UpdateDrag per frame.
+        DragPacer m_dragPacer;
+        CEUtil::UiTimerId m_dragFrameTimer = 0;
+
         int m_dropHoverGroup = -1;
         int m_dropHoverTab = -1;
 
@@ -18,6 +18,8 @@
 #include "ClassicExplorer_i.h"
 #include "dllmain.h"
 #include <commoncontrols.h>
+#include "util/trace.h"
+#include "util/diagnostics.h"
 
 #include "AddressBarHostBand.h"
 
@@ -151,6 +153,7 @@ STDMETHODIMP CAddressBarHostBand::SetSite(IUnknown *pUnkSite)
 		m_parentWindow = GetAncestor(hWndParent, GA_ROOT);
 
 		// Create the toolbar window proper:
+		m_addressBar.SetDesiredSizeChangedHandler([this]() { NotifyBandInfoChanged(); });
 		m_addressBar.Create(hWndParent, NULL, NULL, WS_CHILD);
 		//m_addressBar.CreateBand(hWndParent);
 
@@ -192,15 +195,88 @@ STDMETHODIMP CAddressBarHostBand::SetSite(IUnknown *pUnkSite)
 // handle DWebBrowserEvents2:
 //
 
+/*
+ * The host band is the one sink which feeds navigation events to the tracer; the other bands
+ * and the BHO only report their own work.
+ */
+
+static void WriteNavigationRecord(const NavigationTracer::Record &record)
+{
+        if (CETrace::IsEnabled())
+        {
+                CETrace::WriteNavigation(record.tabId, record.requested, record.failed, record.GetTotalNs(),
+                        record.ownNs, record.GetShellNs());
+        }
+}
+
+STDMETHODIMP CAddressBarHostBand::OnBeforeNavigate(IDispatch *pDisp, VARIANT *url, VARIANT *flags, VARIANT *targetFrameName,
+        VARIANT *postData, VARIANT *headers, VARIANT_BOOL *cancel)
+{
+        UNREFERENCED_PARAMETER(url);
+        UNREFERENCED_PARAMETER(flags);
+        UNREFERENCED_PARAMETER(targetFrameName);
+        UNREFERENCED_PARAMETER(postData);
+        UNREFERENCED_PARAMETER(headers);
+        UNREFERENCED_PARAMETER(cancel);
+
+        if (m_pWebBrowser.IsEqualObject(pDisp))
+        {
+                CEDiagnostics::Navigations().BeforeNavigate(reinterpret_cast<uintptr_t>(m_parentWindow), CETrace::Now());
+        }
+
+        return S_OK;
+}
+
 STDMETHODIMP CAddressBarHostBand::OnNavigateComplete(IDispatch *pDisp, VARIANT *url)
 {
-        UNREFERENCED_PARAMETER(pDisp);
         UNREFERENCED_PARAMETER(url);
+
+        if (m_pWebBrowser.IsEqualObject(pDisp))
+        {
+                CEDiagnostics::Navigations().NavigateComplete(reinterpret_cast<uintptr_t>(m_parentWindow), CETrace::Now());
+        }
+
         m_addressBar.OnExplorerNavigate();
 
         return S_OK;
 }
 
+STDMETHODIMP CAddressBarHostBand::OnDocumentComplete(IDispatch *pDisp, VARIANT *url)
+{
+        UNREFERENCED_PARAMETER(url);
+
+        if (!m_pWebBrowser.IsEqualObject(pDisp))
+                return S_OK;
+
+        NavigationTracer::Record record;
+        if (CEDiagnostics::Navigations().DocumentComplete(reinterpret_cast<uintptr_t>(m_parentWindow), CETrace::Now(), record))
+        {
+                WriteNavigationRecord(record);
+        }
+
+        return S_OK;
+}
+
+STDMETHODIMP CAddressBarHostBand::OnNavigateError(IDispatch *pDisp, VARIANT *url, VARIANT *targetFrameName,
+        VARIANT *statusCode, VARIANT_BOOL *cancel)
+{
+        UNREFERENCED_PARAMETER(url);
+        UNREFERENCED_PARAMETER(targetFrameName);
+        UNREFERENCED_PARAMETER(statusCode);
+        UNREFERENCED_PARAMETER(cancel);
+
+        if (!m_pWebBrowser.IsEqualObject(pDisp))
+                return S_OK;
+
+        NavigationTracer::Record record;
+        if (CEDiagnostics::Navigations().NavigateError(reinterpret_cast<uintptr_t>(m_parentWindow), CETrace::Now(), record))
+        {
+                WriteNavigationRecord(record);
+        }
+
+        return S_OK;
+}
+
 /**
  * OnQuit: Called when the user attempts to quit the Shell browser.
  * 
@@ -212,6 +288,8 @@ STDMETHODIMP CAddressBarHostBand::OnNavigateComplete(IDispatch *pDisp, VARIANT *
  */
 STDMETHODIMP CAddressBarHostBand::OnQuit()
 {
+        CEDiagnostics::Navigations().ForgetWindow(reinterpret_cast<uintptr_t>(m_parentWindow));
+
 	if (m_pWebBrowser && m_dwEventCookie != 0xFEFEFEFE)
 	{
 		return DispEventUnadvise(m_pWebBrowser, &DIID_DWebBrowserEvents2);
@@ -254,4 +332,17 @@ STDMETHODIMP CAddressBarHostBand::UIActivateIO(BOOL fActivate, MSG *pMsg)
 STDMETHODIMP CAddressBarHostBand::OnFocusChangeIS(IUnknown *pUnkObj, BOOL fSetFocus)
 {
 	return E_NOTIMPL;
-}
\ No newline at end of file
+}
+
+/*
+ * NotifyBandInfoChanged: Ask the band site to call GetBandInfo again, e.g. after the tab
+ *                        height setting changed.
+ */
+void CAddressBarHostBand::NotifyBandInfoChanged()
+{
+        CComQIPtr<IOleCommandTarget> pTarget = m_spUnkSite;
+        if (pTarget)
+        {
+                pTarget->Exec(&CGID_DeskBand, DBID_BANDINFOCHANGED, OLECMDEXECOPT_DONTPROMPTUSER, NULL, NULL);
+        }
+}
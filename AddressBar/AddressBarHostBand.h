@@ -29,7 +29,10 @@ class ATL_NO_VTABLE CAddressBarHostBand :
 		DECLARE_REGISTRY_RESOURCEID_V2_WITHOUT_MODULE(IDR_CLASSICEXPLORER, CAddressBarHostBand)
 
 		BEGIN_SINK_MAP(CAddressBarHostBand)
+			SINK_ENTRY_EX(1, DIID_DWebBrowserEvents2, DISPID_BEFORENAVIGATE2, OnBeforeNavigate)
 			SINK_ENTRY_EX(1, DIID_DWebBrowserEvents2, DISPID_NAVIGATECOMPLETE2, OnNavigateComplete)
+			SINK_ENTRY_EX(1, DIID_DWebBrowserEvents2, DISPID_DOCUMENTCOMPLETE, OnDocumentComplete)
+			SINK_ENTRY_EX(1, DIID_DWebBrowserEvents2, DISPID_NAVIGATEERROR, OnNavigateError)
 			SINK_ENTRY_EX(1, DIID_DWebBrowserEvents2, DISPID_ONQUIT, OnQuit)
 		END_SINK_MAP()
 
@@ -68,7 +71,12 @@ class ATL_NO_VTABLE CAddressBarHostBand :
 		STDMETHOD(ShowDW)(BOOL fShow);
 
 		// handle DWebBrowserEvents2:
+		STDMETHOD(OnBeforeNavigate)(IDispatch *pDisp, VARIANT *url, VARIANT *flags, VARIANT *targetFrameName,
+			VARIANT *postData, VARIANT *headers, VARIANT_BOOL *cancel);
 		STDMETHOD(OnNavigateComplete)(IDispatch *pDisp, VARIANT *url);
+		STDMETHOD(OnDocumentComplete)(IDispatch *pDisp, VARIANT *url);
+		STDMETHOD(OnNavigateError)(IDispatch *pDisp, VARIANT *url, VARIANT *targetFrameName,
+			VARIANT *statusCode, VARIANT_BOOL *cancel);
 		STDMETHOD(OnQuit)(void);
 
 		// implement IInputObject:
@@ -78,6 +86,9 @@ class ATL_NO_VTABLE CAddressBarHostBand :
 
 		// implement IInputObjectSite:
 		STDMETHOD(OnFocusChangeIS)(IUnknown *pUnkObj, BOOL fSetFocus);
+
+	protected:
+		void NotifyBandInfoChanged();
 };
 
 OBJECT_ENTRY_AUTO(__uuidof(CAddressBarHostBand), CAddressBarHostBand);
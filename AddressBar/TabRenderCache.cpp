@@ -0,0 +1,223 @@
+/*
+ * TabRenderCache.cpp: Implements the rendered-tab atlas used by the tab bar.
+ *
+ * See TabRenderCache.h for an overview.
+ */
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "TabRenderCache.h"
+
+size_t TabRenderCache::KeyHash::operator()(const Key &key) const
+{
+        size_t hash = std::hash<std::wstring>()(key.title);
+        auto combine = [&hash](size_t value)
+        {
+                hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        };
+        combine(static_cast<size_t>(key.width));
+        combine(static_cast<size_t>(key.height));
+        combine(static_cast<size_t>(key.color));
+        combine(key.active ? 1 : 0);
+        return hash;
+}
+
+TabRenderCache::~TabRenderCache()
+{
+        Clear();
+}
+
+/*
+ * Configure: Set the slot size of the atlas. This must be at least as large as the largest
+ *            tab which will be drawn; changing it discards every cached tab.
+ */
+void TabRenderCache::Configure(int slotWidth, int slotHeight)
+{
+        if (slotWidth == m_slotWidth && slotHeight == m_slotHeight)
+                return;
+
+        Clear();
+        m_slotWidth = slotWidth;
+        m_slotHeight = slotHeight;
+}
+
+void TabRenderCache::SetMemoryCap(size_t bytes)
+{
+        m_memoryCap = bytes;
+        if (m_stats.bytesInUse > m_memoryCap)
+                Clear();
+}
+
+void TabRenderCache::Clear()
+{
+        for (Page &page : m_pages)
+        {
+                SelectObject(page.dc, page.oldBitmap);
+                DeleteObject(page.bitmap);
+                DeleteDC(page.dc);
+        }
+
+        m_pages.clear();
+        m_freeSlots.clear();
+        m_entries.clear();
+        m_lru.clear();
+        m_stats.bytesInUse = 0;
+        m_stats.entries = 0;
+}
+
+/*
+ * Draw: Blit the rendered tab described by key to destination, rendering it into the atlas
+ *       first if it isn't cached yet. dpi is that of the window being painted.
+ *
+ * Returns false if the tab could not be cached (for example if it is larger than a slot), in
+ * which case nothing is drawn and the caller must paint the tab directly.
+ */
+bool TabRenderCache::Draw(HDC hdc, UINT dpi, const Key &key, const POINT &destination, const RenderFunction &render)
+{
+        if (key.width <= 0 || key.height <= 0 || key.width > m_slotWidth || key.height > m_slotHeight)
+                return false;
+
+        SyncDeviceContext(hdc, dpi);
+
+        auto it = m_entries.find(key);
+        if (it != m_entries.end())
+        {
+                m_stats.hits++;
+                m_lru.splice(m_lru.begin(), m_lru, it->second.lruPosition);
+        }
+        else
+        {
+                m_stats.misses++;
+
+                SlotRef slot;
+                if (!AcquireSlot(hdc, slot))
+                        return false;
+
+                const Page &page = m_pages[slot.page];
+                RECT slotRect = GetSlotRect(slot);
+                RECT renderRect = { slotRect.left, slotRect.top, slotRect.left + key.width, slotRect.top + key.height };
+
+                HGDIOBJ oldFont = SelectObject(page.dc, m_font);
+                render(page.dc, renderRect);
+                SelectObject(page.dc, oldFont);
+
+                m_lru.push_front(key);
+                Entry entry;
+                entry.slot = slot;
+                entry.lruPosition = m_lru.begin();
+                it = m_entries.emplace(key, entry).first;
+                m_stats.entries = m_entries.size();
+        }
+
+        const SlotRef &slot = it->second.slot;
+        RECT slotRect = GetSlotRect(slot);
+        BitBlt(
+                hdc,
+                destination.x,
+                destination.y,
+                key.width,
+                key.height,
+                m_pages[slot.page].dc,
+                slotRect.left,
+                slotRect.top,
+                SRCCOPY
+        );
+
+        return true;
+}
+
+/*
+ * SyncDeviceContext: Flush the cache if the font of the target DC or the DPI differs from the
+ *                    one the cached tabs were rendered with.
+ */
+bool TabRenderCache::SyncDeviceContext(HDC hdc, UINT dpi)
+{
+        HGDIOBJ font = GetCurrentObject(hdc, OBJ_FONT);
+
+        if (font == m_font && dpi == m_dpi)
+                return false;
+
+        Clear();
+        m_font = font;
+        m_dpi = dpi;
+        return true;
+}
+
+/*
+ * AcquireSlot: Find a slot for a new entry: a free slot if there is one, otherwise a slot in a
+ *              new page if the memory cap allows it, otherwise the least recently used slot.
+ */
+bool TabRenderCache::AcquireSlot(HDC hdc, SlotRef &slotOut)
+{
+        if (m_freeSlots.empty() && m_stats.bytesInUse + GetPageBytes() <= m_memoryCap)
+        {
+                AddPage(hdc);
+        }
+
+        if (!m_freeSlots.empty())
+        {
+                slotOut = m_freeSlots.back();
+                m_freeSlots.pop_back();
+                return true;
+        }
+
+        if (m_lru.empty())
+                return false;
+
+        auto victim = m_entries.find(m_lru.back());
+        slotOut = victim->second.slot;
+        m_entries.erase(victim);
+        m_lru.pop_back();
+        m_stats.evictions++;
+        m_stats.entries = m_entries.size();
+        return true;
+}
+
+bool TabRenderCache::AddPage(HDC hdc)
+{
+        if (m_slotWidth <= 0 || m_slotHeight <= 0)
+                return false;
+
+        Page page;
+        page.dc = CreateCompatibleDC(hdc);
+        if (!page.dc)
+                return false;
+
+        page.bitmap = CreateCompatibleBitmap(hdc, m_slotWidth * kColumnsPerPage, m_slotHeight * kRowsPerPage);
+        if (!page.bitmap)
+        {
+                DeleteDC(page.dc);
+                return false;
+        }
+
+        page.oldBitmap = SelectObject(page.dc, page.bitmap);
+
+        int pageIndex = static_cast<int>(m_pages.size());
+        m_pages.push_back(page);
+        for (int slot = kSlotsPerPage - 1; slot >= 0; --slot)
+        {
+                m_freeSlots.push_back({ pageIndex, slot });
+        }
+
+        m_stats.bytesInUse += GetPageBytes();
+        return true;
+}
+
+RECT TabRenderCache::GetSlotRect(const SlotRef &slot) const
+{
+        int column = slot.slot % kColumnsPerPage;
+        int row = slot.slot / kColumnsPerPage;
+        RECT rect = {
+                column * m_slotWidth,
+                row * m_slotHeight,
+                (column + 1) * m_slotWidth,
+                (row + 1) * m_slotHeight
+        };
+        return rect;
+}
+
+size_t TabRenderCache::GetPageBytes() const
+{
+        return static_cast<size_t>(m_slotWidth) * m_slotHeight * kSlotsPerPage * 4;
+}
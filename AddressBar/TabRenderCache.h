@@ -0,0 +1,120 @@
+#pragma once
+
+#ifndef _TABRENDERCACHE_H
+#define _TABRENDERCACHE_H
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * TabRenderCache: Keeps fully rendered tabs in a set of atlas pages, so that repainting a tab
+ *                 whose title, size, colour and active state haven't changed is a single BitBlt
+ *                 instead of a fill, a border and a full DrawTextW layout.
+ *
+ * Every page is a compatible bitmap split into a grid of equally-sized slots (the maximum tab
+ * width by the row height). Slots are recycled in least-recently-used order once the pages
+ * reach the memory cap. Entries are only valid for the font of the DC and the DPI of the window
+ * they were rendered for, so a change in either flushes the whole cache.
+ */
+class TabRenderCache
+{
+public:
+        struct Key
+        {
+                std::wstring title;
+                int width = 0;
+                int height = 0;
+                COLORREF color = 0;
+                bool active = false;
+
+                bool operator==(const Key &other) const
+                {
+                        return width == other.width && height == other.height && color == other.color &&
+                                active == other.active && title == other.title;
+                }
+        };
+
+        struct Stats
+        {
+                unsigned long long hits = 0;
+                unsigned long long misses = 0;
+                unsigned long long evictions = 0;
+                size_t bytesInUse = 0;
+                size_t entries = 0;
+        };
+
+        // Renders a tab into the given rectangle of the given DC.
+        using RenderFunction = std::function<void(HDC hdc, const RECT &rect)>;
+
+        TabRenderCache() = default;
+        ~TabRenderCache();
+
+        TabRenderCache(const TabRenderCache &) = delete;
+        TabRenderCache &operator=(const TabRenderCache &) = delete;
+
+        void Configure(int slotWidth, int slotHeight);
+        void SetMemoryCap(size_t bytes);
+        void Clear();
+
+        bool Draw(HDC hdc, UINT dpi, const Key &key, const POINT &destination, const RenderFunction &render);
+
+        Stats GetStats() const { return m_stats; }
+
+private:
+        struct KeyHash
+        {
+                size_t operator()(const Key &key) const;
+        };
+
+        struct Page
+        {
+                HDC dc = nullptr;
+                HBITMAP bitmap = nullptr;
+                HGDIOBJ oldBitmap = nullptr;
+        };
+
+        struct SlotRef
+        {
+                int page = -1;
+                int slot = -1;
+        };
+
+        struct Entry
+        {
+                SlotRef slot;
+                std::list<Key>::iterator lruPosition;
+        };
+
+        static const int kColumnsPerPage = 4;
+        static const int kRowsPerPage = 8;
+        static const int kSlotsPerPage = kColumnsPerPage * kRowsPerPage;
+
+        bool SyncDeviceContext(HDC hdc, UINT dpi);
+        bool AcquireSlot(HDC hdc, SlotRef &slotOut);
+        bool AddPage(HDC hdc);
+        RECT GetSlotRect(const SlotRef &slot) const;
+        size_t GetPageBytes() const;
+
+private:
+        std::vector<Page> m_pages;
+        std::vector<SlotRef> m_freeSlots;
+        std::unordered_map<Key, Entry, KeyHash> m_entries;
+        std::list<Key> m_lru; // front = most recently used
+
+        int m_slotWidth = 0;
+        int m_slotHeight = 0;
+        size_t m_memoryCap = 16 * 1024 * 1024;
+
+        HGDIOBJ m_font = nullptr;
+        UINT m_dpi = 0;
+
+        Stats m_stats;
+};
+
+#endif // _TABRENDERCACHE_H
@@ -9,18 +9,36 @@
 #include "ClassicExplorer_i.h"
 #include "dllmain.h"
 #include <commoncontrols.h>
+#include <uxtheme.h>
 #include "util/util.h"
+#include "util/trace.h"
+#include "util/diagnostics.h"
 
 #include "BrandBand.h"
 
+#include <algorithm>
+
 void CBrandBand::ClearResources()
 {
-	DeleteObject(m_hBitmap);
+	CEUtil::UnsubscribeFromCESettings(m_settingsSubscription);
+	m_settingsSubscription = 0;
+
+	m_navigating = false;
+	UpdateAnimation();
+
+	for (auto &throbber : m_throbbers)
+		throbber.reset();
+	m_bitmap.reset();
+	m_themeData.reset();
+	ReleaseFrame();
 	m_pWebBrowser.Release();
 }
 
 /*
- * OnPaint: Paint the background and the logo.
+ * OnPaint: Paint the current frame of the band.
+ *
+ * This is a single AlphaBlend from the prebuilt frame, after the toolbar behind the band if any
+ * of the frame is transparent. No GDI objects are created here.
  */
 LRESULT CBrandBand::OnPaint(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
 {
@@ -30,43 +48,32 @@ LRESULT CBrandBand::OnPaint(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHand
 	HDC dc = BeginPaint(&paintInfo);
 	GetClientRect(&clientRect);
 
-	// Calculate destination point:
-	POINT destinationPoint;
-	destinationPoint.x = (clientRect.right - clientRect.left - m_cxCurBmp) / 2;
-	destinationPoint.y = (clientRect.bottom - clientRect.top - m_cyCurBmp) / 2;
+	if (!m_frameOpaque)
+		DrawThemeParentBackground(m_hWnd, dc, &clientRect);
 
-	COLORREF background;
-	if (m_theme == CLASSIC_EXPLORER_2K || m_theme == CLASSIC_EXPLORER_MEMPHIS)
+	if (m_frameDc)
 	{
-		background = RGB(0, 0, 0);
+		BLENDFUNCTION blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+		AlphaBlend(
+			dc,
+			0,
+			0,
+			m_frameWidth,
+			m_frameHeight,
+			m_frameDc,
+			(m_frame % m_frameSlots) * m_frameWidth,
+			0,
+			m_frameWidth,
+			m_frameHeight,
+			blend
+		);
+	}
+	else if (m_frameOpaque)
+	{
+		// Building the frame failed, so at least keep the band from showing garbage.
+		SetDCBrushColor(dc, m_themeData ? m_themeData->GetBackground() : RGB(0, 0, 0));
+		FillRect(dc, &clientRect, (HBRUSH)GetStockObject(DC_BRUSH));
 	}
-	else
-		background = RGB(255, 255, 255);
-
-	SetBkColor(dc, background);
-
-	// Draw the background
-	HBRUSH bgBrush = CreateSolidBrush(background);
-	FillRect(dc, &clientRect, bgBrush);
-	DeleteObject(bgBrush);
-
-	HDC sourceDc = CreateCompatibleDC(dc);
-	HBITMAP oldBitmap = (HBITMAP)SelectObject(sourceDc, m_hBitmap);
-
-	BitBlt(
-		dc, 
-		destinationPoint.x, 
-		destinationPoint.y, 
-		m_cxCurBmp, 
-		m_cyCurBmp, 
-		sourceDc, 
-		0, 
-		0, 
-		SRCCOPY
-	);
-
-	SelectObject(sourceDc, oldBitmap);
-	DeleteDC(sourceDc);
 
 	EndPaint(&paintInfo);
 
@@ -74,7 +81,7 @@ LRESULT CBrandBand::OnPaint(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHand
 }
 
 /*
- * OnSize: Handle size messages and reload the desired logo bitmap for the current size.
+ * OnSize: Handle size messages and pick the desired logo bitmap for the current size.
  */
 LRESULT CBrandBand::OnSize(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
 {
@@ -153,6 +160,10 @@ LRESULT CBrandBand::OnClick(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHand
         }
         AppendMenuW(hMenu, MF_POPUP | MF_STRING, (UINT_PTR)hFixedHeightMenu, L"Fixed tab height");
 
+        AppendMenuW(hMenu, MF_SEPARATOR, 0, 0);
+
+        AppendMenuW(hMenu, (CEDiagnostics::IsOverlayEnabled() ? MF_CHECKED : MF_UNCHECKED) | MF_STRING, 7030, L"Show latency overlay");
+
 	POINT p;
 	p.x = GET_X_LPARAM(lParam);
 	p.y = GET_Y_LPARAM(lParam);
@@ -165,6 +176,16 @@ LRESULT CBrandBand::OnClick(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHand
 
 	if(sel == 0) // Current theme selected, or outside click, nothing changes
 		return S_OK;
+
+        // The overlay is a process-wide debug switch rather than a setting, so it applies to
+        // the open windows right away.
+        if (sel == 7030)
+        {
+                CEDiagnostics::SetOverlayEnabled(!CEDiagnostics::IsOverlayEnabled());
+                if (CEUtil::AllowRelayout(hWnd, "RedrawGovernor.OverlayToggle"))
+                        RedrawWindow(::GetAncestor(hWnd, GA_ROOT), NULL, NULL, RDW_INVALIDATE | RDW_ALLCHILDREN);
+                return S_OK;
+        }
         switch (sel)
         {
         case 7000:
@@ -239,94 +260,267 @@ LRESULT CBrandBand::OnClick(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHand
                 break;
         }
         }
-	MessageBeep(0);
-	MessageBox(L"Open a new file explorer window to see the changes.");
+
+	// Every open window, this one included, picks the change up from CE_WM_SETTINGSCHANGED.
 	return S_OK;
 }
 
 /*
- * LoadBitmapForSize: Load the desired throbber icon for the current size of the band.
+ * OnSettingsChanged: The settings were changed, possibly by another window. Only the theme
+ *                    concerns the throbber.
+ */
+LRESULT CBrandBand::OnSettingsChanged(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+{
+	ClassicExplorerTheme theme = CEUtil::GetCESettingsSnapshot()->theme;
+	if (theme == m_theme)
+		return 0;
+
+	m_theme = theme;
+	AcquireTheme();
+	LoadBitmapForSize();
+	Invalidate();
+
+	return 0;
+}
+
+/*
+ * OnDpiChanged: The window was moved to a monitor with a different DPI.
+ */
+LRESULT CBrandBand::OnDpiChanged(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+{
+	AcquireTheme();
+	LoadBitmapForSize();
+	Invalidate();
+
+	// The width of the band scales with the throbbers.
+	CComQIPtr<IOleCommandTarget> pTarget = m_spUnkSite;
+	if (pTarget)
+	{
+		pTarget->Exec(&CGID_DeskBand, DBID_BANDINFOCHANGED, OLECMDEXECOPT_DONTPROMPTUSER, NULL, NULL);
+	}
+
+	return 0;
+}
+
+/*
+ * AcquireTheme: Switch to the process-wide description of the current theme, for the current
+ *               DPI. The throbbers are fetched from it as they are needed.
+ */
+void CBrandBand::AcquireTheme()
+{
+	// The DPI of the monitor the window is on; a DC would report the system DPI.
+	m_throbberDpi = (int)GetDpiForWindow(m_hWnd);
+
+	m_themeData = CEUtil::GetTheme(m_theme);
+	for (auto &throbber : m_throbbers)
+		throbber.reset();
+}
+
+/*
+ * ScaleForDpi: Scale a size in 96 DPI pixels to the DPI the throbbers are drawn for.
+ */
+int CBrandBand::ScaleForDpi(int value) const
+{
+	if (m_throbberDpi <= 0)
+		return value;
+
+	return MulDiv(value, m_throbberDpi, USER_DEFAULT_SCREEN_DPI);
+}
+
+/*
+ * LoadBitmapForSize: Select the desired throbber icon for the current size of the band.
+ *
+ * Each size is only fetched from the theme the first time it is needed, so resizing the band
+ * never touches the resource loader (or decodes anything) after that.
  */
 LRESULT CBrandBand::LoadBitmapForSize()
 {
 	RECT curRect;
 	GetClientRect(&curRect);
 
-	DeleteObject(m_hBitmap);
+	m_bitmap.reset();
+	if (m_themeData)
+	{
+		int size = (int)m_themeData->GetThrobberSizeForHeight(curRect.bottom - curRect.top, m_throbberDpi);
+		if (!m_throbbers[size])
+			m_throbbers[size] = m_themeData->GetThrobber((CEUtil::ThrobberSize)size, m_throbberDpi);
 
-	int cySelf = curRect.bottom - curRect.top;
-	int resourceId = IDB_10_THROBBER_SIZE_SMALL;
+		m_bitmap = m_throbbers[size];
+	}
+
+	m_cxCurBmp = m_bitmap ? m_bitmap->GetFrameWidth() : 0;
+	m_cyCurBmp = m_bitmap ? m_bitmap->GetHeight() : 0;
+
+	RebuildFrame();
+
+	UpdateAnimation();
+
+	return S_OK;
+}
+
+/*
+ * RebuildFrame: Compose every animation frame of the band, at its current size, into the
+ *               persistent frame DC.
+ *
+ * The background and the throbber are blended here once, premultiplied, so that painting is a
+ * single AlphaBlend and a throbber with an alpha channel needs no colour baked into it.
+ */
+void CBrandBand::RebuildFrame()
+{
+	CE_TRACE_SCOPE("BrandBand.RebuildFrame");
 
-	if (cySelf >= 38)
+	RECT clientRect;
+	GetClientRect(&clientRect);
+
+	int width = clientRect.right - clientRect.left;
+	int height = clientRect.bottom - clientRect.top;
+	int slots = m_bitmap ? m_bitmap->GetFrameCount() : 1;
+
+	COLORREF background = m_themeData ? m_themeData->GetBackground() : RGB(0, 0, 0);
+	m_frameOpaque = background != CLR_NONE;
+
+	if (width <= 0 || height <= 0)
 	{
-		switch (m_theme)
-		{
-		default:
-		case CLASSIC_EXPLORER_10:
-			resourceId = IDB_10_THROBBER_SIZE_LARGE;
-			break;
-		case CLASSIC_EXPLORER_2K:
-			resourceId = IDB_2K_THROBBER_SIZE_LARGE;
-			break;
-		case CLASSIC_EXPLORER_MEMPHIS:
-			resourceId = IDB_MEMPHIS_THROBBER_SIZE_LARGE;
-			break;
-		case CLASSIC_EXPLORER_XP:
-			resourceId = IDB_XP_THROBBER_SIZE_LARGE;
-			break;
-		}
+		ReleaseFrame();
+		return;
 	}
-	else if (cySelf >= 26)
+
+	if (!m_frameDc || width != m_frameWidth || height != m_frameHeight || slots != m_frameSlots)
 	{
-		switch (m_theme)
+		ReleaseFrame();
+
+		HDC windowDc = GetDC();
+		m_frameDc = CreateCompatibleDC(windowDc);
+		ReleaseDC(windowDc);
+
+		if (!m_frameDc)
+			return;
+
+		BITMAPINFO info = {};
+		info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		info.bmiHeader.biWidth = width * slots;
+		info.bmiHeader.biHeight = height;
+		info.bmiHeader.biPlanes = 1;
+		info.bmiHeader.biBitCount = 32;
+		info.bmiHeader.biCompression = BI_RGB;
+
+		void *bits = nullptr;
+		m_frameBitmap = CreateDIBSection(m_frameDc, &info, DIB_RGB_COLORS, &bits, NULL, 0);
+		if (!m_frameBitmap)
 		{
-		default:
-		case CLASSIC_EXPLORER_10:
-			resourceId = IDB_10_THROBBER_SIZE_MID;
-			break;
-		case CLASSIC_EXPLORER_2K:
-			resourceId = IDB_2K_THROBBER_SIZE_MID;
-			break;
-		case CLASSIC_EXPLORER_MEMPHIS:
-			resourceId = IDB_MEMPHIS_THROBBER_SIZE_MID;
-			break;
-		case CLASSIC_EXPLORER_XP:
-			resourceId = IDB_XP_THROBBER_SIZE_MID;
-			break;
+			ReleaseFrame();
+			return;
 		}
+
+		m_frameOldBitmap = SelectObject(m_frameDc, m_frameBitmap);
+		m_frameWidth = width;
+		m_frameHeight = height;
+		m_frameSlots = slots;
+	}
+
+	DIBSECTION section;
+	if (!GetObjectW(m_frameBitmap, sizeof(section), &section) || !section.dsBm.bmBits)
+		return;
+
+	GdiFlush();
+
+	uint32_t *pixels = static_cast<uint32_t *>(section.dsBm.bmBits);
+	int stride = width * slots;
+
+	uint32_t fill = 0;
+	if (m_frameOpaque)
+		fill = 0xFF000000 | (GetRValue(background) << 16) | (GetGValue(background) << 8) | GetBValue(background);
+	std::fill(pixels, pixels + static_cast<size_t>(stride) * height, fill);
+
+	if (m_bitmap)
+	{
+		int x = (width - m_cxCurBmp) / 2;
+		int y = (height - m_cyCurBmp) / 2;
+
+		for (int slot = 0; slot < slots; slot++)
+			m_bitmap->BlendInto(pixels + slot * width, stride, width, height, x, y, slot);
+	}
+}
+
+/*
+ * ReleaseFrame: Free the frame DC and its bitmap.
+ */
+void CBrandBand::ReleaseFrame()
+{
+	if (m_frameDc)
+	{
+		if (m_frameOldBitmap)
+			SelectObject(m_frameDc, m_frameOldBitmap);
+		DeleteDC(m_frameDc);
+	}
+
+	if (m_frameBitmap)
+		DeleteObject(m_frameBitmap);
+
+	m_frameDc = NULL;
+	m_frameBitmap = NULL;
+	m_frameOldBitmap = NULL;
+	m_frameWidth = 0;
+	m_frameHeight = 0;
+	m_frameSlots = 0;
+}
+
+/*
+ * UpdateAnimation: Start or stop animating the throbber.
+ *
+ * It only animates while a navigation is in flight and the band is visible, so idle windows
+ * never keep the shared animation timer running. The bundled throbbers are single frames, so
+ * with them it never runs at all.
+ */
+void CBrandBand::UpdateAnimation()
+{
+	bool shouldAnimate = m_navigating && IsWindow() && IsWindowVisible() && m_bitmap && m_themeData && m_bitmap->GetFrameCount() > 1;
+	if (shouldAnimate == m_animating)
+	{
+		// A new theme may animate at a different pace.
+		if (m_animating)
+			CEUtil::GetAnimationTimer().Register(m_hWnd, m_themeData->GetFrameInterval());
+		return;
+	}
+
+	m_animating = shouldAnimate;
+
+	if (m_animating)
+	{
+		m_animationStart = GetTickCount64();
+		CEUtil::GetAnimationTimer().Register(m_hWnd, m_themeData->GetFrameInterval());
 	}
 	else
 	{
-		switch (m_theme)
-		{
-		default:
-		case CLASSIC_EXPLORER_10:
-			resourceId = IDB_10_THROBBER_SIZE_SMALL;
-			break;
-		case CLASSIC_EXPLORER_2K:
-			resourceId = IDB_2K_THROBBER_SIZE_SMALL;
-			break;
-		case CLASSIC_EXPLORER_MEMPHIS:
-			resourceId = IDB_MEMPHIS_THROBBER_SIZE_SMALL;
-			break;
-		case CLASSIC_EXPLORER_XP:
-			resourceId = IDB_XP_THROBBER_SIZE_SMALL;
-			break;
-		}
+		CEUtil::GetAnimationTimer().Unregister(m_hWnd);
+
+		// Come to rest on the first frame.
+		m_frame = 0;
+		if (IsWindow())
+			Invalidate(FALSE);
 	}
+}
 
-	m_hBitmap = LoadBitmapW(
-		_AtlBaseModule.GetResourceInstance(),
-		MAKEINTRESOURCEW(resourceId)
-	);
+/*
+ * OnAnimationTick: Move the throbber on to the frame for the current time. The shared timer
+ *                  ticks at least as often as the theme's frame interval, and may tick more
+ *                  often for another window, so the frame is worked out from the clock.
+ */
+LRESULT CBrandBand::OnAnimationTick(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+{
+	// A tick may arrive just after the animation was stopped.
+	if (!m_animating || !m_bitmap || !m_themeData)
+		return 0;
 
-	BITMAP bmp;
-	GetObject(m_hBitmap, sizeof(bmp), &bmp);
+	unsigned long long elapsed = GetTickCount64() - m_animationStart;
+	int frame = (int)((elapsed / m_themeData->GetFrameInterval()) % m_bitmap->GetFrameCount());
+	if (frame == m_frame)
+		return 0;
 
-	m_cxCurBmp = bmp.bmWidth;
-	m_cyCurBmp = bmp.bmHeight;
+	m_frame = frame;
+	Invalidate(FALSE);
 
-	return S_OK;
+	return 0;
 }
 
 /* 
@@ -344,54 +538,115 @@ LRESULT CBrandBand::LoadBitmapForSize()
  */
 LRESULT CBrandBand::CorrectBandSize()
 {
-	RECT curRect;
-	GetClientRect(&curRect);
-
+	// Nothing that could change our height has happened since the last correction, e.g. the
+	// window was resized without the toolbars wrapping.
 	UINT initialTrHeight = ::SendMessageW(m_parentRebar, RB_GETROWHEIGHT, 0, 0);
+	if (initialTrHeight == m_correctedRowHeight && !m_bandLayoutChanged)
+		return S_OK;
+
+	CE_TRACE_SCOPE("BrandBand.CorrectBandSize");
+
+	// Resizing the band makes the rebar notify us again, so this is where a layout loop with
+	// Explorer would spin.
+	if (!CEUtil::AllowRelayout(m_hWnd, "RedrawGovernor.CorrectBandSize"))
+		return S_FALSE;
+
+	int index = FindBandIndex();
+	if (index < 0)
+		return E_FAIL;
+
+	// The notifications caused by our own changes below are not worth another pass.
+	m_correctingBandSize = true;
+
+	// Get the rebar info:
+	REBARBANDINFOW curBandInfo2;
+	curBandInfo2.cbSize = sizeof(REBARBANDINFOW);
+	curBandInfo2.fMask = RBBIM_SIZE | RBBIM_CHILDSIZE;
+	::SendMessageW(m_parentRebar, RB_GETBANDINFO, index, (LPARAM)&curBandInfo2);
+
+	// Set the bar to the minimum size possible.
+	// Yes, it was necessary to define all of these, or it would half in horizontal size
+	// every time this function was called.
+	curBandInfo2.fMask = RBBIM_CHILDSIZE;
+	curBandInfo2.cxMinChild = ScaleForDpi(38);
+	curBandInfo2.cyMinChild = ScaleForDpi(22);
+	curBandInfo2.cyChild = ScaleForDpi(22);
+	curBandInfo2.cyIntegral = 1;
+	::SendMessageW(m_parentRebar, RB_SETBANDINFOW, index, (LPARAM)&curBandInfo2);
+
+	// Resize the bar back up to what it should be: the size of the topmost row.
+	UINT topRowHeight = ::SendMessageW(m_parentRebar, RB_GETROWHEIGHT, 0, 0);
+	curBandInfo2.cyChild = topRowHeight;
+	::SendMessageW(m_parentRebar, RB_SETBANDINFOW, index, (LPARAM)&curBandInfo2);
+
+	m_correctingBandSize = false;
+	m_correctedRowHeight = ::SendMessageW(m_parentRebar, RB_GETROWHEIGHT, 0, 0);
+	m_bandLayoutChanged = false;
+
+	// Explorer isn't notified of this resize, so we need to manually invalidate the
+	// visual or a vertical gap may be left under the rebar.
+	if (initialTrHeight > topRowHeight)
+	{
+		m_shouldManuallyCorrectHeight = true;
+	}
+
+	return S_OK;
+}
+
+/*
+ * FindBandIndex: Get the index of our band in the rebar, or -1.
+ *
+ * This was never an officially-supported feature of shell rebars in Windows, so there's no
+ * function to just get the interface for our own rebar band. The index is remembered, and only
+ * looked for again once the band at it is no longer ours.
+ */
+int CBrandBand::FindBandIndex()
+{
+	REBARBANDINFOW bandInfo;
+	bandInfo.cbSize = sizeof(REBARBANDINFOW);
+	bandInfo.fMask = RBBIM_CHILD;
 
-	REBARBANDINFOW curBandInfo;
-	curBandInfo.cbSize = sizeof(REBARBANDINFOW);
-	curBandInfo.fMask = RBBIM_CHILD;
+	int bandCount = (int)::SendMessageW(m_parentRebar, RB_GETBANDCOUNT, 0, 0);
 
-	// This was never an officially-supported feature of shell rebars in Windows, so there's
-	// no function to just get the interface for our own rebar band.
-	for (int i = 0; i < ::SendMessageW(m_parentRebar, RB_GETBANDCOUNT, 0, 0); i++)
+	if (m_bandIndex >= 0 && m_bandIndex < bandCount &&
+		::SendMessageW(m_parentRebar, RB_GETBANDINFO, m_bandIndex, (LPARAM)&bandInfo) &&
+		bandInfo.hwndChild == m_hWnd)
 	{
-		::SendMessageW(m_parentRebar, RB_GETBANDINFO, i, (LPARAM)&curBandInfo);
+		return m_bandIndex;
+	}
 
-		if (::IsWindow(curBandInfo.hwndChild) && curBandInfo.hwndChild == m_hWnd)
+	m_bandIndex = -1;
+	for (int i = 0; i < bandCount; i++)
+	{
+		if (::SendMessageW(m_parentRebar, RB_GETBANDINFO, i, (LPARAM)&bandInfo) && bandInfo.hwndChild == m_hWnd)
 		{
-			// Get the rebar info:
-			REBARBANDINFOW curBandInfo2;
-			curBandInfo2.cbSize = sizeof(REBARBANDINFOW);
-			curBandInfo2.fMask = RBBIM_SIZE | RBBIM_CHILDSIZE;
-			::SendMessageW(m_parentRebar, RB_GETBANDINFO, i, (LPARAM)&curBandInfo2);
-
-			// Set the bar to the minimum size possible.
-			// Yes, it was necessary to define all of these, or it would half in horizontal size
-			// every time this function was called.
-			curBandInfo2.fMask = RBBIM_CHILDSIZE;
-			curBandInfo2.cxMinChild = 38;
-			curBandInfo2.cyMinChild = 22;
-			curBandInfo2.cyChild = 22;
-			curBandInfo2.cyIntegral = 1;
-			::SendMessageW(m_parentRebar, RB_SETBANDINFOW, i, (LPARAM)&curBandInfo2);
-
-			// Resize the bar back up to what it should be: the size of the topmost row.
-			UINT topRowHeight = ::SendMessageW(m_parentRebar, RB_GETROWHEIGHT, 0, 0);
-			curBandInfo2.cyChild = topRowHeight;
-			::SendMessageW(m_parentRebar, RB_SETBANDINFOW, i, (LPARAM)&curBandInfo2);
-
-			// Explorer isn't notified of this resize, so we need to manually invalidate the
-			// visual or a vertical gap may be left under the rebar.
-			if (initialTrHeight > topRowHeight)
-			{
-				m_shouldManuallyCorrectHeight = true;
-			}
+			m_bandIndex = i;
+			break;
 		}
 	}
 
-	return S_OK;
+	return m_bandIndex;
+}
+
+/*
+ * ScheduleCorrectBandSize: Ask for a band-size correction once the message loop comes back
+ *                          around. Any further requests until then are folded into it.
+ */
+void CBrandBand::ScheduleCorrectBandSize()
+{
+	if (m_bandSizeCorrectionPending || m_correctingBandSize || !IsWindow())
+		return;
+
+	if (PostMessageW(CE_WM_CORRECTBANDSIZE, 0, 0))
+		m_bandSizeCorrectionPending = true;
+}
+
+LRESULT CBrandBand::OnCorrectBandSize(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled)
+{
+	m_bandSizeCorrectionPending = false;
+	CorrectBandSize();
+
+	return 0;
 }
 
 /*
@@ -426,32 +681,6 @@ bool CBrandBand::ShouldRefreshVisual()
 	return false;
 }
 
-void CBrandBand::PerformRedrawCheck()
-{
-	const int checkDuration = 500;
-	const int allowedRedrawsInTimeSpan = 50;
-
-	unsigned int previousRedrawTime = m_latestRedrawTime;
-	m_latestRedrawTime = GetTickCount64();
-
-	if (m_latestRedrawTime < previousRedrawTime + checkDuration)
-	{
-		m_redrawCounter++;
-
-		if (m_redrawCounter > allowedRedrawsInTimeSpan)
-		{
-			m_disableRedraws = true;
-			#ifdef DEBUG
-			MessageBoxW(L"Redraw loop mitigated.");
-			#endif
-		}
-	}
-	else
-	{
-		m_redrawCounter = 0;
-	}
-}
-
 /*
  * RebarParentSubclassProc: This reads notifications (not messages) of the rebar, which is done by hooking
  *                          its parent (the shell WorkerW).
@@ -472,7 +701,9 @@ LRESULT CALLBACK CBrandBand::RebarParentSubclassProc(HWND hWnd, UINT uMsg, WPARA
 			case RBN_HEIGHTCHANGE:
 			case RBN_LAYOUTCHANGED:
 			{
-				self->CorrectBandSize();
+				// A resize can send a storm of these, so they are coalesced into a
+				// single correction.
+				self->ScheduleCorrectBandSize();
 				break;
 			}
 		}
@@ -488,7 +719,25 @@ LRESULT CALLBACK CBrandBand::RebarParentSubclassProc(HWND hWnd, UINT uMsg, WPARA
 LRESULT CALLBACK CBrandBand::RebarSubclassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData)
 {
 	CBrandBand *self = (CBrandBand *)dwRefData;
-	
+
+	switch (uMsg)
+	{
+		// Another band changed in a way which could change the height we should have,
+		// without necessarily changing the height of the row yet.
+		case RB_SETBANDINFOA:
+		case RB_SETBANDINFOW:
+		case RB_INSERTBANDA:
+		case RB_INSERTBANDW:
+		case RB_DELETEBAND:
+		case RB_SHOWBAND:
+		case RB_MOVEBAND:
+		{
+			if (!self->m_correctingBandSize)
+				self->m_bandLayoutChanged = true;
+			break;
+		}
+	}
+
 	if (uMsg == WM_SIZE)
 	{
 		if (self->m_shouldManuallyCorrectHeight)
@@ -524,14 +773,14 @@ STDMETHODIMP CBrandBand::GetBandInfo(DWORD dwBandId, DWORD dwViewMode, DESKBANDI
 	{
 		if (pDbi->dwMask & DBIM_MINSIZE)
 		{
-			pDbi->ptMinSize.x = 38;
-			pDbi->ptMinSize.y = 22;
+			pDbi->ptMinSize.x = ScaleForDpi(38);
+			pDbi->ptMinSize.y = ScaleForDpi(22);
 		}
 		if (pDbi->dwMask & DBIM_MAXSIZE)
 		{
 			// The throbber should be able to adjust to the size of any sibling rebar, but
-			// should always be locked to a size of 38 pixels horizontally.
-			pDbi->ptMaxSize.x = 38;
+			// should always be locked to a size of 38 pixels horizontally (at 96 DPI).
+			pDbi->ptMaxSize.x = ScaleForDpi(38);
 			pDbi->ptMaxSize.y = -1;
 		}
 		if (pDbi->dwMask & DBIM_INTEGRAL)
@@ -543,7 +792,7 @@ STDMETHODIMP CBrandBand::GetBandInfo(DWORD dwBandId, DWORD dwViewMode, DESKBANDI
 		}
 		if (pDbi->dwMask & DBIM_ACTUAL)
 		{
-			pDbi->ptActual.x = 38;
+			pDbi->ptActual.x = ScaleForDpi(38);
 			pDbi->ptActual.y = -1;
 		}
 		if (pDbi->dwMask & DBIM_TITLE)
@@ -610,6 +859,8 @@ STDMETHODIMP CBrandBand::ShowDW(BOOL fShow)
 	if (m_hWnd)
 		ShowWindow(fShow ? SW_SHOW : SW_HIDE);
 
+	UpdateAnimation();
+
 	return S_OK;
 }
 
@@ -674,6 +925,11 @@ STDMETHODIMP CBrandBand::SetSite(IUnknown *pUnkSite)
 		}
 	}
 
+	// Read settings (from the process-wide snapshot; only the first window reads the registry)
+	m_theme = CEUtil::GetCESettingsSnapshot()->theme;
+	m_settingsSubscription = CEUtil::SubscribeToCESettings(m_hWnd);
+
+	AcquireTheme();
 	LoadBitmapForSize();
 
 
@@ -685,10 +941,6 @@ STDMETHODIMP CBrandBand::SetSite(IUnknown *pUnkSite)
 
 	m_subclassedRebar = true;
 
-	// Read settings from registry
-	CEUtil::CESettings cS = CEUtil::GetCESettings();
-	m_theme = cS.theme;
-
 	// Explorer may initialise our position onto a separate rebar until the sizes are
 	// invalidated, so let's manually invalidate to correct the position:
 	CEUtil::FixExplorerSizes(this->m_hWnd);
@@ -699,10 +951,32 @@ STDMETHODIMP CBrandBand::SetSite(IUnknown *pUnkSite)
 //================================================================================================================
 // handle DWebBrowserEvents2:
 //
+STDMETHODIMP CBrandBand::OnBeforeNavigate(IDispatch *pDisp, VARIANT *url, VARIANT *flags, VARIANT *targetFrameName,
+	VARIANT *postData, VARIANT *headers, VARIANT_BOOL *cancel)
+{
+	m_navigating = true;
+	UpdateAnimation();
+
+	return S_OK;
+}
+
+STDMETHODIMP CBrandBand::OnNavigateError(IDispatch *pDisp, VARIANT *url, VARIANT *targetFrameName,
+	VARIANT *statusCode, VARIANT_BOOL *cancel)
+{
+	m_navigating = false;
+	UpdateAnimation();
+
+	return S_OK;
+}
+
 STDMETHODIMP CBrandBand::OnNavigateComplete(IDispatch *pDisp, VARIANT *url)
 {
+	m_navigating = false;
+	UpdateAnimation();
+
 	//MessageBox(L"fuck you");
-	CEUtil::FixExplorerSizes(this->m_hWnd);
+	// The fix itself is timed when it runs; see ScheduleFixExplorerSizes.
+	CEUtil::ScheduleFixExplorerSizes(this->m_hWnd);
 	//::SendMessageW(m_parentRebar, WM_SIZE, 0, 1);
 
 	return S_OK;
@@ -5,6 +5,13 @@
 #include "resource.h"
 #include "ClassicExplorer_i.h"
 #include "dllmain.h"
+#include "util/util.h"
+#include "util/theme.h"
+#include "util/animation_timer.h"
+
+// Posted by the brand band to itself to run a band-size correction once the current burst of
+// rebar notifications is over.
+#define CE_WM_CORRECTBANDSIZE (WM_APP + 3)
 
 class ATL_NO_VTABLE CBrandBand :
 	public CWindowImpl<CBrandBand, CWindow, CControlWinTraits>,
@@ -17,12 +24,32 @@ class ATL_NO_VTABLE CBrandBand :
 	private: // Class members:
 		CComPtr<IWebBrowser2> m_pWebBrowser = NULL;
 		HWND m_parentRebar = NULL;
-		HBITMAP m_hBitmap = NULL;
 		bool m_subclassedRebar = false;
 		bool m_alreadyDeletedSelf = false;
 		bool m_shouldManuallyCorrectHeight = false;
+
+		// Band-size corrections are deferred and coalesced: rebar notifications only post a
+		// request, and the correction is skipped if neither the row height nor any other band
+		// has changed since the last one.
+		bool m_bandSizeCorrectionPending = false;
+		bool m_correctingBandSize = false;
+		bool m_bandLayoutChanged = true;
+		UINT m_correctedRowHeight = 0;
+		int m_bandIndex = -1;
 		
 		ClassicExplorerTheme m_theme = CLASSIC_EXPLORER_2K;
+		unsigned long long m_settingsSubscription = 0;
+
+		// The current theme, shared with the other windows.
+		std::shared_ptr<const CEUtil::Theme> m_themeData;
+
+		// The sizes of the throbber used so far with the current theme and DPI, held so that
+		// resizing the band back and forth only has to pick one of them.
+		std::shared_ptr<const CEUtil::DecodedBitmap> m_throbbers[(int)CEUtil::ThrobberSize::Count];
+		int m_throbberDpi = 0;
+
+		// The throbber for the current size of the band.
+		std::shared_ptr<const CEUtil::DecodedBitmap> m_bitmap;
 
 		// Width of the current bitmap.
 		int m_cxCurBmp = 0;
@@ -30,9 +57,24 @@ class ATL_NO_VTABLE CBrandBand :
 		// Height of the current bitmap.
 		int m_cyCurBmp = 0;
 
-		int m_redrawCounter = 0;
-		unsigned int m_latestRedrawTime = 0;
-		bool m_disableRedraws = false;
+		// The band as it is painted: a premultiplied 32 bpp slot per animation frame, side by
+		// side in one persistent memory DC. Rebuilt only when the size, theme or DPI changes.
+		HDC m_frameDc = NULL;
+		HBITMAP m_frameBitmap = NULL;
+		HGDIOBJ m_frameOldBitmap = NULL;
+		int m_frameWidth = 0;
+		int m_frameHeight = 0;
+		int m_frameSlots = 0;
+
+		// False if the toolbar behind the band shows through anywhere.
+		bool m_frameOpaque = true;
+
+		// The throbber animates while a navigation is in flight, if its bitmap has more than
+		// one frame.
+		bool m_navigating = false;
+		bool m_animating = false;
+		int m_frame = 0;
+		unsigned long long m_animationStart = 0;
 
 	public: // COM class setup:
 		DECLARE_WND_CLASS(L"ClassicExplorer.BrandBand")
@@ -49,6 +91,10 @@ class ATL_NO_VTABLE CBrandBand :
 			MESSAGE_HANDLER(WM_SIZE, OnSize)
 			MESSAGE_HANDLER(WM_ERASEBKGND, OnEraseBackground)
 			MESSAGE_HANDLER(WM_LBUTTONUP, OnClick)
+			MESSAGE_HANDLER(CE_WM_SETTINGSCHANGED, OnSettingsChanged)
+			MESSAGE_HANDLER(WM_DPICHANGED_AFTERPARENT, OnDpiChanged)
+			MESSAGE_HANDLER(CE_WM_ANIMATIONTICK, OnAnimationTick)
+			MESSAGE_HANDLER(CE_WM_CORRECTBANDSIZE, OnCorrectBandSize)
 			//MESSAGE_HANDLER(WM_COMMAND, OnCommand)
 		END_MSG_MAP()
 
@@ -60,7 +106,9 @@ class ATL_NO_VTABLE CBrandBand :
 		END_COM_MAP()
 
 		BEGIN_SINK_MAP(CBrandBand)
+			SINK_ENTRY_EX(1, DIID_DWebBrowserEvents2, DISPID_BEFORENAVIGATE2, OnBeforeNavigate)
 			SINK_ENTRY_EX(1, DIID_DWebBrowserEvents2, DISPID_NAVIGATECOMPLETE2, OnNavigateComplete)
+			SINK_ENTRY_EX(1, DIID_DWebBrowserEvents2, DISPID_NAVIGATEERROR, OnNavigateError)
 			SINK_ENTRY_EX(1, DIID_DWebBrowserEvents2, DISPID_ONQUIT, OnQuit)
 		END_SINK_MAP()
 
@@ -78,6 +126,10 @@ class ATL_NO_VTABLE CBrandBand :
 		LRESULT OnSize(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
 		LRESULT OnEraseBackground(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
 		LRESULT OnClick(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled);
+		LRESULT OnSettingsChanged(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+		LRESULT OnDpiChanged(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+		LRESULT OnAnimationTick(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+		LRESULT OnCorrectBandSize(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
 
 	protected: // Miscellaneous functions:
 		void ClearResources();
@@ -85,10 +137,16 @@ class ATL_NO_VTABLE CBrandBand :
 		static LRESULT CALLBACK RebarParentSubclassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData);
 		static LRESULT CALLBACK RebarSubclassProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam, UINT_PTR uIdSubclass, DWORD_PTR dwRefData);
 
-		void PerformRedrawCheck();
+		void ScheduleCorrectBandSize();
 		LRESULT CorrectBandSize();
+		int FindBandIndex();
 		bool ShouldRefreshVisual();
 
+		void AcquireTheme();
+		int ScaleForDpi(int value) const;
+		void RebuildFrame();
+		void ReleaseFrame();
+		void UpdateAnimation();
 		LRESULT LoadBitmapForSize();
 
 	public: // COM method implementations:
@@ -109,7 +167,11 @@ class ATL_NO_VTABLE CBrandBand :
 		STDMETHOD(ShowDW)(BOOL fShow);
 
 		// handle DWebBrowserEvents2:
+		STDMETHOD(OnBeforeNavigate)(IDispatch *pDisp, VARIANT *url, VARIANT *flags, VARIANT *targetFrameName,
+			VARIANT *postData, VARIANT *headers, VARIANT_BOOL *cancel);
 		STDMETHOD(OnNavigateComplete)(IDispatch *pDisp, VARIANT *url);
+		STDMETHOD(OnNavigateError)(IDispatch *pDisp, VARIANT *url, VARIANT *targetFrameName,
+			VARIANT *statusCode, VARIANT_BOOL *cancel);
 		STDMETHOD(OnQuit)(void);
 };
 
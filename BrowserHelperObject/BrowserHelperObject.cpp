@@ -8,6 +8,9 @@
 #include "dllmain.h"
 #include <commoncontrols.h>
 #include "util/util.h"
+#include "util/trace.h"
+#include "util/diagnostics.h"
+#include "util/bitmap_cache.h"
 
 #include "util/shell_undoc.h"
 #include "BrowserHelperObject.h"
@@ -16,65 +19,91 @@ void BrowserHelperObject::Cleanup()
 {
 	m_pSite = NULL;
 	m_parentWindow = NULL;
-	//UnhookWindowsHookEx(m_hHook);
+	m_defView = NULL;
+	m_listView = NULL;
 }
 
-HRESULT BrowserHelperObject::_DoUpdateWatermark(HWND listView)
+/*
+ * _GetListView: Get the list view of the given shell view, or NULL if it doesn't use one.
+ *
+ * The shell view hands out its own window, so the list view is a direct child lookup the first
+ * time a view is seen, and a couple of handle checks after that.
+ */
+HWND BrowserHelperObject::_GetListView(IShellView *pView)
 {
-	HRESULT hr = S_OK;
+	HWND defView = NULL;
+	if (!pView || FAILED(pView->GetWindow(&defView)) || !defView)
+		return NULL;
+
+	if (defView != m_defView || !::IsWindow(m_listView) || ::GetParent(m_listView) != defView)
+	{
+		m_defView = defView;
+		m_listView = FindWindowExW(defView, NULL, L"SysListView32", NULL);
+	}
 
-	int resourceId = 0;
-	bool shouldUse = false;
+	return m_listView;
+}
+
+/*
+ * _DoUpdateWatermark: Put the watermark for the type of the current folder in the corner of its
+ *                     list view, or take it away for folders which have none.
+ *
+ * A list view owns the watermark bitmap it accepts, and frees it when it is replaced or the list
+ * view is destroyed. So it is given its own copy of the cached pixels, which is only ours to
+ * free if it is refused. No resource is loaded once a watermark is in the cache.
+ */
+HRESULT BrowserHelperObject::_DoUpdateWatermark(IShellView *pView, HWND listView)
+{
+	HRESULT hr = S_OK;
 
-	CComPtr<IShellView> pView;
-	m_pShellBrowser->QueryActiveShellView(&pView);
 	CComPtr<IFolderType> pType;
-	pView->QueryInterface(IID_IFolderType, (void **)&pType);
+	hr = pView->QueryInterface(IID_IFolderType, (void **)&pType);
+	if (FAILED(hr))
+		return hr;
 
 	FOLDERTYPEID curFolderType;
-	pType->GetFolderType(&curFolderType);
+	hr = pType->GetFolderType(&curFolderType);
+	if (FAILED(hr))
+		return hr;
 
+	CEUtil::WatermarkKind kind = CEUtil::WatermarkKind::Count;
 	if (curFolderType == FOLDERTYPEID_Pictures)
-	{
-		resourceId = IDB_BG_PICTURES_BLUE;
-		shouldUse = true;
-	}
+		kind = CEUtil::WatermarkKind::Pictures;
 	else if (curFolderType == FOLDERTYPEID_Music)
-	{
-		resourceId = IDB_BG_MUSIC_BLUE;
-		shouldUse = true;
-	}
+		kind = CEUtil::WatermarkKind::Music;
 	else if (curFolderType == FOLDERTYPEID_Videos)
-	{
-		resourceId = IDB_BG_VIDEOS_BLUE;
-		shouldUse = true;
-	}
+		kind = CEUtil::WatermarkKind::Videos;
 
-	if (shouldUse)
+	LVBKIMAGEW bkImage = { 0 };
+	bkImage.ulFlags = LVBKIF_TYPE_WATERMARK;
+	bkImage.xOffsetPercent = 100;
+	bkImage.yOffsetPercent = 100;
+
+	if (kind != CEUtil::WatermarkKind::Count)
 	{
-		HBITMAP bitmap = LoadBitmapW(
-			_AtlBaseModule.GetResourceInstance(),
-			MAKEINTRESOURCEW(resourceId)
-		);
-
-		LVBKIMAGEW bkImage = { 0 };
-		bkImage.ulFlags = LVBKIF_TYPE_WATERMARK;
-		bkImage.xOffsetPercent = 100;
-		bkImage.yOffsetPercent = 100;
-		bkImage.hbm = bitmap;
-
-		if (!SendMessageW(listView, LVM_SETBKIMAGEW, NULL, (LPARAM)&bkImage))
+		// The watermarks are drawn for 96 DPI, so the list view gets a copy resampled for its
+		// own DPI rather than one GDI would show at a fraction of the intended size.
+		int dpi = (int)GetDpiForWindow(listView);
+
+		ClassicExplorerTheme theme = CEUtil::GetCESettingsSnapshot()->theme;
+		std::shared_ptr<const CEUtil::DecodedBitmap> watermark = CEUtil::GetThemeBitmapCache().GetWatermark(theme, kind, dpi);
+
+		bkImage.hbm = watermark ? watermark->CreateHBitmap() : NULL;
+		if (!bkImage.hbm)
 		{
-			DeleteObject(bitmap);
-			WCHAR buffer[128];
-			swprintf_s(buffer, L"Failed to apply background image on HWND: %x", listView);
-			MessageBoxW(NULL, buffer, L"Fuck you", MB_OK);
+			CE_TRACE_VALUE("BHO.WatermarkUnavailable", static_cast<int>(kind));
+			return E_FAIL;
 		}
 	}
-	else
+
+	// With no bitmap, this frees the watermark the list view has, if any.
+	if (!SendMessageW(listView, LVM_SETBKIMAGEW, 0, (LPARAM)&bkImage))
 	{
-		// Remove the background
-		SendMessageW(listView, LVM_SETBKIMAGEW, NULL, NULL);
+		if (bkImage.hbm)
+			DeleteObject(bkImage.hbm);
+
+		CE_TRACE_VALUE("BHO.WatermarkRejected", static_cast<int>(kind));
+		return E_FAIL;
 	}
 
 	return hr;
@@ -82,52 +111,22 @@ HRESULT BrowserHelperObject::_DoUpdateWatermark(HWND listView)
 
 HRESULT BrowserHelperObject::UpdateWatermark()
 {
-	bool found = false;
-
-	EnumChildWindows(m_parentWindow, [](HWND hWnd, LPARAM lParam) -> BOOL CALLBACK {
-		BrowserHelperObject *pThis = (BrowserHelperObject *)lParam;
-		WCHAR className[MAX_PATH];
-		if (GetClassName(hWnd, (LPWSTR)&className, MAX_PATH) && (_wcsicmp(className, L"SysListView32") == 0))
-		{
-			HWND parent = GetParent(hWnd);
-			if (parent)
-			{
-				WCHAR className2[MAX_PATH];
-				GetClassNameW(parent, (LPWSTR)&className2, MAX_PATH);
-				if (wcscmp(className2, L"SHELLDLL_DefView") != 0)
-				{
-					// not the right ListView
-					return TRUE;
-				}
-			}
-
-			pThis->_DoUpdateWatermark(hWnd);
+	CE_TRACE_SCOPE("BHO.UpdateWatermark");
 
-			return FALSE;
-		}
-		return TRUE;
-	}, (LPARAM)this);
+	if (!m_pShellBrowser)
+		return E_FAIL;
 
-	if (!found)
-	{
-		// hmm
-	}
-
-	return S_OK;
-}
-
-
-LRESULT CALLBACK BrowserHelperObject::s_HookProc(int nCode, WPARAM wParam, LPARAM lParam)
-{
-	if (nCode == HCBT_CREATEWND)
-	{
-		HWND hWnd = (HWND)wParam;
-		CBT_CREATEWNDW *pCreate = (CBT_CREATEWNDW *)lParam;
+	CComPtr<IShellView> pView;
+	HRESULT hr = m_pShellBrowser->QueryActiveShellView(&pView);
+	if (FAILED(hr) || !pView)
+		return E_FAIL;
 
+	// Views which draw their items without a list view have nowhere to put a watermark.
+	HWND listView = _GetListView(pView);
+	if (!listView)
+		return S_FALSE;
 
-	}
-
-	return CallNextHookEx(NULL, nCode, wParam, lParam);
+	return _DoUpdateWatermark(pView, listView);
 }
 
 //================================================================================================================
@@ -151,9 +150,6 @@ STDMETHODIMP BrowserHelperObject::SetSite(IUnknown *pUnkSite)
 	{
 		CComQIPtr<IServiceProvider> pProvider = pUnkSite;
 
-		// Set Windows hooks for additional things:
-		//m_hHook = SetWindowsHookExW(WH_CBT, s_HookProc, NULL, GetCurrentThreadId());
-
 		if (pProvider)
 		{
 			CComPtr<IShellBrowser> pShellBrowser;
@@ -169,13 +165,13 @@ STDMETHODIMP BrowserHelperObject::SetSite(IUnknown *pUnkSite)
 			}
 
 			HWND parentWindow = NULL;
-			if (SUCCEEDED(m_pShellBrowser->GetWindow(&parentWindow)))
+			if (m_pShellBrowser && SUCCEEDED(m_pShellBrowser->GetWindow(&parentWindow)))
 			{
 				m_parentWindow = GetAncestor(parentWindow, GA_ROOT);
 			}
 			else
 			{
-				MessageBox(NULL, NULL, L"could not get parent window", MB_OK);
+				CE_TRACE_VALUE("BHO.NoParentWindow", 0);
 			}
 		}
 	}
@@ -193,7 +189,9 @@ STDMETHODIMP BrowserHelperObject::SetSite(IUnknown *pUnkSite)
 
 STDMETHODIMP BrowserHelperObject::OnNavigateComplete(IDispatch *pDisp, VARIANT *url)
 {
+	unsigned long long workStart = CETrace::Now();
 	UpdateWatermark();
+	CEDiagnostics::Navigations().AddOwnWork(reinterpret_cast<uintptr_t>(m_parentWindow), CETrace::Now() - workStart);
 	return S_OK;
 }
 
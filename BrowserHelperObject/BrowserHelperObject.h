@@ -19,7 +19,10 @@ class ATL_NO_VTABLE BrowserHelperObject :
 		HWND m_parentWindow = NULL;
 		CComPtr<IWebBrowser2> m_pWebBrowser = NULL;
 		CComPtr<IShellBrowser> m_pShellBrowser = NULL;
-		HHOOK m_hHook = NULL;
+
+		// The shell view window and its list view, as last seen.
+		HWND m_defView = NULL;
+		HWND m_listView = NULL;
 
 	public: // COM class setup:
 		DECLARE_REGISTRY_RESOURCEID_V2_WITHOUT_MODULE(IDR_CLASSICEXPLORER, BrowserHelperObject)
@@ -45,8 +48,8 @@ class ATL_NO_VTABLE BrowserHelperObject :
 	protected: // Miscellaneous methods:
 		void BrowserHelperObject::Cleanup();
 		HRESULT BrowserHelperObject::UpdateWatermark();
-		HRESULT BrowserHelperObject::_DoUpdateWatermark(HWND listView);
-		static LRESULT CALLBACK BrowserHelperObject::s_HookProc(int nCode, WPARAM wParam, LPARAM lParam);
+		HWND BrowserHelperObject::_GetListView(IShellView *pView);
+		HRESULT BrowserHelperObject::_DoUpdateWatermark(IShellView *pView, HWND listView);
 
 	public: // COM method implementations:
 
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef _BENCH_H
+#define _BENCH_H
+
+/*
+ * A minimal benchmark harness for the portable code.
+ *
+ * Each benchmark is a function which runs its operation a given number of times and returns
+ * a value derived from the results, so the work can't be optimised away. The harness calls it
+ * with growing iteration counts until a run is long enough to time, and reports the time per
+ * operation (and per item, for operations over several items) as one JSON object per line.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Bench
+{
+	using Body = std::function<uint64_t(size_t iterations)>;
+
+	struct Benchmark
+	{
+		std::string name;
+		size_t itemsPerOp = 1;
+		Body body;
+	};
+
+	std::vector<Benchmark> &GetRegistry();
+
+	struct Registrar
+	{
+		Registrar(const char *name, size_t itemsPerOp, Body body)
+		{
+			GetRegistry().push_back({ name, itemsPerOp, std::move(body) });
+		}
+	};
+}
+
+#define CE_BENCH_CONCAT_INNER(a, b) a##b
+#define CE_BENCH_CONCAT(a, b) CE_BENCH_CONCAT_INNER(a, b)
+
+// Register a benchmark: CE_BENCHMARK("group/name", items, [](size_t iterations) { ... }).
+#define CE_BENCHMARK(name, itemsPerOp, ...) \
+	static Bench::Registrar CE_BENCH_CONCAT(s_benchmark, __LINE__)(name, itemsPerOp, __VA_ARGS__)
+
+#endif // _BENCH_H
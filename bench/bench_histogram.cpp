@@ -0,0 +1,57 @@
+/*
+ * bench_histogram.cpp: Benchmarks of recording into and summarising a latency histogram.
+ */
+
+#include "bench.h"
+#include "synthetic.h"
+
+#include "util/latency_histogram.h"
+
+#include <memory>
+
+namespace
+{
+	const size_t kSampleCount = 4096;
+
+	const std::vector<uint64_t> &GetSamples()
+	{
+		static const std::vector<uint64_t> samples = []()
+		{
+			Synthetic::Random random(32);
+			std::vector<uint64_t> result;
+			for (size_t i = 0; i < kSampleCount; ++i)
+				result.push_back(random.Next() >> random.Range(34, 50));
+			return result;
+		}();
+		return samples;
+	}
+
+	// Recording is on every paint and layout, so it must stay well under 50 ns.
+	CE_BENCHMARK("histogram/record", kSampleCount, [](size_t iterations)
+	{
+		static auto histogram = std::make_unique<LatencyHistogram>();
+		const std::vector<uint64_t> &samples = GetSamples();
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			for (uint64_t sample : samples)
+				histogram->Record(sample);
+		}
+		return histogram->GetValueAtPercentile(50);
+	});
+
+	// Summarising is once per overlay paint.
+	CE_BENCHMARK("histogram/summarize", 1, [](size_t iterations)
+	{
+		static auto histogram = []()
+		{
+			auto result = std::make_unique<LatencyHistogram>();
+			for (uint64_t sample : GetSamples())
+				result->Record(sample);
+			return result;
+		}();
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+			checksum += histogram->Summarize().p99;
+		return checksum;
+	});
+}
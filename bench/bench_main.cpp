@@ -0,0 +1,132 @@
+/*
+ * bench_main.cpp: Runs the registered benchmarks.
+ *
+ *   ce_bench [--filter TEXT] [--min-time-ms N] [--baseline FILE] [--max-ratio R]
+ *
+ * Every result is printed as one JSON object per line:
+ *
+ *   {"name":"tab_layout/compute/1000","ns_per_op":1234.5,"ns_per_item":1.2,"iterations":65536}
+ *
+ * The output of a run is itself a baseline file. With --baseline, each result also gets the
+ * baseline time and the ratio to it, and with --max-ratio the exit code is 1 if any result is
+ * slower than its baseline by more than that ratio.
+ */
+
+#include "bench.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+namespace Bench
+{
+
+std::vector<Benchmark> &GetRegistry()
+{
+	static std::vector<Benchmark> registry;
+	return registry;
+}
+
+}
+
+// Results are folded into this so no benchmark can be optimised away.
+static volatile uint64_t s_sink = 0;
+
+static std::map<std::string, double> LoadBaseline(const char *path)
+{
+	std::map<std::string, double> baseline;
+	std::ifstream in(path);
+	std::string line;
+	while (std::getline(in, line))
+	{
+		size_t nameStart = line.find("\"name\":\"");
+		size_t timeStart = line.find("\"ns_per_op\":");
+		if (nameStart == std::string::npos || timeStart == std::string::npos)
+			continue;
+
+		nameStart += strlen("\"name\":\"");
+		size_t nameEnd = line.find('"', nameStart);
+		if (nameEnd == std::string::npos)
+			continue;
+
+		baseline[line.substr(nameStart, nameEnd - nameStart)] = strtod(line.c_str() + timeStart + strlen("\"ns_per_op\":"), nullptr);
+	}
+	return baseline;
+}
+
+int main(int argc, char **argv)
+{
+	const char *filter = nullptr;
+	const char *baselinePath = nullptr;
+	double maxRatio = 0;
+	double minTimeNs = 100e6;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--filter") && hasValue)
+			filter = argv[++i];
+		else if (!strcmp(argv[i], "--baseline") && hasValue)
+			baselinePath = argv[++i];
+		else if (!strcmp(argv[i], "--max-ratio") && hasValue)
+			maxRatio = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--min-time-ms") && hasValue)
+			minTimeNs = atof(argv[++i]) * 1e6;
+		else
+		{
+			fprintf(stderr, "usage: %s [--filter TEXT] [--min-time-ms N] [--baseline FILE] [--max-ratio R]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	std::map<std::string, double> baseline;
+	if (baselinePath)
+		baseline = LoadBaseline(baselinePath);
+
+	bool regressed = false;
+	for (const Bench::Benchmark &benchmark : Bench::GetRegistry())
+	{
+		if (filter && benchmark.name.find(filter) == std::string::npos)
+			continue;
+
+		// Warm up, then double the iterations until a run takes long enough to time.
+		s_sink = s_sink + benchmark.body(1);
+
+		size_t iterations = 1;
+		double elapsedNs = 0;
+		for (;;)
+		{
+			auto start = std::chrono::steady_clock::now();
+			s_sink = s_sink + benchmark.body(iterations);
+			elapsedNs = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+			if (elapsedNs >= minTimeNs || iterations >= (size_t(1) << 40))
+				break;
+
+			// Aim straight for the target once the time is measurable.
+			size_t next = iterations * 2;
+			if (elapsedNs > minTimeNs / 100)
+				next = static_cast<size_t>(iterations * (minTimeNs * 1.2 / elapsedNs)) + 1;
+			iterations = next > iterations ? next : iterations + 1;
+		}
+
+		double nsPerOp = elapsedNs / static_cast<double>(iterations);
+		printf("{\"name\":\"%s\",\"ns_per_op\":%.1f,\"ns_per_item\":%.2f,\"iterations\":%zu",
+			benchmark.name.c_str(), nsPerOp, nsPerOp / static_cast<double>(benchmark.itemsPerOp), iterations);
+
+		auto known = baseline.find(benchmark.name);
+		if (known != baseline.end() && known->second > 0)
+		{
+			double ratio = nsPerOp / known->second;
+			printf(",\"baseline_ns_per_op\":%.1f,\"ratio\":%.2f", known->second, ratio);
+			if (maxRatio > 0 && ratio > maxRatio)
+				regressed = true;
+		}
+		printf("}\n");
+		fflush(stdout);
+	}
+
+	return regressed ? 1 : 0;
+}
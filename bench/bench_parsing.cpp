@@ -0,0 +1,166 @@
+/*
+ * bench_parsing.cpp: Benchmarks of drop data, path and settings parsing.
+ */
+
+#include "bench.h"
+#include "synthetic.h"
+
+#include "util/drop_parsing.h"
+#include "util/file_settings.h"
+#include "util/path_tokens.h"
+#include "util/settings_blob.h"
+#include "util/settings_schema.h"
+
+#include <map>
+
+namespace
+{
+	// Inputs are generated once per size, outside the timed runs. Every call site passes its
+	// own lambda, so every call site gets its own inputs.
+	template <typename Input, typename Make>
+	const Input &GetInput(size_t size, Make make)
+	{
+		static std::map<size_t, Input> inputs;
+		auto found = inputs.find(size);
+		if (found == inputs.end())
+			found = inputs.emplace(size, make(size)).first;
+		return found->second;
+	}
+
+	uint64_t ParseDropFiles(size_t pathCount, size_t iterations)
+	{
+		const std::vector<unsigned char> &data = GetInput<std::vector<unsigned char>>(pathCount, [](size_t count)
+		{
+			Synthetic::Random random(count);
+			std::vector<std::wstring> paths;
+			for (size_t i = 0; i < count; ++i)
+				paths.push_back(Synthetic::MakePath(random, random.Range(2, 8)));
+			return Synthetic::MakeDropFiles(paths);
+		});
+
+		uint64_t checksum = 0;
+		std::vector<std::wstring> parsed;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			parsed.clear();
+			DropParsing::ParseDropFiles(data.data(), data.size(), parsed);
+			checksum += parsed.size();
+		}
+		return checksum;
+	}
+
+	CE_BENCHMARK("drop_parsing/drop_files/1", 1, [](size_t iterations) { return ParseDropFiles(1, iterations); });
+	CE_BENCHMARK("drop_parsing/drop_files/100", 100, [](size_t iterations) { return ParseDropFiles(100, iterations); });
+	CE_BENCHMARK("drop_parsing/drop_files/1000", 1000, [](size_t iterations) { return ParseDropFiles(1000, iterations); });
+
+	uint64_t ParseCida(size_t itemCount, size_t iterations)
+	{
+		const std::vector<unsigned char> &data = GetInput<std::vector<unsigned char>>(itemCount, [](size_t count)
+		{
+			Synthetic::Random random(count);
+			std::vector<unsigned char> folder = Synthetic::MakeIdList(random, 4);
+			std::vector<std::vector<unsigned char>> items;
+			for (size_t i = 0; i < count; ++i)
+				items.push_back(Synthetic::MakeIdList(random, 1));
+			return Synthetic::MakeCida(folder, items);
+		});
+
+		uint64_t checksum = 0;
+		size_t folderOffset = 0;
+		std::vector<size_t> itemOffsets;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			itemOffsets.clear();
+			DropParsing::ParseCida(data.data(), data.size(), folderOffset, itemOffsets);
+			checksum += itemOffsets.size() + folderOffset;
+		}
+		return checksum;
+	}
+
+	CE_BENCHMARK("drop_parsing/cida/100", 100, [](size_t iterations) { return ParseCida(100, iterations); });
+	CE_BENCHMARK("drop_parsing/cida/1000", 1000, [](size_t iterations) { return ParseCida(1000, iterations); });
+
+	// Splitting 256 paths, as GetLocalizedDisplayPath does before looking up each component.
+	uint64_t TokenizePaths(size_t depth, size_t iterations)
+	{
+		const std::vector<std::wstring> &paths = GetInput<std::vector<std::wstring>>(depth, [](size_t pathDepth)
+		{
+			Synthetic::Random random(pathDepth);
+			std::vector<std::wstring> result;
+			for (int i = 0; i < 256; ++i)
+				result.push_back(Synthetic::MakePath(random, static_cast<int>(pathDepth)));
+			return result;
+		});
+
+		uint64_t checksum = 0;
+		std::vector<PathTokens::Token> tokens;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			for (const std::wstring &path : paths)
+			{
+				tokens.clear();
+				PathTokens::Tokenize(path.c_str(), path.size(), tokens);
+				checksum += tokens.size();
+			}
+		}
+		return checksum;
+	}
+
+	CE_BENCHMARK("path_tokens/tokenize/depth_8", 256, [](size_t iterations) { return TokenizePaths(8, iterations); });
+	CE_BENCHMARK("path_tokens/tokenize/depth_64", 256, [](size_t iterations) { return TokenizePaths(64, iterations); });
+
+	const CEUtil::CESettings kSettings(CLASSIC_EXPLORER_XP, 1, 0, 1, 0, 240, 28);
+
+	CE_BENCHMARK("settings/parse_ini", 1, [](size_t iterations)
+	{
+		static const std::string text = CEUtil::FileSettingsBackend::FormatText(kSettings);
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+			checksum += CEUtil::FileSettingsBackend::ParseText(text.data(), text.size()).tabFixedWidth;
+		return checksum;
+	});
+
+	CE_BENCHMARK("settings/parse_blob", 1, [](size_t iterations)
+	{
+		static const std::vector<unsigned char> blob = CEUtil::SerializeSettingsBlob(kSettings);
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			CEUtil::CESettings settings;
+			CEUtil::ParseSettingsBlob(blob.data(), blob.size(), settings);
+			checksum += settings.tabFixedWidth;
+		}
+		return checksum;
+	});
+
+	// Validating one enumeration of the legacy registry values.
+	CE_BENCHMARK("settings/parse_values", 1, [](size_t iterations)
+	{
+		static const std::vector<CEUtil::RawSettingValue> values = []()
+		{
+			std::vector<CEUtil::RawSettingValue> result;
+			for (const CEUtil::SettingField &field : CEUtil::kSettingsSchema)
+			{
+				CEUtil::RawSettingValue value;
+				value.name = field.name;
+				if (field.type == CEUtil::SettingType::Theme)
+				{
+					value.kind = CEUtil::RawSettingValue::Kind::String;
+					value.string = CEUtil::GetThemeName(kSettings.theme);
+				}
+				else
+				{
+					value.kind = CEUtil::RawSettingValue::Kind::Dword;
+					value.dword = static_cast<uint32_t>(CEUtil::GetSettingField(kSettings, field));
+				}
+				result.push_back(value);
+			}
+			return result;
+		}();
+
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+			checksum += CEUtil::ParseSettings(values).tabFixedWidth;
+		return checksum;
+	});
+}
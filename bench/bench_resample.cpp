@@ -0,0 +1,39 @@
+/*
+ * bench_resample.cpp: Benchmarks of scaling a throbber strip for the DPI, on each path.
+ */
+
+#include "bench.h"
+
+#include "util/resample.h"
+
+namespace
+{
+	// One 38 px frame of the large throbber, half of it translucent, scaled to 150%.
+	uint64_t ScaleFrame(Resample::Path path, size_t iterations)
+	{
+		static const DecodedImage source = []()
+		{
+			DecodedImage image;
+			image.width = 38;
+			image.height = 38;
+			image.pixels.resize(38 * 38);
+			for (size_t i = 0; i < image.pixels.size(); ++i)
+				image.pixels[i] = (i % 2 ? 0x80000000u : 0xFF000000u) | static_cast<uint32_t>(i * 2654435761u >> 8);
+			return image;
+		}();
+
+		uint64_t checksum = 0;
+		DecodedImage scaled;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			if (Resample::ResampleImage(source, 57, 57, Resample::Filter::Lanczos3, path, scaled))
+				checksum += scaled.pixels[0];
+		}
+		return checksum;
+	}
+
+	// A path the CPU lacks falls back to the best it has.
+	CE_BENCHMARK("resample/lanczos3_150pct/scalar", 57 * 57, [](size_t iterations) { return ScaleFrame(Resample::Path::Scalar, iterations); });
+	CE_BENCHMARK("resample/lanczos3_150pct/sse2", 57 * 57, [](size_t iterations) { return ScaleFrame(Resample::Path::Sse2, iterations); });
+	CE_BENCHMARK("resample/lanczos3_150pct/avx2", 57 * 57, [](size_t iterations) { return ScaleFrame(Resample::Path::Avx2, iterations); });
+}
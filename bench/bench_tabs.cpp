@@ -0,0 +1,197 @@
+/*
+ * bench_tabs.cpp: Benchmarks of tab strip layout, hit-testing, lookup by ID list and reorder.
+ */
+
+#include "bench.h"
+#include "synthetic.h"
+
+#include "util/id_list.h"
+#include "util/tab_layout.h"
+#include "util/tab_order.h"
+
+#include <algorithm>
+#include <map>
+
+namespace
+{
+	const int kTabsPerGroup = 8;
+	const TabLayout::Rect kClient = { 0, 0, 1280, 400 };
+
+	struct StripInput
+	{
+		std::vector<int> groupSizes;
+		std::vector<int> tabWidths;
+	};
+
+	const StripInput &GetStrip(size_t tabCount)
+	{
+		static std::map<size_t, StripInput> strips;
+		auto found = strips.find(tabCount);
+		if (found != strips.end())
+			return found->second;
+
+		Synthetic::Random random(tabCount);
+		StripInput &strip = strips[tabCount];
+		for (size_t i = 0; i < tabCount; i += kTabsPerGroup)
+			strip.groupSizes.push_back(static_cast<int>(std::min<size_t>(kTabsPerGroup, tabCount - i)));
+		for (size_t i = 0; i < tabCount; ++i)
+			strip.tabWidths.push_back(random.Range(120, 280));
+		return strip;
+	}
+
+	uint64_t LayoutTabs(size_t tabCount, size_t iterations)
+	{
+		const StripInput &strip = GetStrip(tabCount);
+		TabLayout::Metrics metrics;
+		TabLayout::StripLayout layout;
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			layout.Compute(metrics, kClient, strip.groupSizes, strip.tabWidths, static_cast<int>(i));
+			checksum += layout.GetVisibleTabs().size();
+		}
+		return checksum;
+	}
+
+	CE_BENCHMARK("tab_layout/compute/100", 100, [](size_t iterations) { return LayoutTabs(100, iterations); });
+	CE_BENCHMARK("tab_layout/compute/1000", 1000, [](size_t iterations) { return LayoutTabs(1000, iterations); });
+	CE_BENCHMARK("tab_layout/compute/10000", 10000, [](size_t iterations) { return LayoutTabs(10000, iterations); });
+
+	// Hit-testing 1024 points over a 10,000 tab strip scrolled halfway.
+	CE_BENCHMARK("tab_layout/hit_test/10000", 1024, [](size_t iterations)
+	{
+		const StripInput &strip = GetStrip(10000);
+		static const std::vector<std::pair<int, int>> points = []()
+		{
+			Synthetic::Random random(42);
+			std::vector<std::pair<int, int>> result;
+			for (int i = 0; i < 1024; ++i)
+				result.emplace_back(random.Range(kClient.left, kClient.right - 1), random.Range(kClient.top, kClient.bottom - 1));
+			return result;
+		}();
+
+		TabLayout::Metrics metrics;
+		TabLayout::StripLayout layout;
+		layout.Compute(metrics, kClient, strip.groupSizes, strip.tabWidths, 0);
+		layout.Compute(metrics, kClient, strip.groupSizes, strip.tabWidths, layout.GetMaxScrollOffset() / 2);
+
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			for (const auto &point : points)
+			{
+				TabLayout::HitTestResult result = layout.HitTest(point.first, point.second);
+				checksum += static_cast<uint64_t>(result.tabIndex + 1);
+			}
+		}
+		return checksum;
+	});
+
+	struct StoredTab
+	{
+		std::vector<unsigned char> idList;
+		IdList::Key key;
+	};
+
+	struct TabStore
+	{
+		std::vector<StoredTab> tabs;
+		std::vector<std::vector<unsigned char>> queries;
+	};
+
+	const TabStore &GetTabStore(size_t tabCount)
+	{
+		static std::map<size_t, TabStore> stores;
+		auto found = stores.find(tabCount);
+		if (found != stores.end())
+			return found->second;
+
+		Synthetic::Random random(7);
+		std::vector<unsigned char> parent = Synthetic::MakeIdList(random, 4);
+		TabStore &store = stores[tabCount];
+		for (size_t i = 0; i < tabCount; ++i)
+		{
+			StoredTab tab;
+			tab.idList = Synthetic::AppendIdList(parent, Synthetic::MakeIdList(random, random.Range(1, 3)));
+			tab.key = IdList::MakeKey(tab.idList.data());
+			store.tabs.push_back(tab);
+
+			// The Shell hands out a fresh copy of the list, never the tab's own.
+			store.queries.push_back(tab.idList);
+		}
+		return store;
+	}
+
+	// Finding the tab showing a location, as CAddressBar::FindTabByPidl does before it falls
+	// back to ILIsEqual. Every tab lives under the same folder, so the lists share a prefix.
+	uint64_t FindTabByIdList(size_t tabCount, size_t iterations)
+	{
+		const TabStore &store = GetTabStore(tabCount);
+		const std::vector<StoredTab> &tabs = store.tabs;
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			const std::vector<unsigned char> &query = store.queries[(i * 7919) % tabCount];
+			IdList::Key key = IdList::MakeKey(query.data());
+			for (size_t t = 0; t < tabs.size(); ++t)
+			{
+				if (IdList::IsSameBytes(tabs[t].idList.data(), tabs[t].key, query.data(), key))
+				{
+					checksum += t;
+					break;
+				}
+			}
+		}
+		return checksum;
+	}
+
+	CE_BENCHMARK("tab_store/find_by_id_list/100", 1, [](size_t iterations) { return FindTabByIdList(100, iterations); });
+	CE_BENCHMARK("tab_store/find_by_id_list/1000", 1, [](size_t iterations) { return FindTabByIdList(1000, iterations); });
+	CE_BENCHMARK("tab_store/find_by_id_list/10000", 1, [](size_t iterations) { return FindTabByIdList(10000, iterations); });
+
+	struct ModelTab
+	{
+		std::wstring title;
+		std::vector<unsigned char> idList;
+		unsigned int id = 0;
+	};
+
+	struct ModelGroup
+	{
+		std::vector<ModelTab> tabs;
+	};
+
+	// Moving random tabs between random slots of a 1,000 tab strip, as a drop does.
+	CE_BENCHMARK("tab_store/move_tab/1000", 1, [](size_t iterations)
+	{
+		static std::vector<ModelGroup> groups = []()
+		{
+			Synthetic::Random random(3);
+			std::vector<ModelGroup> result(1000 / kTabsPerGroup);
+			unsigned int id = 0;
+			for (ModelGroup &group : result)
+			{
+				for (int i = 0; i < kTabsPerGroup; ++i)
+					group.tabs.push_back({ Synthetic::MakeName(random, 8, 40), Synthetic::MakeIdList(random, 5), ++id });
+			}
+			return result;
+		}();
+		static Synthetic::Random random(11);
+
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			// Never empty a group, so the shape of the strip stays the same from run to run.
+			int sourceGroup = random.Range(0, static_cast<int>(groups.size()) - 1);
+			if (groups[sourceGroup].tabs.size() < 2)
+				continue;
+
+			TabLayout::TabRef source = { sourceGroup, random.Range(0, static_cast<int>(groups[sourceGroup].tabs.size()) - 1) };
+			int targetGroup = random.Range(0, static_cast<int>(groups.size()) - 1);
+			TabLayout::TabRef target = { targetGroup, random.Range(0, static_cast<int>(groups[targetGroup].tabs.size())) };
+			TabLayout::TabRef moved = TabOrder::MoveTab(groups, source, target);
+			checksum += groups[moved.groupIndex].tabs[moved.tabIndex].id;
+		}
+		return checksum;
+	});
+}
@@ -0,0 +1,100 @@
+/*
+ * bench_text_fit.cpp: Benchmarks of tab title fitting over 10,000 long titles in a fake font.
+ */
+
+#include "bench.h"
+#include "synthetic.h"
+
+#include "util/text_fit.h"
+
+namespace
+{
+	const size_t kTitleCount = 10000;
+
+	// A proportional fake font standing in for GetTextExtentExPointW.
+	int GetCharWidth(wchar_t ch)
+	{
+		return 3 + (static_cast<unsigned>(ch) * 7) % 10;
+	}
+
+	void MeasureTitle(TextFit::TitleMetrics &metrics, const std::wstring &title)
+	{
+		metrics.Reset(1);
+		metrics.advances.resize(title.length());
+		int width = 0;
+		for (size_t i = 0; i < title.length(); ++i)
+		{
+			width += GetCharWidth(title[i]);
+			metrics.advances[i] = width;
+		}
+		metrics.ellipsisWidth = 3 * GetCharWidth(L'.');
+	}
+
+	struct Titles
+	{
+		std::vector<std::wstring> text;
+		std::vector<TextFit::TitleMetrics> metrics;
+	};
+
+	// Long paths, as shown by tabs with full paths in their titles.
+	Titles &GetTitles()
+	{
+		static Titles titles = []()
+		{
+			Synthetic::Random random(27);
+			Titles result;
+			for (size_t i = 0; i < kTitleCount; ++i)
+			{
+				result.text.push_back(Synthetic::MakePath(random, random.Range(6, 16)));
+				result.metrics.emplace_back();
+				MeasureTitle(result.metrics.back(), result.text.back());
+			}
+			return result;
+		}();
+		return titles;
+	}
+
+	// Measuring every title once, as happens when the font changes.
+	CE_BENCHMARK("text_fit/measure/10000", kTitleCount, [](size_t iterations)
+	{
+		Titles &titles = GetTitles();
+		TextFit::TitleMetrics metrics;
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			for (const std::wstring &title : titles.text)
+			{
+				MeasureTitle(metrics, title);
+				checksum += metrics.GetWidth();
+			}
+		}
+		return checksum;
+	});
+
+	// Fitting every title to a new width, as a resize of the tab bar does.
+	CE_BENCHMARK("text_fit/fit/10000", kTitleCount, [](size_t iterations)
+	{
+		Titles &titles = GetTitles();
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			int width = 80 + static_cast<int>(i % 160);
+			for (size_t t = 0; t < kTitleCount; ++t)
+				checksum += TextFit::GetDisplayText(titles.metrics[t], titles.text[t], width).length();
+		}
+		return checksum;
+	});
+
+	// Repainting every title at the width it was last fitted to.
+	CE_BENCHMARK("text_fit/repaint/10000", kTitleCount, [](size_t iterations)
+	{
+		Titles &titles = GetTitles();
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			for (size_t t = 0; t < kTitleCount; ++t)
+				checksum += TextFit::GetDisplayText(titles.metrics[t], titles.text[t], 200).length();
+		}
+		return checksum;
+	});
+}
@@ -0,0 +1,63 @@
+/*
+ * bench_theme_pack.cpp: Benchmarks of reading a theme pack and decoding its sprites.
+ */
+
+#include "bench.h"
+#include "synthetic.h"
+
+#include "util/theme_pack.h"
+
+namespace
+{
+	// The three throbber sizes of the bundled themes, as strips of eight frames.
+	const std::vector<unsigned char> &GetPack()
+	{
+		static const std::vector<unsigned char> pack = []()
+		{
+			Synthetic::Random random(42);
+			return Synthetic::MakeThemePack({
+				Synthetic::MakeBmp(random, 22 * 8, 22, 24),
+				Synthetic::MakeBmp(random, 26 * 8, 26, 24),
+				Synthetic::MakeBmp(random, 38 * 8, 38, 32),
+			});
+		}();
+		return pack;
+	}
+
+	// Parsing is all that happens when Explorer starts, so it must stay trivial.
+	CE_BENCHMARK("theme_pack/parse", 1, [](size_t iterations)
+	{
+		const std::vector<unsigned char> &data = GetPack();
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			ThemePack pack;
+			checksum += ThemePack::Parse(data.data(), data.size(), pack) ? pack.GetSprites().size() : 0;
+		}
+		return checksum;
+	});
+
+	uint64_t DecodeSprite(int sizeClass, size_t iterations)
+	{
+		static ThemePack pack = []()
+		{
+			ThemePack result;
+			ThemePack::Parse(GetPack().data(), GetPack().size(), result);
+			return result;
+		}();
+
+		int index = pack.FindSprite(ThemePack::SpriteRole::Throbber, sizeClass);
+		uint64_t checksum = 0;
+		DecodedImage image;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			if (pack.DecodeSprite(index, image))
+				checksum += image.pixels[0];
+		}
+		return checksum;
+	}
+
+	// Decoding is once per size per process, when the throbber is first drawn.
+	CE_BENCHMARK("theme_pack/decode/small_24bpp", 22 * 8 * 22, [](size_t iterations) { return DecodeSprite(0, iterations); });
+	CE_BENCHMARK("theme_pack/decode/large_32bpp", 38 * 8 * 38, [](size_t iterations) { return DecodeSprite(2, iterations); });
+}
@@ -0,0 +1,72 @@
+/*
+ * bench_timer_wheel.cpp: Benchmarks of scheduling, cancelling and firing 100k timers.
+ */
+
+#include "bench.h"
+#include "synthetic.h"
+
+#include "util/timer_wheel.h"
+
+namespace
+{
+	const size_t kTimerCount = 100000;
+
+	// Delays of a UI thread's timers: mostly debounces and frames, some idle work seconds out.
+	const std::vector<uint64_t> &GetDelays()
+	{
+		static const std::vector<uint64_t> delays = []()
+		{
+			Synthetic::Random random(41);
+			std::vector<uint64_t> result;
+			for (size_t i = 0; i < kTimerCount; ++i)
+			{
+				int kind = random.Range(0, 9);
+				if (kind < 6)
+					result.push_back(static_cast<uint64_t>(random.Range(1, 250)));
+				else if (kind < 9)
+					result.push_back(static_cast<uint64_t>(random.Range(250, 10000)));
+				else
+					result.push_back(static_cast<uint64_t>(random.Range(10000, 600000)));
+			}
+			return result;
+		}();
+		return delays;
+	}
+
+	// Every timer fires, with the clock moved on a frame at a time as a UI thread would.
+	CE_BENCHMARK("timer_wheel/schedule_fire/100000", kTimerCount, [](size_t iterations)
+	{
+		const std::vector<uint64_t> &delays = GetDelays();
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			TimerWheel wheel(1000);
+			uint64_t fired = 0;
+			for (uint64_t delay : delays)
+				wheel.Schedule(1000 + delay, [&fired]() { fired++; });
+
+			uint64_t wakeup;
+			while (wheel.GetNextWakeup(wakeup))
+				wheel.Advance(wakeup + 15);
+			checksum += fired;
+		}
+		return checksum;
+	});
+
+	// Debouncing: almost every timer is cancelled before it fires.
+	CE_BENCHMARK("timer_wheel/schedule_cancel/100000", kTimerCount, [](size_t iterations)
+	{
+		const std::vector<uint64_t> &delays = GetDelays();
+		static std::vector<TimerWheel::TimerId> ids(kTimerCount);
+		uint64_t checksum = 0;
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			TimerWheel wheel(1000);
+			for (size_t t = 0; t < kTimerCount; ++t)
+				ids[t] = wheel.Schedule(1000 + delays[t], nullptr);
+			for (TimerWheel::TimerId id : ids)
+				checksum += wheel.Cancel(id);
+		}
+		return checksum;
+	});
+}
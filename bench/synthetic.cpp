@@ -0,0 +1,181 @@
+/*
+ * synthetic.cpp: Deterministic generators of benchmark inputs.
+ */
+
+#include "synthetic.h"
+
+#include <cstring>
+
+namespace Synthetic
+{
+
+static void AppendUInt16(std::vector<unsigned char> &data, uint16_t value)
+{
+	unsigned char bytes[sizeof(value)];
+	memcpy(bytes, &value, sizeof(value));
+	data.insert(data.end(), bytes, bytes + sizeof(value));
+}
+
+static void AppendUInt32(std::vector<unsigned char> &data, uint32_t value)
+{
+	unsigned char bytes[sizeof(value)];
+	memcpy(bytes, &value, sizeof(value));
+	data.insert(data.end(), bytes, bytes + sizeof(value));
+}
+
+std::wstring MakeName(Random &random, int minLength, int maxLength)
+{
+	static const wchar_t kAlphabet[] = L"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 _-.()";
+	const int alphabetSize = static_cast<int>(sizeof(kAlphabet) / sizeof(kAlphabet[0])) - 1;
+
+	std::wstring name;
+	int length = random.Range(minLength, maxLength);
+	for (int i = 0; i < length; ++i)
+		name.push_back(kAlphabet[random.Range(0, alphabetSize - 1)]);
+	return name;
+}
+
+std::wstring MakePath(Random &random, int depth)
+{
+	std::wstring path = L"C:";
+	for (int i = 0; i < depth; ++i)
+	{
+		path += L'\\';
+		path += MakeName(random, 3, 24);
+	}
+	return path;
+}
+
+std::vector<unsigned char> MakeDropFiles(const std::vector<std::wstring> &paths)
+{
+	// DROPFILES { DWORD pFiles; POINT pt; BOOL fNC; BOOL fWide; }
+	std::vector<unsigned char> data;
+	AppendUInt32(data, 20);
+	AppendUInt32(data, 0);
+	AppendUInt32(data, 0);
+	AppendUInt32(data, 0);
+	AppendUInt32(data, 1);
+
+	for (const std::wstring &path : paths)
+	{
+		for (wchar_t c : path)
+			AppendUInt16(data, static_cast<uint16_t>(c));
+		AppendUInt16(data, 0);
+	}
+	AppendUInt16(data, 0);
+	return data;
+}
+
+std::vector<unsigned char> MakeIdList(Random &random, int items)
+{
+	std::vector<unsigned char> data;
+	for (int i = 0; i < items; ++i)
+	{
+		int payload = random.Range(12, 60);
+		AppendUInt16(data, static_cast<uint16_t>(payload + 2));
+		for (int b = 0; b < payload; ++b)
+			data.push_back(static_cast<unsigned char>(random.Next()));
+	}
+	AppendUInt16(data, 0);
+	return data;
+}
+
+std::vector<unsigned char> AppendIdList(const std::vector<unsigned char> &parent, const std::vector<unsigned char> &child)
+{
+	std::vector<unsigned char> data(parent.begin(), parent.end() - sizeof(uint16_t));
+	data.insert(data.end(), child.begin(), child.end());
+	return data;
+}
+
+std::vector<unsigned char> MakeCida(const std::vector<unsigned char> &folder, const std::vector<std::vector<unsigned char>> &items)
+{
+	// CIDA { UINT cidl; UINT aoffset[cidl + 1]; }, followed by the lists.
+	std::vector<unsigned char> data;
+	AppendUInt32(data, static_cast<uint32_t>(items.size()));
+
+	uint32_t offset = static_cast<uint32_t>((items.size() + 2) * sizeof(uint32_t));
+	AppendUInt32(data, offset);
+	offset += static_cast<uint32_t>(folder.size());
+	for (const auto &item : items)
+	{
+		AppendUInt32(data, offset);
+		offset += static_cast<uint32_t>(item.size());
+	}
+
+	data.insert(data.end(), folder.begin(), folder.end());
+	for (const auto &item : items)
+		data.insert(data.end(), item.begin(), item.end());
+	return data;
+}
+
+std::vector<unsigned char> MakeBmp(Random &random, int width, int height, int bitCount)
+{
+	uint32_t stride = ((static_cast<uint32_t>(width) * bitCount + 31) / 32) * 4;
+	uint32_t pixelOffset = 14 + 40;
+
+	// BITMAPFILEHEADER, then BITMAPINFOHEADER; see util/image_decode.cpp.
+	std::vector<unsigned char> data;
+	data.push_back('B');
+	data.push_back('M');
+	AppendUInt32(data, pixelOffset + stride * height);
+	AppendUInt32(data, 0);
+	AppendUInt32(data, pixelOffset);
+	AppendUInt32(data, 40);
+	AppendUInt32(data, static_cast<uint32_t>(width));
+	AppendUInt32(data, static_cast<uint32_t>(height));
+	AppendUInt16(data, 1);
+	AppendUInt16(data, static_cast<uint16_t>(bitCount));
+	for (int i = 0; i < 6; ++i)
+		AppendUInt32(data, 0);
+
+	for (uint32_t i = 0; i < stride * height; ++i)
+		data.push_back(static_cast<unsigned char>(random.Next()));
+	return data;
+}
+
+std::vector<unsigned char> MakeThemePack(const std::vector<std::vector<unsigned char>> &bmpSprites)
+{
+	// The header and sprite table are laid out in util/theme_pack.h.
+	uint32_t tableSize = static_cast<uint32_t>(bmpSprites.size() * 20);
+	const char kName[] = "Synthetic";
+	uint32_t nameLength = sizeof(kName) - 1;
+
+	std::vector<unsigned char> data = { 'C', 'E', 'T', 'P' };
+	AppendUInt16(data, 1);
+	AppendUInt16(data, static_cast<uint16_t>(bmpSprites.size()));
+	AppendUInt32(data, 0xFFFFFFFF);
+	AppendUInt16(data, 30);
+	AppendUInt16(data, 40);
+	AppendUInt16(data, 100);
+	AppendUInt16(data, 0);
+	AppendUInt32(data, 32 + tableSize);
+	AppendUInt32(data, nameLength);
+	AppendUInt32(data, 0);
+
+	uint32_t offset = 32 + tableSize + nameLength;
+	for (size_t i = 0; i < bmpSprites.size(); ++i)
+	{
+		const std::vector<unsigned char> &bmp = bmpSprites[i];
+		uint32_t width;
+		uint32_t height;
+		memcpy(&width, bmp.data() + 18, sizeof(width));
+		memcpy(&height, bmp.data() + 22, sizeof(height));
+
+		AppendUInt16(data, 0);
+		AppendUInt16(data, static_cast<uint16_t>(i));
+		AppendUInt16(data, 0);
+		AppendUInt16(data, 0);
+		AppendUInt16(data, 0);
+		AppendUInt16(data, static_cast<uint16_t>(width / height));
+		AppendUInt32(data, offset);
+		AppendUInt32(data, static_cast<uint32_t>(bmp.size()));
+		offset += static_cast<uint32_t>(bmp.size());
+	}
+
+	data.insert(data.end(), kName, kName + nameLength);
+	for (const std::vector<unsigned char> &bmp : bmpSprites)
+		data.insert(data.end(), bmp.begin(), bmp.end());
+	return data;
+}
+
+} // namespace Synthetic
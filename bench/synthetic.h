@@ -0,0 +1,62 @@
+#pragma once
+#ifndef _SYNTHETIC_H
+#define _SYNTHETIC_H
+
+/*
+ * Deterministic generators of benchmark inputs. Every generator takes the random source, so
+ * each benchmark sees the same data on every run.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Synthetic
+{
+	// xorshift64*; fast, and the same sequence on every platform.
+	class Random
+	{
+	public:
+		explicit Random(uint64_t seed = 0x9E3779B97F4A7C15ULL) : m_state(seed ? seed : 1) {}
+
+		uint64_t Next()
+		{
+			m_state ^= m_state >> 12;
+			m_state ^= m_state << 25;
+			m_state ^= m_state >> 27;
+			return m_state * 0x2545F4914F6CDD1DULL;
+		}
+
+		// Uniform in [low, high].
+		int Range(int low, int high)
+		{
+			return low + static_cast<int>(Next() % static_cast<uint64_t>(high - low + 1));
+		}
+
+	private:
+		uint64_t m_state;
+	};
+
+	std::wstring MakeName(Random &random, int minLength, int maxLength);
+	std::wstring MakePath(Random &random, int depth);
+
+	// A wide CF_HDROP block holding the given paths.
+	std::vector<unsigned char> MakeDropFiles(const std::vector<std::wstring> &paths);
+
+	// An ID list of the given number of items, each with a random payload.
+	std::vector<unsigned char> MakeIdList(Random &random, int items);
+	std::vector<unsigned char> AppendIdList(const std::vector<unsigned char> &parent, const std::vector<unsigned char> &child);
+
+	// A CFSTR_SHELLIDLIST block with a parent folder and the given children.
+	std::vector<unsigned char> MakeCida(const std::vector<unsigned char> &folder, const std::vector<std::vector<unsigned char>> &items);
+
+	// An uncompressed 24 or 32 bpp .bmp file of random pixels.
+	std::vector<unsigned char> MakeBmp(Random &random, int width, int height, int bitCount);
+
+	// A theme pack with one throbber sprite per .bmp file, size classes in order, each a strip
+	// of square frames.
+	std::vector<unsigned char> MakeThemePack(const std::vector<std::vector<unsigned char>> &bmpSprites);
+}
+
+#endif // _SYNTHETIC_H
@@ -7,6 +7,9 @@
 #include "resource.h"
 #include "ClassicExplorer_i.h"
 #include "dllmain.h"
+#include "util/trace.h"
+#include "util/util.h"
+#include "util/animation_timer.h"
 
 CAddressBarModule g_AtlModule;
 
@@ -14,7 +17,17 @@ CAddressBarModule g_AtlModule;
 _Use_decl_annotations_
 STDAPI DllCanUnloadNow(void)
 {
-	return g_AtlModule.DllCanUnloadNow();
+	HRESULT hr = g_AtlModule.DllCanUnloadNow();
+
+	// Stop the settings watch and the animation timer here rather than in DllMain, as they
+	// wait for their callbacks.
+	if (hr == S_OK)
+	{
+		CEUtil::ShutdownSettings();
+		CEUtil::GetAnimationTimer().Shutdown();
+	}
+
+	return hr;
 }
 
 // Returns a class factory to create an object of the requested type.
@@ -91,5 +104,14 @@ STDAPI DllInstall(BOOL bInstall, _In_opt_  LPCWSTR pszCmdLine)
 // DLL entry point, managed by ATL.
 extern "C" BOOL WINAPI DllMain(HINSTANCE hInstance, DWORD dwReason, LPVOID lpReserved)
 {
+	if (dwReason == DLL_PROCESS_ATTACH)
+	{
+		CETrace::Register();
+	}
+	else if (dwReason == DLL_PROCESS_DETACH)
+	{
+		CETrace::Unregister();
+	}
+
 	return g_AtlModule.DllMain(dwReason, lpReserved);
 }
@@ -0,0 +1,222 @@
+/*
+ * drag_pacer_test.cpp: Drag pacing over synthetic mouse streams and a fake clock.
+ */
+
+#include "util/drag_pacer.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+	struct Sample
+	{
+		unsigned long long timeMs;
+		DragPacer::Point point;
+		bool outside;
+	};
+
+	struct Delivery
+	{
+		unsigned long long timeMs;
+		DragPacer::Point point;
+		bool outside;
+
+		// The number of samples pushed by the time of the delivery.
+		unsigned long long received;
+	};
+
+	// A mouse moving right one pixel per sample, every intervalMs, with optional jitter.
+	std::vector<Sample> MakeStream(size_t count, unsigned int intervalMs, unsigned int jitterMs = 0, uint64_t seed = 1)
+	{
+		std::vector<Sample> stream;
+		unsigned long long now = 1000;
+		for (size_t i = 0; i < count; ++i)
+		{
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			unsigned long long jitter = jitterMs ? (seed >> 33) % (jitterMs + 1) : 0;
+			now += intervalMs + jitter;
+			stream.push_back({ now, { static_cast<int>(i), 0 }, false });
+		}
+		return stream;
+	}
+
+	// Feed a stream to the pacer as the tab bar does: every sample goes through Push, and a
+	// one-shot timer armed for GetDelayUntilDue calls TakeDue. The timer runs until the pacer
+	// has nothing pending.
+	std::vector<Delivery> Replay(DragPacer &pacer, const std::vector<Sample> &stream)
+	{
+		std::vector<Delivery> deliveries;
+		bool timerArmed = false;
+		unsigned long long timerDueMs = 0;
+
+		auto fireTimer = [&](unsigned long long now)
+		{
+			timerArmed = false;
+			DragPacer::Point point;
+			if (pacer.TakeDue(now, point))
+				deliveries.push_back({ now, point, false, pacer.GetStats().received });
+			if (pacer.HasPending())
+			{
+				timerArmed = true;
+				timerDueMs = now + pacer.GetDelayUntilDue(now);
+			}
+		};
+
+		for (const Sample &sample : stream)
+		{
+			// WM_TIMER has the lowest priority, so input queued for the same tick comes first.
+			while (timerArmed && timerDueMs < sample.timeMs)
+				fireTimer(timerDueMs);
+
+			if (pacer.Push(sample.point, sample.outside, sample.timeMs))
+				deliveries.push_back({ sample.timeMs, sample.point, sample.outside, pacer.GetStats().received });
+			else if (!timerArmed)
+			{
+				timerArmed = true;
+				timerDueMs = sample.timeMs + pacer.GetDelayUntilDue(sample.timeMs);
+			}
+		}
+
+		while (timerArmed)
+			fireTimer(timerDueMs);
+		return deliveries;
+	}
+}
+
+TEST(DragPacerTest, FirstSampleIsDeliveredImmediately)
+{
+	DragPacer pacer(16);
+	EXPECT_TRUE(pacer.Push({ 5, 5 }, false, 100));
+	EXPECT_FALSE(pacer.HasPending());
+	EXPECT_EQ(1u, pacer.GetStats().delivered);
+}
+
+TEST(DragPacerTest, SamplesWithinAFrameAreCoalescedToTheLatest)
+{
+	DragPacer pacer(16);
+	ASSERT_TRUE(pacer.Push({ 0, 0 }, false, 100));
+	EXPECT_FALSE(pacer.Push({ 1, 0 }, false, 101));
+	EXPECT_FALSE(pacer.Push({ 2, 0 }, false, 105));
+	EXPECT_FALSE(pacer.Push({ 3, 0 }, false, 110));
+	EXPECT_EQ(6u, pacer.GetDelayUntilDue(110));
+
+	DragPacer::Point point;
+	EXPECT_FALSE(pacer.TakeDue(115, point));
+	ASSERT_TRUE(pacer.TakeDue(116, point));
+	EXPECT_EQ(3, point.x);
+	EXPECT_FALSE(pacer.HasPending());
+	EXPECT_FALSE(pacer.TakeDue(200, point));
+
+	EXPECT_EQ(4u, pacer.GetStats().received);
+	EXPECT_EQ(2u, pacer.GetStats().delivered);
+}
+
+TEST(DragPacerTest, ThousandHertzMouseIsPacedToFrameRate)
+{
+	DragPacer pacer(16);
+	std::vector<Sample> stream = MakeStream(1000, 1);
+	std::vector<Delivery> deliveries = Replay(pacer, stream);
+
+	// One second of input yields about one delivery per 16 ms frame.
+	EXPECT_GE(deliveries.size(), 62u);
+	EXPECT_LE(deliveries.size(), 64u);
+	for (size_t i = 1; i < deliveries.size(); ++i)
+		EXPECT_GE(deliveries[i].timeMs - deliveries[i - 1].timeMs, 16u);
+
+	// The final position is never dropped.
+	EXPECT_EQ(stream.back().point.x, deliveries.back().point.x);
+	EXPECT_EQ(stream.size(), pacer.GetStats().received);
+	EXPECT_EQ(deliveries.size(), pacer.GetStats().delivered);
+}
+
+TEST(DragPacerTest, DeliveriesAreAlwaysTheLatestSampleAndInOrder)
+{
+	DragPacer pacer(16);
+	std::vector<Sample> stream = MakeStream(5000, 0, 3, 29);
+	std::vector<Delivery> deliveries = Replay(pacer, stream);
+
+	int lastX = -1;
+	for (const Delivery &delivery : deliveries)
+	{
+		// Whatever is delivered is the newest sample pushed so far.
+		ASSERT_GT(delivery.received, 0u);
+		EXPECT_EQ(stream[delivery.received - 1].point.x, delivery.point.x) << "at " << delivery.timeMs;
+		EXPECT_GT(delivery.point.x, lastX);
+		lastX = delivery.point.x;
+	}
+	EXPECT_EQ(stream.back().point.x, deliveries.back().point.x);
+}
+
+TEST(DragPacerTest, SlowMouseIsNeverDelayed)
+{
+	DragPacer pacer(16);
+	std::vector<Sample> stream = MakeStream(100, 20);
+	std::vector<Delivery> deliveries = Replay(pacer, stream);
+	ASSERT_EQ(stream.size(), deliveries.size());
+	for (size_t i = 0; i < stream.size(); ++i)
+		EXPECT_EQ(stream[i].timeMs, deliveries[i].timeMs);
+}
+
+TEST(DragPacerTest, DetachCrossingsAreDeliveredWithinAFrame)
+{
+	DragPacer pacer(16);
+	std::vector<Sample> stream = MakeStream(1000, 1);
+
+	// A 2 ms excursion out of the strip, far shorter than a frame.
+	stream[500].outside = true;
+	stream[501].outside = true;
+	std::vector<Delivery> deliveries = Replay(pacer, stream);
+
+	bool sawOut = false;
+	bool sawBack = false;
+	for (const Delivery &delivery : deliveries)
+	{
+		if (delivery.point.x == stream[500].point.x)
+		{
+			EXPECT_TRUE(delivery.outside);
+			EXPECT_EQ(stream[500].timeMs, delivery.timeMs);
+			sawOut = true;
+		}
+		if (delivery.point.x == stream[502].point.x)
+		{
+			EXPECT_FALSE(delivery.outside);
+			EXPECT_EQ(stream[502].timeMs, delivery.timeMs);
+			sawBack = true;
+		}
+	}
+	EXPECT_TRUE(sawOut);
+	EXPECT_TRUE(sawBack);
+	EXPECT_EQ(2u, pacer.GetStats().crossings);
+}
+
+TEST(DragPacerTest, TakePendingFlushesBeforeADrop)
+{
+	DragPacer pacer(16);
+	ASSERT_TRUE(pacer.Push({ 0, 0 }, false, 100));
+	EXPECT_FALSE(pacer.Push({ 9, 9 }, false, 102));
+
+	DragPacer::Point point;
+	ASSERT_TRUE(pacer.TakePending(point));
+	EXPECT_EQ(9, point.x);
+	EXPECT_EQ(9, point.y);
+	EXPECT_FALSE(pacer.TakePending(point));
+
+	// Flushing doesn't restart the frame; the next due time is still measured from 100.
+	EXPECT_FALSE(pacer.Push({ 10, 10 }, false, 110));
+	EXPECT_EQ(6u, pacer.GetDelayUntilDue(110));
+}
+
+TEST(DragPacerTest, ResetStartsANewDrag)
+{
+	DragPacer pacer(16);
+	ASSERT_TRUE(pacer.Push({ 0, 0 }, false, 100));
+	EXPECT_TRUE(pacer.Push({ 1, 0 }, true, 101));
+	pacer.Reset();
+
+	EXPECT_FALSE(pacer.HasPending());
+	EXPECT_EQ(0u, pacer.GetDelayUntilDue(102));
+	EXPECT_TRUE(pacer.Push({ 2, 0 }, false, 102));
+}
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef _FAKE_KEY_STORE_H
+#define _FAKE_KEY_STORE_H
+
+/*
+ * FakeKeyStore: An in-memory SettingsKeyStore standing in for the registry key, which counts
+ *               how it is used. Names are case-insensitive, as in the registry.
+ */
+
+#include "util/settings_schema.h"
+
+#include <cwctype>
+#include <map>
+
+class FakeKeyStore : public CEUtil::SettingsKeyStore
+{
+public:
+	bool EnumerateValues(std::vector<CEUtil::RawSettingValue> &valuesOut) override
+	{
+		enumerations++;
+		if (unreadable)
+			return false;
+		for (const auto &entry : values)
+			valuesOut.push_back(entry.second);
+		return true;
+	}
+
+	bool GetValue(const wchar_t *name, CEUtil::RawSettingValue &valueOut) override
+	{
+		gets++;
+		auto found = values.find(Fold(name));
+		if (unreadable || found == values.end())
+			return false;
+		valueOut = found->second;
+		return true;
+	}
+
+	bool SetValue(const CEUtil::RawSettingValue &value) override
+	{
+		sets++;
+		values[Fold(value.name)] = value;
+		return true;
+	}
+
+	void SetDword(const wchar_t *name, uint32_t dword)
+	{
+		CEUtil::RawSettingValue value;
+		value.name = name;
+		value.kind = CEUtil::RawSettingValue::Kind::Dword;
+		value.dword = dword;
+		values[Fold(name)] = value;
+	}
+
+	void SetString(const wchar_t *name, const std::wstring &string)
+	{
+		CEUtil::RawSettingValue value;
+		value.name = name;
+		value.kind = CEUtil::RawSettingValue::Kind::String;
+		value.string = string;
+		values[Fold(name)] = value;
+	}
+
+	bool Has(const wchar_t *name) const
+	{
+		return values.count(Fold(name)) != 0;
+	}
+
+	CEUtil::RawSettingValue &At(const wchar_t *name)
+	{
+		return values.at(Fold(name));
+	}
+
+	std::map<std::wstring, CEUtil::RawSettingValue> values;
+	bool unreadable = false;
+	int enumerations = 0;
+	int gets = 0;
+	int sets = 0;
+
+private:
+	static std::wstring Fold(const std::wstring &name)
+	{
+		std::wstring folded = name;
+		for (wchar_t &c : folded)
+			c = static_cast<wchar_t>(towlower(c));
+		return folded;
+	}
+};
+
+#endif // _FAKE_KEY_STORE_H
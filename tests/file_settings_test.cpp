@@ -0,0 +1,215 @@
+/*
+ * file_settings_test.cpp: Parsing, caching and atomic replacement of the INI settings file.
+ */
+
+#include "util/file_settings.h"
+#include "util/settings_schema.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+using namespace CEUtil;
+
+namespace
+{
+	class FileSettingsTest : public testing::Test
+	{
+	protected:
+		FileSettingsTest()
+		{
+			const testing::TestInfo *info = testing::UnitTest::GetInstance()->current_test_info();
+			m_directory = std::filesystem::temp_directory_path() / (std::string("ce_file_settings_") + info->name());
+			std::filesystem::remove_all(m_directory);
+			std::filesystem::create_directories(m_directory);
+			m_path = m_directory / "settings.ini";
+		}
+
+		~FileSettingsTest()
+		{
+			std::error_code error;
+			std::filesystem::remove_all(m_directory, error);
+		}
+
+		void WriteRaw(const std::string &text)
+		{
+			std::ofstream out(m_path, std::ios::binary | std::ios::trunc);
+			out << text;
+		}
+
+		// Everything in the directory other than the settings file itself.
+		std::vector<std::filesystem::path> GetStrayFiles() const
+		{
+			std::vector<std::filesystem::path> stray;
+			for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(m_directory))
+			{
+				if (entry.path() != m_path)
+					stray.push_back(entry.path());
+			}
+			return stray;
+		}
+
+		std::filesystem::path m_directory;
+		std::filesystem::path m_path;
+	};
+}
+
+TEST(FileSettingsTextTest, ParsesTheDocumentedFormat)
+{
+	const char *text =
+		"; comment\n"
+		"[ClassicExplorer]\n"
+		"# another comment\n"
+		"Theme = \"10\"\r\n"
+		"showgobutton=false\n"
+		"ShowAddressLabel = yes\n"
+		"TabFixedWidth=99999\n"
+		"TabFixedHeight = '40'\n"
+		"Junk = 1\n"
+		"no equals sign\n";
+
+	CESettings settings = FileSettingsBackend::ParseText(text, strlen(text));
+	EXPECT_EQ(CLASSIC_EXPLORER_10, settings.theme);
+	EXPECT_EQ(0, settings.showGoButton);
+	EXPECT_EQ(1, settings.showAddressLabel);
+	EXPECT_EQ(40, settings.tabFixedHeight);
+
+	// Out of range, so the default.
+	EXPECT_EQ(GetDefaultSettings().tabFixedWidth, settings.tabFixedWidth);
+}
+
+TEST(FileSettingsTextTest, FormattedTextRoundTrips)
+{
+	for (ClassicExplorerTheme theme : { CLASSIC_EXPLORER_2K, CLASSIC_EXPLORER_XP, CLASSIC_EXPLORER_10, CLASSIC_EXPLORER_MEMPHIS })
+	{
+		CESettings settings(theme, 0, 1, 0, 1, 333, 99);
+		std::string text = FileSettingsBackend::FormatText(settings);
+		EXPECT_EQ(settings, FileSettingsBackend::ParseText(text.data(), text.size()));
+	}
+
+	EXPECT_EQ(GetDefaultSettings(), FileSettingsBackend::ParseText("", 0));
+}
+
+TEST_F(FileSettingsTest, MissingFileGetsTheDefaults)
+{
+	FileSettingsBackend backend(m_path);
+	EXPECT_EQ(GetDefaultSettings(), backend.Load());
+}
+
+TEST_F(FileSettingsTest, WriteMergesAndLeavesNoTemporaryFile)
+{
+	WriteRaw("TabFixedWidth = 250\n");
+
+	FileSettingsBackend backend(m_path);
+	ASSERT_TRUE(backend.Write(CESettings(CLASSIC_EXPLORER_XP, -1, -1, -1)));
+
+	CESettings loaded = FileSettingsBackend(m_path).Load();
+	EXPECT_EQ(CLASSIC_EXPLORER_XP, loaded.theme);
+	EXPECT_EQ(250, loaded.tabFixedWidth);
+	EXPECT_TRUE(GetStrayFiles().empty());
+}
+
+TEST_F(FileSettingsTest, ExternalEditIsSeenOnTheNextLoad)
+{
+	FileSettingsBackend backend(m_path);
+	ASSERT_TRUE(backend.Write(CESettings(CLASSIC_EXPLORER_XP, -1, -1, -1)));
+	EXPECT_EQ(CLASSIC_EXPLORER_XP, backend.Load().theme);
+
+	// A different size, so the stamp changes even within the timestamp resolution.
+	WriteRaw("Theme = 98\nTabFixedHeight = 50\n");
+	CESettings loaded = backend.Load();
+	EXPECT_EQ(CLASSIC_EXPLORER_MEMPHIS, loaded.theme);
+	EXPECT_EQ(50, loaded.tabFixedHeight);
+}
+
+TEST_F(FileSettingsTest, WriteIntoAMissingDirectoryFails)
+{
+	FileSettingsBackend backend(m_directory / "missing" / "settings.ini");
+	EXPECT_FALSE(backend.Write(CESettings(CLASSIC_EXPLORER_XP, -1, -1, -1)));
+	EXPECT_EQ(GetDefaultSettings(), backend.Load());
+}
+
+TEST_F(FileSettingsTest, FailedRenameLeavesTheStoreUnchanged)
+{
+	// A directory where the file should be can't be renamed over.
+	std::filesystem::create_directory(m_path);
+
+	auto backend = std::make_unique<FileSettingsBackend>(m_path);
+	FileSettingsBackend *file = backend.get();
+	SettingsCache cache(std::move(backend));
+	std::shared_ptr<const CESettings> before = cache.Get();
+
+	EXPECT_FALSE(cache.Write(CESettings(CLASSIC_EXPLORER_XP, -1, -1, -1)));
+	EXPECT_EQ(before, cache.Get());
+	EXPECT_EQ(GetDefaultSettings(), file->Load());
+	EXPECT_TRUE(GetStrayFiles().empty());
+}
+
+TEST_F(FileSettingsTest, WatchReportsChanges)
+{
+	FileSettingsBackend backend(m_path, 10);
+	std::atomic<int> changes(0);
+	ASSERT_TRUE(backend.Watch([&changes]() { changes++; }));
+
+	WriteRaw("Theme = XP\n");
+	for (int i = 0; i < 500 && changes.load() == 0; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	EXPECT_GT(changes.load(), 0);
+
+	// Nothing is called once StopWatching returns.
+	backend.StopWatching();
+	int stopped = changes.load();
+	WriteRaw("Theme = 10\nShowGoButton = 0\n");
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(stopped, changes.load());
+}
+
+TEST_F(FileSettingsTest, ConcurrentWritersNeverExposeAPartialFile)
+{
+	// Writers on separate backends, as if in separate processes, set only the width; the theme
+	// stays XP throughout, so any partial or mixed file shows up as a bad read.
+	FileSettingsBackend(m_path).Write(CESettings(CLASSIC_EXPLORER_XP, -1, -1, -1, -1, 100, -1));
+
+	std::atomic<bool> stop(false);
+	std::atomic<unsigned long long> reads(0);
+	std::atomic<unsigned long long> bad(0);
+	std::thread reader([&]()
+	{
+		FileSettingsBackend backend(m_path);
+		while (!stop.load())
+		{
+			CESettings current = backend.Load();
+			if (current.theme != CLASSIC_EXPLORER_XP || current.tabFixedWidth < 100 || current.tabFixedWidth >= 700)
+				bad++;
+			reads++;
+		}
+	});
+
+	std::atomic<int> failedWrites(0);
+	std::vector<std::thread> writers;
+	for (int w = 0; w < 2; ++w)
+	{
+		writers.emplace_back([&, w]()
+		{
+			FileSettingsBackend backend(m_path);
+			for (int i = 0; i < 300; ++i)
+			{
+				if (!backend.Write(CESettings(CLASSIC_EXPLORER_NONE, -1, -1, -1, -1, 100 + w * 300 + i, -1)))
+					failedWrites++;
+			}
+		});
+	}
+	for (std::thread &writer : writers)
+		writer.join();
+
+	stop = true;
+	reader.join();
+
+	EXPECT_EQ(0, failedWrites.load());
+	EXPECT_EQ(0u, bad.load()) << "of " << reads.load() << " reads";
+	EXPECT_TRUE(GetStrayFiles().empty());
+}
@@ -0,0 +1,181 @@
+/*
+ * latency_histogram_test.cpp: Bucketing and percentiles against exact sorted samples.
+ */
+
+#include "util/latency_histogram.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return state >> 11;
+	}
+
+	// The nearest-rank percentile, as FindPercentile defines it.
+	uint64_t GetExactPercentile(const std::vector<uint64_t> &sorted, double percentile)
+	{
+		uint64_t rank = static_cast<uint64_t>((percentile / 100.0) * static_cast<double>(sorted.size()) + 0.5);
+		if (rank < 1)
+			rank = 1;
+		return sorted[rank - 1];
+	}
+
+	// Every value is reported as the upper bound of its bucket, which is at most 1/16 above it.
+	void ExpectWithinBucket(uint64_t exact, uint64_t reported)
+	{
+		EXPECT_GE(reported, exact);
+		EXPECT_LE(reported - exact, exact / LatencyHistogram::kSubBuckets) << "exact " << exact;
+	}
+
+	void ExpectPercentilesMatch(const std::vector<uint64_t> &values)
+	{
+		auto histogram = std::make_unique<LatencyHistogram>();
+		for (uint64_t value : values)
+			histogram->Record(value);
+
+		std::vector<uint64_t> sorted = values;
+		std::sort(sorted.begin(), sorted.end());
+
+		LatencyHistogram::Summary summary = histogram->Summarize();
+		EXPECT_EQ(values.size(), summary.count);
+		EXPECT_EQ(sorted.back(), summary.max);
+		ExpectWithinBucket(GetExactPercentile(sorted, 50), summary.p50);
+		ExpectWithinBucket(GetExactPercentile(sorted, 95), summary.p95);
+		ExpectWithinBucket(GetExactPercentile(sorted, 99), summary.p99);
+
+		for (double percentile : { 0.1, 1.0, 10.0, 25.0, 75.0, 90.0, 99.9, 100.0 })
+			ExpectWithinBucket(GetExactPercentile(sorted, percentile), histogram->GetValueAtPercentile(percentile));
+	}
+}
+
+TEST(LatencyHistogramTest, EveryValueFallsInsideItsBucket)
+{
+	for (uint64_t value = 0; value < 200000; ++value)
+	{
+		int index = LatencyHistogram::GetBucketIndex(value);
+		ASSERT_LE(value, LatencyHistogram::GetBucketUpperBound(index)) << value;
+		if (index > 0)
+		{
+			ASSERT_GT(value, LatencyHistogram::GetBucketUpperBound(index - 1)) << value;
+		}
+	}
+}
+
+TEST(LatencyHistogramTest, BucketsCoverTheFullRange)
+{
+	EXPECT_EQ(LatencyHistogram::kBucketCount - 1, LatencyHistogram::GetBucketIndex(~0ULL));
+	EXPECT_EQ(~0ULL, LatencyHistogram::GetBucketUpperBound(LatencyHistogram::kBucketCount - 1));
+
+	for (int bit = 0; bit < 64; ++bit)
+	{
+		uint64_t value = 1ULL << bit;
+		for (uint64_t probe : { value - 1, value, value + 1, value + (value >> 1) })
+		{
+			int index = LatencyHistogram::GetBucketIndex(probe);
+			ASSERT_GE(index, 0);
+			ASSERT_LT(index, LatencyHistogram::kBucketCount);
+			ExpectWithinBucket(probe, LatencyHistogram::GetBucketUpperBound(index));
+		}
+	}
+}
+
+TEST(LatencyHistogramTest, EmptyHistogramReportsZero)
+{
+	auto histogram = std::make_unique<LatencyHistogram>();
+	LatencyHistogram::Summary summary = histogram->Summarize();
+	EXPECT_EQ(0u, summary.count);
+	EXPECT_EQ(0u, summary.p50);
+	EXPECT_EQ(0u, summary.p99);
+	EXPECT_EQ(0u, summary.max);
+	EXPECT_EQ(0u, histogram->GetValueAtPercentile(50));
+}
+
+TEST(LatencyHistogramTest, SingleValueIsReportedExactly)
+{
+	// Percentiles are capped at the maximum, which is exact.
+	auto histogram = std::make_unique<LatencyHistogram>();
+	histogram->Record(123457);
+	LatencyHistogram::Summary summary = histogram->Summarize();
+	EXPECT_EQ(123457u, summary.p50);
+	EXPECT_EQ(123457u, summary.p99);
+	EXPECT_EQ(123457u, summary.max);
+}
+
+TEST(LatencyHistogramTest, PercentilesOfUniformValues)
+{
+	std::vector<uint64_t> values;
+	for (uint64_t i = 1; i <= 1000; ++i)
+		values.push_back(i * 1000);
+	ExpectPercentilesMatch(values);
+}
+
+TEST(LatencyHistogramTest, PercentilesOfLogNormalishValues)
+{
+	// Paint times: mostly tens of microseconds with a long tail into hundreds of milliseconds.
+	uint64_t state = 32;
+	std::vector<uint64_t> values;
+	for (int i = 0; i < 100000; ++i)
+	{
+		double exponent = 0;
+		for (int j = 0; j < 4; ++j)
+			exponent += static_cast<double>(NextRandom(state) % 1000) / 1000.0;
+		values.push_back(static_cast<uint64_t>(std::pow(10.0, 3.0 + exponent * 1.4)));
+	}
+	ExpectPercentilesMatch(values);
+}
+
+TEST(LatencyHistogramTest, PercentilesOfBimodalValues)
+{
+	uint64_t state = 7;
+	std::vector<uint64_t> values;
+	for (int i = 0; i < 50000; ++i)
+	{
+		bool slow = NextRandom(state) % 100 < 3;
+		values.push_back(slow ? 40000000 + NextRandom(state) % 10000000 : 20000 + NextRandom(state) % 5000);
+	}
+	ExpectPercentilesMatch(values);
+}
+
+TEST(LatencyHistogramTest, ResetClearsEverything)
+{
+	auto histogram = std::make_unique<LatencyHistogram>();
+	for (uint64_t i = 0; i < 100; ++i)
+		histogram->Record(i * 97);
+	histogram->Reset();
+
+	LatencyHistogram::Summary summary = histogram->Summarize();
+	EXPECT_EQ(0u, summary.count);
+	EXPECT_EQ(0u, summary.max);
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecordingLosesNothing)
+{
+	const int kThreads = 4;
+	const uint64_t kPerThread = 200000;
+
+	auto histogram = std::make_unique<LatencyHistogram>();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < kThreads; ++t)
+	{
+		threads.emplace_back([&histogram, t]()
+		{
+			for (uint64_t i = 0; i < kPerThread; ++i)
+				histogram->Record(i * kThreads + static_cast<uint64_t>(t));
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+
+	LatencyHistogram::Summary summary = histogram->Summarize();
+	EXPECT_EQ(kThreads * kPerThread, summary.count);
+	EXPECT_EQ(kThreads * kPerThread - 1, summary.max);
+}
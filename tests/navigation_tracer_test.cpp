@@ -0,0 +1,269 @@
+/*
+ * navigation_tracer_test.cpp: Correlation of navigation events and per-tab timings.
+ */
+
+#include "util/navigation_tracer.h"
+#include "util/trace.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const NavigationTracer::WindowKey kWindow = 0x1000;
+	const NavigationTracer::WindowKey kOtherWindow = 0x2000;
+}
+
+TEST(NavigationTracerTest, RequestedNavigationIsCorrelatedEndToEnd)
+{
+	NavigationTracer tracer;
+	tracer.Request(kWindow, 7, 100);
+	tracer.AddOwnWork(kWindow, 10);
+	tracer.BeforeNavigate(kWindow, 150);
+	tracer.NavigateComplete(kWindow, 300);
+	tracer.AddOwnWork(kWindow, 40);
+
+	NavigationTracer::Record record;
+	ASSERT_TRUE(tracer.DocumentComplete(kWindow, 500, record));
+	EXPECT_EQ(7u, record.tabId);
+	EXPECT_TRUE(record.requested);
+	EXPECT_FALSE(record.failed);
+	EXPECT_EQ(100u, record.startNs);
+	EXPECT_EQ(150u, record.beforeNavigateNs);
+	EXPECT_EQ(300u, record.navigateCompleteNs);
+	EXPECT_EQ(500u, record.endNs);
+	EXPECT_EQ(400u, record.GetTotalNs());
+	EXPECT_EQ(50u, record.ownNs);
+	EXPECT_EQ(350u, record.GetShellNs());
+
+	// The record is closed; a second DocumentComplete (e.g. from a frame) isn't counted.
+	EXPECT_FALSE(tracer.DocumentComplete(kWindow, 600, record));
+	EXPECT_EQ(1u, tracer.GetStats().completed);
+}
+
+TEST(NavigationTracerTest, ExplorerNavigationIsTimedFromBeforeNavigate)
+{
+	NavigationTracer tracer;
+	tracer.BeforeNavigate(kWindow, 1000);
+	tracer.AttributeToTab(kWindow, 3);
+
+	NavigationTracer::Record record;
+	ASSERT_TRUE(tracer.DocumentComplete(kWindow, 1100, record));
+	EXPECT_EQ(3u, record.tabId);
+	EXPECT_FALSE(record.requested);
+	EXPECT_EQ(100u, record.GetTotalNs());
+	EXPECT_EQ(1u, tracer.GetStats().uncorrelated);
+}
+
+TEST(NavigationTracerTest, RequestedNavigationKeepsItsTab)
+{
+	NavigationTracer tracer;
+	tracer.Request(kWindow, 5, 0);
+	tracer.BeforeNavigate(kWindow, 10);
+	tracer.AttributeToTab(kWindow, 9);
+
+	NavigationTracer::Record record;
+	ASSERT_TRUE(tracer.DocumentComplete(kWindow, 20, record));
+	EXPECT_EQ(5u, record.tabId);
+}
+
+TEST(NavigationTracerTest, StaleRequestIsNotCorrelated)
+{
+	NavigationTracer tracer;
+	tracer.Request(kWindow, 4, 0);
+	tracer.BeforeNavigate(kWindow, NavigationTracer::kRequestTimeoutNs + 1);
+
+	NavigationTracer::Record record;
+	ASSERT_TRUE(tracer.DocumentComplete(kWindow, NavigationTracer::kRequestTimeoutNs + 2, record));
+	EXPECT_EQ(0u, record.tabId);
+	EXPECT_FALSE(record.requested);
+	EXPECT_EQ(1u, record.GetTotalNs());
+
+	NavigationTracer::Stats stats = tracer.GetStats();
+	EXPECT_EQ(1u, stats.abandoned);
+	EXPECT_EQ(1u, stats.uncorrelated);
+}
+
+TEST(NavigationTracerTest, NewRequestAbandonsTheOneInFlight)
+{
+	NavigationTracer tracer;
+	tracer.Request(kWindow, 1, 0);
+	tracer.BeforeNavigate(kWindow, 10);
+	tracer.Request(kWindow, 2, 20);
+	tracer.BeforeNavigate(kWindow, 30);
+
+	NavigationTracer::Record record;
+	ASSERT_TRUE(tracer.DocumentComplete(kWindow, 50, record));
+	EXPECT_EQ(2u, record.tabId);
+	EXPECT_EQ(30u, record.GetTotalNs());
+	EXPECT_EQ(1u, tracer.GetStats().abandoned);
+}
+
+TEST(NavigationTracerTest, EventsWithoutANavigationAreIgnored)
+{
+	NavigationTracer tracer;
+	NavigationTracer::Record record;
+	tracer.NavigateComplete(kWindow, 10);
+	tracer.AddOwnWork(kWindow, 100);
+	tracer.AttributeToTab(kWindow, 3);
+	EXPECT_FALSE(tracer.DocumentComplete(kWindow, 20, record));
+	EXPECT_FALSE(tracer.NavigateError(kWindow, 20, record));
+
+	// A request alone isn't a navigation until Explorer starts one.
+	tracer.Request(kWindow, 3, 30);
+	EXPECT_FALSE(tracer.DocumentComplete(kWindow, 40, record));
+
+	NavigationTracer::Stats stats = tracer.GetStats();
+	EXPECT_EQ(0u, stats.completed);
+	EXPECT_EQ(0u, stats.failed);
+}
+
+TEST(NavigationTracerTest, NavigateErrorClosesTheRecordAsFailed)
+{
+	NavigationTracer tracer;
+	tracer.Request(kWindow, 6, 100);
+	tracer.BeforeNavigate(kWindow, 120);
+	tracer.AddOwnWork(kWindow, 5);
+
+	NavigationTracer::Record record;
+	ASSERT_TRUE(tracer.NavigateError(kWindow, 400, record));
+	EXPECT_TRUE(record.failed);
+	EXPECT_EQ(6u, record.tabId);
+	EXPECT_EQ(300u, record.GetTotalNs());
+	EXPECT_EQ(5u, record.ownNs);
+
+	// Nothing is left in flight for a later event to land on.
+	EXPECT_FALSE(tracer.DocumentComplete(kWindow, 500, record));
+
+	NavigationTracer::Stats stats = tracer.GetStats();
+	EXPECT_EQ(0u, stats.completed);
+	EXPECT_EQ(1u, stats.failed);
+	EXPECT_EQ(0u, stats.abandoned);
+
+	NavigationTracer::TabTimings timings;
+	ASSERT_TRUE(tracer.GetTabTimings(kWindow, 6, timings));
+	EXPECT_EQ(0u, timings.count);
+	EXPECT_EQ(1u, timings.failed);
+	EXPECT_EQ(0u, timings.totalNs);
+	EXPECT_TRUE(timings.last.failed);
+}
+
+TEST(NavigationTracerTest, TabTimingsAccumulatePerTab)
+{
+	NavigationTracer tracer;
+	NavigationTracer::Record record;
+	unsigned long long now = 0;
+	for (unsigned int i = 0; i < 6; ++i)
+	{
+		unsigned int tabId = 1 + i % 2;
+		tracer.Request(kWindow, tabId, now);
+		tracer.BeforeNavigate(kWindow, now + 10);
+		tracer.AddOwnWork(kWindow, 5 * tabId);
+		ASSERT_TRUE(tracer.DocumentComplete(kWindow, now + 100 * tabId, record));
+		now += 1000;
+	}
+
+	NavigationTracer::TabTimings timings;
+	ASSERT_TRUE(tracer.GetTabTimings(kWindow, 1, timings));
+	EXPECT_EQ(3u, timings.count);
+	EXPECT_EQ(300u, timings.totalNs);
+	EXPECT_EQ(15u, timings.ownNs);
+	EXPECT_EQ(4000u, timings.last.startNs);
+
+	ASSERT_TRUE(tracer.GetTabTimings(kWindow, 2, timings));
+	EXPECT_EQ(3u, timings.count);
+	EXPECT_EQ(600u, timings.totalNs);
+	EXPECT_EQ(30u, timings.ownNs);
+
+	// Navigations not attributed to a tab are traced, but have no timings.
+	tracer.BeforeNavigate(kWindow, now);
+	ASSERT_TRUE(tracer.DocumentComplete(kWindow, now + 10, record));
+	EXPECT_FALSE(tracer.GetTabTimings(kWindow, NavigationTracer::kNoTab, timings));
+
+	tracer.ForgetTab(kWindow, 1);
+	EXPECT_FALSE(tracer.GetTabTimings(kWindow, 1, timings));
+	EXPECT_TRUE(tracer.GetTabTimings(kWindow, 2, timings));
+}
+
+TEST(NavigationTracerTest, WindowsAreIndependent)
+{
+	NavigationTracer tracer;
+	tracer.Request(kWindow, 1, 0);
+	tracer.Request(kOtherWindow, 1, 0);
+	tracer.BeforeNavigate(kWindow, 10);
+	tracer.BeforeNavigate(kOtherWindow, 20);
+	tracer.AddOwnWork(kOtherWindow, 7);
+
+	NavigationTracer::Record record;
+	ASSERT_TRUE(tracer.DocumentComplete(kOtherWindow, 200, record));
+	EXPECT_EQ(200u, record.GetTotalNs());
+	EXPECT_EQ(7u, record.ownNs);
+	ASSERT_TRUE(tracer.DocumentComplete(kWindow, 100, record));
+	EXPECT_EQ(100u, record.GetTotalNs());
+	EXPECT_EQ(0u, record.ownNs);
+	EXPECT_EQ(0u, tracer.GetStats().abandoned);
+
+	// Closing one window forgets its tabs only.
+	tracer.ForgetWindow(kWindow);
+	NavigationTracer::TabTimings timings;
+	EXPECT_FALSE(tracer.GetTabTimings(kWindow, 1, timings));
+	EXPECT_TRUE(tracer.GetTabTimings(kOtherWindow, 1, timings));
+}
+
+TEST(NavigationTracerTest, ConcurrentWindowsAreCorrelatedIndependently)
+{
+	// Every Explorer window has its own UI thread.
+	const int kWindows = 4;
+	const int kNavigations = 2000;
+
+	NavigationTracer tracer;
+	std::vector<std::thread> threads;
+	for (int w = 0; w < kWindows; ++w)
+	{
+		threads.emplace_back([&tracer, w]()
+		{
+			NavigationTracer::WindowKey window = static_cast<NavigationTracer::WindowKey>(w + 1);
+			NavigationTracer::Record record;
+			for (int i = 0; i < kNavigations; ++i)
+			{
+				unsigned long long start = static_cast<unsigned long long>(i) * 100;
+				tracer.Request(window, static_cast<unsigned int>(w + 1), start);
+				tracer.BeforeNavigate(window, start + 10);
+				tracer.AddOwnWork(window, 3);
+				tracer.DocumentComplete(window, start + 50, record);
+			}
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+
+	EXPECT_EQ(static_cast<unsigned long long>(kWindows * kNavigations), tracer.GetStats().completed);
+	for (int w = 0; w < kWindows; ++w)
+	{
+		NavigationTracer::TabTimings timings;
+		ASSERT_TRUE(tracer.GetTabTimings(static_cast<NavigationTracer::WindowKey>(w + 1), static_cast<unsigned int>(w + 1), timings));
+		EXPECT_EQ(static_cast<unsigned long long>(kNavigations), timings.count);
+		EXPECT_EQ(static_cast<unsigned long long>(kNavigations) * 50, timings.totalNs);
+		EXPECT_EQ(static_cast<unsigned long long>(kNavigations) * 3, timings.ownNs);
+	}
+}
+
+TEST(NavigationTracerTest, FinishedNavigationIsTracedAsOneEvent)
+{
+	CETrace::ClearRingBuffer();
+	CETrace::SetRingBufferEnabled(true);
+	CETrace::WriteNavigation(4, true, false, 9000, 2000, 7000);
+	CETrace::SetRingBufferEnabled(false);
+
+	std::vector<CETrace::Record> records = CETrace::ReadRingBuffer();
+	ASSERT_EQ(1u, records.size());
+	EXPECT_STREQ("Navigation", records[0].name);
+	EXPECT_EQ(4u, records[0].tabId);
+	EXPECT_TRUE(records[0].requested);
+	EXPECT_FALSE(records[0].failed);
+	EXPECT_EQ(9000u, records[0].durationNs);
+	EXPECT_EQ(2000u, records[0].ownNs);
+	EXPECT_EQ(7000u, records[0].shellNs);
+}
@@ -0,0 +1,183 @@
+/*
+ * rate_governor_test.cpp: Throttling of runaway loops, and leaving ordinary use alone, on a
+ *                         fake clock.
+ */
+
+#include "util/rate_governor.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+	using Decision = RateGovernor::Decision;
+
+	struct Counts
+	{
+		unsigned int allowed = 0;
+		unsigned int engaged = 0;
+	};
+
+	// Request once a millisecond over [startMs, endMs), like a relayout feeding back into itself.
+	Counts RunLoop(RateGovernor &governor, unsigned long long startMs, unsigned long long endMs)
+	{
+		Counts counts;
+		for (unsigned long long nowMs = startMs; nowMs < endMs; ++nowMs)
+		{
+			Decision decision = governor.Request(nowMs);
+			counts.allowed += decision == Decision::Allow;
+			counts.engaged += decision == Decision::Engage;
+		}
+		return counts;
+	}
+}
+
+TEST(RateGovernorTest, OrdinaryUseIsNeverRefused)
+{
+	// A request every 100 ms for an hour.
+	RateGovernor steady;
+	for (unsigned long long nowMs = 0; nowMs < 3600000; nowMs += 100)
+		ASSERT_EQ(Decision::Allow, steady.Request(nowMs)) << nowMs;
+
+	// Bursts of 40 back to back, every 3 s, such as resizing every band of a window at once.
+	RateGovernor bursty;
+	for (unsigned long long nowMs = 0; nowMs < 600000; nowMs += 3000)
+	{
+		for (int i = 0; i < 40; ++i)
+			ASSERT_EQ(Decision::Allow, bursty.Request(nowMs)) << nowMs;
+	}
+	EXPECT_EQ(0u, bursty.GetStats().engagements);
+}
+
+TEST(RateGovernorTest, KiloHertzLoopIsHeldToTheRefillRate)
+{
+	// Ten seconds of a 1 kHz loop: the burst of 50, then 20 a second in bursts of 10 each
+	// time the bucket recovers, plus the one token regained while the last burst ran.
+	RateGovernor governor;
+	Counts counts = RunLoop(governor, 1000, 11000);
+	EXPECT_EQ(241u, counts.allowed);
+	EXPECT_EQ(20u, counts.engaged);
+
+	const RateGovernor::Stats &stats = governor.GetStats();
+	EXPECT_EQ(241u, stats.allowed);
+	EXPECT_EQ(10000u - 241u, stats.denied);
+	EXPECT_EQ(20u, stats.engagements);
+	EXPECT_TRUE(governor.IsEngaged());
+
+	// Once the loop stops, the work runs again.
+	EXPECT_EQ(Decision::Allow, governor.Request(13000));
+	EXPECT_FALSE(governor.IsEngaged());
+}
+
+TEST(RateGovernorTest, EngagedGovernorRefusesUntilRecovered)
+{
+	RateGovernor::Config config;
+	config.burst = 5;
+	config.refillPerSecond = 10;
+	config.recoveryLevel = 3;
+	RateGovernor governor(config);
+
+	for (int i = 0; i < 5; ++i)
+		ASSERT_EQ(Decision::Allow, governor.Request(0));
+	EXPECT_EQ(Decision::Engage, governor.Request(0));
+
+	// A token comes back every 100 ms, but nothing runs until there are three.
+	EXPECT_EQ(Decision::Deny, governor.Request(100));
+	EXPECT_EQ(Decision::Deny, governor.Request(299));
+	EXPECT_EQ(Decision::Allow, governor.Request(300));
+	EXPECT_EQ(Decision::Allow, governor.Request(300));
+	EXPECT_EQ(Decision::Allow, governor.Request(300));
+	EXPECT_EQ(Decision::Engage, governor.Request(300));
+	EXPECT_EQ(2u, governor.GetStats().engagements);
+}
+
+TEST(RateGovernorTest, SameMillisecondLoopGetsOnlyTheBurst)
+{
+	RateGovernor governor;
+	Counts counts;
+	for (int i = 0; i < 1000; ++i)
+		counts.allowed += governor.Request(5) == Decision::Allow;
+	EXPECT_EQ(50u, counts.allowed);
+	EXPECT_EQ(1u, governor.GetStats().engagements);
+}
+
+TEST(RateGovernorTest, BackwardsClockAddsNothing)
+{
+	// Two governors engaged by the same loop; one then sees the clock go back a second.
+	RateGovernor forward;
+	RateGovernor backward;
+	RunLoop(forward, 5000, 5060);
+	RunLoop(backward, 5000, 5060);
+	ASSERT_TRUE(forward.IsEngaged());
+	ASSERT_TRUE(backward.IsEngaged());
+
+	EXPECT_EQ(Decision::Deny, backward.Request(4059));
+
+	// Each recovers after the same time has passed on its own clock.
+	unsigned long long forwardWait = 0;
+	while (forward.Request(5059 + forwardWait) != Decision::Allow)
+		++forwardWait;
+	unsigned long long backwardWait = 0;
+	while (backward.Request(4059 + backwardWait) != Decision::Allow)
+		++backwardWait;
+
+	EXPECT_EQ(forwardWait, backwardWait);
+	EXPECT_GT(forwardWait, 400u);
+}
+
+TEST(RateGovernorTest, BackwardsClockDoesNotFreezeTheWork)
+{
+	// A clock which jumps back a long way (a suspended VM, a reset tick count) mustn't hold the
+	// governor engaged until it catches up.
+	RateGovernor governor;
+	RunLoop(governor, 1000000, 1000060);
+	ASSERT_TRUE(governor.IsEngaged());
+
+	EXPECT_EQ(Decision::Deny, governor.Request(5));
+
+	// Still throttled to the refill rate: 20 a second, in bursts of 10.
+	Counts counts = RunLoop(governor, 6, 2006);
+	EXPECT_GE(counts.allowed, 30u);
+	EXPECT_LE(counts.allowed, 41u);
+}
+
+TEST(RateGovernorTest, LongIdleSpellRefillsWithoutOverflow)
+{
+	RateGovernor governor;
+	RunLoop(governor, 0, 100);
+	ASSERT_TRUE(governor.IsEngaged());
+
+	EXPECT_EQ(Decision::Allow, governor.Request(~0ULL));
+	Counts counts;
+	for (int i = 0; i < 100; ++i)
+		counts.allowed += governor.Request(~0ULL) == Decision::Allow;
+	EXPECT_EQ(49u, counts.allowed);
+}
+
+TEST(RateGovernorTest, WithoutRefillOnlyTheBurstEverRuns)
+{
+	RateGovernor::Config config;
+	config.refillPerSecond = 0;
+	RateGovernor governor(config);
+
+	Counts counts;
+	for (unsigned long long nowMs = 0; nowMs < 100000; nowMs += 7)
+		counts.allowed += governor.Request(nowMs) == Decision::Allow;
+	EXPECT_EQ(50u, counts.allowed);
+}
+
+TEST(RateGovernorTest, RecoveryLevelAboveTheBurstIsClamped)
+{
+	RateGovernor::Config config;
+	config.burst = 4;
+	config.refillPerSecond = 1000;
+	config.recoveryLevel = 100;
+	RateGovernor governor(config);
+
+	RunLoop(governor, 0, 1);
+	for (int i = 0; i < 5; ++i)
+		governor.Request(1);
+	ASSERT_TRUE(governor.IsEngaged());
+
+	// Recovers once the bucket is full again, rather than never.
+	EXPECT_EQ(Decision::Allow, governor.Request(10));
+}
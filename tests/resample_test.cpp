@@ -0,0 +1,138 @@
+/*
+ * resample_test.cpp: Agreement between the resampler's paths, and its handling of alpha.
+ */
+
+#include "util/resample.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+
+using namespace Resample;
+
+namespace
+{
+	uint32_t NextRandom(uint64_t &state)
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return static_cast<uint32_t>(state >> 32);
+	}
+
+	DecodedImage MakeImage(int width, int height, uint32_t fill)
+	{
+		DecodedImage image;
+		image.width = width;
+		image.height = height;
+		image.pixels.assign(static_cast<size_t>(width) * height, fill);
+		return image;
+	}
+
+	int GetChannel(uint32_t pixel, int channel)
+	{
+		return static_cast<int>((pixel >> (channel * 8)) & 0xFF);
+	}
+}
+
+TEST(ResampleTest, PathsAgree)
+{
+	// Whichever paths this CPU lacks fall back, so they compare against themselves.
+	uint64_t state = 1;
+	for (int run = 0; run < 2000; ++run)
+	{
+		DecodedImage source = MakeImage(1 + NextRandom(state) % 60, 1 + NextRandom(state) % 60, 0);
+		for (uint32_t &pixel : source.pixels)
+			pixel = NextRandom(state);
+
+		int width = 1 + NextRandom(state) % 120;
+		int height = 1 + NextRandom(state) % 120;
+		Filter filter = run % 2 ? Filter::Lanczos3 : Filter::Box;
+
+		DecodedImage scalar;
+		DecodedImage sse2;
+		DecodedImage avx2;
+		ASSERT_TRUE(ResampleImage(source, width, height, filter, Path::Scalar, scalar));
+		ASSERT_TRUE(ResampleImage(source, width, height, filter, Path::Sse2, sse2));
+		ASSERT_TRUE(ResampleImage(source, width, height, filter, Path::Avx2, avx2));
+		ASSERT_EQ(static_cast<size_t>(width) * height, scalar.pixels.size());
+
+		// SSE2 adds in the same order as the scalar loops; AVX2 may differ by a level.
+		ASSERT_EQ(scalar.pixels, sse2.pixels) << "run " << run;
+		for (size_t i = 0; i < scalar.pixels.size(); ++i)
+		{
+			for (int channel = 0; channel < 4; ++channel)
+				ASSERT_LE(std::abs(GetChannel(scalar.pixels[i], channel) - GetChannel(avx2.pixels[i], channel)), 1) << "run " << run << ", pixel " << i;
+		}
+	}
+}
+
+TEST(ResampleTest, UniformImageIsUnchanged)
+{
+	for (uint32_t fill : { 0xFF204080u, 0x80C01060u, 0x01FFFFFFu })
+	{
+		for (Filter filter : { Filter::Box, Filter::Lanczos3 })
+		{
+			DecodedImage scaled;
+			ASSERT_TRUE(ResampleImage(MakeImage(22, 22, fill), 33, 17, filter, scaled));
+			for (uint32_t pixel : scaled.pixels)
+				ASSERT_EQ(fill, pixel);
+		}
+	}
+}
+
+TEST(ResampleTest, ImageWithoutAlphaMustBeMadeOpaqueFirst)
+{
+	// 24 bpp resources come through GetDIBits with alpha 0 everywhere: to the resampler that
+	// is an invisible image, so the bitmap cache sets the alpha before scaling.
+	DecodedImage scaled;
+	ASSERT_TRUE(ResampleImage(MakeImage(8, 8, 0x00336699u), 12, 12, Filter::Lanczos3, scaled));
+	for (uint32_t pixel : scaled.pixels)
+		ASSERT_EQ(0u, pixel);
+
+	for (Path path : { Path::Scalar, Path::Sse2, Path::Avx2 })
+	{
+		ASSERT_TRUE(ResampleImage(MakeImage(8, 8, 0x00336699u | 0xFF000000u), 12, 12, Filter::Lanczos3, path, scaled));
+		for (uint32_t pixel : scaled.pixels)
+			ASSERT_EQ(0xFF336699u, pixel);
+	}
+}
+
+TEST(ResampleTest, TransparentColourDoesNotBleed)
+{
+	// Opaque red on the left, fully transparent but green on the right.
+	DecodedImage source = MakeImage(16, 4, 0x0000FF00u);
+	for (int y = 0; y < 4; ++y)
+	{
+		for (int x = 0; x < 8; ++x)
+			source.pixels[static_cast<size_t>(y) * 16 + x] = 0xFFFF0000u;
+	}
+
+	for (Path path : { Path::Scalar, Path::Sse2, Path::Avx2 })
+	{
+		DecodedImage scaled;
+		ASSERT_TRUE(ResampleImage(source, 24, 6, Filter::Lanczos3, path, scaled));
+
+		// The edge fades out, but whatever is visible of it stays red.
+		bool sawEdge = false;
+		for (uint32_t pixel : scaled.pixels)
+		{
+			int alpha = GetChannel(pixel, 3);
+			if (alpha == 0)
+				continue;
+			sawEdge |= alpha < 255;
+			EXPECT_EQ(0, GetChannel(pixel, 1)) << std::hex << pixel;
+			EXPECT_EQ(0, GetChannel(pixel, 0)) << std::hex << pixel;
+		}
+		EXPECT_TRUE(sawEdge);
+	}
+}
+
+TEST(ResampleTest, BadSizesAreRejected)
+{
+	DecodedImage scaled;
+	EXPECT_FALSE(ResampleImage(MakeImage(4, 4, 0), 0, 4, Filter::Box, scaled));
+	EXPECT_FALSE(ResampleImage(MakeImage(4, 4, 0), 4, ImageDecode::kMaxDimension + 1, Filter::Box, scaled));
+
+	DecodedImage mismatched = MakeImage(4, 4, 0);
+	mismatched.pixels.pop_back();
+	EXPECT_FALSE(ResampleImage(mismatched, 4, 4, Filter::Box, scaled));
+}
@@ -0,0 +1,189 @@
+/*
+ * settings_blob_test.cpp: Round-tripping the settings blob, and rejecting damaged ones.
+ */
+
+#include "fake_key_store.h"
+
+#include "util/settings_blob.h"
+#include "util/settings_schema.h"
+
+#include <gtest/gtest.h>
+
+using namespace CEUtil;
+
+namespace
+{
+	const CESettings kSample(CLASSIC_EXPLORER_XP, 0, 1, 0, 1, 220, 36);
+
+	void PutUInt16(std::vector<unsigned char> &blob, size_t offset, uint16_t value)
+	{
+		blob[offset] = static_cast<unsigned char>(value);
+		blob[offset + 1] = static_cast<unsigned char>(value >> 8);
+	}
+
+	// Replace the checksum, so a deliberate edit is judged on its content alone.
+	void Reseal(std::vector<unsigned char> &blob)
+	{
+		size_t payloadSize = blob.size() - 4;
+		uint32_t crc = Crc32(blob.data(), payloadSize);
+		for (int i = 0; i < 4; ++i)
+			blob[payloadSize + i] = static_cast<unsigned char>(crc >> (i * 8));
+	}
+
+	void ExpectRejected(const std::vector<unsigned char> &blob)
+	{
+		CESettings out = kSample;
+		EXPECT_FALSE(ParseSettingsBlob(blob.data(), blob.size(), out));
+		EXPECT_EQ(kSample, out);
+	}
+}
+
+TEST(SettingsBlobTest, Crc32MatchesTheStandardCheckValue)
+{
+	const unsigned char digits[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+	EXPECT_EQ(0xCBF43926u, Crc32(digits, sizeof(digits)));
+	EXPECT_EQ(0u, Crc32(nullptr, 0));
+}
+
+TEST(SettingsBlobTest, LayoutIsAsDocumented)
+{
+	std::vector<unsigned char> blob = SerializeSettingsBlob(kSample);
+	ASSERT_EQ(8 + kSettingsSchemaSize * 4 + 4, blob.size());
+	EXPECT_EQ('C', blob[0]);
+	EXPECT_EQ('E', blob[1]);
+	EXPECT_EQ('S', blob[2]);
+	EXPECT_EQ('B', blob[3]);
+	EXPECT_EQ(kSettingsBlobVersion, blob[4] | (blob[5] << 8));
+	EXPECT_EQ(kSettingsSchemaSize, static_cast<size_t>(blob[6] | (blob[7] << 8)));
+
+	// TabFixedWidth is the sixth field.
+	EXPECT_EQ(220, blob[8 + 5 * 4] | (blob[8 + 5 * 4 + 1] << 8));
+}
+
+TEST(SettingsBlobTest, EverySettingRoundTrips)
+{
+	// Every combination of themes and flags, and each width and height at the ends of its range.
+	for (ClassicExplorerTheme theme : { CLASSIC_EXPLORER_2K, CLASSIC_EXPLORER_XP, CLASSIC_EXPLORER_10, CLASSIC_EXPLORER_MEMPHIS })
+	{
+		for (int flags = 0; flags < 16; ++flags)
+		{
+			for (long width : { 60L, 180L, 1000L })
+			{
+				for (long height : { 16L, 128L })
+				{
+					CESettings settings(theme, flags & 1, (flags >> 1) & 1, (flags >> 2) & 1, (flags >> 3) & 1, width, height);
+					std::vector<unsigned char> blob = SerializeSettingsBlob(settings);
+					CESettings out;
+					ASSERT_TRUE(ParseSettingsBlob(blob.data(), blob.size(), out));
+					ASSERT_EQ(settings, out);
+				}
+			}
+		}
+	}
+}
+
+TEST(SettingsBlobTest, EverySingleBitFlipIsRejected)
+{
+	std::vector<unsigned char> blob = SerializeSettingsBlob(kSample);
+	for (size_t i = 0; i < blob.size(); ++i)
+	{
+		for (int bit = 0; bit < 8; ++bit)
+		{
+			std::vector<unsigned char> damaged = blob;
+			damaged[i] ^= static_cast<unsigned char>(1 << bit);
+			ExpectRejected(damaged);
+		}
+	}
+}
+
+TEST(SettingsBlobTest, TruncatedAndPaddedBlobsAreRejected)
+{
+	std::vector<unsigned char> blob = SerializeSettingsBlob(kSample);
+	for (size_t size = 0; size < blob.size(); ++size)
+		ExpectRejected(std::vector<unsigned char>(blob.begin(), blob.begin() + size));
+
+	std::vector<unsigned char> padded = blob;
+	padded.push_back(0);
+	ExpectRejected(padded);
+
+	CESettings out = kSample;
+	EXPECT_FALSE(ParseSettingsBlob(nullptr, 0, out));
+}
+
+TEST(SettingsBlobTest, UnknownVersionIsRejected)
+{
+	std::vector<unsigned char> blob = SerializeSettingsBlob(kSample);
+	PutUInt16(blob, 4, kSettingsBlobVersion + 1);
+	Reseal(blob);
+	ExpectRejected(blob);
+}
+
+TEST(SettingsBlobTest, OutOfRangeValueIsRejectedEvenWithAValidChecksum)
+{
+	std::vector<unsigned char> blob = SerializeSettingsBlob(kSample);
+	blob[8 + 5 * 4] = 10;
+	blob[8 + 5 * 4 + 1] = 0;
+	Reseal(blob);
+	ExpectRejected(blob);
+}
+
+TEST(SettingsBlobTest, OlderBlobGetsDefaultsForNewerFields)
+{
+	// A blob from a version which only knew the first five fields.
+	std::vector<unsigned char> blob = SerializeSettingsBlob(kSample);
+	blob.erase(blob.begin() + 8 + 5 * 4, blob.end());
+	PutUInt16(blob, 6, 5);
+	blob.resize(blob.size() + 4);
+	Reseal(blob);
+
+	CESettings out;
+	ASSERT_TRUE(ParseSettingsBlob(blob.data(), blob.size(), out));
+	EXPECT_EQ(kSample.theme, out.theme);
+	EXPECT_EQ(kSample.tabAutoSize, out.tabAutoSize);
+	EXPECT_EQ(GetDefaultSettings().tabFixedWidth, out.tabFixedWidth);
+	EXPECT_EQ(GetDefaultSettings().tabFixedHeight, out.tabFixedHeight);
+}
+
+TEST(SettingsBlobTest, NewerBlobKeepsKnownFieldsAndIgnoresTheRest)
+{
+	std::vector<unsigned char> blob = SerializeSettingsBlob(kSample);
+	size_t checksumOffset = blob.size() - 4;
+	blob.insert(blob.begin() + checksumOffset, { 0xAA, 0xBB, 0xCC, 0xDD });
+	PutUInt16(blob, 6, static_cast<uint16_t>(kSettingsSchemaSize + 1));
+	Reseal(blob);
+
+	CESettings out;
+	ASSERT_TRUE(ParseSettingsBlob(blob.data(), blob.size(), out));
+	EXPECT_EQ(kSample, out);
+}
+
+TEST(SettingsBlobTest, CorruptStoredBlobFallsBackToLegacyValues)
+{
+	FakeKeyStore store;
+	store.SetString(L"Theme", L"98");
+	store.SetDword(L"TabFixedWidth", 140);
+	ASSERT_EQ(CLASSIC_EXPLORER_MEMPHIS, LoadSettingsFromStore(store).theme);
+
+	// Damage the migrated blob; the next load rebuilds it from the legacy values.
+	store.At(kSettingsBlobValueName).binary[9] ^= 0x40;
+	store.enumerations = 0;
+	store.sets = 0;
+	CESettings loaded = LoadSettingsFromStore(store);
+	EXPECT_EQ(CLASSIC_EXPLORER_MEMPHIS, loaded.theme);
+	EXPECT_EQ(140, loaded.tabFixedWidth);
+	EXPECT_EQ(1, store.enumerations);
+	EXPECT_EQ(1, store.sets);
+
+	const std::vector<unsigned char> &rebuilt = store.At(kSettingsBlobValueName).binary;
+	CESettings out;
+	EXPECT_TRUE(ParseSettingsBlob(rebuilt.data(), rebuilt.size(), out));
+}
+
+TEST(SettingsBlobTest, BlobOfTheWrongKindIsIgnored)
+{
+	FakeKeyStore store;
+	store.SetString(kSettingsBlobValueName, L"not a blob");
+	store.SetDword(L"ShowGoButton", 0);
+	EXPECT_EQ(0, LoadSettingsFromStore(store).showGoButton);
+	EXPECT_EQ(RawSettingValue::Kind::Binary, store.At(kSettingsBlobValueName).kind);
+}
@@ -0,0 +1,217 @@
+/*
+ * settings_cache_test.cpp: Caching and invalidation of the settings snapshot, over the
+ *                          in-memory backend.
+ */
+
+#include "util/settings_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace CEUtil;
+
+namespace
+{
+	const CESettings kInitial(CLASSIC_EXPLORER_2K, 1, 1, 1, 1, 180, 32);
+
+	class SettingsCacheTest : public testing::Test
+	{
+	protected:
+		SettingsCacheTest()
+		{
+			auto backend = std::make_unique<MemorySettingsBackend>(kInitial);
+			m_backend = backend.get();
+			m_cache = std::make_unique<SettingsCache>(std::move(backend));
+		}
+
+		MemorySettingsBackend *m_backend;
+		std::unique_ptr<SettingsCache> m_cache;
+	};
+}
+
+TEST_F(SettingsCacheTest, NothingIsLoadedUntilFirstUse)
+{
+	EXPECT_EQ(0u, m_backend->GetLoadCount());
+
+	// A change before the first load has nobody to reload for.
+	m_cache->Refresh();
+	EXPECT_EQ(0u, m_backend->GetLoadCount());
+}
+
+TEST_F(SettingsCacheTest, RepeatedReadsShareOneLoad)
+{
+	std::shared_ptr<const CESettings> first = m_cache->Get();
+	for (int i = 0; i < 100; ++i)
+		EXPECT_EQ(first, m_cache->Get());
+
+	EXPECT_EQ(kInitial, *first);
+	EXPECT_EQ(1u, m_backend->GetLoadCount());
+}
+
+TEST_F(SettingsCacheTest, ExternalChangeInvalidatesTheSnapshot)
+{
+	std::shared_ptr<const CESettings> before = m_cache->Get();
+
+	CESettings changed = kInitial;
+	changed.theme = CLASSIC_EXPLORER_XP;
+	m_backend->SetStored(changed);
+
+	std::shared_ptr<const CESettings> after = m_cache->Get();
+	EXPECT_EQ(CLASSIC_EXPLORER_XP, after->theme);
+	EXPECT_EQ(2u, m_backend->GetLoadCount());
+
+	// Readers holding the old snapshot still see it whole.
+	EXPECT_EQ(kInitial, *before);
+}
+
+TEST_F(SettingsCacheTest, UnchangedReloadKeepsTheSnapshot)
+{
+	std::shared_ptr<const CESettings> before = m_cache->Get();
+	m_backend->SetStored(kInitial);
+	EXPECT_EQ(before, m_cache->Get());
+	EXPECT_EQ(2u, m_backend->GetLoadCount());
+}
+
+TEST_F(SettingsCacheTest, WriteMergesAndRepublishes)
+{
+	m_cache->Get();
+	m_cache->Write(CESettings(CLASSIC_EXPLORER_NONE, -1, -1, -1, -1, 220, -1));
+
+	std::shared_ptr<const CESettings> current = m_cache->Get();
+	EXPECT_EQ(220, current->tabFixedWidth);
+	EXPECT_EQ(CLASSIC_EXPLORER_2K, current->theme);
+	EXPECT_EQ(32, current->tabFixedHeight);
+	EXPECT_EQ(220, m_backend->Load().tabFixedWidth);
+}
+
+TEST_F(SettingsCacheTest, SubscribersHearOnlyRealChanges)
+{
+	std::vector<CESettings> heard;
+	SettingsCache::SubscriptionId id = m_cache->Subscribe([&heard](const std::shared_ptr<const CESettings> &current)
+	{
+		heard.push_back(*current);
+	});
+
+	m_cache->Get();
+	m_cache->Write(CESettings(CLASSIC_EXPLORER_2K, -1, -1, -1));
+	EXPECT_TRUE(heard.empty());
+
+	m_cache->Write(CESettings(CLASSIC_EXPLORER_10, -1, -1, -1));
+	ASSERT_EQ(1u, heard.size());
+	EXPECT_EQ(CLASSIC_EXPLORER_10, heard[0].theme);
+
+	CESettings external = kInitial;
+	external.showGoButton = 0;
+	m_backend->SetStored(external);
+	ASSERT_EQ(2u, heard.size());
+	EXPECT_EQ(external, heard[1]);
+
+	m_cache->Unsubscribe(id);
+	m_cache->Write(CESettings(CLASSIC_EXPLORER_XP, -1, -1, -1));
+	EXPECT_EQ(2u, heard.size());
+}
+
+TEST_F(SettingsCacheTest, SubscriberMayReadTheCache)
+{
+	std::shared_ptr<const CESettings> seen;
+	m_cache->Subscribe([this, &seen](const std::shared_ptr<const CESettings> &)
+	{
+		seen = m_cache->Get();
+	});
+
+	m_cache->Get();
+	m_cache->Write(CESettings(CLASSIC_EXPLORER_XP, -1, -1, -1));
+	ASSERT_TRUE(seen);
+	EXPECT_EQ(CLASSIC_EXPLORER_XP, seen->theme);
+}
+
+TEST_F(SettingsCacheTest, ShutdownStopsWatchingUntilNextUse)
+{
+	m_cache->Get();
+	m_cache->Shutdown();
+
+	CESettings changed = kInitial;
+	changed.theme = CLASSIC_EXPLORER_MEMPHIS;
+	m_backend->SetStored(changed);
+	EXPECT_EQ(1u, m_backend->GetLoadCount());
+
+	// The next read loads afresh and watches again.
+	EXPECT_EQ(CLASSIC_EXPLORER_MEMPHIS, m_cache->Get()->theme);
+	EXPECT_EQ(2u, m_backend->GetLoadCount());
+
+	changed.theme = CLASSIC_EXPLORER_XP;
+	m_backend->SetStored(changed);
+	EXPECT_EQ(CLASSIC_EXPLORER_XP, m_cache->Get()->theme);
+}
+
+TEST_F(SettingsCacheTest, ConcurrentReadersNeverSeeTornSettings)
+{
+	// Every stored value has width == height * 10, so a mix of two versions is detectable.
+	std::atomic<bool> stop(false);
+	std::atomic<unsigned long long> reads(0);
+	std::atomic<bool> torn(false);
+
+	m_cache->Get();
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 4; ++i)
+	{
+		readers.emplace_back([&]()
+		{
+			while (!stop.load())
+			{
+				std::shared_ptr<const CESettings> current = m_cache->Get();
+				if (current->tabFixedWidth != current->tabFixedHeight * 10 && current->tabFixedHeight != 32)
+					torn = true;
+				reads++;
+			}
+		});
+	}
+
+	// Let the readers get going before the settings start to change under them.
+	while (reads.load() < 100)
+		std::this_thread::yield();
+
+	for (long i = 1; i <= 2000; ++i)
+	{
+		CESettings update = kInitial;
+		update.tabFixedHeight = i;
+		update.tabFixedWidth = i * 10;
+		if (i % 2)
+			m_backend->SetStored(update);
+		else
+			m_cache->Write(update);
+	}
+
+	stop = true;
+	for (std::thread &reader : readers)
+		reader.join();
+
+	EXPECT_FALSE(torn.load());
+	EXPECT_EQ(20000, m_cache->Get()->tabFixedWidth);
+}
+
+TEST_F(SettingsCacheTest, ConcurrentWritersAndSubscribersSettle)
+{
+	m_cache->Get();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([this, t]()
+		{
+			for (int i = 0; i < 500; ++i)
+			{
+				SettingsCache::SubscriptionId id = m_cache->Subscribe([](const std::shared_ptr<const CESettings> &) {});
+				m_cache->Write(CESettings(CLASSIC_EXPLORER_NONE, -1, -1, -1, -1, t * 1000 + i, -1));
+				m_cache->Unsubscribe(id);
+			}
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+
+	// Whatever write landed last, the cache agrees with the backend.
+	EXPECT_EQ(m_backend->Load(), *m_cache->Get());
+}
@@ -0,0 +1,199 @@
+/*
+ * settings_schema_test.cpp: Validation, batched loading and writing of the settings schema,
+ *                           over a fake key store.
+ */
+
+#include "fake_key_store.h"
+
+#include "util/settings_cache.h"
+#include "util/settings_schema.h"
+
+#include <gtest/gtest.h>
+
+using namespace CEUtil;
+
+namespace
+{
+	RawSettingValue MakeDword(const wchar_t *name, uint32_t dword)
+	{
+		RawSettingValue value;
+		value.name = name;
+		value.kind = RawSettingValue::Kind::Dword;
+		value.dword = dword;
+		return value;
+	}
+
+	RawSettingValue MakeString(const wchar_t *name, const wchar_t *string)
+	{
+		RawSettingValue value;
+		value.name = name;
+		value.kind = RawSettingValue::Kind::String;
+		value.string = string;
+		return value;
+	}
+
+	// The legacy layout, one value per setting, as older versions wrote it.
+	void StoreLegacyValues(FakeKeyStore &store)
+	{
+		store.SetString(L"Theme", L"XP");
+		store.SetDword(L"ShowGoButton", 0);
+		store.SetDword(L"ShowAddressLabel", 1);
+		store.SetDword(L"ShowFullAddress", 0);
+		store.SetDword(L"TabAutoSize", 0);
+		store.SetDword(L"TabFixedWidth", 240);
+		store.SetDword(L"TabFixedHeight", 40);
+	}
+
+	const CESettings kLegacySettings(CLASSIC_EXPLORER_XP, 0, 1, 0, 0, 240, 40);
+}
+
+TEST(SettingsSchemaTest, SchemaIsConsistent)
+{
+	for (size_t i = 0; i < kSettingsSchemaSize; ++i)
+	{
+		const SettingField &field = kSettingsSchema[i];
+		EXPECT_TRUE(IsValidSettingValue(field, field.defaultValue)) << field.name;
+		EXPECT_LE(field.minValue, field.maxValue);
+		EXPECT_EQ(field.type == SettingType::Theme, field.member == nullptr) << field.name;
+		EXPECT_EQ(&field, FindSettingField(field.name));
+	}
+
+	// Every field has a default, so nothing loaded is ever "leave alone".
+	CESettings defaults = GetDefaultSettings();
+	for (const SettingField &field : kSettingsSchema)
+		EXPECT_NE(-1, GetSettingField(defaults, field)) << field.name;
+}
+
+TEST(SettingsSchemaTest, FieldNamesAreCaseInsensitive)
+{
+	EXPECT_EQ(FindSettingField(L"TabFixedWidth"), FindSettingField(L"tabfixedwidth"));
+	EXPECT_EQ(FindSettingField(L"Theme"), FindSettingField(L"THEME"));
+	EXPECT_EQ(nullptr, FindSettingField(L"TabFixedWidt"));
+	EXPECT_EQ(nullptr, FindSettingField(L""));
+}
+
+TEST(SettingsSchemaTest, ThemeNamesRoundTrip)
+{
+	for (ClassicExplorerTheme theme : { CLASSIC_EXPLORER_2K, CLASSIC_EXPLORER_XP, CLASSIC_EXPLORER_10, CLASSIC_EXPLORER_MEMPHIS })
+	{
+		const wchar_t *name = GetThemeName(theme);
+		ASSERT_NE(nullptr, name);
+		CESettings settings = ParseSettings({ MakeString(L"Theme", name) });
+		EXPECT_EQ(theme, settings.theme);
+	}
+	EXPECT_EQ(nullptr, GetThemeName(CLASSIC_EXPLORER_NONE));
+}
+
+TEST(SettingsSchemaTest, ValidValuesAreParsedInOnePass)
+{
+	std::vector<const SettingField *> invalid;
+	CESettings settings = ParseSettings({
+		MakeString(L"Theme", L"10"),
+		MakeDword(L"ShowGoButton", 0),
+		MakeDword(L"ShowAddressLabel", 7),
+		MakeDword(L"ShowFullAddress", 1),
+		MakeDword(L"TabAutoSize", 0),
+		MakeDword(L"TabFixedWidth", 60),
+		MakeDword(L"TabFixedHeight", 128),
+		MakeDword(L"SomethingElse", 5),
+	}, &invalid);
+
+	EXPECT_TRUE(invalid.empty());
+	EXPECT_EQ(CESettings(CLASSIC_EXPLORER_10, 0, 1, 1, 0, 60, 128), settings);
+}
+
+TEST(SettingsSchemaTest, InvalidValuesFallBackToDefaults)
+{
+	std::vector<const SettingField *> invalid;
+	CESettings settings = ParseSettings({
+		MakeString(L"Theme", L"Vista"),
+		MakeString(L"ShowGoButton", L"0"),
+		MakeDword(L"TabFixedWidth", 59),
+		MakeDword(L"TabFixedHeight", 129),
+		MakeDword(L"ShowFullAddress", 0),
+	}, &invalid);
+
+	CESettings defaults = GetDefaultSettings();
+	EXPECT_EQ(defaults.theme, settings.theme);
+	EXPECT_EQ(defaults.showGoButton, settings.showGoButton);
+	EXPECT_EQ(defaults.tabFixedWidth, settings.tabFixedWidth);
+	EXPECT_EQ(defaults.tabFixedHeight, settings.tabFixedHeight);
+	EXPECT_EQ(0, settings.showFullAddress);
+
+	// Missing values are reported along with the bad ones; only ShowFullAddress was usable.
+	EXPECT_EQ(kSettingsSchemaSize - 1, invalid.size());
+	for (const SettingField *field : invalid)
+		EXPECT_NE(FindSettingField(L"ShowFullAddress"), field);
+}
+
+TEST(SettingsSchemaTest, LegacyValuesAreReadInOnePassAndMigrated)
+{
+	FakeKeyStore store;
+	StoreLegacyValues(store);
+
+	EXPECT_EQ(kLegacySettings, LoadSettingsFromStore(store));
+	EXPECT_EQ(1, store.enumerations);
+	EXPECT_EQ(1, store.sets);
+	ASSERT_TRUE(store.Has(kSettingsBlobValueName));
+	EXPECT_EQ(RawSettingValue::Kind::Binary, store.At(kSettingsBlobValueName).kind);
+
+	// The legacy values stay for older versions.
+	EXPECT_TRUE(store.Has(L"TabFixedWidth"));
+
+	// From then on, loading is a single read of the blob.
+	store.enumerations = 0;
+	store.gets = 0;
+	store.sets = 0;
+	EXPECT_EQ(kLegacySettings, LoadSettingsFromStore(store));
+	EXPECT_EQ(0, store.enumerations);
+	EXPECT_EQ(1, store.gets);
+	EXPECT_EQ(0, store.sets);
+}
+
+TEST(SettingsSchemaTest, EmptyStoreGetsTheDefaults)
+{
+	FakeKeyStore store;
+	EXPECT_EQ(GetDefaultSettings(), LoadSettingsFromStore(store));
+	EXPECT_EQ(1, store.sets);
+	EXPECT_TRUE(store.Has(kSettingsBlobValueName));
+}
+
+TEST(SettingsSchemaTest, UnreadableStoreGetsTheDefaultsWithoutWriting)
+{
+	FakeKeyStore store;
+	StoreLegacyValues(store);
+	store.unreadable = true;
+	EXPECT_EQ(GetDefaultSettings(), LoadSettingsFromStore(store));
+	EXPECT_EQ(0, store.sets);
+}
+
+TEST(SettingsSchemaTest, WriteMergesIntoOneBlobWrite)
+{
+	FakeKeyStore store;
+	StoreLegacyValues(store);
+	LoadSettingsFromStore(store);
+
+	store.sets = 0;
+	WriteSettingsToStore(store, CESettings(CLASSIC_EXPLORER_MEMPHIS, -1, 0, -1, -1, 300, -1));
+	EXPECT_EQ(1, store.sets);
+
+	CESettings expected = kLegacySettings;
+	expected.theme = CLASSIC_EXPLORER_MEMPHIS;
+	expected.showAddressLabel = 0;
+	expected.tabFixedWidth = 300;
+	EXPECT_EQ(expected, LoadSettingsFromStore(store));
+}
+
+TEST(SettingsSchemaTest, MergeSkipsUnsetFields)
+{
+	CESettings settings = GetDefaultSettings();
+	MergeSettings(settings, CESettings(CLASSIC_EXPLORER_10, -1, -1, 0));
+	EXPECT_EQ(CLASSIC_EXPLORER_10, settings.theme);
+	EXPECT_EQ(0, settings.showFullAddress);
+	EXPECT_EQ(GetDefaultSettings().tabFixedHeight, settings.tabFixedHeight);
+	EXPECT_EQ(GetDefaultSettings().showGoButton, settings.showGoButton);
+
+	CESettings unchanged = settings;
+	MergeSettings(settings, CESettings());
+	EXPECT_EQ(unchanged, settings);
+}
@@ -0,0 +1,198 @@
+/*
+ * tab_layout_test.cpp: Wrapping, overflow, scrolling and hit-testing of the tab strip.
+ */
+
+#include "util/tab_layout.h"
+
+#include <gtest/gtest.h>
+
+using namespace TabLayout;
+
+namespace
+{
+	/*
+	 * A 300 px wide strip with the default metrics and at most two rows:
+	 *
+	 *   row 0 (y 6):   group 0, tabs [14, 114) and [120, 220)
+	 *   row 1 (y 44):  group 1, tab [14, 114); group 2, tabs [136, 236), [242, 342) and
+	 *                  [348, 448); group 3, tab [470, 520)
+	 *
+	 * Group 2 doesn't fit and there is no third row, so row 1 overflows behind the chevron at
+	 * [284, 300). Positions are before scrolling.
+	 */
+	const Rect kClient = { 0, 0, 300, 200 };
+
+	Metrics GetMetrics()
+	{
+		Metrics metrics;
+		metrics.maxRows = 2;
+		return metrics;
+	}
+
+	StripLayout ComputeOverflowing(int scrollOffset)
+	{
+		StripLayout layout;
+		layout.Compute(GetMetrics(), kClient, { 2, 1, 3, 1 }, { 100, 100, 100, 100, 100, 100, 50 }, scrollOffset);
+		return layout;
+	}
+
+	void ExpectRect(const Rect &rect, int left, int top, int right, int bottom)
+	{
+		EXPECT_EQ(left, rect.left);
+		EXPECT_EQ(top, rect.top);
+		EXPECT_EQ(right, rect.right);
+		EXPECT_EQ(bottom, rect.bottom);
+	}
+}
+
+TEST(TabLayoutTest, StripWhichFitsDoesNotScroll)
+{
+	StripLayout layout;
+	layout.Compute(GetMetrics(), kClient, { 1, 0, 2 }, { 80, 50, 50 }, 40);
+
+	EXPECT_FALSE(layout.IsOverflowing());
+	EXPECT_EQ(0, layout.GetMaxScrollOffset());
+	EXPECT_EQ(0, layout.GetScrollOffset());
+	EXPECT_EQ(44, layout.GetHeight());
+
+	// The empty group takes no space.
+	ExpectRect(layout.GetGroupRect(0), 6, 6, 94, 38);
+	ExpectRect(layout.GetGroupRect(2), 108, 6, 222, 38);
+	EXPECT_EQ(2u, layout.GetVisibleGroups().size());
+	EXPECT_EQ(3u, layout.GetVisibleTabs().size());
+	EXPECT_EQ(0, layout.GetOffsetToReveal(2, 1));
+}
+
+TEST(TabLayoutTest, OverflowGoesOntoTheScrolledRow)
+{
+	StripLayout layout = ComputeOverflowing(0);
+
+	ASSERT_TRUE(layout.IsOverflowing());
+	EXPECT_EQ(82, layout.GetHeight());
+	ExpectRect(layout.GetChevronRect(), 284, 44, 300, 76);
+	EXPECT_EQ(520 + 6 - 284, layout.GetMaxScrollOffset());
+
+	ExpectRect(layout.GetGroupRect(0), 6, 6, 220, 38);
+	ExpectRect(layout.GetGroupRect(1), 6, 44, 114, 76);
+	ExpectRect(layout.GetGroupRect(2), 128, 44, 448, 76);
+	ExpectRect(layout.GetTabRect(3, 0), 470, 44, 520, 76);
+
+	// Partly hidden tabs count as visible; those wholly behind the chevron don't.
+	EXPECT_EQ(3u, layout.GetVisibleGroups().size());
+	EXPECT_EQ(5u, layout.GetVisibleTabs().size());
+	EXPECT_TRUE(layout.IsTabFullyVisible(2, 0));
+	EXPECT_FALSE(layout.IsTabFullyVisible(2, 1));
+	EXPECT_FALSE(layout.IsTabFullyVisible(3, 0));
+	EXPECT_TRUE(layout.IsTabFullyVisible(0, 1));
+}
+
+TEST(TabLayoutTest, ScrollingMovesOnlyTheOverflowingRow)
+{
+	StripLayout layout = ComputeOverflowing(1000);
+
+	// Clamped to the end of the row, which then just clears the chevron.
+	EXPECT_EQ(242, layout.GetScrollOffset());
+	ExpectRect(layout.GetTabRect(3, 0), 228, 44, 278, 76);
+	EXPECT_TRUE(layout.IsTabFullyVisible(3, 0));
+
+	// Group 1 shares the row, so it scrolls out; group 0 is pinned.
+	ExpectRect(layout.GetGroupRect(1), -236, 44, -128, 76);
+	ExpectRect(layout.GetGroupRect(0), 6, 6, 220, 38);
+	EXPECT_TRUE(layout.IsTabFullyVisible(0, 0));
+
+	EXPECT_EQ(0, ComputeOverflowing(-5).GetScrollOffset());
+}
+
+TEST(TabLayoutTest, HitTestAtTabEdges)
+{
+	StripLayout layout = ComputeOverflowing(0);
+
+	HitTestResult result = layout.HitTest(13, 10);
+	EXPECT_TRUE(result.valid);
+	EXPECT_TRUE(result.groupHandle);
+	EXPECT_EQ(0, result.groupIndex);
+
+	// Left edges are inside, right edges outside.
+	result = layout.HitTest(14, 10);
+	EXPECT_TRUE(result.valid);
+	EXPECT_FALSE(result.groupHandle);
+	EXPECT_EQ(0, result.groupIndex);
+	EXPECT_EQ(0, result.tabIndex);
+
+	EXPECT_EQ(0, layout.HitTest(113, 37).tabIndex);
+	EXPECT_FALSE(layout.HitTest(114, 10).valid);
+	EXPECT_FALSE(layout.HitTest(50, 38).valid);
+	EXPECT_EQ(1, layout.HitTest(120, 10).tabIndex);
+
+	// The chevron covers the hidden end of the row, and is only on that row.
+	result = layout.HitTest(290, 50);
+	EXPECT_TRUE(result.chevron);
+	EXPECT_FALSE(result.valid);
+	EXPECT_FALSE(layout.HitTest(290, 10).chevron);
+	EXPECT_FALSE(layout.HitTest(300, 50).valid);
+
+	result = layout.HitTest(283, 50);
+	EXPECT_TRUE(result.valid);
+	EXPECT_EQ(2, result.groupIndex);
+	EXPECT_EQ(1, result.tabIndex);
+
+	// After scrolling, the hit follows the tab.
+	result = ComputeOverflowing(242).HitTest(228, 50);
+	EXPECT_EQ(3, result.groupIndex);
+	EXPECT_EQ(0, result.tabIndex);
+}
+
+TEST(TabLayoutTest, DropSlotAtTabEdges)
+{
+	StripLayout layout = ComputeOverflowing(0);
+
+	// Before a tab up to and including its midpoint, after it beyond.
+	TabRef slot = layout.FindDropSlot(64, 10, false);
+	EXPECT_EQ(0, slot.groupIndex);
+	EXPECT_EQ(0, slot.tabIndex);
+	EXPECT_EQ(1, layout.FindDropSlot(65, 10, false).tabIndex);
+	EXPECT_EQ(1, layout.FindDropSlot(170, 10, false).tabIndex);
+	EXPECT_EQ(2, layout.FindDropSlot(171, 10, false).tabIndex);
+	EXPECT_EQ(2, layout.FindDropSlot(219, 10, false).tabIndex);
+
+	// Whole groups split at the middle of the group.
+	slot = layout.FindDropSlot(112, 10, true);
+	EXPECT_EQ(0, slot.groupIndex);
+	EXPECT_EQ(-1, slot.tabIndex);
+	EXPECT_EQ(1, layout.FindDropSlot(113, 10, true).groupIndex);
+
+	// Between groups, and behind the chevron, there is nowhere to drop.
+	slot = layout.FindDropSlot(225, 10, false);
+	EXPECT_EQ(-1, slot.groupIndex);
+	EXPECT_EQ(-1, slot.tabIndex);
+	EXPECT_EQ(-1, layout.FindDropSlot(290, 50, false).groupIndex);
+
+	// The gap between two tabs is in the group, but over neither tab.
+	TabRef hover = layout.FindDropHover(117, 10);
+	EXPECT_EQ(0, hover.groupIndex);
+	EXPECT_EQ(-1, hover.tabIndex);
+	hover = layout.FindDropHover(120, 10);
+	EXPECT_EQ(0, hover.groupIndex);
+	EXPECT_EQ(1, hover.tabIndex);
+}
+
+TEST(TabLayoutTest, OffsetToRevealMovesAsLittleAsPossible)
+{
+	StripLayout layout = ComputeOverflowing(100);
+	ASSERT_EQ(100, layout.GetScrollOffset());
+
+	// Before the view: scrolled back until its left edge meets the margin.
+	EXPECT_EQ(8, layout.GetOffsetToReveal(1, 0));
+	EXPECT_EQ(6, ComputeOverflowing(8).GetTabRect(1, 0).left);
+
+	// Already in view: no change.
+	EXPECT_EQ(100, layout.GetOffsetToReveal(2, 1));
+
+	// After the view: scrolled on until its right edge meets the margin before the chevron.
+	EXPECT_EQ(170, layout.GetOffsetToReveal(2, 2));
+	EXPECT_EQ(278, ComputeOverflowing(170).GetTabRect(2, 2).right);
+	EXPECT_EQ(242, layout.GetOffsetToReveal(3, 0));
+
+	// Tabs on the pinned row are always in view.
+	EXPECT_EQ(100, layout.GetOffsetToReveal(0, 1));
+}
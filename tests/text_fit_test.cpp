@@ -0,0 +1,154 @@
+/*
+ * text_fit_test.cpp: Ellipsis fitting against a fake font and a brute-force reference.
+ */
+
+#include "util/text_fit.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+namespace
+{
+	// A proportional fake font: every character has its own width between 3 and 12.
+	int GetCharWidth(wchar_t ch)
+	{
+		return 3 + (static_cast<unsigned>(ch) * 7) % 10;
+	}
+
+	TextFit::TitleMetrics Measure(const std::wstring &text, unsigned long long fontKey = 1)
+	{
+		TextFit::TitleMetrics metrics;
+		metrics.Reset(fontKey);
+		int width = 0;
+		for (wchar_t ch : text)
+		{
+			width += GetCharWidth(ch);
+			metrics.advances.push_back(width);
+		}
+		metrics.ellipsisWidth = 3 * GetCharWidth(L'.');
+		return metrics;
+	}
+
+	// What DT_END_ELLIPSIS would draw, found by measuring every prefix from scratch.
+	std::wstring FitByRemeasuring(const std::wstring &text, int maxWidth)
+	{
+		int width = 0;
+		for (wchar_t ch : text)
+			width += GetCharWidth(ch);
+		if (width <= maxWidth)
+			return text;
+
+		int ellipsisWidth = 3 * GetCharWidth(L'.');
+		std::wstring result;
+		for (size_t length = text.length(); length > 0; --length)
+		{
+			int prefixWidth = 0;
+			for (size_t i = 0; i < length; ++i)
+				prefixWidth += GetCharWidth(text[i]);
+			if (prefixWidth + ellipsisWidth <= maxWidth)
+			{
+				result.assign(text, 0, length);
+				break;
+			}
+		}
+		return result + L"...";
+	}
+
+	std::wstring MakeTitle(uint64_t seed, size_t length)
+	{
+		std::wstring title;
+		for (size_t i = 0; i < length; ++i)
+		{
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			title += static_cast<wchar_t>(L' ' + (seed >> 33) % 95);
+		}
+		return title;
+	}
+}
+
+TEST(TextFitTest, FitPrefixFindsLongestPrefixWithinWidth)
+{
+	std::vector<int> advances = { 5, 10, 15, 20 };
+	EXPECT_EQ(0u, TextFit::FitPrefix(advances, 0));
+	EXPECT_EQ(0u, TextFit::FitPrefix(advances, 4));
+	EXPECT_EQ(1u, TextFit::FitPrefix(advances, 5));
+	EXPECT_EQ(2u, TextFit::FitPrefix(advances, 14));
+	EXPECT_EQ(4u, TextFit::FitPrefix(advances, 20));
+	EXPECT_EQ(4u, TextFit::FitPrefix(advances, 1000));
+	EXPECT_EQ(0u, TextFit::FitPrefix({}, 100));
+}
+
+TEST(TextFitTest, FitPrefixHandlesZeroWidthCharacters)
+{
+	// Combining marks have no advance of their own, and belong with the prefix before them.
+	std::vector<int> advances = { 5, 5, 5, 10 };
+	EXPECT_EQ(3u, TextFit::FitPrefix(advances, 5));
+	EXPECT_EQ(3u, TextFit::FitPrefix(advances, 9));
+}
+
+TEST(TextFitTest, TextWhichFitsIsUnchanged)
+{
+	std::wstring text = L"Documents";
+	TextFit::TitleMetrics metrics = Measure(text);
+	EXPECT_EQ(text, TextFit::GetDisplayText(metrics, text, metrics.GetWidth()));
+	metrics.displayWidth = -1;
+	EXPECT_EQ(text, TextFit::GetDisplayText(metrics, text, metrics.GetWidth() + 100));
+}
+
+TEST(TextFitTest, TooNarrowForAnyCharacterShowsEllipsisOnly)
+{
+	std::wstring text = L"Documents";
+	TextFit::TitleMetrics metrics = Measure(text);
+	EXPECT_EQ(L"...", TextFit::GetDisplayText(metrics, text, 0));
+	metrics.displayWidth = -1;
+	EXPECT_EQ(L"...", TextFit::GetDisplayText(metrics, text, metrics.ellipsisWidth));
+}
+
+TEST(TextFitTest, AgreesWithRemeasuringAtEveryWidth)
+{
+	for (uint64_t seed = 1; seed <= 50; ++seed)
+	{
+		std::wstring text = MakeTitle(seed, 1 + seed * 3);
+		TextFit::TitleMetrics metrics = Measure(text);
+		for (int width = 0; width <= metrics.GetWidth() + 5; ++width)
+		{
+			ASSERT_EQ(FitByRemeasuring(text, width), TextFit::GetDisplayText(metrics, text, width))
+				<< "seed " << seed << ", width " << width;
+		}
+	}
+}
+
+TEST(TextFitTest, DisplayTextIsMemoisedPerWidth)
+{
+	std::wstring text = L"C:\\Users\\Public\\Documents\\Projects";
+	TextFit::TitleMetrics metrics = Measure(text);
+
+	const std::wstring &first = TextFit::GetDisplayText(metrics, text, 60);
+	std::wstring expected = first;
+
+	// The same width returns the memoised string without looking at the text again.
+	EXPECT_EQ(expected, TextFit::GetDisplayText(metrics, L"", 60));
+	EXPECT_EQ(60, metrics.displayWidth);
+
+	// A new width refits.
+	EXPECT_EQ(FitByRemeasuring(text, 90), TextFit::GetDisplayText(metrics, text, 90));
+	EXPECT_EQ(90, metrics.displayWidth);
+}
+
+TEST(TextFitTest, MetricsAreValidOnlyForTheirFontAndLength)
+{
+	std::wstring text = L"Pictures";
+	TextFit::TitleMetrics metrics = Measure(text, 42);
+	EXPECT_TRUE(metrics.IsValidFor(42, text.length()));
+	EXPECT_FALSE(metrics.IsValidFor(43, text.length()));
+	EXPECT_FALSE(metrics.IsValidFor(42, text.length() + 1));
+
+	TextFit::GetDisplayText(metrics, text, 10);
+	metrics.Reset(43);
+	EXPECT_TRUE(metrics.advances.empty());
+	EXPECT_EQ(0, metrics.GetWidth());
+	EXPECT_EQ(-1, metrics.displayWidth);
+	EXPECT_TRUE(metrics.displayText.empty());
+	EXPECT_TRUE(metrics.IsValidFor(43, 0));
+}
@@ -0,0 +1,435 @@
+/*
+ * theme_pack_test.cpp: Reading theme packs and decoding their sprites, including a corpus of
+ *                      well-formed .bmp and .cetheme files mutated at random.
+ */
+
+#include "util/image_decode.h"
+#include "util/theme_pack.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return state >> 11;
+	}
+
+	void PutUInt16(std::vector<unsigned char> &data, size_t offset, uint16_t value)
+	{
+		memcpy(data.data() + offset, &value, sizeof(value));
+	}
+
+	void PutUInt32(std::vector<unsigned char> &data, size_t offset, uint32_t value)
+	{
+		memcpy(data.data() + offset, &value, sizeof(value));
+	}
+
+	// The colour of every pixel of the test images: its position, so misplaced rows show.
+	uint32_t GetTestPixel(int x, int y)
+	{
+		return 0xFF000000 | (static_cast<uint32_t>(x) << 8) | static_cast<uint32_t>(y);
+	}
+
+	/*
+	 * MakeBmp: A .bmp file of the given size and depth. Paletted images have a grey ramp and
+	 * index (x + y) modulo the palette size; the others hold GetTestPixel.
+	 */
+	std::vector<unsigned char> MakeBmp(int width, int height, int bitCount, bool topDown = false, bool bitfields = false)
+	{
+		size_t colors = bitCount <= 8 ? (static_cast<size_t>(1) << bitCount) : 0;
+		size_t stride = ((static_cast<size_t>(width) * bitCount + 31) / 32) * 4;
+		size_t pixelOffset = 14 + 40 + (bitfields ? 12 : 0) + colors * 4;
+
+		std::vector<unsigned char> data(pixelOffset + stride * height);
+		data[0] = 'B';
+		data[1] = 'M';
+		PutUInt32(data, 2, static_cast<uint32_t>(data.size()));
+		PutUInt32(data, 10, static_cast<uint32_t>(pixelOffset));
+		PutUInt32(data, 14, 40);
+		PutUInt32(data, 18, static_cast<uint32_t>(width));
+		PutUInt32(data, 22, static_cast<uint32_t>(topDown ? -height : height));
+		PutUInt16(data, 26, 1);
+		PutUInt16(data, 28, static_cast<uint16_t>(bitCount));
+		PutUInt32(data, 30, bitfields ? 3 : 0);
+
+		if (bitfields)
+		{
+			PutUInt32(data, 54, 0x00FF0000);
+			PutUInt32(data, 58, 0x0000FF00);
+			PutUInt32(data, 62, 0x000000FF);
+		}
+
+		for (size_t i = 0; i < colors; i++)
+		{
+			uint32_t grey = static_cast<uint32_t>(i * 255 / (colors - 1));
+			PutUInt32(data, 54 + i * 4, (grey << 16) | (grey << 8) | grey);
+		}
+
+		for (int y = 0; y < height; y++)
+		{
+			int storedRow = topDown ? height - 1 - y : y;
+			unsigned char *row = data.data() + pixelOffset + static_cast<size_t>(storedRow) * stride;
+			for (int x = 0; x < width; x++)
+			{
+				uint32_t pixel = GetTestPixel(x, y);
+				size_t index = static_cast<size_t>(x + y) % (colors ? colors : 1);
+				switch (bitCount)
+				{
+				case 32:
+					memcpy(row + x * 4, &pixel, 4);
+					break;
+				case 24:
+					memcpy(row + x * 3, &pixel, 3);
+					break;
+				case 8:
+					row[x] = static_cast<unsigned char>(index);
+					break;
+				case 4:
+					row[x / 2] |= static_cast<unsigned char>(index << ((x % 2) ? 0 : 4));
+					break;
+				case 1:
+					row[x / 8] |= static_cast<unsigned char>(index << (7 - x % 8));
+					break;
+				}
+			}
+		}
+		return data;
+	}
+
+	struct SpriteSpec
+	{
+		int sizeClass;
+		ThemePack::Encoding encoding;
+		int width;
+		int height;
+		int frameCount;
+		std::vector<unsigned char> data;
+	};
+
+	std::vector<unsigned char> MakeBgra(int width, int height)
+	{
+		std::vector<unsigned char> data(static_cast<size_t>(width) * height * 4);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+				PutUInt32(data, (static_cast<size_t>(y) * width + x) * 4, GetTestPixel(x, y));
+		}
+		return data;
+	}
+
+	std::vector<unsigned char> MakePack(const std::vector<SpriteSpec> &sprites, const std::string &name = "Test")
+	{
+		std::vector<unsigned char> data(ThemePack::kHeaderSize + sprites.size() * ThemePack::kSpriteEntrySize);
+		memcpy(data.data(), "CETP", 4);
+		PutUInt16(data, 4, ThemePack::kVersion);
+		PutUInt16(data, 6, static_cast<uint16_t>(sprites.size()));
+		PutUInt32(data, 8, ThemePack::kNoBackground);
+		PutUInt16(data, 12, 30);
+		PutUInt16(data, 14, 40);
+		PutUInt16(data, 16, 80);
+		PutUInt16(data, 18, 1);
+
+		PutUInt32(data, 20, static_cast<uint32_t>(data.size()));
+		PutUInt32(data, 24, static_cast<uint32_t>(name.size()));
+		data.insert(data.end(), name.begin(), name.end());
+
+		for (size_t i = 0; i < sprites.size(); i++)
+		{
+			const SpriteSpec &sprite = sprites[i];
+			size_t entry = ThemePack::kHeaderSize + i * ThemePack::kSpriteEntrySize;
+			PutUInt16(data, entry + 2, static_cast<uint16_t>(sprite.sizeClass));
+			PutUInt16(data, entry + 4, static_cast<uint16_t>(sprite.encoding));
+			PutUInt16(data, entry + 6, static_cast<uint16_t>(sprite.width));
+			PutUInt16(data, entry + 8, static_cast<uint16_t>(sprite.height));
+			PutUInt16(data, entry + 10, static_cast<uint16_t>(sprite.frameCount));
+			PutUInt32(data, entry + 12, static_cast<uint32_t>(data.size()));
+			PutUInt32(data, entry + 16, static_cast<uint32_t>(sprite.data.size()));
+			data.insert(data.end(), sprite.data.begin(), sprite.data.end());
+		}
+		return data;
+	}
+
+	std::vector<unsigned char> MakeSamplePack()
+	{
+		return MakePack({
+			{ 0, ThemePack::Encoding::Bmp, 0, 0, 0, MakeBmp(22, 22, 24) },
+			{ 1, ThemePack::Encoding::Bgra, 104, 26, 4, MakeBgra(104, 26) },
+			{ 2, ThemePack::Encoding::Bmp, 0, 0, 3, MakeBmp(114, 38, 32) },
+		}, "Sample");
+	}
+
+	// The seeds of the fuzz corpus: every kind of .bmp the decoder accepts.
+	std::vector<std::vector<unsigned char>> GetBmpCorpus()
+	{
+		return {
+			MakeBmp(13, 7, 1),
+			MakeBmp(13, 7, 4),
+			MakeBmp(13, 7, 8),
+			MakeBmp(13, 7, 24),
+			MakeBmp(13, 7, 32),
+			MakeBmp(13, 7, 24, true),
+			MakeBmp(13, 7, 32, false, true),
+			MakeBmp(1, 1, 8),
+		};
+	}
+
+	// Overwrite a random part of the data with something likely to find a bad bounds check.
+	void Mutate(std::vector<unsigned char> &data, uint64_t &state)
+	{
+		static const uint32_t kInteresting[] = { 0, 1, 2, 3, 4, 0x7F, 0x80, 0xFF, 0x100, 0x7FFF, 0x8000, 0xFFFF, 0x10000, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 4096, 4097 };
+
+		int mutations = 1 + static_cast<int>(NextRandom(state) % 4);
+		for (int m = 0; m < mutations && !data.empty(); m++)
+		{
+			size_t offset = NextRandom(state) % data.size();
+			switch (NextRandom(state) % 5)
+			{
+			case 0:
+				data[offset] ^= static_cast<unsigned char>(1 << (NextRandom(state) % 8));
+				break;
+			case 1:
+				data[offset] = static_cast<unsigned char>(NextRandom(state));
+				break;
+			case 2:
+				if (offset + 2 <= data.size())
+					PutUInt16(data, offset, static_cast<uint16_t>(kInteresting[NextRandom(state) % (sizeof(kInteresting) / sizeof(kInteresting[0]))]));
+				break;
+			case 3:
+				if (offset + 4 <= data.size())
+					PutUInt32(data, offset, kInteresting[NextRandom(state) % (sizeof(kInteresting) / sizeof(kInteresting[0]))]);
+				break;
+			default:
+				data.resize(offset);
+				break;
+			}
+		}
+	}
+
+	// Whatever the input, a successful decode must describe its pixels truthfully.
+	void ExpectConsistent(const DecodedImage &image)
+	{
+		ASSERT_GT(image.width, 0);
+		ASSERT_GT(image.height, 0);
+		ASSERT_LE(image.width, ImageDecode::kMaxDimension);
+		ASSERT_LE(image.height, ImageDecode::kMaxDimension);
+		ASSERT_EQ(static_cast<size_t>(image.width) * image.height, image.pixels.size());
+	}
+
+	// Decoding from an exactly sized copy, so reading past the end is caught by sanitizers.
+	bool DecodeBmpCopy(const std::vector<unsigned char> &data, DecodedImage &imageOut)
+	{
+		std::unique_ptr<unsigned char[]> copy(new unsigned char[data.size() ? data.size() : 1]);
+		if (!data.empty())
+			memcpy(copy.get(), data.data(), data.size());
+		return ImageDecode::DecodeBmp(copy.get(), data.size(), imageOut);
+	}
+}
+
+TEST(ThemePackTest, EveryBmpDepthDecodes)
+{
+	for (int bitCount : { 1, 4, 8, 24, 32 })
+	{
+		for (bool topDown : { false, true })
+		{
+			std::vector<unsigned char> bmp = MakeBmp(13, 7, bitCount, topDown);
+			DecodedImage image;
+			ASSERT_TRUE(ImageDecode::DecodeBmp(bmp.data(), bmp.size(), image)) << bitCount;
+			EXPECT_EQ(13, image.width);
+			EXPECT_EQ(7, image.height);
+
+			for (int y = 0; y < 7; y++)
+			{
+				for (int x = 0; x < 13; x++)
+				{
+					uint32_t pixel = image.pixels[static_cast<size_t>(y) * 13 + x];
+					if (bitCount > 8)
+					{
+						ASSERT_EQ(GetTestPixel(x, y), pixel) << bitCount << " bpp at " << x << "," << y;
+					}
+					else
+					{
+						uint32_t colors = 1u << bitCount;
+						uint32_t grey = ((x + y) % colors) * 255 / (colors - 1);
+						ASSERT_EQ(0xFF000000 | (grey << 16) | (grey << 8) | grey, pixel) << bitCount << " bpp at " << x << "," << y;
+					}
+				}
+			}
+		}
+	}
+
+	std::vector<unsigned char> bitfields = MakeBmp(5, 3, 32, false, true);
+	DecodedImage image;
+	ASSERT_TRUE(ImageDecode::DecodeBmp(bitfields.data(), bitfields.size(), image));
+	EXPECT_EQ(GetTestPixel(4, 2), image.pixels[2 * 5 + 4]);
+}
+
+TEST(ThemePackTest, UnsupportedBmpsAreRejected)
+{
+	DecodedImage image;
+
+	std::vector<unsigned char> bmp = MakeBmp(4, 4, 24);
+	PutUInt32(bmp, 30, 1); // RLE8
+	EXPECT_FALSE(ImageDecode::DecodeBmp(bmp.data(), bmp.size(), image));
+
+	bmp = MakeBmp(4, 4, 16);
+	EXPECT_FALSE(ImageDecode::DecodeBmp(bmp.data(), bmp.size(), image));
+
+	bmp = MakeBmp(4, 4, 24);
+	PutUInt32(bmp, 18, ImageDecode::kMaxDimension + 1);
+	EXPECT_FALSE(ImageDecode::DecodeBmp(bmp.data(), bmp.size(), image));
+
+	bmp = MakeBmp(4, 4, 32, false, true);
+	PutUInt32(bmp, 54, 0xFF000000);
+	EXPECT_FALSE(ImageDecode::DecodeBmp(bmp.data(), bmp.size(), image));
+}
+
+TEST(ThemePackTest, PackIsReadAndDecodedLazily)
+{
+	std::vector<unsigned char> data = MakeSamplePack();
+	ThemePack pack;
+	ASSERT_TRUE(ThemePack::Parse(data.data(), data.size(), pack));
+
+	const ThemePack::Metadata &metadata = pack.GetMetadata();
+	EXPECT_EQ("Sample", metadata.name);
+	EXPECT_EQ(0xFFFFFFFFu, metadata.background);
+	EXPECT_EQ(30, metadata.midHeight);
+	EXPECT_EQ(40, metadata.largeHeight);
+	EXPECT_EQ(80u, metadata.frameIntervalMs);
+	EXPECT_EQ(1, metadata.replacesTheme);
+
+	ASSERT_EQ(3u, pack.GetSprites().size());
+	EXPECT_EQ(1, pack.GetSprites()[0].frameCount);
+	EXPECT_EQ(4, pack.GetSprites()[1].frameCount);
+	EXPECT_EQ(3, pack.GetSprites()[2].frameCount);
+
+	int mid = pack.FindSprite(ThemePack::SpriteRole::Throbber, 1);
+	ASSERT_EQ(1, mid);
+	DecodedImage image;
+	ASSERT_TRUE(pack.DecodeSprite(mid, image));
+	EXPECT_EQ(104, image.width);
+	EXPECT_EQ(GetTestPixel(103, 25), image.pixels.back());
+
+	ASSERT_TRUE(pack.DecodeSprite(pack.FindSprite(ThemePack::SpriteRole::Throbber, 2), image));
+	EXPECT_EQ(114, image.width);
+
+	EXPECT_FALSE(pack.DecodeSprite(-1, image));
+	EXPECT_FALSE(pack.DecodeSprite(3, image));
+}
+
+TEST(ThemePackTest, SpritesMustBeAWholeNumberOfFrames)
+{
+	std::vector<unsigned char> bgra = MakePack({ { 0, ThemePack::Encoding::Bgra, 10, 4, 3, MakeBgra(10, 4) } });
+	ThemePack pack;
+	EXPECT_FALSE(ThemePack::Parse(bgra.data(), bgra.size(), pack));
+
+	// A .bmp sprite's width is only known once it's decoded.
+	std::vector<unsigned char> bmp = MakePack({ { 0, ThemePack::Encoding::Bmp, 0, 0, 3, MakeBmp(10, 4, 24) } });
+	ASSERT_TRUE(ThemePack::Parse(bmp.data(), bmp.size(), pack));
+	DecodedImage image;
+	EXPECT_FALSE(pack.DecodeSprite(0, image));
+}
+
+TEST(ThemePackTest, DamagedHeadersAreRejected)
+{
+	std::vector<unsigned char> good = MakeSamplePack();
+	ThemePack pack;
+
+	std::vector<unsigned char> data = good;
+	data[0] = 'X';
+	EXPECT_FALSE(ThemePack::Parse(data.data(), data.size(), pack));
+
+	data = good;
+	PutUInt16(data, 4, ThemePack::kVersion + 1);
+	EXPECT_FALSE(ThemePack::Parse(data.data(), data.size(), pack));
+
+	data = good;
+	PutUInt16(data, 16, 0); // frame interval
+	EXPECT_FALSE(ThemePack::Parse(data.data(), data.size(), pack));
+
+	data = good;
+	PutUInt16(data, 12, 50); // mid above large
+	EXPECT_FALSE(ThemePack::Parse(data.data(), data.size(), pack));
+
+	data = good;
+	PutUInt16(data, ThemePack::kHeaderSize + 2, ThemePack::kSizeClassCount);
+	EXPECT_FALSE(ThemePack::Parse(data.data(), data.size(), pack));
+
+	data = good;
+	PutUInt32(data, ThemePack::kHeaderSize + 16, static_cast<uint32_t>(data.size()));
+	EXPECT_FALSE(ThemePack::Parse(data.data(), data.size(), pack));
+
+	EXPECT_FALSE(ThemePack::Parse(nullptr, 0, pack));
+	for (size_t size = 0; size < ThemePack::kHeaderSize + 3 * ThemePack::kSpriteEntrySize; size++)
+		EXPECT_FALSE(ThemePack::Parse(good.data(), size, pack)) << size;
+}
+
+TEST(ThemePackTest, MutatedBmpCorpusNeverMisbehaves)
+{
+	uint64_t state = 42;
+	for (const std::vector<unsigned char> &seed : GetBmpCorpus())
+	{
+		// Every truncation, then random damage.
+		for (size_t size = 0; size < seed.size(); size++)
+		{
+			DecodedImage image;
+			EXPECT_FALSE(DecodeBmpCopy(std::vector<unsigned char>(seed.begin(), seed.begin() + size), image)) << size;
+		}
+
+		for (int i = 0; i < 5000; i++)
+		{
+			std::vector<unsigned char> data = seed;
+			Mutate(data, state);
+
+			DecodedImage image;
+			if (DecodeBmpCopy(data, image))
+				ExpectConsistent(image);
+			if (testing::Test::HasFatalFailure())
+				return;
+		}
+	}
+}
+
+TEST(ThemePackTest, MutatedPackCorpusNeverMisbehaves)
+{
+	uint64_t state = 43;
+	std::vector<unsigned char> seed = MakeSamplePack();
+	int parsed = 0;
+	for (int i = 0; i < 20000; i++)
+	{
+		std::vector<unsigned char> data = seed;
+		Mutate(data, state);
+
+		std::unique_ptr<unsigned char[]> copy(new unsigned char[data.size() ? data.size() : 1]);
+		if (!data.empty())
+			memcpy(copy.get(), data.data(), data.size());
+
+		ThemePack pack;
+		if (!ThemePack::Parse(copy.get(), data.size(), pack))
+			continue;
+		parsed++;
+
+		const std::vector<ThemePack::Sprite> &sprites = pack.GetSprites();
+		for (size_t s = 0; s < sprites.size(); s++)
+		{
+			ASSERT_LE(sprites[s].offset + sprites[s].length, data.size());
+			ASSERT_GE(sprites[s].frameCount, 1);
+
+			DecodedImage image;
+			if (pack.DecodeSprite(static_cast<int>(s), image))
+			{
+				ExpectConsistent(image);
+				ASSERT_EQ(0, image.width % sprites[s].frameCount);
+			}
+		}
+	}
+
+	// Most mutations hit sprite data, which Parse doesn't look at, so plenty parse.
+	EXPECT_GT(parsed, 1000);
+}
@@ -0,0 +1,273 @@
+/*
+ * timer_wheel_test.cpp: The timer wheel against a sorted reference model, on a fake clock.
+ */
+
+#include "util/timer_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	uint64_t NextRandom(uint64_t &state)
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return state >> 11;
+	}
+
+	struct Firing
+	{
+		int key;
+		uint64_t atMs;
+	};
+
+	/*
+	 * ModelTest: Drives a wheel and a plain ordered map of (due, key) through the same random
+	 * schedules, cancels and advances, and checks that every timer fires exactly when the
+	 * model says, in due order, and exactly once.
+	 */
+	class ModelTest
+	{
+	public:
+		explicit ModelTest(uint64_t startMs) : m_wheel(startMs) {}
+
+		void Schedule(uint64_t dueMs)
+		{
+			int key = m_nextKey++;
+			uint64_t effectiveDue = dueMs <= m_wheel.GetNow() ? m_wheel.GetNow() + 1 : dueMs;
+			TimerWheel::TimerId id = m_wheel.Schedule(dueMs, [this, key]()
+			{
+				m_fired.push_back({ key, m_wheel.GetNow() });
+			});
+			ASSERT_NE(0u, id);
+			m_ids[key] = id;
+			m_model.insert({ effectiveDue, key });
+			m_dues[key] = effectiveDue;
+		}
+
+		void CancelAny(uint64_t &state)
+		{
+			if (m_ids.empty())
+				return;
+
+			auto it = m_ids.begin();
+			std::advance(it, NextRandom(state) % m_ids.size());
+			int key = it->first;
+			EXPECT_TRUE(m_wheel.Cancel(it->second));
+			EXPECT_FALSE(m_wheel.Cancel(it->second));
+			m_model.erase({ m_dues[key], key });
+			m_ids.erase(it);
+		}
+
+		void Advance(uint64_t nowMs)
+		{
+			std::vector<std::pair<uint64_t, int>> expected;
+			while (!m_model.empty() && m_model.begin()->first <= nowMs)
+			{
+				expected.push_back(*m_model.begin());
+				m_model.erase(m_model.begin());
+			}
+
+			m_fired.clear();
+			size_t fired = m_wheel.Advance(nowMs);
+			ASSERT_EQ(expected.size(), fired);
+			ASSERT_EQ(expected.size(), m_fired.size());
+
+			// Timers due in the same millisecond may fire in any order among themselves.
+			std::set<std::pair<uint64_t, int>> expectedSet(expected.begin(), expected.end());
+			uint64_t lastMs = 0;
+			for (const Firing &firing : m_fired)
+			{
+				ASSERT_EQ(1u, expectedSet.count({ firing.atMs, firing.key })) << "timer " << firing.key << " fired at " << firing.atMs << ", due " << m_dues[firing.key];
+				ASSERT_GE(firing.atMs, lastMs);
+				lastMs = firing.atMs;
+
+				EXPECT_FALSE(m_wheel.Cancel(m_ids[firing.key]));
+				m_ids.erase(firing.key);
+			}
+
+			EXPECT_EQ(m_model.size(), m_wheel.GetCount());
+			EXPECT_EQ(nowMs > m_now ? nowMs : m_now, m_wheel.GetNow());
+			if (nowMs > m_now)
+				m_now = nowMs;
+
+			// The wheel must wake up no later than the next due time.
+			uint64_t wakeup;
+			if (m_model.empty())
+			{
+				EXPECT_FALSE(m_wheel.GetNextWakeup(wakeup));
+			}
+			else
+			{
+				ASSERT_TRUE(m_wheel.GetNextWakeup(wakeup));
+				EXPECT_GT(wakeup, m_wheel.GetNow());
+				EXPECT_LE(wakeup, m_model.begin()->first);
+			}
+		}
+
+		uint64_t GetNow() const { return m_wheel.GetNow(); }
+		size_t GetPending() const { return m_model.size(); }
+
+	private:
+		TimerWheel m_wheel;
+		uint64_t m_now = 0;
+		int m_nextKey = 1;
+		std::set<std::pair<uint64_t, int>> m_model;
+		std::map<int, TimerWheel::TimerId> m_ids;
+		std::map<int, uint64_t> m_dues;
+		std::vector<Firing> m_fired;
+	};
+
+	// Delays spread across every level and beyond the wheel's range.
+	uint64_t RandomDelay(uint64_t &state)
+	{
+		switch (NextRandom(state) % 5)
+		{
+		case 0: return NextRandom(state) % 64;
+		case 1: return NextRandom(state) % 4096;
+		case 2: return NextRandom(state) % 262144;
+		case 3: return NextRandom(state) % 16777216;
+		default: return NextRandom(state) % 100000000;
+		}
+	}
+
+	void RunRandomModel(uint64_t seed, uint64_t startMs)
+	{
+		uint64_t state = seed;
+		ModelTest test(startMs);
+		for (int step = 0; step < 20000; ++step)
+		{
+			switch (NextRandom(state) % 8)
+			{
+			case 0:
+			case 1:
+			case 2:
+				test.Schedule(test.GetNow() + RandomDelay(state));
+				break;
+			case 3:
+				test.CancelAny(state);
+				break;
+			case 4:
+				// Now or in the past, which fires on the next millisecond.
+				test.Schedule(test.GetNow() - std::min<uint64_t>(test.GetNow(), NextRandom(state) % 3));
+				break;
+			case 5:
+				// The clock never goes backwards.
+				test.Advance(test.GetNow() - std::min<uint64_t>(test.GetNow(), NextRandom(state) % 100));
+				break;
+			default:
+				test.Advance(test.GetNow() + RandomDelay(state) / 4);
+				break;
+			}
+			if (testing::Test::HasFatalFailure())
+				return;
+		}
+
+		// Everything left fires eventually.
+		test.Advance(test.GetNow() + 1000000000);
+		EXPECT_EQ(0u, test.GetPending());
+	}
+}
+
+TEST(TimerWheelTest, MatchesTheReferenceModel)
+{
+	RunRandomModel(1, 0);
+}
+
+TEST(TimerWheelTest, MatchesTheReferenceModelFromAnUnalignedStart)
+{
+	// A start in the middle of every level's slots, as GetTickCount64 would give.
+	RunRandomModel(2, 123456789012ULL);
+	RunRandomModel(3, (1ULL << 24) - 5);
+}
+
+TEST(TimerWheelTest, TimersFireAtTheirDueTime)
+{
+	TimerWheel wheel(1000);
+	std::vector<uint64_t> firedAt;
+	for (uint64_t delay : { 1ULL, 63ULL, 64ULL, 65ULL, 4095ULL, 4096ULL, 262143ULL, 262144ULL, 16777215ULL, 16777216ULL, 50000000ULL })
+	{
+		wheel.Schedule(1000 + delay, [&wheel, &firedAt]() { firedAt.push_back(wheel.GetNow()); });
+	}
+
+	// One millisecond at a time around the edges would take too long; stepping by the wakeup
+	// lands on every due time regardless.
+	uint64_t wakeup;
+	while (wheel.GetNextWakeup(wakeup))
+		wheel.Advance(wakeup);
+
+	std::vector<uint64_t> expected;
+	for (uint64_t delay : { 1ULL, 63ULL, 64ULL, 65ULL, 4095ULL, 4096ULL, 262143ULL, 262144ULL, 16777215ULL, 16777216ULL, 50000000ULL })
+		expected.push_back(1000 + delay);
+	EXPECT_EQ(expected, firedAt);
+}
+
+TEST(TimerWheelTest, PastDueTimerFiresOnTheNextMillisecond)
+{
+	TimerWheel wheel(500);
+	int fired = 0;
+	wheel.Schedule(100, [&fired]() { fired++; });
+	EXPECT_EQ(0u, wheel.Advance(500));
+	EXPECT_EQ(1u, wheel.Advance(501));
+	EXPECT_EQ(1, fired);
+}
+
+TEST(TimerWheelTest, StaleAndInvalidIdsAreRejected)
+{
+	TimerWheel wheel;
+	EXPECT_FALSE(wheel.Cancel(0));
+	EXPECT_FALSE(wheel.Cancel(12345));
+
+	TimerWheel::TimerId first = wheel.Schedule(10, nullptr);
+	EXPECT_TRUE(wheel.Cancel(first));
+
+	// The node is reused, but the old id doesn't reach the new timer.
+	TimerWheel::TimerId second = wheel.Schedule(10, nullptr);
+	EXPECT_NE(first, second);
+	EXPECT_FALSE(wheel.Cancel(first));
+	EXPECT_EQ(1u, wheel.GetCount());
+	EXPECT_EQ(1u, wheel.Advance(10));
+	EXPECT_FALSE(wheel.Cancel(second));
+}
+
+TEST(TimerWheelTest, CallbacksMayScheduleAndCancel)
+{
+	TimerWheel wheel;
+	std::vector<int> order;
+	TimerWheel::TimerId victim = 0;
+
+	wheel.Schedule(5, [&]()
+	{
+		order.push_back(1);
+		wheel.Cancel(victim);
+
+		// Due now, so it fires on the next millisecond rather than in this pass.
+		wheel.Schedule(5, [&order]() { order.push_back(3); });
+	});
+	victim = wheel.Schedule(5, [&order]() { order.push_back(2); });
+	victim = wheel.Schedule(5, [&order]() { order.push_back(2); });
+
+	EXPECT_EQ(2u, wheel.Advance(5));
+	EXPECT_EQ(1u, wheel.GetCount());
+	EXPECT_EQ(1u, wheel.Advance(6));
+	ASSERT_EQ(3u, order.size());
+	EXPECT_EQ(3, order.back());
+}
+
+TEST(TimerWheelTest, BigJumpFiresEverythingInOrder)
+{
+	TimerWheel wheel;
+	std::vector<uint64_t> firedAt;
+	uint64_t state = 9;
+	for (int i = 0; i < 1000; ++i)
+		wheel.Schedule(1 + NextRandom(state) % 30000000, [&wheel, &firedAt]() { firedAt.push_back(wheel.GetNow()); });
+
+	EXPECT_EQ(1000u, wheel.Advance(30000000));
+	EXPECT_TRUE(std::is_sorted(firedAt.begin(), firedAt.end()));
+	EXPECT_EQ(0u, wheel.GetCount());
+}
@@ -0,0 +1,172 @@
+/*
+ * animation_timer.cpp: Implements the process-wide animation timer.
+ */
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "animation_timer.h"
+
+#include <algorithm>
+
+namespace CEUtil
+{
+
+/*
+ * Register: Start posting ticks to the given window at least every intervalMs, re-arming the
+ *           timer if it is the first window or wants a shorter interval than the others.
+ *
+ * Registering a window again changes its interval.
+ */
+void AnimationTimer::Register(HWND window, DWORD intervalMs)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = std::find_if(m_registrations.begin(), m_registrations.end(), [window](const Registration &registration)
+	{
+		return registration.window == window;
+	});
+	if (it != m_registrations.end())
+		it->intervalMs = intervalMs;
+	else
+		m_registrations.push_back({ window, intervalMs });
+
+	DWORD wanted = GetWantedInterval();
+	if (wanted != m_armedIntervalMs)
+		Arm(wanted);
+}
+
+/*
+ * Unregister: Stop posting ticks to the given window, disarming the timer if it was the last
+ *             or slowing it down if it wanted the shortest interval.
+ *
+ * A tick which is already being delivered may still reach the window afterwards.
+ */
+void AnimationTimer::Unregister(HWND window)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = std::find_if(m_registrations.begin(), m_registrations.end(), [window](const Registration &registration)
+	{
+		return registration.window == window;
+	});
+	if (it != m_registrations.end())
+		m_registrations.erase(it);
+
+	if (m_registrations.empty())
+	{
+		Disarm();
+		return;
+	}
+
+	DWORD wanted = GetWantedInterval();
+	if (wanted != m_armedIntervalMs)
+		Arm(wanted);
+}
+
+/*
+ * Shutdown: Stop the timer and wait for any running callback to finish.
+ */
+void AnimationTimer::Shutdown()
+{
+	PTP_TIMER timer = NULL;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_registrations.clear();
+		m_armedIntervalMs = 0;
+		std::swap(timer, m_timer);
+	}
+
+	if (timer)
+	{
+		// The callback takes the lock, so this must wait outside of it.
+		SetThreadpoolTimer(timer, NULL, 0, 0);
+		WaitForThreadpoolTimerCallbacks(timer, TRUE);
+		CloseThreadpoolTimer(timer);
+	}
+}
+
+/*
+ * GetWantedInterval: The smallest interval among the registered windows, clamped to
+ *                    kMinIntervalMs. Called with the lock held.
+ */
+DWORD AnimationTimer::GetWantedInterval() const
+{
+	DWORD intervalMs = MAXDWORD;
+	for (const Registration &registration : m_registrations)
+		intervalMs = std::min(intervalMs, registration.intervalMs);
+	return intervalMs < kMinIntervalMs ? kMinIntervalMs : intervalMs;
+}
+
+/*
+ * Arm: Start (or restart) the periodic timer at the given interval, creating it on first use.
+ *      Called with the lock held.
+ */
+void AnimationTimer::Arm(DWORD intervalMs)
+{
+	if (!m_timer)
+	{
+		m_timer = CreateThreadpoolTimer(OnTick, this, NULL);
+		if (!m_timer)
+			return;
+	}
+
+	// Relative due times are negative, in 100 ns units.
+	ULARGE_INTEGER dueTime;
+	dueTime.QuadPart = static_cast<ULONGLONG>(-static_cast<LONGLONG>(intervalMs) * 10000);
+
+	FILETIME dueFileTime;
+	dueFileTime.dwLowDateTime = dueTime.LowPart;
+	dueFileTime.dwHighDateTime = dueTime.HighPart;
+
+	// Allow up to 30% of the interval for coalescing, so short intervals stay smooth.
+	DWORD toleranceMs = intervalMs * 3 / 10;
+	if (toleranceMs > kMaxToleranceMs)
+		toleranceMs = kMaxToleranceMs;
+
+	SetThreadpoolTimer(m_timer, &dueFileTime, intervalMs, toleranceMs);
+	m_armedIntervalMs = intervalMs;
+}
+
+/*
+ * Disarm: Stop the periodic timer. Called with the lock held.
+ */
+void AnimationTimer::Disarm()
+{
+	if (m_armedIntervalMs == 0)
+		return;
+
+	SetThreadpoolTimer(m_timer, NULL, 0, 0);
+	m_armedIntervalMs = 0;
+}
+
+void CALLBACK AnimationTimer::OnTick(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer)
+{
+	AnimationTimer *self = (AnimationTimer *)context;
+
+	std::vector<Registration> registrations;
+	{
+		std::lock_guard<std::mutex> lock(self->m_mutex);
+		registrations = self->m_registrations;
+	}
+
+	// Windows which were destroyed without unregistering simply fail to receive the message.
+	for (const Registration &registration : registrations)
+	{
+		PostMessageW(registration.window, CE_WM_ANIMATIONTICK, 0, 0);
+	}
+}
+
+/*
+ * GetAnimationTimer: The process-wide animation timer.
+ *
+ * Like the settings cache, it is never destroyed, since stopping it may block; DllCanUnloadNow
+ * shuts it down when the DLL is about to be unloaded.
+ */
+AnimationTimer &GetAnimationTimer()
+{
+	static AnimationTimer *s_timer = new AnimationTimer();
+	return *s_timer;
+}
+
+} // namespace CEUtil
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef _ANIMATION_TIMER_H
+#define _ANIMATION_TIMER_H
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include <mutex>
+#include <vector>
+
+// Posted to every window registered with AnimationTimer on each tick.
+#define CE_WM_ANIMATIONTICK (WM_APP + 2)
+
+namespace CEUtil
+{
+	/*
+	 * AnimationTimer: One thread pool timer shared by every animation in the process.
+	 *
+	 * Windows register, with the interval they want, while they have something to animate, and
+	 * are posted CE_WM_ANIMATIONTICK on every tick. The timer runs at the smallest interval
+	 * among the registered windows (but no faster than kMinIntervalMs), so a window may be
+	 * ticked more often than it asked for and should work out its frame from the clock. The
+	 * timer is only armed while at least one window is registered, so idle windows cause no
+	 * wakeups at all, and it is given a tolerance window so the system can coalesce it with
+	 * other timers.
+	 *
+	 * Shutdown waits for a running callback, so it must not be called from DllMain.
+	 */
+	class AnimationTimer
+	{
+	public:
+		static const DWORD kDefaultIntervalMs = 100;
+		static const DWORD kMinIntervalMs = 16;
+		static const DWORD kMaxToleranceMs = 30;
+
+		AnimationTimer() = default;
+
+		AnimationTimer(const AnimationTimer &) = delete;
+		AnimationTimer &operator=(const AnimationTimer &) = delete;
+
+		void Register(HWND window, DWORD intervalMs = kDefaultIntervalMs);
+		void Unregister(HWND window);
+		void Shutdown();
+
+	private:
+		struct Registration
+		{
+			HWND window;
+			DWORD intervalMs;
+		};
+
+		static void CALLBACK OnTick(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_TIMER timer);
+		DWORD GetWantedInterval() const;
+		void Arm(DWORD intervalMs);
+		void Disarm();
+
+		std::mutex m_mutex;
+		std::vector<Registration> m_registrations;
+		PTP_TIMER m_timer = NULL;
+		DWORD m_armedIntervalMs = 0;
+	};
+
+	AnimationTimer &GetAnimationTimer();
+}
+
+#endif // _ANIMATION_TIMER_H
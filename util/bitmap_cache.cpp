@@ -0,0 +1,370 @@
+/*
+ * bitmap_cache.cpp: Decodes the theme bitmaps once per process and shares them between windows.
+ */
+
+#include "stdafx.h"
+#include "framework.h"
+#include "resource.h"
+
+#include "bitmap_cache.h"
+#include "resample.h"
+#include "trace.h"
+
+#include <algorithm>
+
+namespace CEUtil
+{
+
+DecodedBitmap::DecodedBitmap(int width, int height, std::vector<uint32_t> &&pixels, int frameCount)
+	: m_width(width)
+	, m_height(height)
+	, m_frameCount(1)
+	, m_hasAlpha(false)
+	, m_info()
+	, m_pixels(std::move(pixels))
+{
+	m_info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	m_info.bmiHeader.biWidth = width;
+	m_info.bmiHeader.biHeight = height;
+	m_info.bmiHeader.biPlanes = 1;
+	m_info.bmiHeader.biBitCount = 32;
+	m_info.bmiHeader.biCompression = BI_RGB;
+
+	if (frameCount > 1 && width % frameCount == 0)
+		m_frameCount = frameCount;
+
+	m_hasAlpha = std::any_of(m_pixels.begin(), m_pixels.end(), [](uint32_t pixel)
+	{
+		return (pixel >> 24) != 0;
+	});
+}
+
+/*
+ * FromResource: Load a bitmap resource and convert it to 32 bpp pixels.
+ *
+ * Returns null if the resource doesn't exist or can't be converted.
+ */
+std::shared_ptr<const DecodedBitmap> DecodedBitmap::FromResource(HINSTANCE instance, int resourceId)
+{
+	CE_TRACE_SCOPE("BitmapCache.Decode");
+
+	HBITMAP bitmap = (HBITMAP)LoadImageW(
+		instance,
+		MAKEINTRESOURCEW(resourceId),
+		IMAGE_BITMAP,
+		0,
+		0,
+		LR_CREATEDIBSECTION
+	);
+
+	if (!bitmap)
+		return nullptr;
+
+	BITMAP bmp;
+	if (!GetObjectW(bitmap, sizeof(bmp), &bmp) || bmp.bmWidth <= 0 || bmp.bmHeight <= 0)
+	{
+		DeleteObject(bitmap);
+		return nullptr;
+	}
+
+	BITMAPINFO info = {};
+	info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	info.bmiHeader.biWidth = bmp.bmWidth;
+	info.bmiHeader.biHeight = bmp.bmHeight;
+	info.bmiHeader.biPlanes = 1;
+	info.bmiHeader.biBitCount = 32;
+	info.bmiHeader.biCompression = BI_RGB;
+
+	std::vector<uint32_t> pixels(static_cast<size_t>(bmp.bmWidth) * bmp.bmHeight);
+
+	HDC screenDc = GetDC(NULL);
+	int lines = GetDIBits(screenDc, bitmap, 0, bmp.bmHeight, pixels.data(), &info, DIB_RGB_COLORS);
+	ReleaseDC(NULL, screenDc);
+	DeleteObject(bitmap);
+
+	if (lines != bmp.bmHeight)
+		return nullptr;
+
+	return std::make_shared<DecodedBitmap>(bmp.bmWidth, bmp.bmHeight, std::move(pixels));
+}
+
+/*
+ * ScaleForDpi: Resample the bitmap from 96 DPI to the given DPI with a Lanczos filter.
+ *
+ * The frames of a sprite sheet are resampled one at a time, so that the filter never pulls
+ * pixels across from the neighbouring frame. Returns null if the result would be too large.
+ */
+std::shared_ptr<const DecodedBitmap> DecodedBitmap::ScaleForDpi(int dpi) const
+{
+	CE_TRACE_SCOPE("BitmapCache.Resample");
+
+	int frameWidth = GetFrameWidth();
+	int scaledFrameWidth = std::max(1, MulDiv(frameWidth, dpi, USER_DEFAULT_SCREEN_DPI));
+	int scaledHeight = std::max(1, MulDiv(m_height, dpi, USER_DEFAULT_SCREEN_DPI));
+	int scaledWidth = scaledFrameWidth * m_frameCount;
+
+	if (scaledWidth > ImageDecode::kMaxDimension || scaledHeight > ImageDecode::kMaxDimension)
+		return nullptr;
+
+	DecodedImage frame;
+	frame.width = frameWidth;
+	frame.height = m_height;
+	frame.pixels.resize(static_cast<size_t>(frameWidth) * m_height);
+
+	DecodedImage scaledFrame;
+	std::vector<uint32_t> pixels(static_cast<size_t>(scaledWidth) * scaledHeight);
+
+	// Resources loaded through GetDIBits have alpha 0 throughout. The resampler weights colour
+	// by alpha, so they must be made opaque first or they come out entirely transparent.
+	uint32_t opaque = m_hasAlpha ? 0 : 0xFF000000u;
+
+	for (int i = 0; i < m_frameCount; i++)
+	{
+		for (int y = 0; y < m_height; y++)
+		{
+			const uint32_t *row = m_pixels.data() + static_cast<size_t>(y) * m_width + i * frameWidth;
+			std::transform(row, row + frameWidth, frame.pixels.begin() + static_cast<size_t>(y) * frameWidth, [opaque](uint32_t pixel)
+			{
+				return pixel | opaque;
+			});
+		}
+
+		if (!Resample::ResampleImage(frame, scaledFrameWidth, scaledHeight, Resample::Filter::Lanczos3, scaledFrame))
+			return nullptr;
+
+		for (int y = 0; y < scaledHeight; y++)
+		{
+			const uint32_t *row = scaledFrame.pixels.data() + static_cast<size_t>(y) * scaledFrameWidth;
+			std::copy(row, row + scaledFrameWidth, pixels.begin() + static_cast<size_t>(y) * scaledWidth + i * scaledFrameWidth);
+		}
+	}
+
+	return std::make_shared<DecodedBitmap>(scaledWidth, scaledHeight, std::move(pixels), m_frameCount);
+}
+
+HBITMAP DecodedBitmap::CreateHBitmap() const
+{
+	void *bits = nullptr;
+	HBITMAP bitmap = CreateDIBSection(NULL, &m_info, DIB_RGB_COLORS, &bits, NULL, 0);
+	if (!bitmap)
+		return NULL;
+
+	memcpy(bits, m_pixels.data(), m_pixels.size() * sizeof(uint32_t));
+	return bitmap;
+}
+
+/*
+ * BlendInto: Composite an animation frame over a bottom-up buffer of premultiplied 32 bpp
+ *            pixels, with its top-left corner at (x, y). The frame is clipped to the first
+ *            width by height pixels of the buffer; stride is the length of a whole row.
+ */
+void DecodedBitmap::BlendInto(uint32_t *pixels, int stride, int width, int height, int x, int y, int frame) const
+{
+	int frameWidth = GetFrameWidth();
+	int sourceLeft = (frame % m_frameCount) * frameWidth;
+
+	for (int row = 0; row < m_height; row++)
+	{
+		int destinationY = y + row;
+		if (destinationY < 0 || destinationY >= height)
+			continue;
+
+		const uint32_t *source = m_pixels.data() + static_cast<size_t>(m_height - 1 - row) * m_width + sourceLeft;
+		uint32_t *destination = pixels + static_cast<size_t>(height - 1 - destinationY) * stride;
+
+		for (int column = 0; column < frameWidth; column++)
+		{
+			int destinationX = x + column;
+			if (destinationX < 0 || destinationX >= width)
+				continue;
+
+			uint32_t pixel = source[column];
+			uint32_t alpha = m_hasAlpha ? pixel >> 24 : 255;
+			if (alpha == 0)
+				continue;
+
+			// Treating the alpha channel as a colour channel of value 255 blends it the
+			// same way as the others.
+			pixel |= 0xFF000000;
+
+			uint32_t below = destination[destinationX];
+			uint32_t result = 0;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				uint32_t top = (((pixel >> shift) & 0xFF) * alpha + 127) / 255;
+				uint32_t bottom = (((below >> shift) & 0xFF) * (255 - alpha) + 127) / 255;
+				result |= (top + bottom) << shift;
+			}
+
+			destination[destinationX] = result;
+		}
+	}
+}
+
+int ThemeBitmapCache::GetThrobberResourceId(ClassicExplorerTheme theme, ThrobberSize size)
+{
+	static const int kResourceIds[][static_cast<int>(ThrobberSize::Count)] = {
+		{ IDB_10_THROBBER_SIZE_SMALL,      IDB_10_THROBBER_SIZE_MID,      IDB_10_THROBBER_SIZE_LARGE },
+		{ IDB_2K_THROBBER_SIZE_SMALL,      IDB_2K_THROBBER_SIZE_MID,      IDB_2K_THROBBER_SIZE_LARGE },
+		{ IDB_MEMPHIS_THROBBER_SIZE_SMALL, IDB_MEMPHIS_THROBBER_SIZE_MID, IDB_MEMPHIS_THROBBER_SIZE_LARGE },
+		{ IDB_XP_THROBBER_SIZE_SMALL,      IDB_XP_THROBBER_SIZE_MID,      IDB_XP_THROBBER_SIZE_LARGE },
+	};
+
+	int row = 0;
+	switch (theme)
+	{
+	default:
+	case CLASSIC_EXPLORER_10:
+		row = 0;
+		break;
+	case CLASSIC_EXPLORER_2K:
+		row = 1;
+		break;
+	case CLASSIC_EXPLORER_MEMPHIS:
+		row = 2;
+		break;
+	case CLASSIC_EXPLORER_XP:
+		row = 3;
+		break;
+	}
+
+	return kResourceIds[row][static_cast<int>(size)];
+}
+
+/*
+ * GetWatermarkResourceId: Every theme uses the same blue watermarks for now, but they are
+ *                         looked up per theme so that a theme can have its own.
+ */
+int ThemeBitmapCache::GetWatermarkResourceId(ClassicExplorerTheme theme, WatermarkKind kind)
+{
+	switch (kind)
+	{
+	case WatermarkKind::Music:
+		return IDB_BG_MUSIC_BLUE;
+	case WatermarkKind::Videos:
+		return IDB_BG_VIDEOS_BLUE;
+	default:
+	case WatermarkKind::Pictures:
+		return IDB_BG_PICTURES_BLUE;
+	}
+}
+
+/*
+ * GetBitmap: Get the given bitmap resource drawn for the given DPI, decoding (and resampling)
+ *            it if no window holds it at the moment.
+ */
+std::shared_ptr<const DecodedBitmap> ThemeBitmapCache::GetBitmap(int resourceId, int dpi)
+{
+	if (dpi <= 0)
+		dpi = USER_DEFAULT_SCREEN_DPI;
+
+	Key key = { resourceId, dpi };
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (std::shared_ptr<const DecodedBitmap> bitmap = FindLocked(key))
+		return bitmap;
+
+	// Decoding or resampling one of these bitmaps takes well under a millisecond, so it is
+	// simpler to hold the lock than to let two threads race to build the same bitmap.
+	std::shared_ptr<const DecodedBitmap> bitmap = FindLocked({ resourceId, USER_DEFAULT_SCREEN_DPI });
+	if (!bitmap)
+	{
+		bitmap = DecodedBitmap::FromResource(_AtlBaseModule.GetResourceInstance(), resourceId);
+		if (!bitmap)
+			return nullptr;
+
+		m_decodeCount++;
+	}
+
+	if (dpi != USER_DEFAULT_SCREEN_DPI)
+	{
+		bitmap = bitmap->ScaleForDpi(dpi);
+		if (!bitmap)
+			return nullptr;
+
+		m_decodeCount++;
+	}
+
+	PruneExpired();
+	m_entries[key] = bitmap;
+
+	return bitmap;
+}
+
+/*
+ * GetThrobber: Get the throbber bitmap for the given theme, size class and DPI.
+ */
+std::shared_ptr<const DecodedBitmap> ThemeBitmapCache::GetThrobber(ClassicExplorerTheme theme, ThrobberSize size, int dpi)
+{
+	return GetBitmap(GetThrobberResourceId(theme, size), dpi);
+}
+
+/*
+ * GetWatermark: Get the list view watermark for the given theme, folder type and DPI. Each is
+ *               decoded at most once per process.
+ */
+std::shared_ptr<const DecodedBitmap> ThemeBitmapCache::GetWatermark(ClassicExplorerTheme theme, WatermarkKind kind, int dpi)
+{
+	if (dpi <= 0)
+		dpi = USER_DEFAULT_SCREEN_DPI;
+
+	WatermarkKey key = { theme, kind, dpi };
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto it = m_watermarks.find(key);
+		if (it != m_watermarks.end())
+			return it->second;
+	}
+
+	std::shared_ptr<const DecodedBitmap> bitmap = GetBitmap(GetWatermarkResourceId(theme, kind), dpi);
+	if (!bitmap)
+		return nullptr;
+
+	// Another thread may have got here first, in which case its bitmap is the same one.
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_watermarks.emplace(key, bitmap).first->second;
+}
+
+unsigned long long ThemeBitmapCache::GetDecodeCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_decodeCount;
+}
+
+/*
+ * FindLocked: Get the entry for the given key if its bitmap is still alive. Called with the
+ *             lock held.
+ */
+std::shared_ptr<const DecodedBitmap> ThemeBitmapCache::FindLocked(const Key &key) const
+{
+	auto it = m_entries.find(key);
+	if (it == m_entries.end())
+		return nullptr;
+
+	return it->second.lock();
+}
+
+/*
+ * PruneExpired: Drop the entries of bitmaps which have been freed. Called with the lock held.
+ */
+void ThemeBitmapCache::PruneExpired()
+{
+	for (auto it = m_entries.begin(); it != m_entries.end();)
+	{
+		if (it->second.expired())
+			it = m_entries.erase(it);
+		else
+			++it;
+	}
+}
+
+ThemeBitmapCache &GetThemeBitmapCache()
+{
+	static ThemeBitmapCache s_cache;
+	return s_cache;
+}
+
+} // namespace CEUtil
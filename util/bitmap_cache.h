@@ -0,0 +1,146 @@
+#pragma once
+#ifndef _BITMAP_CACHE_H
+#define _BITMAP_CACHE_H
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "settings.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace CEUtil
+{
+	/*
+	 * DecodedBitmap: An immutable 32 bpp bitmap kept in ordinary memory rather than as a GDI
+	 *                object.
+	 *
+	 * A GDI bitmap can only be selected into one DC at a time, and every Explorer window runs
+	 * on its own thread, so a single HBITMAP can't safely be shared between windows. Plain
+	 * pixels, which each window blends into its own frame, can be.
+	 *
+	 * A bitmap with more than one frame is a horizontal sprite sheet of animation frames of
+	 * equal width; whoever supplies the pixels says how many there are, since the size alone
+	 * can't tell a strip from a wide image. A bitmap whose alpha channel is empty, such as
+	 * anything loaded from a 24 bpp resource, is opaque.
+	 */
+	class DecodedBitmap
+	{
+	public:
+		// A frame count which doesn't divide the width is taken as one frame.
+		DecodedBitmap(int width, int height, std::vector<uint32_t> &&pixels, int frameCount = 1);
+
+		static std::shared_ptr<const DecodedBitmap> FromResource(HINSTANCE instance, int resourceId);
+
+		// A copy resampled from 96 DPI to the given DPI, each animation frame on its own.
+		std::shared_ptr<const DecodedBitmap> ScaleForDpi(int dpi) const;
+
+		// A new DIB section with the same pixels, for controls which want a bitmap handle.
+		// The caller owns it.
+		HBITMAP CreateHBitmap() const;
+
+		int GetWidth() const { return m_width; }
+		int GetHeight() const { return m_height; }
+
+		int GetFrameCount() const { return m_frameCount; }
+		int GetFrameWidth() const { return m_width / m_frameCount; }
+
+		void BlendInto(uint32_t *pixels, int stride, int width, int height, int x, int y, int frame = 0) const;
+
+	private:
+		int m_width;
+		int m_height;
+		int m_frameCount;
+		bool m_hasAlpha;
+		BITMAPINFO m_info;
+		std::vector<uint32_t> m_pixels; // bottom-up rows, as GDI expects by default
+	};
+
+	// The throbber is drawn at one of three sizes, depending on the height of its band.
+	enum class ThrobberSize
+	{
+		Small,
+		Mid,
+		Large,
+		Count
+	};
+
+	// The folder types which get a watermark in the corner of their list view.
+	enum class WatermarkKind
+	{
+		Pictures,
+		Music,
+		Videos,
+		Count
+	};
+
+	/*
+	 * ThemeBitmapCache: Owns the decoded theme bitmaps of the process, keyed by resource and
+	 *                   DPI.
+	 *
+	 * Bitmaps are decoded on first use and handed out as shared references; the cache itself
+	 * only keeps weak references, so a bitmap is freed when the last window using it lets go.
+	 * The resources are drawn for 96 DPI; every other DPI gets a copy resampled from them once,
+	 * which is shared like any other entry. Watermarks are the exception to the weak references:
+	 * the list view only ever gets copies of them, so nothing else would keep them alive, and
+	 * there are only a few. It is safe to use from any thread.
+	 */
+	class ThemeBitmapCache
+	{
+	public:
+		std::shared_ptr<const DecodedBitmap> GetBitmap(int resourceId, int dpi);
+		std::shared_ptr<const DecodedBitmap> GetThrobber(ClassicExplorerTheme theme, ThrobberSize size, int dpi);
+		std::shared_ptr<const DecodedBitmap> GetWatermark(ClassicExplorerTheme theme, WatermarkKind kind, int dpi);
+
+		// The number of bitmaps decoded or resampled so far, for diagnostics.
+		unsigned long long GetDecodeCount() const;
+
+	private:
+		struct Key
+		{
+			int resourceId;
+			int dpi;
+
+			bool operator<(const Key &other) const
+			{
+				if (resourceId != other.resourceId)
+					return resourceId < other.resourceId;
+				return dpi < other.dpi;
+			}
+		};
+
+		struct WatermarkKey
+		{
+			ClassicExplorerTheme theme;
+			WatermarkKind kind;
+			int dpi;
+
+			bool operator<(const WatermarkKey &other) const
+			{
+				if (theme != other.theme)
+					return theme < other.theme;
+				if (kind != other.kind)
+					return kind < other.kind;
+				return dpi < other.dpi;
+			}
+		};
+
+		static int GetThrobberResourceId(ClassicExplorerTheme theme, ThrobberSize size);
+		static int GetWatermarkResourceId(ClassicExplorerTheme theme, WatermarkKind kind);
+		std::shared_ptr<const DecodedBitmap> FindLocked(const Key &key) const;
+		void PruneExpired();
+
+		mutable std::mutex m_mutex;
+		std::map<Key, std::weak_ptr<const DecodedBitmap>> m_entries;
+		std::map<WatermarkKey, std::shared_ptr<const DecodedBitmap>> m_watermarks;
+		unsigned long long m_decodeCount = 0;
+	};
+
+	ThemeBitmapCache &GetThemeBitmapCache();
+}
+
+#endif // _BITMAP_CACHE_H
@@ -0,0 +1,47 @@
+/*
+ * diagnostics.cpp: Holds the process-wide latency histograms and the overlay switch.
+ */
+
+#include "diagnostics.h"
+
+namespace CEDiagnostics
+{
+
+static LatencyHistogram s_paintLatency;
+static LatencyHistogram s_layoutLatency;
+static LatencyHistogram s_navigationLatency;
+static NavigationTracer s_navigations;
+
+static std::atomic<bool> s_overlayEnabled(false);
+
+LatencyHistogram &PaintLatency()
+{
+	return s_paintLatency;
+}
+
+LatencyHistogram &LayoutLatency()
+{
+	return s_layoutLatency;
+}
+
+LatencyHistogram &NavigationLatency()
+{
+	return s_navigationLatency;
+}
+
+NavigationTracer &Navigations()
+{
+	return s_navigations;
+}
+
+bool IsOverlayEnabled()
+{
+	return s_overlayEnabled.load(std::memory_order_relaxed);
+}
+
+void SetOverlayEnabled(bool enabled)
+{
+	s_overlayEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+} // namespace CEDiagnostics
@@ -0,0 +1,27 @@
+#pragma once
+#ifndef _DIAGNOSTICS_H
+#define _DIAGNOSTICS_H
+
+// This header is deliberately free of Windows dependencies.
+
+#include "latency_histogram.h"
+#include "navigation_tracer.h"
+
+namespace CEDiagnostics
+{
+	/*
+	 * Process-wide latency histograms for the tab bar's hot paths. They are always recorded,
+	 * and shown on the tab strip when the latency overlay is on.
+	 */
+	LatencyHistogram &PaintLatency();
+	LatencyHistogram &LayoutLatency();
+	LatencyHistogram &NavigationLatency();
+
+	// Correlates navigations across the tab bar, the other bands and the BHO.
+	NavigationTracer &Navigations();
+
+	bool IsOverlayEnabled();
+	void SetOverlayEnabled(bool enabled);
+}
+
+#endif // _DIAGNOSTICS_H
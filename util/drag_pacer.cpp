@@ -0,0 +1,93 @@
+/*
+ * drag_pacer.cpp: Frame pacing for drag input.
+ *
+ * See drag_pacer.h for an overview.
+ */
+
+#include "drag_pacer.h"
+
+void DragPacer::Reset()
+{
+	m_hasPending = false;
+	m_pendingOutside = false;
+	m_hasDelivered = false;
+	m_deliveredOutside = false;
+	m_lastDeliveryMs = 0;
+}
+
+/*
+ * Push: Record a pointer sample.
+ *
+ * Returns true if the sample must be processed right away: it is the first sample of the drag,
+ * a frame has elapsed since the last delivery, or it crosses the detach threshold. Otherwise the
+ * sample replaces any pending one, and the caller must arrange to call TakeDue once the delay
+ * reported by GetDelayUntilDue has elapsed.
+ */
+bool DragPacer::Push(const Point &point, bool outsideDetachZone, unsigned long long nowMs)
+{
+	m_stats.received++;
+
+	m_pending = point;
+	m_pendingOutside = outsideDetachZone;
+	m_hasPending = true;
+
+	if (m_hasDelivered && outsideDetachZone != m_deliveredOutside)
+	{
+		m_stats.crossings++;
+		Deliver(nowMs);
+		return true;
+	}
+
+	if (!m_hasDelivered || nowMs - m_lastDeliveryMs >= m_frameIntervalMs)
+	{
+		Deliver(nowMs);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * TakeDue: Take the pending sample if there is one and a frame has elapsed since the last
+ *          delivery.
+ */
+bool DragPacer::TakeDue(unsigned long long nowMs, Point &pointOut)
+{
+	if (!m_hasPending || nowMs - m_lastDeliveryMs < m_frameIntervalMs)
+		return false;
+
+	pointOut = m_pending;
+	Deliver(nowMs);
+	return true;
+}
+
+/*
+ * TakePending: Take the pending sample regardless of pacing, e.g. right before a drop.
+ */
+bool DragPacer::TakePending(Point &pointOut)
+{
+	if (!m_hasPending)
+		return false;
+
+	pointOut = m_pending;
+	Deliver(m_lastDeliveryMs);
+	return true;
+}
+
+unsigned int DragPacer::GetDelayUntilDue(unsigned long long nowMs) const
+{
+	unsigned long long elapsed = nowMs - m_lastDeliveryMs;
+	if (!m_hasDelivered || elapsed >= m_frameIntervalMs)
+		return 0;
+
+	return static_cast<unsigned int>(m_frameIntervalMs - elapsed);
+}
+
+void DragPacer::Deliver(unsigned long long nowMs)
+{
+	m_stats.delivered++;
+	m_hasPending = false;
+	m_hasDelivered = true;
+	m_deliveredOutside = m_pendingOutside;
+	m_lastDeliveryMs = nowMs;
+}
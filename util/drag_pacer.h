@@ -0,0 +1,60 @@
+#pragma once
+#ifndef _DRAG_PACER_H
+#define _DRAG_PACER_H
+
+// This header is deliberately free of Windows dependencies; the caller supplies the clock.
+
+/*
+ * DragPacer: Coalesces pointer samples during a drag so that the expensive drag update runs
+ *            at most once per frame, always with the latest point.
+ *
+ * Intermediate samples are discarded, except for samples which cross the detach threshold:
+ * those are delivered immediately so a quick excursion out of the strip is never lost.
+ */
+class DragPacer
+{
+public:
+	struct Point
+	{
+		int x = 0;
+		int y = 0;
+	};
+
+	struct Stats
+	{
+		unsigned long long received = 0;
+		unsigned long long delivered = 0;
+		unsigned long long crossings = 0;
+	};
+
+	explicit DragPacer(unsigned int frameIntervalMs = 16) : m_frameIntervalMs(frameIntervalMs) {}
+
+	void Reset();
+
+	bool Push(const Point &point, bool outsideDetachZone, unsigned long long nowMs);
+	bool TakeDue(unsigned long long nowMs, Point &pointOut);
+	bool TakePending(Point &pointOut);
+
+	bool HasPending() const { return m_hasPending; }
+	unsigned int GetDelayUntilDue(unsigned long long nowMs) const;
+	unsigned int GetFrameInterval() const { return m_frameIntervalMs; }
+	const Stats &GetStats() const { return m_stats; }
+
+private:
+	void Deliver(unsigned long long nowMs);
+
+private:
+	unsigned int m_frameIntervalMs;
+
+	Point m_pending;
+	bool m_hasPending = false;
+	bool m_pendingOutside = false;
+
+	bool m_hasDelivered = false;
+	bool m_deliveredOutside = false;
+	unsigned long long m_lastDeliveryMs = 0;
+
+	Stats m_stats;
+};
+
+#endif // _DRAG_PACER_H
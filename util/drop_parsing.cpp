@@ -0,0 +1,110 @@
+/*
+ * drop_parsing.cpp: Parsers for the clipboard formats accepted by the tab bar.
+ *
+ * The layouts are fixed by the Shell:
+ *
+ *   DROPFILES { DWORD pFiles; POINT pt; BOOL fNC; BOOL fWide; }, followed at pFiles by a
+ *   double-NUL-terminated list of paths.
+ *
+ *   CIDA { UINT cidl; UINT aoffset[cidl + 1]; }, where aoffset[0] is the parent folder and
+ *   every ID list is a run of SHITEMID { USHORT cb; BYTE abID[cb - 2]; } ending with cb == 0.
+ */
+
+#include "drop_parsing.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace DropParsing
+{
+
+static const size_t kDropFilesHeaderSize = 20;
+static const size_t kDropFilesWideOffset = 16;
+
+static uint32_t ReadUInt32(const unsigned char *data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint16_t ReadUInt16(const unsigned char *data)
+{
+	uint16_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+bool ParseDropFiles(const unsigned char *data, size_t size, std::vector<std::wstring> &pathsOut)
+{
+	if (!data || size < kDropFilesHeaderSize)
+		return false;
+
+	size_t offset = ReadUInt32(data);
+	bool wide = ReadUInt32(data + kDropFilesWideOffset) != 0;
+	if (!wide || offset < kDropFilesHeaderSize || offset > size)
+		return false;
+
+	std::wstring current;
+	for (; offset + sizeof(uint16_t) <= size; offset += sizeof(uint16_t))
+	{
+		uint16_t unit = ReadUInt16(data + offset);
+		if (unit != 0)
+		{
+			current.push_back(static_cast<wchar_t>(unit));
+			continue;
+		}
+
+		// An empty string terminates the list.
+		if (current.empty())
+			return true;
+
+		pathsOut.push_back(current);
+		current.clear();
+	}
+
+	// Ran off the end of the block without the final terminator.
+	return false;
+}
+
+static bool IsIdListTerminated(const unsigned char *data, size_t size, size_t offset)
+{
+	while (offset + sizeof(uint16_t) <= size)
+	{
+		uint16_t cb = ReadUInt16(data + offset);
+		if (cb == 0)
+			return true;
+		if (cb < sizeof(uint16_t) || cb > size - offset)
+			return false;
+		offset += cb;
+	}
+	return false;
+}
+
+bool ParseCida(const unsigned char *data, size_t size, size_t &folderOffsetOut, std::vector<size_t> &itemOffsetsOut)
+{
+	if (!data || size < sizeof(uint32_t))
+		return false;
+
+	size_t count = ReadUInt32(data);
+	size_t tableSize = (count + 2) * sizeof(uint32_t);
+	if (count > size / sizeof(uint32_t) || tableSize > size)
+		return false;
+
+	folderOffsetOut = ReadUInt32(data + sizeof(uint32_t));
+	if (!IsIdListTerminated(data, size, folderOffsetOut))
+		return false;
+
+	itemOffsetsOut.reserve(itemOffsetsOut.size() + count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		size_t itemOffset = ReadUInt32(data + (i + 2) * sizeof(uint32_t));
+		if (!IsIdListTerminated(data, size, itemOffset))
+			return false;
+		itemOffsetsOut.push_back(itemOffset);
+	}
+
+	return true;
+}
+
+} // namespace DropParsing
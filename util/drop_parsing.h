@@ -0,0 +1,30 @@
+#pragma once
+#ifndef _DROP_PARSING_H
+#define _DROP_PARSING_H
+
+// This header is deliberately free of Windows dependencies; it works on raw clipboard bytes.
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace DropParsing
+{
+	/*
+	 * ParseDropFiles: Read the file list of a CF_HDROP (DROPFILES) block in one pass.
+	 *
+	 * Returns false if the block is malformed, or if it holds ANSI rather than wide strings;
+	 * the caller should then fall back to DragQueryFile.
+	 */
+	bool ParseDropFiles(const unsigned char *data, size_t size, std::vector<std::wstring> &pathsOut);
+
+	/*
+	 * ParseCida: Validate a CFSTR_SHELLIDLIST (CIDA) block and get the byte offsets of the
+	 *            parent folder ID list and of every child ID list.
+	 *
+	 * Every offset is checked to point at an ID list which is terminated within the block.
+	 */
+	bool ParseCida(const unsigned char *data, size_t size, size_t &folderOffsetOut, std::vector<size_t> &itemOffsetsOut);
+}
+
+#endif // _DROP_PARSING_H
@@ -0,0 +1,145 @@
+/*
+ * explorer_topology.cpp: Finds the windows inside Explorer windows, and remembers them.
+ */
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "explorer_topology.h"
+
+#include <map>
+
+namespace CEUtil
+{
+
+/*
+ * ThreadTopologies: The cached topologies of the Explorer windows of one UI thread.
+ *
+ * The WinEvent hooks only listen to this thread, and are only set while the cache holds
+ * something, so nothing is left pointing into the DLL once the thread's last Explorer window
+ * has closed.
+ */
+struct ThreadTopologies
+{
+	std::map<HWND, ExplorerTopology> roots;
+	HWINEVENTHOOK destroyHook = NULL;
+	HWINEVENTHOOK parentChangeHook = NULL;
+
+	~ThreadTopologies()
+	{
+		if (destroyHook)
+			UnhookWinEvent(destroyHook);
+		if (parentChangeHook)
+			UnhookWinEvent(parentChangeHook);
+	}
+};
+
+static thread_local ThreadTopologies t_topologies;
+
+static void CALLBACK OnWindowEvent(HWINEVENTHOOK hook, DWORD event, HWND hWnd, LONG idObject, LONG idChild,
+	DWORD idEventThread, DWORD dwmsEventTime);
+
+static void UpdateHooks()
+{
+	ThreadTopologies &topologies = t_topologies;
+
+	if (!topologies.roots.empty() && !topologies.destroyHook)
+	{
+		DWORD processId = GetCurrentProcessId();
+		DWORD threadId = GetCurrentThreadId();
+
+		topologies.destroyHook = SetWinEventHook(EVENT_OBJECT_DESTROY, EVENT_OBJECT_DESTROY, NULL, OnWindowEvent,
+			processId, threadId, WINEVENT_OUTOFCONTEXT);
+		topologies.parentChangeHook = SetWinEventHook(EVENT_OBJECT_PARENTCHANGE, EVENT_OBJECT_PARENTCHANGE, NULL,
+			OnWindowEvent, processId, threadId, WINEVENT_OUTOFCONTEXT);
+	}
+	else if (topologies.roots.empty() && topologies.destroyHook)
+	{
+		UnhookWinEvent(topologies.destroyHook);
+		topologies.destroyHook = NULL;
+
+		if (topologies.parentChangeHook)
+		{
+			UnhookWinEvent(topologies.parentChangeHook);
+			topologies.parentChangeHook = NULL;
+		}
+	}
+}
+
+/*
+ * OnWindowEvent: Forget the handles of windows which were destroyed or moved to another parent,
+ *                along with everything found beneath them.
+ */
+static void CALLBACK OnWindowEvent(HWINEVENTHOOK hook, DWORD event, HWND hWnd, LONG idObject, LONG idChild,
+	DWORD idEventThread, DWORD dwmsEventTime)
+{
+	if (idObject != OBJID_WINDOW || idChild != CHILDID_SELF || !hWnd)
+		return;
+
+	ThreadTopologies &topologies = t_topologies;
+
+	auto root = topologies.roots.find(hWnd);
+	if (root != topologies.roots.end())
+	{
+		topologies.roots.erase(root);
+		UpdateHooks();
+		return;
+	}
+
+	for (auto &entry : topologies.roots)
+	{
+		ExplorerTopology &topology = entry.second;
+
+		// Each window was found beneath the ones before it.
+		if (hWnd == topology.tabWindow)
+			topology.tabWindow = NULL;
+		if (!topology.tabWindow || hWnd == topology.rebarHost)
+			topology.rebarHost = NULL;
+		if (!topology.rebarHost || hWnd == topology.rebar)
+			topology.rebar = NULL;
+	}
+}
+
+/*
+ * IsCachedChild: Check that a cached handle still names a window under the same parent. Window
+ *                handles are recycled, so IsWindow alone could be fooled.
+ */
+static bool IsCachedChild(HWND parent, HWND child)
+{
+	return child && IsWindow(child) && GetParent(child) == parent;
+}
+
+ExplorerTopology GetExplorerTopology(HWND explorerChild)
+{
+	HWND explorerRoot = GetAncestor(explorerChild, GA_ROOTOWNER);
+	if (!IsWindow(explorerRoot))
+		return ExplorerTopology();
+
+	ThreadTopologies &topologies = t_topologies;
+
+	ExplorerTopology &topology = topologies.roots[explorerRoot];
+	topology.root = explorerRoot;
+	UpdateHooks();
+
+	if (!IsCachedChild(explorerRoot, topology.tabWindow))
+	{
+		topology = ExplorerTopology();
+		topology.root = explorerRoot;
+		topology.tabWindow = FindWindowExW(explorerRoot, NULL, L"ShellTabWindowClass", NULL);
+		if (!topology.tabWindow)
+			return topology;
+	}
+
+	if (!IsCachedChild(topology.tabWindow, topology.rebarHost))
+	{
+		topology.rebarHost = FindWindowExW(topology.tabWindow, NULL, L"WorkerW", NULL);
+		topology.rebar = NULL;
+	}
+
+	if (topology.rebarHost && !IsCachedChild(topology.rebarHost, topology.rebar))
+		topology.rebar = FindWindowExW(topology.rebarHost, NULL, L"ReBarWindow32", NULL);
+
+	return topology;
+}
+
+} // namespace CEUtil
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef _EXPLORER_TOPOLOGY_H
+#define _EXPLORER_TOPOLOGY_H
+
+#include "stdafx.h"
+#include "framework.h"
+
+namespace CEUtil
+{
+	/*
+	 * ExplorerTopology: The windows inside one Explorer window which our code reaches into.
+	 *
+	 * Any of them may be null if Explorer hasn't made it yet. The shell view isn't part of it:
+	 * it is replaced on navigation, and the IShellView hands out its window anyway.
+	 */
+	struct ExplorerTopology
+	{
+		HWND root = NULL;
+		HWND tabWindow = NULL; // ShellTabWindowClass
+		HWND rebarHost = NULL; // WorkerW
+		HWND rebar = NULL;     // ReBarWindow32
+	};
+
+	/*
+	 * Get the topology of the Explorer window which contains the given window.
+	 *
+	 * The handles are looked up once per Explorer window and cached per UI thread. Handles are
+	 * dropped from the cache when a WinEvent reports that they were destroyed or reparented, and
+	 * every read also checks them, so a lookup is usually a few handle checks rather than a walk
+	 * of the window tree. Call it on the thread which owns the Explorer window.
+	 */
+	ExplorerTopology GetExplorerTopology(HWND explorerChild);
+}
+
+#endif // _EXPLORER_TOPOLOGY_H
@@ -0,0 +1,339 @@
+/*
+ * file_settings.cpp: Implements the INI file settings backend.
+ */
+
+#include "file_settings.h"
+#include "mapped_file.h"
+#include "settings_schema.h"
+#include "trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+
+namespace CEUtil
+{
+
+static std::wstring Widen(const std::string &text)
+{
+	// Names and values are ASCII.
+	return std::wstring(text.begin(), text.end());
+}
+
+static std::string Trim(const std::string &text)
+{
+	size_t first = 0;
+	size_t last = text.size();
+	while (first < last && isspace(static_cast<unsigned char>(text[first])))
+		++first;
+	while (last > first && isspace(static_cast<unsigned char>(text[last - 1])))
+		--last;
+	return text.substr(first, last - first);
+}
+
+/*
+ * ToRawValue: Convert the text of a value to the kind its field expects.
+ */
+static bool ToRawValue(const SettingField &field, const std::string &text, RawSettingValue &valueOut)
+{
+	if (field.type == SettingType::Theme)
+	{
+		valueOut.kind = RawSettingValue::Kind::String;
+		valueOut.string = Widen(text);
+		return true;
+	}
+
+	if (text == "true" || text == "yes")
+	{
+		valueOut.kind = RawSettingValue::Kind::Dword;
+		valueOut.dword = 1;
+		return true;
+	}
+	if (text == "false" || text == "no")
+	{
+		valueOut.kind = RawSettingValue::Kind::Dword;
+		valueOut.dword = 0;
+		return true;
+	}
+
+	if (text.empty() || text.size() > 9)
+		return false;
+
+	uint32_t number = 0;
+	for (char c : text)
+	{
+		if (c < '0' || c > '9')
+			return false;
+		number = number * 10 + static_cast<uint32_t>(c - '0');
+	}
+
+	valueOut.kind = RawSettingValue::Kind::Dword;
+	valueOut.dword = number;
+	return true;
+}
+
+CESettings FileSettingsBackend::ParseText(const char *text, size_t length)
+{
+	std::vector<RawSettingValue> values;
+
+	size_t lineStart = 0;
+	while (lineStart < length)
+	{
+		size_t lineEnd = lineStart;
+		while (lineEnd < length && text[lineEnd] != '\n')
+			++lineEnd;
+
+		std::string line = Trim(std::string(text + lineStart, lineEnd - lineStart));
+		lineStart = lineEnd + 1;
+
+		if (line.empty() || line[0] == ';' || line[0] == '#' || line[0] == '[')
+			continue;
+
+		size_t equals = line.find('=');
+		if (equals == std::string::npos)
+			continue;
+
+		std::string name = Trim(line.substr(0, equals));
+		std::string value = Trim(line.substr(equals + 1));
+		if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front())
+			value = value.substr(1, value.size() - 2);
+
+		const SettingField *field = FindSettingField(Widen(name));
+		if (!field)
+			continue;
+
+		RawSettingValue raw;
+		raw.name = field->name;
+		if (ToRawValue(*field, value, raw))
+			values.push_back(raw);
+	}
+
+	return ParseSettings(values);
+}
+
+std::string FileSettingsBackend::FormatText(const CESettings &settings)
+{
+	std::string text = "; Classic Explorer settings\n[ClassicExplorer]\n";
+	for (const SettingField &field : kSettingsSchema)
+	{
+		long value = GetSettingField(settings, field);
+
+		std::wstring name = field.name;
+		text.append(name.begin(), name.end());
+		text += " = ";
+
+		if (field.type == SettingType::Theme)
+		{
+			const wchar_t *themeName = GetThemeName(static_cast<ClassicExplorerTheme>(value));
+			std::wstring themeText = themeName ? themeName : L"";
+			text.append(themeText.begin(), themeText.end());
+		}
+		else
+		{
+			text += std::to_string(value);
+		}
+		text += "\n";
+	}
+	return text;
+}
+
+FileSettingsBackend::FileSettingsBackend(const std::filesystem::path &path, unsigned int pollIntervalMs)
+	: m_path(path), m_pollIntervalMs(pollIntervalMs)
+{
+}
+
+FileSettingsBackend::~FileSettingsBackend()
+{
+	StopWatching();
+}
+
+FileSettingsBackend::FileStamp FileSettingsBackend::GetStamp() const
+{
+	FileStamp stamp;
+	std::error_code error;
+	stamp.modified = std::filesystem::last_write_time(m_path, error);
+	if (error)
+		return stamp;
+
+	stamp.size = std::filesystem::file_size(m_path, error);
+	if (error)
+		return stamp;
+
+	stamp.exists = true;
+	return stamp;
+}
+
+CESettings FileSettingsBackend::LoadLocked()
+{
+	FileStamp stamp = GetStamp();
+	if (m_cached && stamp == m_cachedStamp)
+		return *m_cached;
+
+	CESettings settings = GetDefaultSettings();
+	if (stamp.exists)
+	{
+		MappedFile file(m_path);
+		if (file.GetData())
+			settings = ParseText(file.GetData(), file.GetSize());
+	}
+
+	m_cached = std::make_shared<const CESettings>(settings);
+	m_cachedStamp = stamp;
+	return settings;
+}
+
+CESettings FileSettingsBackend::Load()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return LoadLocked();
+}
+
+/*
+ * MakeTempPath: A temporary name next to the settings file, unique to this process and call, so
+ * concurrent writers (in this or another process) never write to the same temporary file.
+ */
+static std::filesystem::path MakeTempPath(const std::filesystem::path &path)
+{
+	static std::atomic<unsigned long long> counter(0);
+
+#ifdef _WIN32
+	unsigned long processId = GetCurrentProcessId();
+#else
+	unsigned long processId = static_cast<unsigned long>(getpid());
+#endif
+
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp." + std::to_string(processId) + "." + std::to_string(counter++);
+	return tempPath;
+}
+
+/*
+ * RenameOverFile: Rename the temporary file over the settings file. On Windows the rename fails
+ * while another process (a reader, a virus scanner, an indexer) has the file open without
+ * FILE_SHARE_DELETE, which rarely lasts long, so those failures are retried a few times.
+ */
+static bool RenameOverFile(const std::filesystem::path &tempPath, const std::filesystem::path &path, std::error_code &error)
+{
+	const int kAttempts = 5;
+	for (int attempt = 1; ; ++attempt)
+	{
+		std::filesystem::rename(tempPath, path, error);
+		if (!error)
+			return true;
+
+#ifdef _WIN32
+		bool transient = error == std::errc::permission_denied || error == std::errc::device_or_resource_busy;
+#else
+		bool transient = false;
+#endif
+		if (!transient || attempt == kAttempts)
+			return false;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10 * attempt));
+	}
+}
+
+bool FileSettingsBackend::Write(const CESettings &toWrite)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	CESettings settings = LoadLocked();
+	MergeSettings(settings, toWrite);
+
+	// The last rename wins.
+	std::filesystem::path tempPath = MakeTempPath(m_path);
+	std::error_code error;
+
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			CE_TRACE_VALUE("Settings.FileCreateFailed", errno);
+			return false;
+		}
+		out << FormatText(settings);
+		if (!out.flush())
+		{
+			CE_TRACE_VALUE("Settings.FileWriteFailed", errno);
+			out.close();
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	if (!RenameOverFile(tempPath, m_path, error))
+	{
+		CE_TRACE_VALUE("Settings.FileRenameFailed", error.value());
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	// The stamp may not change if the file is rewritten within the timestamp resolution with
+	// the same size, so remember what was written rather than relying on it.
+	m_cached = std::make_shared<const CESettings>(settings);
+	m_cachedStamp = GetStamp();
+	return true;
+}
+
+void FileSettingsBackend::PollThread(FileStamp lastStamp)
+{
+	std::unique_lock<std::mutex> lock(m_watchMutex);
+
+	while (!m_stopWatching)
+	{
+		m_watchCondition.wait_for(lock, std::chrono::milliseconds(m_pollIntervalMs));
+		if (m_stopWatching)
+			break;
+
+		FileStamp stamp = GetStamp();
+		if (stamp == lastStamp)
+			continue;
+
+		lastStamp = stamp;
+		std::function<void()> onChange = m_onChange;
+
+		lock.unlock();
+		if (onChange)
+			onChange();
+		lock.lock();
+	}
+}
+
+bool FileSettingsBackend::Watch(std::function<void()> onChange)
+{
+	StopWatching();
+
+	std::lock_guard<std::mutex> lock(m_watchMutex);
+	m_onChange = std::move(onChange);
+	m_stopWatching = false;
+
+	// Take the first stamp here rather than on the thread, so a change made as soon as this
+	// returns isn't mistaken for the starting state.
+	m_watchThread = std::thread(&FileSettingsBackend::PollThread, this, GetStamp());
+	return true;
+}
+
+void FileSettingsBackend::StopWatching()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_watchMutex);
+		m_stopWatching = true;
+	}
+	m_watchCondition.notify_all();
+
+	if (m_watchThread.joinable())
+		m_watchThread.join();
+
+	std::lock_guard<std::mutex> lock(m_watchMutex);
+	m_onChange = nullptr;
+}
+
+} // namespace CEUtil
@@ -0,0 +1,82 @@
+#pragma once
+#ifndef _FILE_SETTINGS_H
+#define _FILE_SETTINGS_H
+
+// This header is deliberately free of Windows dependencies.
+
+#include "settings_cache.h"
+
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace CEUtil
+{
+	/*
+	 * FileSettingsBackend: Stores the settings in an INI-style text file, for deployments where
+	 *                      the registry is slow or unavailable:
+	 *
+	 *     [ClassicExplorer]
+	 *     Theme = XP
+	 *     TabFixedWidth = 180
+	 *
+	 * Names are those of kSettingsSchema. Lines starting with ';' or '#', unknown names and
+	 * section headers are ignored, and values may be quoted.
+	 *
+	 * The file is memory-mapped and parsed only when its modification time or size changes, so
+	 * an unchanged file costs a stat and a compare. Writes go to a temporary file which is then
+	 * renamed over the original, so readers (in any process) see the old or the new file, never
+	 * a partial one; Write returns false (and traces why) if the file couldn't be replaced. Changes
+	 * are watched by polling the same stat at a fixed interval.
+	 */
+	class FileSettingsBackend : public SettingsBackend
+	{
+	public:
+		explicit FileSettingsBackend(const std::filesystem::path &path, unsigned int pollIntervalMs = 1000);
+		~FileSettingsBackend();
+
+		CESettings Load() override;
+		bool Write(const CESettings &toWrite) override;
+		bool Watch(std::function<void()> onChange) override;
+		void StopWatching() override;
+
+		static CESettings ParseText(const char *text, size_t length);
+		static std::string FormatText(const CESettings &settings);
+
+	private:
+		struct FileStamp
+		{
+			bool exists = false;
+			std::filesystem::file_time_type modified;
+			uintmax_t size = 0;
+
+			bool operator==(const FileStamp &other) const
+			{
+				return exists == other.exists && modified == other.modified && size == other.size;
+			}
+		};
+
+		FileStamp GetStamp() const;
+		CESettings LoadLocked();
+		void PollThread(FileStamp lastStamp);
+
+	private:
+		std::filesystem::path m_path;
+		unsigned int m_pollIntervalMs;
+
+		std::mutex m_mutex;
+		FileStamp m_cachedStamp;
+		std::shared_ptr<const CESettings> m_cached;
+
+		std::mutex m_watchMutex;
+		std::condition_variable m_watchCondition;
+		std::thread m_watchThread;
+		std::function<void()> m_onChange;
+		bool m_stopWatching = false;
+	};
+}
+
+#endif // _FILE_SETTINGS_H
@@ -0,0 +1,55 @@
+/*
+ * id_list.cpp: Byte-level helpers for Shell ID lists.
+ *
+ * An ID list is a run of SHITEMID { USHORT cb; BYTE abID[cb - 2]; } ending with cb == 0.
+ */
+
+#include "id_list.h"
+
+#include <cstring>
+
+namespace IdList
+{
+
+size_t GetSize(const unsigned char *idList)
+{
+	if (!idList)
+		return 0;
+
+	size_t size = 0;
+	for (;;)
+	{
+		uint16_t cb;
+		memcpy(&cb, idList + size, sizeof(cb));
+		if (cb == 0)
+			return size + sizeof(cb);
+		size += cb;
+	}
+}
+
+/*
+ * MakeKey: Get the size and the FNV-1a hash of the bytes of an ID list.
+ */
+Key MakeKey(const unsigned char *idList)
+{
+	Key key;
+	key.size = GetSize(idList);
+
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < key.size; ++i)
+	{
+		hash ^= idList[i];
+		hash *= 0x100000001b3ULL;
+	}
+	key.hash = hash;
+	return key;
+}
+
+bool IsSameBytes(const unsigned char *a, const Key &keyA, const unsigned char *b, const Key &keyB)
+{
+	if (keyA != keyB)
+		return false;
+	return keyA.size == 0 || memcmp(a, b, keyA.size) == 0;
+}
+
+} // namespace IdList
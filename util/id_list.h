@@ -0,0 +1,39 @@
+#pragma once
+#ifndef _ID_LIST_H
+#define _ID_LIST_H
+
+// This header is deliberately free of Windows dependencies; it works on raw ID list bytes.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace IdList
+{
+	/*
+	 * Key: A summary of the bytes of an ID list. Lists with different keys are never equal
+	 *      byte for byte, so comparing a list against many others rarely touches their bytes.
+	 */
+	struct Key
+	{
+		uint64_t hash = 0;
+		size_t size = 0;
+
+		bool operator==(const Key &other) const
+		{
+			return hash == other.hash && size == other.size;
+		}
+
+		bool operator!=(const Key &other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+	// Get the size of an ID list in bytes, including its terminator.
+	size_t GetSize(const unsigned char *idList);
+
+	Key MakeKey(const unsigned char *idList);
+	bool IsSameBytes(const unsigned char *a, const Key &keyA, const unsigned char *b, const Key &keyB);
+}
+
+#endif // _ID_LIST_H
@@ -0,0 +1,191 @@
+/*
+ * image_decode.cpp: Decoders for the image encodings used by theme packs.
+ *
+ * The .bmp layout is fixed by GDI:
+ *
+ *   BITMAPFILEHEADER { WORD bfType = 'BM'; DWORD bfSize; WORD bfReserved1, bfReserved2;
+ *                      DWORD bfOffBits; }, 14 bytes,
+ *   BITMAPINFOHEADER { DWORD biSize; LONG biWidth, biHeight; WORD biPlanes, biBitCount;
+ *                      DWORD biCompression, biSizeImage; LONG biXPelsPerMeter,
+ *                      biYPelsPerMeter; DWORD biClrUsed, biClrImportant; }, 40 bytes or more,
+ *
+ *   followed by the colour masks (BI_BITFIELDS with a 40-byte header only), the palette
+ *   (8 bpp and below), and at bfOffBits the rows, each padded to a multiple of 4 bytes. A
+ *   negative biHeight means the rows are stored top-down.
+ */
+
+#include "image_decode.h"
+
+#include <cstring>
+
+namespace ImageDecode
+{
+
+static const size_t kFileHeaderSize = 14;
+static const size_t kInfoHeaderSize = 40;
+static const uint32_t kCompressionRgb = 0;
+static const uint32_t kCompressionBitfields = 3;
+static const uint32_t kOpaque = 0xFF000000;
+
+static uint32_t ReadUInt32(const unsigned char *data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint16_t ReadUInt16(const unsigned char *data)
+{
+	uint16_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static int32_t ReadInt32(const unsigned char *data)
+{
+	int32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static bool IsValidSize(int64_t width, int64_t height)
+{
+	return width > 0 && height > 0 && width <= kMaxDimension && height <= kMaxDimension;
+}
+
+bool DecodeBmp(const unsigned char *data, size_t size, DecodedImage &imageOut)
+{
+	if (!data || size < kFileHeaderSize + kInfoHeaderSize)
+		return false;
+
+	if (data[0] != 'B' || data[1] != 'M')
+		return false;
+
+	size_t pixelOffset = ReadUInt32(data + 10);
+	const unsigned char *info = data + kFileHeaderSize;
+
+	size_t headerSize = ReadUInt32(info);
+	if (headerSize < kInfoHeaderSize || headerSize > size - kFileHeaderSize)
+		return false;
+
+	int64_t width = ReadInt32(info + 4);
+	int64_t signedHeight = ReadInt32(info + 8);
+	uint16_t planes = ReadUInt16(info + 12);
+	uint16_t bitCount = ReadUInt16(info + 14);
+	uint32_t compression = ReadUInt32(info + 16);
+	uint32_t colorsUsed = ReadUInt32(info + 32);
+
+	bool topDown = signedHeight < 0;
+	int64_t height = topDown ? -signedHeight : signedHeight;
+	if (planes != 1 || !IsValidSize(width, height))
+		return false;
+
+	size_t tableOffset = kFileHeaderSize + headerSize;
+
+	if (compression == kCompressionBitfields)
+	{
+		if (bitCount != 32)
+			return false;
+
+		// The masks follow a 40-byte header; later headers hold them at the same place.
+		size_t masksOffset = kFileHeaderSize + kInfoHeaderSize;
+		if (masksOffset + 12 > size)
+			return false;
+
+		if (ReadUInt32(data + masksOffset) != 0x00FF0000 ||
+			ReadUInt32(data + masksOffset + 4) != 0x0000FF00 ||
+			ReadUInt32(data + masksOffset + 8) != 0x000000FF)
+		{
+			return false;
+		}
+
+		if (headerSize == kInfoHeaderSize)
+			tableOffset += 12;
+	}
+	else if (compression != kCompressionRgb)
+	{
+		return false;
+	}
+
+	uint32_t palette[256];
+	if (bitCount == 1 || bitCount == 4 || bitCount == 8)
+	{
+		size_t maxColors = static_cast<size_t>(1) << bitCount;
+		size_t colors = colorsUsed ? colorsUsed : maxColors;
+		if (colors > maxColors || tableOffset + colors * 4 > size)
+			return false;
+
+		// Indices past the end of a short palette come out black.
+		for (size_t i = 0; i < maxColors; i++)
+		{
+			palette[i] = i < colors ? (ReadUInt32(data + tableOffset + i * 4) | kOpaque) : kOpaque;
+		}
+	}
+	else if (bitCount != 24 && bitCount != 32)
+	{
+		return false;
+	}
+
+	size_t stride = ((static_cast<size_t>(width) * bitCount + 31) / 32) * 4;
+	if (pixelOffset > size || stride * static_cast<size_t>(height) > size - pixelOffset)
+		return false;
+
+	imageOut.width = static_cast<int>(width);
+	imageOut.height = static_cast<int>(height);
+	imageOut.pixels.resize(static_cast<size_t>(width) * static_cast<size_t>(height));
+
+	for (int64_t y = 0; y < height; y++)
+	{
+		// Rows come out bottom-up whichever way they are stored.
+		int64_t sourceRow = topDown ? height - 1 - y : y;
+		const unsigned char *row = data + pixelOffset + static_cast<size_t>(sourceRow) * stride;
+		uint32_t *out = imageOut.pixels.data() + static_cast<size_t>(y) * static_cast<size_t>(width);
+
+		switch (bitCount)
+		{
+		case 32:
+			memcpy(out, row, static_cast<size_t>(width) * 4);
+			break;
+		case 24:
+			for (int64_t x = 0; x < width; x++)
+			{
+				const unsigned char *pixel = row + x * 3;
+				out[x] = kOpaque | (static_cast<uint32_t>(pixel[2]) << 16) | (static_cast<uint32_t>(pixel[1]) << 8) | pixel[0];
+			}
+			break;
+		case 8:
+			for (int64_t x = 0; x < width; x++)
+				out[x] = palette[row[x]];
+			break;
+		case 4:
+			for (int64_t x = 0; x < width; x++)
+				out[x] = palette[(row[x / 2] >> ((x % 2) ? 0 : 4)) & 0x0F];
+			break;
+		case 1:
+			for (int64_t x = 0; x < width; x++)
+				out[x] = palette[(row[x / 8] >> (7 - x % 8)) & 0x01];
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool DecodeBgra(const unsigned char *data, size_t size, int width, int height, DecodedImage &imageOut)
+{
+	if (!data || !IsValidSize(width, height))
+		return false;
+
+	size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
+	if (size != pixelCount * 4)
+		return false;
+
+	imageOut.width = width;
+	imageOut.height = height;
+	imageOut.pixels.resize(pixelCount);
+	memcpy(imageOut.pixels.data(), data, size);
+
+	return true;
+}
+
+} // namespace ImageDecode
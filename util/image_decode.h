@@ -0,0 +1,42 @@
+#pragma once
+#ifndef _IMAGE_DECODE_H
+#define _IMAGE_DECODE_H
+
+// This header is deliberately free of Windows dependencies; it works on raw file bytes.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * DecodedImage: 32 bpp BGRA pixels (0xAARRGGBB when read as little-endian words), with the
+ *               rows stored bottom-up as in a GDI DIB.
+ */
+struct DecodedImage
+{
+	int width = 0;
+	int height = 0;
+	std::vector<uint32_t> pixels;
+};
+
+namespace ImageDecode
+{
+	// Larger images are rejected, so a corrupt header can't ask for gigabytes.
+	static const int kMaxDimension = 4096;
+
+	/*
+	 * DecodeBmp: Decode a .bmp file (BITMAPFILEHEADER onwards).
+	 *
+	 * Supports uncompressed 1, 4, 8, 24 and 32 bpp images, either row order, with the
+	 * BITMAPINFOHEADER or a later version of it. 32 bpp images may also use BI_BITFIELDS with
+	 * the standard masks. Pixels of images without an alpha channel are made opaque.
+	 */
+	bool DecodeBmp(const unsigned char *data, size_t size, DecodedImage &imageOut);
+
+	/*
+	 * DecodeBgra: Copy raw 32 bpp BGRA pixels, rows stored bottom-up and tightly packed.
+	 */
+	bool DecodeBgra(const unsigned char *data, size_t size, int width, int height, DecodedImage &imageOut);
+}
+
+#endif // _IMAGE_DECODE_H
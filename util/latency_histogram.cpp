@@ -0,0 +1,93 @@
+/*
+ * latency_histogram.cpp: Implements the reading side of LatencyHistogram.
+ */
+
+#include "latency_histogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+	Reset();
+}
+
+void LatencyHistogram::Reset()
+{
+	for (auto &bucket : m_buckets)
+		bucket.store(0, std::memory_order_relaxed);
+
+	m_max.store(0, std::memory_order_relaxed);
+}
+
+/*
+ * GetBucketUpperBound: Get the largest value which is recorded into the given bucket.
+ */
+uint64_t LatencyHistogram::GetBucketUpperBound(int index)
+{
+	if (index < kSubBuckets)
+		return static_cast<uint64_t>(index);
+
+	int shift = index / kSubBuckets - 1;
+	uint64_t subBucket = static_cast<uint64_t>(index % kSubBuckets);
+	uint64_t lower = (kSubBuckets + subBucket) << shift;
+	return lower + ((1ULL << shift) - 1);
+}
+
+/*
+ * Snapshot: Copy out the bucket counts and get their total.
+ */
+uint64_t LatencyHistogram::Snapshot(uint64_t *countsOut) const
+{
+	uint64_t total = 0;
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		countsOut[i] = m_buckets[i].load(std::memory_order_relaxed);
+		total += countsOut[i];
+	}
+	return total;
+}
+
+/*
+ * FindPercentile: Get the upper bound of the bucket holding the given percentile (0 to 100)
+ *                 of a snapshot, capped at the recorded maximum.
+ */
+uint64_t LatencyHistogram::FindPercentile(const uint64_t *counts, uint64_t total, uint64_t max, double percentile)
+{
+	if (total == 0)
+		return 0;
+
+	uint64_t target = static_cast<uint64_t>((percentile / 100.0) * static_cast<double>(total) + 0.5);
+	if (target < 1)
+		target = 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < kBucketCount; ++i)
+	{
+		seen += counts[i];
+		if (seen >= target)
+		{
+			uint64_t bound = GetBucketUpperBound(i);
+			return bound < max ? bound : max;
+		}
+	}
+
+	return max;
+}
+
+uint64_t LatencyHistogram::GetValueAtPercentile(double percentile) const
+{
+	uint64_t counts[kBucketCount];
+	uint64_t total = Snapshot(counts);
+	return FindPercentile(counts, total, m_max.load(std::memory_order_relaxed), percentile);
+}
+
+LatencyHistogram::Summary LatencyHistogram::Summarize() const
+{
+	uint64_t counts[kBucketCount];
+
+	Summary summary;
+	summary.count = Snapshot(counts);
+	summary.max = m_max.load(std::memory_order_relaxed);
+	summary.p50 = FindPercentile(counts, summary.count, summary.max, 50.0);
+	summary.p95 = FindPercentile(counts, summary.count, summary.max, 95.0);
+	summary.p99 = FindPercentile(counts, summary.count, summary.max, 99.0);
+	return summary;
+}
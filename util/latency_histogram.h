@@ -0,0 +1,92 @@
+#pragma once
+#ifndef _LATENCY_HISTOGRAM_H
+#define _LATENCY_HISTOGRAM_H
+
+// This header is deliberately free of Windows dependencies.
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+ * LatencyHistogram: A log-bucketed (HDR-style) histogram of durations in nanoseconds.
+ *
+ * Every power of two is split into kSubBuckets linear buckets, so any recorded value is
+ * reported within about 6% of its true value, from 1 ns up to the full 64-bit range.
+ *
+ * Recording is lock-free (one relaxed increment and, rarely, a compare-exchange for the
+ * maximum) and may happen from any thread. Reading takes a snapshot which is consistent
+ * enough for display purposes.
+ */
+class LatencyHistogram
+{
+public:
+	static constexpr int kSubBucketBits = 4;
+	static constexpr int kSubBuckets = 1 << kSubBucketBits;
+	static constexpr int kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+	struct Summary
+	{
+		uint64_t count = 0;
+		uint64_t p50 = 0;
+		uint64_t p95 = 0;
+		uint64_t p99 = 0;
+		uint64_t max = 0;
+	};
+
+	LatencyHistogram();
+
+	LatencyHistogram(const LatencyHistogram &) = delete;
+	LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+	void Record(uint64_t valueNs)
+	{
+		m_buckets[GetBucketIndex(valueNs)].fetch_add(1, std::memory_order_relaxed);
+
+		uint64_t currentMax = m_max.load(std::memory_order_relaxed);
+		while (valueNs > currentMax && !m_max.compare_exchange_weak(currentMax, valueNs, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void Reset();
+	Summary Summarize() const;
+	uint64_t GetValueAtPercentile(double percentile) const;
+
+	static int GetBucketIndex(uint64_t value);
+	static uint64_t GetBucketUpperBound(int index);
+
+private:
+	uint64_t Snapshot(uint64_t *countsOut) const;
+	static uint64_t FindPercentile(const uint64_t *counts, uint64_t total, uint64_t max, double percentile);
+
+	std::atomic<uint64_t> m_buckets[kBucketCount];
+	std::atomic<uint64_t> m_max;
+};
+
+inline int LatencyHistogram::GetBucketIndex(uint64_t value)
+{
+	if (value < static_cast<uint64_t>(kSubBuckets))
+		return static_cast<int>(value);
+
+	int msb = 63;
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	msb = static_cast<int>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+	msb = 63 - __builtin_clzll(value);
+#else
+	while (!(value & (1ULL << msb)))
+		msb--;
+#endif
+
+	int shift = msb - kSubBucketBits;
+	int subBucket = static_cast<int>((value >> shift) & (kSubBuckets - 1));
+	return (shift + 1) * kSubBuckets + subBucket;
+}
+
+#endif // _LATENCY_HISTOGRAM_H
@@ -0,0 +1,73 @@
+/*
+ * mapped_file.cpp: Implements MappedFile with file mappings on Windows and mmap elsewhere.
+ */
+
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CEUtil
+{
+
+MappedFile::MappedFile(const std::filesystem::path &path)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		return;
+
+	m_mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_mapping)
+		return;
+
+	m_data = static_cast<const char *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data)
+		m_size = static_cast<size_t>(size.QuadPart);
+#else
+	m_fd = open(path.c_str(), O_RDONLY);
+	if (m_fd < 0)
+		return;
+
+	struct stat info;
+	if (fstat(m_fd, &info) != 0 || info.st_size == 0)
+		return;
+
+	void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (data == MAP_FAILED)
+		return;
+
+	m_data = static_cast<const char *>(data);
+	m_size = static_cast<size_t>(info.st_size);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+#else
+	if (m_data)
+		munmap(const_cast<char *>(m_data), m_size);
+	if (m_fd >= 0)
+		close(m_fd);
+#endif
+}
+
+} // namespace CEUtil
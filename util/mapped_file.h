@@ -0,0 +1,43 @@
+#pragma once
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+// This header is deliberately free of Windows dependencies.
+
+#include <cstddef>
+#include <filesystem>
+
+namespace CEUtil
+{
+	/*
+	 * MappedFile: A read-only view of a whole file. GetData is null if the file couldn't be
+	 *             opened or mapped, or is empty.
+	 *
+	 * On Windows the file is opened with full sharing, so it can still be replaced or deleted
+	 * while it is mapped.
+	 */
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::filesystem::path &path);
+		~MappedFile();
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+
+		const char *GetData() const { return m_data; }
+		size_t GetSize() const { return m_size; }
+
+	private:
+#ifdef _WIN32
+		void *m_file = nullptr;
+		void *m_mapping = nullptr;
+#else
+		int m_fd = -1;
+#endif
+		const char *m_data = nullptr;
+		size_t m_size = 0;
+	};
+}
+
+#endif // _MAPPED_FILE_H
@@ -0,0 +1,182 @@
+/*
+ * navigation_tracer.cpp: Implements NavigationTracer.
+ */
+
+#include "navigation_tracer.h"
+
+void NavigationTracer::Abandon(InFlight &flight)
+{
+	if (flight.phase != Phase::Idle)
+		m_stats.abandoned++;
+
+	flight = InFlight();
+}
+
+/*
+ * Request: The tab bar is about to ask Explorer to navigate to the given tab.
+ */
+void NavigationTracer::Request(WindowKey window, unsigned int tabId, unsigned long long nowNs)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	InFlight &flight = m_inFlight[window];
+	Abandon(flight);
+
+	flight.phase = Phase::Requested;
+	flight.record.tabId = tabId;
+	flight.record.requested = true;
+	flight.record.startNs = nowNs;
+}
+
+/*
+ * BeforeNavigate: Explorer is starting a navigation. It belongs to the pending request if
+ *                 there is a recent one, and is otherwise one which Explorer started itself.
+ */
+void NavigationTracer::BeforeNavigate(WindowKey window, unsigned long long nowNs)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	InFlight &flight = m_inFlight[window];
+	bool correlated = flight.phase == Phase::Requested && nowNs - flight.record.startNs <= kRequestTimeoutNs;
+	if (!correlated)
+	{
+		Abandon(flight);
+		flight.record.startNs = nowNs;
+		m_stats.uncorrelated++;
+	}
+
+	flight.phase = Phase::Navigating;
+	flight.record.beforeNavigateNs = nowNs;
+}
+
+void NavigationTracer::NavigateComplete(WindowKey window, unsigned long long nowNs)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_inFlight.find(window);
+	if (it == m_inFlight.end() || it->second.phase != Phase::Navigating)
+		return;
+
+	it->second.record.navigateCompleteNs = nowNs;
+}
+
+/*
+ * Finish: End the navigation in flight, if any, add it to its tab's timings and get its record.
+ */
+bool NavigationTracer::Finish(WindowKey window, unsigned long long nowNs, bool failed, Record &recordOut)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_inFlight.find(window);
+	if (it == m_inFlight.end() || it->second.phase != Phase::Navigating)
+		return false;
+
+	Record record = it->second.record;
+	record.failed = failed;
+	record.endNs = nowNs;
+	it->second = InFlight();
+	if (failed)
+		m_stats.failed++;
+	else
+		m_stats.completed++;
+
+	if (record.tabId != kNoTab)
+	{
+		TabTimings &timings = m_tabs[std::make_pair(window, record.tabId)];
+		if (failed)
+		{
+			timings.failed++;
+		}
+		else
+		{
+			timings.count++;
+			timings.totalNs += record.GetTotalNs();
+			timings.ownNs += record.ownNs;
+		}
+		timings.last = record;
+	}
+
+	recordOut = record;
+	return true;
+}
+
+bool NavigationTracer::DocumentComplete(WindowKey window, unsigned long long nowNs, Record &recordOut)
+{
+	return Finish(window, nowNs, false, recordOut);
+}
+
+/*
+ * NavigateError: Finish the navigation in flight as failed. Explorer doesn't follow a failed
+ *                navigation with DocumentComplete, so this is the only end it gets.
+ */
+bool NavigationTracer::NavigateError(WindowKey window, unsigned long long nowNs, Record &recordOut)
+{
+	return Finish(window, nowNs, true, recordOut);
+}
+
+/*
+ * AttributeToTab: Set the tab of a navigation which Explorer started, once the tab bar has
+ *                 worked out which tab it landed on. Requested navigations keep their tab.
+ */
+void NavigationTracer::AttributeToTab(WindowKey window, unsigned int tabId)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_inFlight.find(window);
+	if (it == m_inFlight.end() || it->second.phase == Phase::Idle || it->second.record.tabId != kNoTab)
+		return;
+
+	it->second.record.tabId = tabId;
+}
+
+/*
+ * AddOwnWork: Add time spent in our own code to the navigation in flight. Work done while no
+ *             navigation is in flight isn't part of one, and is ignored.
+ */
+void NavigationTracer::AddOwnWork(WindowKey window, unsigned long long durationNs)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_inFlight.find(window);
+	if (it == m_inFlight.end() || it->second.phase == Phase::Idle)
+		return;
+
+	it->second.record.ownNs += durationNs;
+}
+
+bool NavigationTracer::GetTabTimings(WindowKey window, unsigned int tabId, TabTimings &timingsOut) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_tabs.find(std::make_pair(window, tabId));
+	if (it == m_tabs.end())
+		return false;
+
+	timingsOut = it->second;
+	return true;
+}
+
+void NavigationTracer::ForgetTab(WindowKey window, unsigned int tabId)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_tabs.erase(std::make_pair(window, tabId));
+}
+
+void NavigationTracer::ForgetWindow(WindowKey window)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_inFlight.erase(window);
+
+	auto first = m_tabs.lower_bound(std::make_pair(window, 0u));
+	auto last = first;
+	while (last != m_tabs.end() && last->first.first == window)
+		++last;
+	m_tabs.erase(first, last);
+}
+
+NavigationTracer::Stats NavigationTracer::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#ifndef _NAVIGATION_TRACER_H
+#define _NAVIGATION_TRACER_H
+
+// This header is deliberately free of Windows dependencies; the caller supplies the clock and
+// identifies each Explorer window by an opaque key (its root window handle).
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+
+/*
+ * NavigationTracer: Correlates the events of a navigation in each Explorer window, from the
+ *                   tab bar asking for it (or BeforeNavigate2, if Explorer started it) through
+ *                   NavigateComplete2 to DocumentComplete (or NavigateError, if it fails), and
+ *                   keeps per-tab timings.
+ *
+ * Time spent in our own handlers while a navigation is in flight is reported with AddOwnWork,
+ * so that the total can be split into our share and the Shell's.
+ *
+ * Every window has at most one navigation in flight; a new request or an uncorrelated
+ * BeforeNavigate2 abandons the previous one. All methods may be called from any thread.
+ */
+class NavigationTracer
+{
+public:
+	using WindowKey = uintptr_t;
+
+	// Tab ids start at 1; 0 means the navigation hasn't been attributed to a tab.
+	static const unsigned int kNoTab = 0;
+
+	// A request which isn't followed by BeforeNavigate2 within this time is not correlated.
+	static const unsigned long long kRequestTimeoutNs = 5000000000ULL;
+
+	struct Record
+	{
+		unsigned int tabId = kNoTab;
+		bool requested = false;
+		bool failed = false;
+
+		unsigned long long startNs = 0;
+		unsigned long long beforeNavigateNs = 0;
+		unsigned long long navigateCompleteNs = 0;
+
+		// DocumentComplete, or NavigateError for a failed navigation.
+		unsigned long long endNs = 0;
+
+		unsigned long long ownNs = 0;
+
+		unsigned long long GetTotalNs() const { return endNs - startNs; }
+		unsigned long long GetShellNs() const
+		{
+			unsigned long long total = GetTotalNs();
+			return ownNs < total ? total - ownNs : 0;
+		}
+	};
+
+	// Totals are of completed navigations only; failed ones are just counted.
+	struct TabTimings
+	{
+		unsigned long long count = 0;
+		unsigned long long failed = 0;
+		unsigned long long totalNs = 0;
+		unsigned long long ownNs = 0;
+		Record last;
+	};
+
+	struct Stats
+	{
+		unsigned long long completed = 0;
+		unsigned long long failed = 0;
+		unsigned long long abandoned = 0;
+		unsigned long long uncorrelated = 0;
+	};
+
+	void Request(WindowKey window, unsigned int tabId, unsigned long long nowNs);
+	void BeforeNavigate(WindowKey window, unsigned long long nowNs);
+	void NavigateComplete(WindowKey window, unsigned long long nowNs);
+	bool DocumentComplete(WindowKey window, unsigned long long nowNs, Record &recordOut);
+	bool NavigateError(WindowKey window, unsigned long long nowNs, Record &recordOut);
+
+	void AttributeToTab(WindowKey window, unsigned int tabId);
+	void AddOwnWork(WindowKey window, unsigned long long durationNs);
+
+	bool GetTabTimings(WindowKey window, unsigned int tabId, TabTimings &timingsOut) const;
+	void ForgetTab(WindowKey window, unsigned int tabId);
+	void ForgetWindow(WindowKey window);
+
+	Stats GetStats() const;
+
+private:
+	enum class Phase
+	{
+		Idle,
+		Requested,
+		Navigating
+	};
+
+	struct InFlight
+	{
+		Phase phase = Phase::Idle;
+		Record record;
+	};
+
+	void Abandon(InFlight &flight);
+	bool Finish(WindowKey window, unsigned long long nowNs, bool failed, Record &recordOut);
+
+private:
+	mutable std::mutex m_mutex;
+	std::map<WindowKey, InFlight> m_inFlight;
+	std::map<std::pair<WindowKey, unsigned int>, TabTimings> m_tabs;
+	Stats m_stats;
+};
+
+#endif // _NAVIGATION_TRACER_H
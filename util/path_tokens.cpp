@@ -0,0 +1,30 @@
+/*
+ * path_tokens.cpp: Splits paths into components.
+ */
+
+#include "path_tokens.h"
+
+namespace PathTokens
+{
+
+void Tokenize(const wchar_t *path, size_t length, std::vector<Token> &tokensOut)
+{
+	size_t start = 0;
+	for (size_t i = 0; i <= length; ++i)
+	{
+		if (i < length && path[i] != L'\\')
+			continue;
+
+		if (i > start)
+		{
+			Token token;
+			token.offset = start;
+			token.length = i - start;
+			token.drive = path[i - 1] == L':';
+			tokensOut.push_back(token);
+		}
+		start = i + 1;
+	}
+}
+
+} // namespace PathTokens
@@ -0,0 +1,29 @@
+#pragma once
+#ifndef _PATH_TOKENS_H
+#define _PATH_TOKENS_H
+
+// This header is deliberately free of Windows dependencies.
+
+#include <cstddef>
+#include <vector>
+
+namespace PathTokens
+{
+	struct Token
+	{
+		size_t offset = 0;
+		size_t length = 0;
+
+		// The component ends with ':', as in "C:".
+		bool drive = false;
+	};
+
+	/*
+	 * Tokenize: Split a path at its backslashes, skipping empty components as wcstok does.
+	 *
+	 * Tokens refer to the caller's string, so nothing is copied.
+	 */
+	void Tokenize(const wchar_t *path, size_t length, std::vector<Token> &tokensOut);
+}
+
+#endif // _PATH_TOKENS_H
@@ -0,0 +1,88 @@
+/*
+ * rate_governor.cpp: Token bucket throttling for self-triggering work.
+ *
+ * See rate_governor.h for an overview.
+ */
+
+#include "rate_governor.h"
+
+RateGovernor::RateGovernor()
+	: RateGovernor(Config())
+{
+}
+
+RateGovernor::RateGovernor(const Config &config)
+	: m_config(config)
+	, m_capacity(static_cast<unsigned long long>(config.burst) * kScale)
+	, m_tokens(m_capacity)
+{
+	// A recovery level above the burst would never be reached.
+	if (m_config.recoveryLevel > m_config.burst)
+		m_config.recoveryLevel = m_config.burst;
+}
+
+/*
+ * Refill: Add the tokens regained since the last request. The first request starts the clock
+ *         with a full bucket. A clock which goes backwards adds nothing, and time is counted
+ *         from the new reading, so an engaged governor doesn't wait for the clock to catch up.
+ */
+void RateGovernor::Refill(unsigned long long nowMs)
+{
+	if (!m_started)
+	{
+		m_started = true;
+		m_lastRefillMs = nowMs;
+		return;
+	}
+
+	if (nowMs < m_lastRefillMs)
+	{
+		m_lastRefillMs = nowMs;
+		return;
+	}
+
+	if (nowMs == m_lastRefillMs || m_config.refillPerSecond == 0)
+		return;
+
+	unsigned long long elapsedMs = nowMs - m_lastRefillMs;
+	m_lastRefillMs = nowMs;
+
+	// A token per second is a thousandth of a token per millisecond. Compare before
+	// multiplying, so that a long idle spell can't overflow.
+	unsigned long long missing = m_capacity - m_tokens;
+	if (elapsedMs > missing / m_config.refillPerSecond)
+		m_tokens = m_capacity;
+	else
+		m_tokens += elapsedMs * m_config.refillPerSecond;
+}
+
+/*
+ * Request: Take a token for one run of the governed work, if the work may run now.
+ */
+RateGovernor::Decision RateGovernor::Request(unsigned long long nowMs)
+{
+	Refill(nowMs);
+
+	if (m_engaged)
+	{
+		if (m_tokens < static_cast<unsigned long long>(m_config.recoveryLevel) * kScale)
+		{
+			m_stats.denied++;
+			return Decision::Deny;
+		}
+
+		m_engaged = false;
+	}
+
+	if (m_tokens >= kScale)
+	{
+		m_tokens -= kScale;
+		m_stats.allowed++;
+		return Decision::Allow;
+	}
+
+	m_engaged = true;
+	m_stats.engagements++;
+	m_stats.denied++;
+	return Decision::Engage;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef _RATE_GOVERNOR_H
+#define _RATE_GOVERNOR_H
+
+// This header is deliberately free of Windows dependencies; the caller supplies the clock.
+
+/*
+ * RateGovernor: A token bucket which throttles work that can feed back into itself, such as
+ *               relayouts which cause the resizes that trigger them.
+ *
+ * Every request takes a token. A full bucket grants a burst of requests back to back, and
+ * tokens come back at a steady rate, so ordinary use never comes near running it dry. Once it
+ * does run dry the governor engages: requests are refused until the bucket has recovered to a
+ * given level, rather than granted one by one as each token trickles back. A runaway loop is
+ * thereby slowed to the refill rate in bursts, instead of freezing the thread or being cut off
+ * for good.
+ */
+class RateGovernor
+{
+public:
+	struct Config
+	{
+		// The number of requests a full bucket grants back to back.
+		unsigned int burst = 50;
+
+		// Tokens regained per second: the rate of requests which can go on forever.
+		unsigned int refillPerSecond = 20;
+
+		// Once engaged, requests are refused until the bucket holds this many tokens.
+		unsigned int recoveryLevel = 10;
+	};
+
+	enum class Decision
+	{
+		Allow,
+
+		// The request is refused, and is the one which engaged the governor.
+		Engage,
+
+		// The request is refused while the governor is engaged.
+		Deny
+	};
+
+	struct Stats
+	{
+		unsigned long long allowed = 0;
+		unsigned long long denied = 0;
+		unsigned long long engagements = 0;
+	};
+
+	RateGovernor();
+	explicit RateGovernor(const Config &config);
+
+	Decision Request(unsigned long long nowMs);
+
+	bool IsEngaged() const { return m_engaged; }
+	const Stats &GetStats() const { return m_stats; }
+
+private:
+	void Refill(unsigned long long nowMs);
+
+private:
+	static const unsigned long long kScale = 1000; // tokens are counted in thousandths
+
+	Config m_config;
+	unsigned long long m_capacity;
+	unsigned long long m_tokens;
+	unsigned long long m_lastRefillMs = 0;
+	bool m_started = false;
+	bool m_engaged = false;
+
+	Stats m_stats;
+};
+
+#endif // _RATE_GOVERNOR_H
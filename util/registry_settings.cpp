@@ -0,0 +1,246 @@
+/*
+ * registry_settings.cpp: Reads, writes and watches the settings in the registry.
+ */
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "registry_settings.h"
+#include "settings_schema.h"
+#include "trace.h"
+
+namespace CEUtil
+{
+
+#define CE_REGISTRY_PATH L"SOFTWARE\\kawapure\\ClassicExplorer"
+
+/*
+ * ToRawValue: Convert registry data of the given type to a RawSettingValue.
+ */
+static void ToRawValue(DWORD type, const BYTE *data, DWORD dataSize, RawSettingValue &valueOut)
+{
+	if (type == REG_DWORD && dataSize == sizeof(DWORD))
+	{
+		valueOut.kind = RawSettingValue::Kind::Dword;
+		memcpy(&valueOut.dword, data, sizeof(DWORD));
+	}
+	else if (type == REG_SZ)
+	{
+		// The stored string isn't necessarily NUL-terminated.
+		valueOut.kind = RawSettingValue::Kind::String;
+		valueOut.string.assign(reinterpret_cast<const wchar_t *>(data), dataSize / sizeof(wchar_t));
+		while (!valueOut.string.empty() && valueOut.string.back() == L'\0')
+			valueOut.string.pop_back();
+	}
+	else if (type == REG_BINARY)
+	{
+		valueOut.kind = RawSettingValue::Kind::Binary;
+		valueOut.binary.assign(data, data + dataSize);
+	}
+}
+
+/*
+ * RegistryKeyStore: Adapts an open registry key to SettingsKeyStore.
+ */
+class RegistryKeyStore : public SettingsKeyStore
+{
+public:
+	explicit RegistryKeyStore(HKEY hKey) : m_hKey(hKey) {}
+
+	/*
+	 * EnumerateValues: Read every value of the key with RegEnumValueW, using buffers sized
+	 *                  once from RegQueryInfoKeyW.
+	 */
+	bool EnumerateValues(std::vector<RawSettingValue> &valuesOut) override
+	{
+		DWORD valueCount = 0;
+		DWORD maxNameLength = 0;
+		DWORD maxDataSize = 0;
+		if (RegQueryInfoKeyW(m_hKey, NULL, NULL, NULL, NULL, NULL, NULL, &valueCount, &maxNameLength, &maxDataSize, NULL, NULL) != ERROR_SUCCESS)
+			return false;
+
+		std::vector<wchar_t> name(maxNameLength + 1);
+		std::vector<BYTE> data(maxDataSize + sizeof(wchar_t));
+		valuesOut.reserve(valueCount);
+
+		for (DWORD index = 0;; ++index)
+		{
+			DWORD nameLength = static_cast<DWORD>(name.size());
+			DWORD dataSize = static_cast<DWORD>(data.size());
+			DWORD type = REG_NONE;
+			LSTATUS ls = RegEnumValueW(m_hKey, index, name.data(), &nameLength, NULL, &type, data.data(), &dataSize);
+			if (ls == ERROR_NO_MORE_ITEMS)
+				break;
+			if (ls != ERROR_SUCCESS) // e.g. a value was added while enumerating; skip it
+				continue;
+
+			RawSettingValue value;
+			value.name.assign(name.data(), nameLength);
+			ToRawValue(type, data.data(), dataSize, value);
+			valuesOut.push_back(value);
+		}
+
+		return true;
+	}
+
+	/*
+	 * GetValue: Read one value, with a single call for anything which fits in a small buffer
+	 *           (such as the settings blob).
+	 */
+	bool GetValue(const wchar_t *name, RawSettingValue &valueOut) override
+	{
+		BYTE buffer[256];
+		std::vector<BYTE> large;
+		BYTE *data = buffer;
+		DWORD dataSize = sizeof(buffer);
+		DWORD type = REG_NONE;
+
+		LSTATUS ls = RegQueryValueExW(m_hKey, name, NULL, &type, data, &dataSize);
+		if (ls == ERROR_MORE_DATA)
+		{
+			large.resize(dataSize);
+			data = large.data();
+			ls = RegQueryValueExW(m_hKey, name, NULL, &type, data, &dataSize);
+		}
+		if (ls != ERROR_SUCCESS)
+			return false;
+
+		valueOut.name = name;
+		ToRawValue(type, data, dataSize, valueOut);
+		return true;
+	}
+
+	bool SetValue(const RawSettingValue &value) override
+	{
+		if (value.kind == RawSettingValue::Kind::Dword)
+		{
+			DWORD dwValue = value.dword;
+			return RegSetValueExW(m_hKey, value.name.c_str(), 0, REG_DWORD, (const BYTE *)&dwValue, sizeof(DWORD)) == ERROR_SUCCESS;
+		}
+		if (value.kind == RawSettingValue::Kind::String)
+		{
+			// Include the terminating NUL in the stored size.
+			DWORD size = static_cast<DWORD>((value.string.length() + 1) * sizeof(wchar_t));
+			return RegSetValueExW(m_hKey, value.name.c_str(), 0, REG_SZ, (const BYTE *)value.string.c_str(), size) == ERROR_SUCCESS;
+		}
+		if (value.kind == RawSettingValue::Kind::Binary)
+		{
+			// A single value write is atomic, so readers never see half of an update.
+			DWORD size = static_cast<DWORD>(value.binary.size());
+			return RegSetValueExW(m_hKey, value.name.c_str(), 0, REG_BINARY, value.binary.data(), size) == ERROR_SUCCESS;
+		}
+		return false;
+	}
+
+private:
+	HKEY m_hKey;
+};
+
+RegistrySettingsBackend::~RegistrySettingsBackend()
+{
+	StopWatching();
+}
+
+CESettings RegistrySettingsBackend::Load()
+{
+	HKEY hKey;
+	if (RegCreateKeyExW(HKEY_CURRENT_USER, CE_REGISTRY_PATH, 0, NULL, 0, KEY_QUERY_VALUE | KEY_SET_VALUE, NULL, &hKey, NULL) != ERROR_SUCCESS)
+		return GetDefaultSettings();
+
+	RegistryKeyStore store(hKey);
+	CESettings settings = LoadSettingsFromStore(store);
+	RegCloseKey(hKey);
+	return settings;
+}
+
+bool RegistrySettingsBackend::Write(const CESettings &toWrite)
+{
+	HKEY hKey;
+	LSTATUS status = RegCreateKeyExW(HKEY_CURRENT_USER, CE_REGISTRY_PATH, 0, NULL, 0, KEY_QUERY_VALUE | KEY_SET_VALUE, NULL, &hKey, NULL);
+	if (status != ERROR_SUCCESS)
+	{
+		CE_TRACE_VALUE("Settings.RegistryOpenFailed", status);
+		return false;
+	}
+
+	RegistryKeyStore store(hKey);
+	bool written = WriteSettingsToStore(store, toWrite);
+	RegCloseKey(hKey);
+	return written;
+}
+
+/*
+ * ArmNotification: Ask for the watch event to be signalled on the next change. The request is
+ *                  one-shot, so this is repeated every time it fires. It is thread-agnostic,
+ *                  as thread pool threads come and go.
+ */
+bool RegistrySettingsBackend::ArmNotification()
+{
+	return RegNotifyChangeKeyValue(
+		m_watchKey,
+		FALSE,
+		REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_THREAD_AGNOSTIC,
+		m_watchEvent,
+		TRUE) == ERROR_SUCCESS;
+}
+
+void CALLBACK RegistrySettingsBackend::OnKeyChanged(PVOID context, BOOLEAN timedOut)
+{
+	UNREFERENCED_PARAMETER(timedOut);
+
+	RegistrySettingsBackend *self = static_cast<RegistrySettingsBackend *>(context);
+
+	// Re-arm first, so a change made while the callback runs isn't missed.
+	self->ArmNotification();
+	if (self->m_onChange)
+		self->m_onChange();
+}
+
+bool RegistrySettingsBackend::Watch(std::function<void()> onChange)
+{
+	StopWatching();
+
+	if (RegCreateKeyExW(HKEY_CURRENT_USER, CE_REGISTRY_PATH, 0, NULL, 0, KEY_NOTIFY, NULL, &m_watchKey, NULL) != ERROR_SUCCESS)
+	{
+		m_watchKey = NULL;
+		return false;
+	}
+
+	m_onChange = std::move(onChange);
+	m_watchEvent = CreateEventW(NULL, FALSE, FALSE, NULL);
+	if (!m_watchEvent || !ArmNotification() ||
+		!RegisterWaitForSingleObject(&m_watchWait, m_watchEvent, OnKeyChanged, this, INFINITE, WT_EXECUTEDEFAULT))
+	{
+		m_watchWait = NULL;
+		StopWatching();
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * StopWatching: Blocks until a running callback has finished, so this must not be called from
+ *               the callback itself or under the loader lock.
+ */
+void RegistrySettingsBackend::StopWatching()
+{
+	if (m_watchWait)
+	{
+		UnregisterWaitEx(m_watchWait, INVALID_HANDLE_VALUE);
+		m_watchWait = NULL;
+	}
+	if (m_watchKey)
+	{
+		RegCloseKey(m_watchKey);
+		m_watchKey = NULL;
+	}
+	if (m_watchEvent)
+	{
+		CloseHandle(m_watchEvent);
+		m_watchEvent = NULL;
+	}
+	m_onChange = nullptr;
+}
+
+} // namespace CEUtil
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef _REGISTRY_SETTINGS_H
+#define _REGISTRY_SETTINGS_H
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "settings_cache.h"
+
+namespace CEUtil
+{
+	/*
+	 * RegistrySettingsBackend: Stores the settings as values under
+	 *                          HKCU\SOFTWARE\kawapure\ClassicExplorer.
+	 *
+	 * Changes are watched with RegNotifyChangeKeyValue on a thread pool wait, so edits made by
+	 * other Explorer processes (or by hand) are picked up without polling.
+	 */
+	class RegistrySettingsBackend : public SettingsBackend
+	{
+	public:
+		RegistrySettingsBackend() = default;
+		~RegistrySettingsBackend();
+
+		CESettings Load() override;
+		bool Write(const CESettings &toWrite) override;
+		bool Watch(std::function<void()> onChange) override;
+		void StopWatching() override;
+
+	private:
+		static void CALLBACK OnKeyChanged(PVOID context, BOOLEAN timedOut);
+		bool ArmNotification();
+
+		HKEY m_watchKey = NULL;
+		HANDLE m_watchEvent = NULL;
+		HANDLE m_watchWait = NULL;
+		std::function<void()> m_onChange;
+	};
+}
+
+#endif // _REGISTRY_SETTINGS_H
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef _RESAMPLE_H
+#define _RESAMPLE_H
+
+// This header is deliberately free of Windows dependencies.
+
+#include "image_decode.h"
+
+namespace Resample
+{
+	enum class Filter
+	{
+		// Averages the source pixels under each destination pixel. Cheap, and exact for
+		// integer downscales.
+		Box,
+
+		// Windowed sinc with three lobes: sharp, with little ringing. Used for DPI scaling.
+		Lanczos3
+	};
+
+	// The instruction sets the filter can run with, slowest first.
+	enum class Path
+	{
+		Scalar,
+		Sse2,
+		Avx2
+	};
+
+	/*
+	 * ResampleImage: Scale an image to the given size with a separable filter, weighting the
+	 *                colour by alpha so that transparent pixels contribute none.
+	 *
+	 * Uses the fastest path the CPU supports; every path gives the same result to within one
+	 * level per channel.
+	 */
+	bool ResampleImage(const DecodedImage &source, int width, int height, Filter filter, DecodedImage &imageOut);
+	bool ResampleImage(const DecodedImage &source, int width, int height, Filter filter, Path path, DecodedImage &imageOut);
+
+	Path GetBestPath();
+}
+
+#endif // _RESAMPLE_H
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef _SETTINGS_H
+#define _SETTINGS_H
+
+// This header is deliberately free of Windows dependencies, so that the settings cache and
+// its backends can be built and exercised anywhere.
+
+enum ClassicExplorerTheme
+{
+	CLASSIC_EXPLORER_NONE = -1,
+	CLASSIC_EXPLORER_2K = 0,
+	CLASSIC_EXPLORER_XP = 1,
+	CLASSIC_EXPLORER_10 = 2,
+	CLASSIC_EXPLORER_MEMPHIS = 3
+};
+
+namespace CEUtil
+{
+	/*
+	 * CESettings: The user's settings. When writing, a value of -1 (or CLASSIC_EXPLORER_NONE)
+	 *             leaves the stored value alone.
+	 */
+	struct CESettings
+	{
+		ClassicExplorerTheme theme = CLASSIC_EXPLORER_NONE;
+		long showGoButton = -1;
+		long showAddressLabel = -1;
+		long showFullAddress = -1;
+		long tabAutoSize = -1;
+		long tabFixedWidth = -1;
+		long tabFixedHeight = -1;
+
+		CESettings() = default;
+
+		CESettings(
+			ClassicExplorerTheme t,
+			long showGo,
+			long showLabel,
+			long showFull,
+			long autoSize = -1,
+			long fixedWidth = -1,
+			long fixedHeight = -1)
+		{
+			theme = t;
+			showGoButton = showGo;
+			showAddressLabel = showLabel;
+			showFullAddress = showFull;
+			tabAutoSize = autoSize;
+			tabFixedWidth = fixedWidth;
+			tabFixedHeight = fixedHeight;
+		}
+
+		bool operator==(const CESettings &other) const
+		{
+			return theme == other.theme &&
+				showGoButton == other.showGoButton &&
+				showAddressLabel == other.showAddressLabel &&
+				showFullAddress == other.showFullAddress &&
+				tabAutoSize == other.tabAutoSize &&
+				tabFixedWidth == other.tabFixedWidth &&
+				tabFixedHeight == other.tabFixedHeight;
+		}
+
+		bool operator!=(const CESettings &other) const
+		{
+			return !(*this == other);
+		}
+	};
+}
+
+#endif // _SETTINGS_H
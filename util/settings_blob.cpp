@@ -0,0 +1,101 @@
+/*
+ * settings_blob.cpp: Packs the settings into a versioned, checksummed blob and back.
+ */
+
+#include "settings_blob.h"
+#include "settings_schema.h"
+
+namespace CEUtil
+{
+
+static const size_t kHeaderSize = 8;
+static const size_t kChecksumSize = 4;
+
+static void PutUInt16(std::vector<unsigned char> &out, uint16_t value)
+{
+	out.push_back(static_cast<unsigned char>(value));
+	out.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+static void PutUInt32(std::vector<unsigned char> &out, uint32_t value)
+{
+	for (int shift = 0; shift < 32; shift += 8)
+		out.push_back(static_cast<unsigned char>(value >> shift));
+}
+
+static uint16_t GetUInt16(const unsigned char *data)
+{
+	return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+static uint32_t GetUInt32(const unsigned char *data)
+{
+	return static_cast<uint32_t>(data[0]) |
+		(static_cast<uint32_t>(data[1]) << 8) |
+		(static_cast<uint32_t>(data[2]) << 16) |
+		(static_cast<uint32_t>(data[3]) << 24);
+}
+
+/*
+ * Crc32: The usual reflected CRC-32 (polynomial 0xEDB88320). Settings blobs are tiny, so a
+ *        table isn't worth it.
+ */
+uint32_t Crc32(const unsigned char *data, size_t size)
+{
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; ++bit)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+	return ~crc;
+}
+
+std::vector<unsigned char> SerializeSettingsBlob(const CESettings &settings)
+{
+	std::vector<unsigned char> out;
+	out.reserve(kHeaderSize + kSettingsSchemaSize * 4 + kChecksumSize);
+
+	PutUInt32(out, kSettingsBlobMagic);
+	PutUInt16(out, kSettingsBlobVersion);
+	PutUInt16(out, static_cast<uint16_t>(kSettingsSchemaSize));
+
+	for (const SettingField &field : kSettingsSchema)
+		PutUInt32(out, static_cast<uint32_t>(static_cast<int32_t>(GetSettingField(settings, field))));
+
+	PutUInt32(out, Crc32(out.data(), out.size()));
+	return out;
+}
+
+bool ParseSettingsBlob(const unsigned char *data, size_t size, CESettings &settingsOut)
+{
+	if (!data || size < kHeaderSize + kChecksumSize)
+		return false;
+
+	if (GetUInt32(data) != kSettingsBlobMagic || GetUInt16(data + 4) != kSettingsBlobVersion)
+		return false;
+
+	size_t fieldCount = GetUInt16(data + 6);
+	if (size != kHeaderSize + fieldCount * 4 + kChecksumSize)
+		return false;
+
+	size_t payloadSize = size - kChecksumSize;
+	if (Crc32(data, payloadSize) != GetUInt32(data + payloadSize))
+		return false;
+
+	CESettings settings = GetDefaultSettings();
+	for (size_t i = 0; i < kSettingsSchemaSize && i < fieldCount; ++i)
+	{
+		const SettingField &field = kSettingsSchema[i];
+		long value = static_cast<int32_t>(GetUInt32(data + kHeaderSize + i * 4));
+		if (!IsValidSettingValue(field, value))
+			return false;
+		SetSettingField(settings, field, value);
+	}
+
+	settingsOut = settings;
+	return true;
+}
+
+} // namespace CEUtil
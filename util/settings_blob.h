@@ -0,0 +1,40 @@
+#pragma once
+#ifndef _SETTINGS_BLOB_H
+#define _SETTINGS_BLOB_H
+
+// This header is deliberately free of Windows dependencies.
+
+#include "settings.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace CEUtil
+{
+	/*
+	 * The settings blob packs every setting into one value, so it can be read with one call and
+	 * replaced atomically. All integers are little-endian:
+	 *
+	 *   uint32 magic ('CESB')
+	 *   uint16 version (kSettingsBlobVersion)
+	 *   uint16 field count (n)
+	 *   int32  value[n], in kSettingsSchema order
+	 *   uint32 CRC-32 of everything before it
+	 *
+	 * A blob with fewer fields than the schema (written by an older version) gets defaults for
+	 * the rest; extra fields (written by a newer version) are ignored.
+	 */
+	const uint32_t kSettingsBlobMagic = 0x42534543; // "CESB"
+	const uint16_t kSettingsBlobVersion = 1;
+
+	std::vector<unsigned char> SerializeSettingsBlob(const CESettings &settings);
+
+	// Returns false, leaving settingsOut alone, if the blob is truncated, corrupted, of an
+	// unknown version, or holds an out-of-range value.
+	bool ParseSettingsBlob(const unsigned char *data, size_t size, CESettings &settingsOut);
+
+	uint32_t Crc32(const unsigned char *data, size_t size);
+}
+
+#endif // _SETTINGS_BLOB_H
@@ -0,0 +1,205 @@
+/*
+ * settings_cache.cpp: Implements the settings snapshot cache and the in-memory backend.
+ */
+
+#include "settings_cache.h"
+#include "settings_schema.h"
+
+namespace CEUtil
+{
+
+void MergeSettings(CESettings &target, const CESettings &update)
+{
+	for (const SettingField &field : kSettingsSchema)
+	{
+		long value = GetSettingField(update, field);
+		if (value != -1)
+			SetSettingField(target, field, value);
+	}
+}
+
+//================================================================================================================
+// MemorySettingsBackend:
+//
+
+MemorySettingsBackend::MemorySettingsBackend(const CESettings &initial)
+	: m_stored(initial)
+{
+}
+
+CESettings MemorySettingsBackend::Load()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_loadCount++;
+	return m_stored;
+}
+
+bool MemorySettingsBackend::Write(const CESettings &toWrite)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	MergeSettings(m_stored, toWrite);
+	return true;
+}
+
+bool MemorySettingsBackend::Watch(std::function<void()> onChange)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_onChange = std::move(onChange);
+	return true;
+}
+
+void MemorySettingsBackend::StopWatching()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_onChange = nullptr;
+}
+
+void MemorySettingsBackend::SetStored(const CESettings &settings)
+{
+	std::function<void()> onChange;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stored = settings;
+		onChange = m_onChange;
+	}
+
+	if (onChange)
+		onChange();
+}
+
+unsigned long long MemorySettingsBackend::GetLoadCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_loadCount;
+}
+
+//================================================================================================================
+// SettingsCache:
+//
+
+SettingsCache::SettingsCache(std::unique_ptr<SettingsBackend> backend)
+	: m_backend(std::move(backend)), m_subscriptions(std::make_shared<const std::vector<Subscription>>())
+{
+}
+
+SettingsCache::~SettingsCache()
+{
+	Shutdown();
+}
+
+std::shared_ptr<const CESettings> SettingsCache::Get()
+{
+	std::shared_ptr<const CESettings> snapshot = std::atomic_load(&m_snapshot);
+	if (snapshot)
+		return snapshot;
+
+	std::lock_guard<std::mutex> lock(m_loadMutex);
+	snapshot = std::atomic_load(&m_snapshot);
+	if (snapshot)
+		return snapshot;
+
+	// Watch before loading, so a change landing during the load is reloaded afterwards.
+	if (!m_watching)
+	{
+		m_watching = m_backend->Watch([this]() { Refresh(); });
+	}
+
+	snapshot = std::make_shared<const CESettings>(m_backend->Load());
+	std::atomic_store(&m_snapshot, snapshot);
+	return snapshot;
+}
+
+/*
+ * Write: Write through to the backend and publish the result. Returns false, leaving the
+ *        snapshot alone, if the backend couldn't store the settings.
+ */
+bool SettingsCache::Write(const CESettings &toWrite)
+{
+	if (!m_backend->Write(toWrite))
+		return false;
+
+	Refresh();
+	return true;
+}
+
+/*
+ * Refresh: Reload the settings from the backend, publish them, and tell the subscribers if
+ *          they changed. Does nothing if nothing has been loaded yet.
+ */
+void SettingsCache::Refresh()
+{
+	std::shared_ptr<const CESettings> current;
+	{
+		std::lock_guard<std::mutex> lock(m_loadMutex);
+		std::shared_ptr<const CESettings> previous = std::atomic_load(&m_snapshot);
+		if (!previous)
+			return;
+
+		current = std::make_shared<const CESettings>(m_backend->Load());
+		if (*current == *previous)
+			return;
+
+		std::atomic_store(&m_snapshot, current);
+	}
+
+	Notify(current);
+}
+
+SettingsCache::SubscriptionId SettingsCache::Subscribe(Listener listener)
+{
+	std::lock_guard<std::mutex> lock(m_subscriptionMutex);
+
+	auto subscriptions = std::make_shared<std::vector<Subscription>>(*m_subscriptions);
+	SubscriptionId id = m_nextSubscriptionId++;
+	subscriptions->push_back(Subscription{ id, std::move(listener) });
+	m_subscriptions = subscriptions;
+	return id;
+}
+
+void SettingsCache::Unsubscribe(SubscriptionId id)
+{
+	std::lock_guard<std::mutex> lock(m_subscriptionMutex);
+
+	auto subscriptions = std::make_shared<std::vector<Subscription>>();
+	subscriptions->reserve(m_subscriptions->size());
+	for (const Subscription &subscription : *m_subscriptions)
+	{
+		if (subscription.id != id)
+			subscriptions->push_back(subscription);
+	}
+	m_subscriptions = subscriptions;
+}
+
+void SettingsCache::Notify(const std::shared_ptr<const CESettings> &current)
+{
+	std::shared_ptr<const std::vector<Subscription>> subscriptions;
+	{
+		std::lock_guard<std::mutex> lock(m_subscriptionMutex);
+		subscriptions = m_subscriptions;
+	}
+
+	for (const Subscription &subscription : *subscriptions)
+		subscription.listener(current);
+}
+
+/*
+ * Shutdown: The backend may wait for a running watch callback, which itself takes the load
+ *           lock in Refresh, so the lock isn't held while it stops.
+ */
+void SettingsCache::Shutdown()
+{
+	bool watching;
+	{
+		std::lock_guard<std::mutex> lock(m_loadMutex);
+		watching = m_watching;
+		m_watching = false;
+	}
+
+	if (watching)
+		m_backend->StopWatching();
+
+	std::lock_guard<std::mutex> lock(m_loadMutex);
+	std::atomic_store(&m_snapshot, std::shared_ptr<const CESettings>());
+}
+
+} // namespace CEUtil
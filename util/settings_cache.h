@@ -0,0 +1,124 @@
+#pragma once
+#ifndef _SETTINGS_CACHE_H
+#define _SETTINGS_CACHE_H
+
+// This header is deliberately free of Windows dependencies; the registry backend lives in
+// registry_settings.h.
+
+#include "settings.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace CEUtil
+{
+	/*
+	 * SettingsBackend: Where the settings are stored.
+	 */
+	class SettingsBackend
+	{
+	public:
+		virtual ~SettingsBackend() = default;
+
+		// Read every setting, creating the store with the defaults if it doesn't exist.
+		virtual CESettings Load() = 0;
+
+		// Write the settings which aren't -1 (see CESettings). Returns false if they couldn't be
+		// stored, in which case the store is unchanged.
+		virtual bool Write(const CESettings &toWrite) = 0;
+
+		// Start calling onChange, from any thread, whenever the stored settings may have
+		// changed. Returns false if the backend can't watch for changes.
+		virtual bool Watch(std::function<void()> onChange) = 0;
+
+		// Stop calling the watch callback. Once this returns, it is not running and won't run.
+		virtual void StopWatching() = 0;
+	};
+
+	/*
+	 * MemorySettingsBackend: Keeps the settings in memory. Changes made with SetStored stand in
+	 *                        for another process editing the store.
+	 */
+	class MemorySettingsBackend : public SettingsBackend
+	{
+	public:
+		explicit MemorySettingsBackend(const CESettings &initial);
+
+		CESettings Load() override;
+		bool Write(const CESettings &toWrite) override;
+		bool Watch(std::function<void()> onChange) override;
+		void StopWatching() override;
+
+		void SetStored(const CESettings &settings);
+		unsigned long long GetLoadCount() const;
+
+	private:
+		mutable std::mutex m_mutex;
+		CESettings m_stored;
+		std::function<void()> m_onChange;
+		unsigned long long m_loadCount = 0;
+	};
+
+	// Copy the values of update which aren't -1 over target.
+	void MergeSettings(CESettings &target, const CESettings &update);
+
+	/*
+	 * SettingsCache: Publishes an immutable snapshot of the settings.
+	 *
+	 * The backend is read once, on first use, and again only after the backend reports a
+	 * change or the settings are written through the cache. Readers on any thread get the
+	 * current snapshot with an atomic load and never touch the backend otherwise.
+	 *
+	 * Subscribers are told about every reload which changes the settings. They are called on
+	 * the thread which caused the reload, with no lock held, so a callback may still be
+	 * running when Unsubscribe returns; callbacks should only hand off (e.g. post a message).
+	 */
+	class SettingsCache
+	{
+	public:
+		using Listener = std::function<void(const std::shared_ptr<const CESettings> &current)>;
+		using SubscriptionId = unsigned long long;
+
+		explicit SettingsCache(std::unique_ptr<SettingsBackend> backend);
+		~SettingsCache();
+
+		SettingsCache(const SettingsCache &) = delete;
+		SettingsCache &operator=(const SettingsCache &) = delete;
+
+		std::shared_ptr<const CESettings> Get();
+		bool Write(const CESettings &toWrite);
+		void Refresh();
+
+		SubscriptionId Subscribe(Listener listener);
+		void Unsubscribe(SubscriptionId id);
+
+		// Stop watching and drop the snapshot. The next Get loads and watches again.
+		void Shutdown();
+
+	private:
+		struct Subscription
+		{
+			SubscriptionId id;
+			Listener listener;
+		};
+
+		void Notify(const std::shared_ptr<const CESettings> &current);
+
+	private:
+		std::unique_ptr<SettingsBackend> m_backend;
+
+		std::mutex m_loadMutex;
+		std::shared_ptr<const CESettings> m_snapshot;
+		bool m_watching = false;
+
+		// Copy-on-write, so Notify can walk a stable list without holding the lock.
+		std::mutex m_subscriptionMutex;
+		std::shared_ptr<const std::vector<Subscription>> m_subscriptions;
+		SubscriptionId m_nextSubscriptionId = 1;
+	};
+}
+
+#endif // _SETTINGS_CACHE_H
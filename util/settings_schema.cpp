@@ -0,0 +1,203 @@
+/*
+ * settings_schema.cpp: Reads, validates and writes settings as described by kSettingsSchema.
+ */
+
+#include "settings_schema.h"
+#include "settings_blob.h"
+#include "settings_cache.h"
+
+#include <cwchar>
+#include <cwctype>
+
+namespace CEUtil
+{
+
+static const struct
+{
+	ClassicExplorerTheme theme;
+	const wchar_t *name;
+} kThemeNames[] = {
+	{ CLASSIC_EXPLORER_2K, L"2K" },
+	{ CLASSIC_EXPLORER_XP, L"XP" },
+	{ CLASSIC_EXPLORER_10, L"10" },
+	{ CLASSIC_EXPLORER_MEMPHIS, L"98" },
+};
+
+static bool ParseTheme(const std::wstring &name, ClassicExplorerTheme &themeOut)
+{
+	for (const auto &entry : kThemeNames)
+	{
+		if (name == entry.name)
+		{
+			themeOut = entry.theme;
+			return true;
+		}
+	}
+	return false;
+}
+
+const wchar_t *GetThemeName(ClassicExplorerTheme theme)
+{
+	for (const auto &entry : kThemeNames)
+	{
+		if (entry.theme == theme)
+			return entry.name;
+	}
+	return nullptr;
+}
+
+/*
+ * FindSettingField: Look up a field by name. Names are case-insensitive, as in the registry.
+ */
+const SettingField *FindSettingField(const std::wstring &name)
+{
+	for (const SettingField &field : kSettingsSchema)
+	{
+		if (name.size() != wcslen(field.name))
+			continue;
+
+		bool sameName = true;
+		for (size_t c = 0; c < name.size() && sameName; ++c)
+			sameName = towlower(name[c]) == towlower(field.name[c]);
+		if (sameName)
+			return &field;
+	}
+	return nullptr;
+}
+
+long GetSettingField(const CESettings &settings, const SettingField &field)
+{
+	if (field.type == SettingType::Theme)
+		return settings.theme;
+	return settings.*field.member;
+}
+
+void SetSettingField(CESettings &settings, const SettingField &field, long value)
+{
+	if (field.type == SettingType::Theme)
+		settings.theme = static_cast<ClassicExplorerTheme>(value);
+	else
+		settings.*field.member = value;
+}
+
+/*
+ * ParseField: Validate a stored value against its field. Returns false if it can't be used.
+ */
+static bool ParseField(const SettingField &field, const RawSettingValue &value, long &valueOut)
+{
+	switch (field.type)
+	{
+	case SettingType::Bool:
+		if (value.kind != RawSettingValue::Kind::Dword)
+			return false;
+		valueOut = value.dword != 0 ? 1 : 0;
+		return true;
+
+	case SettingType::Dword:
+		if (value.kind != RawSettingValue::Kind::Dword)
+			return false;
+		if (value.dword < static_cast<uint32_t>(field.minValue) || value.dword > static_cast<uint32_t>(field.maxValue))
+			return false;
+		valueOut = static_cast<long>(value.dword);
+		return true;
+
+	case SettingType::Theme:
+	{
+		ClassicExplorerTheme theme;
+		if (value.kind != RawSettingValue::Kind::String || !ParseTheme(value.string, theme))
+			return false;
+		valueOut = theme;
+		return true;
+	}
+	}
+
+	return false;
+}
+
+bool IsValidSettingValue(const SettingField &field, long value)
+{
+	return value >= field.minValue && value <= field.maxValue;
+}
+
+CESettings GetDefaultSettings()
+{
+	CESettings settings;
+	for (const SettingField &field : kSettingsSchema)
+		SetSettingField(settings, field, field.defaultValue);
+	return settings;
+}
+
+CESettings ParseSettings(const std::vector<RawSettingValue> &values, std::vector<const SettingField *> *invalidOut)
+{
+	CESettings settings = GetDefaultSettings();
+	bool valid[kSettingsSchemaSize] = {};
+
+	for (const RawSettingValue &value : values)
+	{
+		const SettingField *field = FindSettingField(value.name);
+		if (!field)
+			continue;
+
+		long parsed;
+		if (ParseField(*field, value, parsed))
+		{
+			SetSettingField(settings, *field, parsed);
+			valid[field - kSettingsSchema] = true;
+		}
+	}
+
+	if (invalidOut)
+	{
+		for (size_t i = 0; i < kSettingsSchemaSize; ++i)
+		{
+			if (!valid[i])
+				invalidOut->push_back(&kSettingsSchema[i]);
+		}
+	}
+
+	return settings;
+}
+
+static bool WriteSettingsBlob(SettingsKeyStore &store, const CESettings &settings)
+{
+	RawSettingValue value;
+	value.name = kSettingsBlobValueName;
+	value.kind = RawSettingValue::Kind::Binary;
+	value.binary = SerializeSettingsBlob(settings);
+	return store.SetValue(value);
+}
+
+static bool ReadSettingsBlob(SettingsKeyStore &store, CESettings &settingsOut)
+{
+	RawSettingValue value;
+	if (!store.GetValue(kSettingsBlobValueName, value) || value.kind != RawSettingValue::Kind::Binary)
+		return false;
+
+	return ParseSettingsBlob(value.binary.data(), value.binary.size(), settingsOut);
+}
+
+CESettings LoadSettingsFromStore(SettingsKeyStore &store)
+{
+	CESettings settings;
+	if (ReadSettingsBlob(store, settings))
+		return settings;
+
+	// No blob yet (or it is damaged): fall back to the separate values, which are left in place
+	// for older versions, and migrate them.
+	std::vector<RawSettingValue> values;
+	if (!store.EnumerateValues(values))
+		return GetDefaultSettings();
+
+	settings = ParseSettings(values);
+	WriteSettingsBlob(store, settings);
+	return settings;
+}
+
+bool WriteSettingsToStore(SettingsKeyStore &store, const CESettings &toWrite)
+{
+	CESettings settings = LoadSettingsFromStore(store);
+	MergeSettings(settings, toWrite);
+	return WriteSettingsBlob(store, settings);
+}
+
+} // namespace CEUtil
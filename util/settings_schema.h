@@ -0,0 +1,122 @@
+#pragma once
+#ifndef _SETTINGS_SCHEMA_H
+#define _SETTINGS_SCHEMA_H
+
+// This header is deliberately free of Windows dependencies; backends adapt their storage to
+// SettingsKeyStore.
+
+#include "settings.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace CEUtil
+{
+	enum class SettingType
+	{
+		Bool,   // DWORD; any non-zero value is true
+		Dword,  // DWORD within [minValue, maxValue]
+		Theme   // string naming a ClassicExplorerTheme
+	};
+
+	/*
+	 * SettingField: One stored setting. The theme is the one field which isn't a long, so it
+	 *               has no member pointer and is handled by type.
+	 */
+	struct SettingField
+	{
+		const wchar_t *name;
+		SettingType type;
+		long defaultValue;
+		long minValue;
+		long maxValue;
+		long CESettings::*member;
+	};
+
+	/*
+	 * kSettingsSchema: Every stored setting. Adding a setting is one line here (plus its
+	 *                  member in CESettings).
+	 *
+	 * The settings blob stores the fields in this order, so new settings must be appended.
+	 * The table is inline so every translation unit shares it, and field pointers compare equal
+	 * wherever they come from.
+	 */
+	inline constexpr SettingField kSettingsSchema[] = {
+		{ L"Theme",            SettingType::Theme, CLASSIC_EXPLORER_2K, CLASSIC_EXPLORER_2K, CLASSIC_EXPLORER_MEMPHIS, nullptr },
+		{ L"ShowGoButton",     SettingType::Bool,  1,   0,  1,    &CESettings::showGoButton },
+		{ L"ShowAddressLabel", SettingType::Bool,  1,   0,  1,    &CESettings::showAddressLabel },
+		{ L"ShowFullAddress",  SettingType::Bool,  1,   0,  1,    &CESettings::showFullAddress },
+		{ L"TabAutoSize",      SettingType::Bool,  1,   0,  1,    &CESettings::tabAutoSize },
+		{ L"TabFixedWidth",    SettingType::Dword, 180, 60, 1000, &CESettings::tabFixedWidth },
+		{ L"TabFixedHeight",   SettingType::Dword, 32,  16, 128,  &CESettings::tabFixedHeight },
+	};
+
+	constexpr size_t kSettingsSchemaSize = sizeof(kSettingsSchema) / sizeof(kSettingsSchema[0]);
+
+	/*
+	 * RawSettingValue: A value as stored, before validation.
+	 */
+	struct RawSettingValue
+	{
+		enum class Kind
+		{
+			Dword,
+			String,
+			Binary,
+			Other
+		};
+
+		std::wstring name;
+		Kind kind = Kind::Other;
+		uint32_t dword = 0;
+		std::wstring string;
+		std::vector<unsigned char> binary;
+	};
+
+	/*
+	 * SettingsKeyStore: A flat store of named values, such as a registry key.
+	 */
+	class SettingsKeyStore
+	{
+	public:
+		virtual ~SettingsKeyStore() = default;
+
+		// Get every value in the store in one pass. Returns false if the store can't be read.
+		virtual bool EnumerateValues(std::vector<RawSettingValue> &valuesOut) = 0;
+
+		// Get a single value. Returns false if it doesn't exist.
+		virtual bool GetValue(const wchar_t *name, RawSettingValue &valueOut) = 0;
+
+		virtual bool SetValue(const RawSettingValue &value) = 0;
+	};
+
+	const SettingField *FindSettingField(const std::wstring &name);
+	const wchar_t *GetThemeName(ClassicExplorerTheme theme);
+
+	long GetSettingField(const CESettings &settings, const SettingField &field);
+	void SetSettingField(CESettings &settings, const SettingField &field, long value);
+
+	CESettings GetDefaultSettings();
+	bool IsValidSettingValue(const SettingField &field, long value);
+
+	// Validate every field at once. Fields which are missing, of the wrong kind or out of range
+	// get their default, and are listed in invalidOut if given.
+	CESettings ParseSettings(const std::vector<RawSettingValue> &values, std::vector<const SettingField *> *invalidOut = nullptr);
+
+	// The value holding the packed settings blob (see settings_blob.h).
+	constexpr const wchar_t *kSettingsBlobValueName = L"SettingsBlob";
+
+	/*
+	 * LoadSettingsFromStore: Read the settings blob with a single read. If there is no valid
+	 *                        blob, read the separate (legacy) values in one pass instead, and
+	 *                        migrate them into a new blob.
+	 */
+	CESettings LoadSettingsFromStore(SettingsKeyStore &store);
+
+	// Merge the fields of toWrite which aren't -1 into the stored settings, and replace the
+	// blob with a single write. Returns false if the store couldn't be written.
+	bool WriteSettingsToStore(SettingsKeyStore &store, const CESettings &toWrite);
+}
+
+#endif // _SETTINGS_SCHEMA_H
@@ -5,6 +5,10 @@
 #include "dllmain.h"
 
 #include "util.h"
+#include "path_tokens.h"
+
+#include <string>
+#include <vector>
 
 namespace ShellHelpers
 {
@@ -23,40 +27,35 @@ HRESULT GetLocalizedDisplayPath(const WCHAR *path, WCHAR *out, long length)
 
 	ZeroMemory(out, length);
 
-	// Avoid modifying the input pointer:
-	WCHAR copyPath[2048];
-	wcscpy_s(copyPath, path);
-
-	WCHAR truePath[2048] = { 0 };
+	std::vector<PathTokens::Token> tokens;
+	PathTokens::Tokenize(path, wcslen(path), tokens);
 
-	WCHAR *buffer = NULL;
-	WCHAR *token = wcstok_s(copyPath, L"\\", &buffer);
+	std::wstring truePath;
 	int i = 0;
 
-	while (token)
+	for (const PathTokens::Token &token : tokens)
 	{
-		int tokenLen = wcslen(token);
+		std::wstring component(path + token.offset, token.length);
 
 		// If the final character of the token is the colon character, then it represents
 		// a drive path. Just copy it and ignore.
-		if (tokenLen != 0 && token[tokenLen - 1] == L':')
+		if (token.drive)
 		{
-			wcscat_s(out, length, token);
-			wcscat_s(truePath, token);
-			token = wcstok_s(NULL, L"\\", &buffer);
+			wcscat_s(out, length, component.c_str());
+			truePath += component;
 			continue;
 		}
 
 		// Concatenate working path to truePath to lookup:
-		wcscat_s(truePath, L"\\");
-		wcscat_s(truePath, token);
+		truePath += L'\\';
+		truePath += component;
 
 		CComPtr<IShellFolder> pShellFolder;
 
 		PIDLIST_ABSOLUTE pidl;
 		PCITEMID_CHILD pidlChild;
 		hr = SHParseDisplayName(
-			truePath,
+			truePath.c_str(),
 			NULL,
 			&pidl,
 			NULL,
@@ -64,7 +63,7 @@ HRESULT GetLocalizedDisplayPath(const WCHAR *path, WCHAR *out, long length)
 		);
 
 		if (hr != S_OK)
-			goto iteration_cleanup;
+			return hr;
 
 		hr = SHBindToParent(
 			pidl,
@@ -73,39 +72,32 @@ HRESULT GetLocalizedDisplayPath(const WCHAR *path, WCHAR *out, long length)
 			&pidlChild
 		);
 
-		if (hr != S_OK)
-			return hr;
-
-		STRRET ret;
-		hr = pShellFolder->GetDisplayNameOf(
-			pidlChild,
-			SHGDN_NORMAL,
-			&ret
-		);
-
-		if (hr != S_OK)
-			goto iteration_cleanup;
+		if (hr == S_OK)
+		{
+			STRRET ret;
+			hr = pShellFolder->GetDisplayNameOf(
+				pidlChild,
+				SHGDN_NORMAL,
+				&ret
+			);
+
+			if (hr == S_OK)
+			{
+				WCHAR pszName[MAX_PATH];
+				hr = StrRetToBuf(&ret, pidlChild, pszName, MAX_PATH);
 
-		WCHAR pszName[MAX_PATH];
-		hr = StrRetToBuf(&ret, pidlChild, pszName, MAX_PATH);
+				wcscat_s(out, length, L"\\");
+				wcscat_s(out, length, pszName);
+			}
+		}
 
-		wcscat_s(out, length, L"\\");
-		wcscat_s(out, length, pszName);
+		// pidlChild points into pidl, so it can only go once the name is copied.
+		ILFree(pidl);
 
-		// Grab the next token:
-		token = wcstok_s(NULL, L"\\", &buffer);
+		if (hr != S_OK)
+			return hr;
 
 		i++;
-
-		iteration_cleanup:
-		{
-			pShellFolder.Release();
-
-			if (hr != S_OK)
-			{
-				return hr;
-			}
-		}
 	}
 
 	// If we only echoed the drive letter, then place a semantic "\" anyway.
@@ -0,0 +1,293 @@
+/*
+ * tab_layout.cpp: Tab strip geometry, visibility and hit-testing.
+ *
+ * See tab_layout.h for an overview.
+ */
+
+#include "tab_layout.h"
+
+#include <algorithm>
+
+namespace TabLayout
+{
+
+static bool Contains(const Rect &rect, int x, int y)
+{
+	return x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+}
+
+/*
+ * Compute: Place every group and tab, then collect those visible at the given scroll offset.
+ *
+ * groupSizes holds the number of tabs in each group, and tabWidths the width of every tab,
+ * group after group. Empty groups take no space. The scroll offset is clamped to the extent
+ * of the overflowing row; GetScrollOffset returns the result.
+ */
+void StripLayout::Compute(const Metrics &metrics, const Rect &client, const std::vector<int> &groupSizes,
+	const std::vector<int> &tabWidths, int scrollOffset)
+{
+	m_metrics = metrics;
+	m_client = client;
+
+	size_t groupCount = groupSizes.size();
+	m_groupRects.assign(groupCount, Rect());
+	m_groupRows.assign(groupCount, -1);
+	m_groupFirstTab.resize(groupCount);
+	m_tabRects.resize(tabWidths.size());
+	m_visibleGroups.clear();
+	m_visibleTabs.clear();
+
+	int rowStart = client.left + metrics.margin;
+	int rowLimit = client.right - metrics.margin;
+	int x = rowStart;
+	int y = client.top + metrics.margin;
+	int row = 0;
+	bool overflowing = false;
+	int overflowRight = 0;
+
+	size_t firstTab = 0;
+	for (size_t groupIndex = 0; groupIndex < groupCount; ++groupIndex)
+	{
+		size_t tabCount = static_cast<size_t>(groupSizes[groupIndex]);
+		m_groupFirstTab[groupIndex] = firstTab;
+		if (tabCount == 0)
+			continue;
+
+		int groupWidth = metrics.groupHandleWidth + static_cast<int>(tabCount - 1) * metrics.tabSpacing;
+		for (size_t i = 0; i < tabCount; ++i)
+			groupWidth += tabWidths[firstTab + i];
+
+		if (!overflowing && x + groupWidth > rowLimit)
+		{
+			if (x > rowStart && row < metrics.maxRows - 1)
+			{
+				row++;
+				x = rowStart;
+				y += metrics.rowHeight + metrics.rowSpacing;
+			}
+
+			// Wrapping stops at the first group which doesn't fit, so only the last row scrolls.
+			overflowing = x + groupWidth > rowLimit;
+		}
+
+		int tabX = x + metrics.groupHandleWidth;
+		for (size_t i = 0; i < tabCount; ++i)
+		{
+			int width = tabWidths[firstTab + i];
+			m_tabRects[firstTab + i] = { tabX, y, tabX + width, y + metrics.rowHeight };
+			tabX += width + metrics.tabSpacing;
+		}
+
+		m_groupRects[groupIndex] = { x, y, tabX - metrics.tabSpacing, y + metrics.rowHeight };
+		m_groupRows[groupIndex] = row;
+		overflowRight = m_groupRects[groupIndex].right;
+		x = m_groupRects[groupIndex].right + metrics.groupSpacing;
+		firstTab += tabCount;
+	}
+
+	m_height = (row + 1) * metrics.rowHeight + (metrics.margin * 2) + (row * metrics.rowSpacing);
+
+	// Reserve room for the chevron on the overflowing row only.
+	m_scrollRow = -1;
+	m_viewRight = client.right;
+	m_chevronRect = Rect();
+	m_maxScrollOffset = 0;
+	if (overflowing)
+	{
+		int rowTop = client.top + metrics.margin + row * (metrics.rowHeight + metrics.rowSpacing);
+		m_scrollRow = row;
+		m_viewRight = std::max(client.left, client.right - metrics.chevronWidth);
+		m_chevronRect = { m_viewRight, rowTop, client.right, rowTop + metrics.rowHeight };
+		m_maxScrollOffset = std::max(0, overflowRight + metrics.margin - m_viewRight);
+	}
+	m_scrollOffset = std::clamp(scrollOffset, 0, m_maxScrollOffset);
+
+	for (size_t groupIndex = 0; groupIndex < groupCount; ++groupIndex)
+	{
+		if (m_groupRows[groupIndex] < 0)
+			continue;
+
+		int groupTabs = groupSizes[groupIndex];
+		size_t first = m_groupFirstTab[groupIndex];
+		if (!IsOnScrollRow(static_cast<int>(groupIndex)))
+		{
+			m_visibleGroups.push_back(static_cast<int>(groupIndex));
+			for (int tabIndex = 0; tabIndex < groupTabs; ++tabIndex)
+				m_visibleTabs.push_back({ static_cast<int>(groupIndex), tabIndex });
+			continue;
+		}
+
+		Rect &groupRect = m_groupRects[groupIndex];
+		groupRect.left -= m_scrollOffset;
+		groupRect.right -= m_scrollOffset;
+		if (groupRect.left < m_viewRight && groupRect.left + metrics.groupHandleWidth > client.left)
+			m_visibleGroups.push_back(static_cast<int>(groupIndex));
+
+		bool groupVisible = groupRect.right > client.left && groupRect.left < m_viewRight;
+		for (int tabIndex = 0; tabIndex < groupTabs; ++tabIndex)
+		{
+			Rect &tabRect = m_tabRects[first + tabIndex];
+			tabRect.left -= m_scrollOffset;
+			tabRect.right -= m_scrollOffset;
+			if (groupVisible && tabRect.right > client.left && tabRect.left < m_viewRight)
+				m_visibleTabs.push_back({ static_cast<int>(groupIndex), tabIndex });
+		}
+	}
+}
+
+/*
+ * IsPointInView: Check whether a point is over the strip, and not over the chevron or the
+ *                part of the overflowing row hidden behind it.
+ */
+bool StripLayout::IsPointInView(int x, int y) const
+{
+	if (!Contains(m_client, x, y))
+		return false;
+	return m_scrollRow < 0 || !Contains(m_chevronRect, x, y);
+}
+
+bool StripLayout::IsTabFullyVisible(int groupIndex, int tabIndex) const
+{
+	if (!IsOnScrollRow(groupIndex))
+		return true;
+
+	const Rect &rect = GetTabRect(groupIndex, tabIndex);
+	return rect.left >= m_client.left && rect.right <= m_viewRight;
+}
+
+/*
+ * GetOffsetToReveal: Get the scroll offset which brings a tab entirely into view, moving the
+ *                    overflowing row as little as possible. Tabs on other rows are always in
+ *                    view, so for them this is the current offset.
+ */
+int StripLayout::GetOffsetToReveal(int groupIndex, int tabIndex) const
+{
+	if (!IsOnScrollRow(groupIndex))
+		return m_scrollOffset;
+
+	const Rect &rect = GetTabRect(groupIndex, tabIndex);
+	int offset = m_scrollOffset;
+	int viewLeft = m_client.left + m_metrics.margin;
+	int viewRight = m_viewRight - m_metrics.margin;
+	if (rect.left < viewLeft)
+		offset -= viewLeft - rect.left;
+	else if (rect.right > viewRight)
+		offset += rect.right - viewRight;
+
+	return std::clamp(offset, 0, m_maxScrollOffset);
+}
+
+HitTestResult StripLayout::HitTest(int x, int y) const
+{
+	HitTestResult result;
+	if (m_scrollRow >= 0 && Contains(m_chevronRect, x, y))
+	{
+		result.chevron = true;
+		return result;
+	}
+
+	if (!IsPointInView(x, y))
+		return result;
+
+	for (int groupIndex : m_visibleGroups)
+	{
+		Rect handleRect = m_groupRects[groupIndex];
+		handleRect.right = handleRect.left + m_metrics.groupHandleWidth;
+		if (Contains(handleRect, x, y))
+		{
+			result.valid = true;
+			result.groupHandle = true;
+			result.groupIndex = groupIndex;
+			return result;
+		}
+	}
+
+	for (const TabRef &ref : m_visibleTabs)
+	{
+		if (Contains(GetTabRect(ref.groupIndex, ref.tabIndex), x, y))
+		{
+			result.valid = true;
+			result.groupIndex = ref.groupIndex;
+			result.tabIndex = ref.tabIndex;
+			return result;
+		}
+	}
+	return result;
+}
+
+int StripLayout::FindGroupAt(int x, int y) const
+{
+	if (!IsPointInView(x, y))
+		return -1;
+
+	for (size_t groupIndex = 0; groupIndex < m_groupRects.size(); ++groupIndex)
+	{
+		if (m_groupRows[groupIndex] >= 0 && Contains(m_groupRects[groupIndex], x, y))
+			return static_cast<int>(groupIndex);
+	}
+	return -1;
+}
+
+/*
+ * FindDropSlot: Get where a dragged tab or group would be inserted if dropped at a point.
+ *
+ * For a tab, this is a group and the index of the tab to insert before, which may be one past
+ * the end. For a whole group, groupIndex is the index of the group to insert before and
+ * tabIndex is -1. Both are -1 if the point isn't over a group.
+ */
+TabRef StripLayout::FindDropSlot(int x, int y, bool wholeGroup) const
+{
+	TabRef slot;
+	int groupIndex = FindGroupAt(x, y);
+	if (groupIndex < 0)
+		return slot;
+
+	const Rect &groupRect = m_groupRects[groupIndex];
+	if (wholeGroup)
+	{
+		int midpoint = groupRect.left + ((groupRect.right - groupRect.left) / 2);
+		slot.groupIndex = (x < midpoint) ? groupIndex : groupIndex + 1;
+		return slot;
+	}
+
+	slot.groupIndex = groupIndex;
+	size_t first = m_groupFirstTab[groupIndex];
+	size_t end = (static_cast<size_t>(groupIndex) + 1 < m_groupFirstTab.size()) ? m_groupFirstTab[groupIndex + 1] : m_tabRects.size();
+	for (size_t i = first; i < end; ++i)
+	{
+		const Rect &rect = m_tabRects[i];
+		if (x <= rect.left + ((rect.right - rect.left) / 2))
+		{
+			slot.tabIndex = static_cast<int>(i - first);
+			return slot;
+		}
+	}
+
+	slot.tabIndex = static_cast<int>(end - first);
+	return slot;
+}
+
+/*
+ * FindDropHover: Get the group under a point, and the tab under it if there is one.
+ */
+TabRef StripLayout::FindDropHover(int x, int y) const
+{
+	TabRef hover;
+	hover.groupIndex = FindGroupAt(x, y);
+	if (hover.groupIndex < 0)
+		return hover;
+
+	size_t first = m_groupFirstTab[hover.groupIndex];
+	size_t end = (static_cast<size_t>(hover.groupIndex) + 1 < m_groupFirstTab.size()) ? m_groupFirstTab[hover.groupIndex + 1] : m_tabRects.size();
+	for (size_t i = first; i < end; ++i)
+	{
+		if (Contains(m_tabRects[i], x, y))
+		{
+			hover.tabIndex = static_cast<int>(i - first);
+			break;
+		}
+	}
+	return hover;
+}
+
+} // namespace TabLayout
@@ -0,0 +1,111 @@
+#pragma once
+#ifndef _TAB_LAYOUT_H
+#define _TAB_LAYOUT_H
+
+// This header is deliberately free of Windows dependencies; the caller measures the tabs.
+
+#include <cstddef>
+#include <vector>
+
+namespace TabLayout
+{
+	struct Rect
+	{
+		int left = 0;
+		int top = 0;
+		int right = 0;
+		int bottom = 0;
+	};
+
+	struct Metrics
+	{
+		int margin = 6;
+		int tabSpacing = 6;
+		int groupSpacing = 14;
+		int groupHandleWidth = 8;
+		int rowHeight = 32;
+		int rowSpacing = 6;
+		int maxRows = 10;
+		int chevronWidth = 16;
+	};
+
+	struct TabRef
+	{
+		int groupIndex = -1;
+		int tabIndex = -1;
+	};
+
+	struct HitTestResult
+	{
+		bool valid = false;
+		bool groupHandle = false;
+		bool chevron = false;
+		int groupIndex = -1;
+		int tabIndex = -1;
+	};
+
+	/*
+	 * StripLayout: Geometry of the tab strip, and the rules for what is visible and hit.
+	 *
+	 * Groups wrap onto at most maxRows rows. Every row but the last fits in the client area;
+	 * once a group doesn't fit, wrapping stops and everything after it goes on the same row,
+	 * which then scrolls horizontally behind an overflow chevron. Only that row is affected by
+	 * the scroll offset, so reaching a hidden tab never moves the rows above it.
+	 *
+	 * Rects are in client coordinates, with the scroll offset already applied.
+	 */
+	class StripLayout
+	{
+	public:
+		void Compute(const Metrics &metrics, const Rect &client, const std::vector<int> &groupSizes,
+			const std::vector<int> &tabWidths, int scrollOffset);
+
+		size_t GetFlatTabIndex(int groupIndex, int tabIndex) const { return m_groupFirstTab[groupIndex] + tabIndex; }
+		const Rect &GetGroupRect(int groupIndex) const { return m_groupRects[groupIndex]; }
+		const Rect &GetTabRect(int groupIndex, int tabIndex) const { return m_tabRects[GetFlatTabIndex(groupIndex, tabIndex)]; }
+
+		// Groups whose handle is visible, and tabs which are at least partly visible.
+		const std::vector<int> &GetVisibleGroups() const { return m_visibleGroups; }
+		const std::vector<TabRef> &GetVisibleTabs() const { return m_visibleTabs; }
+
+		bool IsOverflowing() const { return m_scrollRow >= 0; }
+		const Rect &GetChevronRect() const { return m_chevronRect; }
+		int GetScrollOffset() const { return m_scrollOffset; }
+		int GetMaxScrollOffset() const { return m_maxScrollOffset; }
+		int GetHeight() const { return m_height; }
+
+		bool IsPointInView(int x, int y) const;
+		bool IsTabFullyVisible(int groupIndex, int tabIndex) const;
+		int GetOffsetToReveal(int groupIndex, int tabIndex) const;
+
+		HitTestResult HitTest(int x, int y) const;
+		TabRef FindDropSlot(int x, int y, bool wholeGroup) const;
+		TabRef FindDropHover(int x, int y) const;
+
+	private:
+		int FindGroupAt(int x, int y) const;
+		bool IsOnScrollRow(int groupIndex) const { return m_scrollRow >= 0 && m_groupRows[groupIndex] == m_scrollRow; }
+
+	private:
+		Metrics m_metrics;
+		Rect m_client;
+
+		std::vector<Rect> m_groupRects;
+		std::vector<int> m_groupRows;
+		std::vector<size_t> m_groupFirstTab;
+		std::vector<Rect> m_tabRects;
+
+		std::vector<int> m_visibleGroups;
+		std::vector<TabRef> m_visibleTabs;
+
+		// The row which overflows, or -1, and where it is cut off by the chevron.
+		int m_scrollRow = -1;
+		int m_viewRight = 0;
+		Rect m_chevronRect;
+		int m_scrollOffset = 0;
+		int m_maxScrollOffset = 0;
+		int m_height = 0;
+	};
+}
+
+#endif // _TAB_LAYOUT_H
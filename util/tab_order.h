@@ -0,0 +1,66 @@
+#pragma once
+#ifndef _TAB_ORDER_H
+#define _TAB_ORDER_H
+
+// This header is deliberately free of Windows dependencies; it works on any group type with
+// a tabs vector.
+
+#include "tab_layout.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace TabOrder
+{
+	/*
+	 * MoveTab: Move a tab in front of the tab at target, or to the end of the target group if
+	 *          target.tabIndex is one past its end. A group left empty is removed, unless it
+	 *          is the only one. Returns where the tab ended up.
+	 *
+	 * The target is given as it was before the move, as from a drop slot.
+	 */
+	template <typename Group>
+	TabLayout::TabRef MoveTab(std::vector<Group> &groups, const TabLayout::TabRef &source, TabLayout::TabRef target)
+	{
+		auto &sourceTabs = groups[source.groupIndex].tabs;
+		auto moving = std::move(sourceTabs[source.tabIndex]);
+		sourceTabs.erase(sourceTabs.begin() + source.tabIndex);
+
+		if (target.groupIndex == source.groupIndex && target.tabIndex > source.tabIndex)
+			--target.tabIndex;
+
+		if (sourceTabs.empty() && groups.size() > 1)
+		{
+			if (target.groupIndex > source.groupIndex)
+				--target.groupIndex;
+			groups.erase(groups.begin() + source.groupIndex);
+		}
+
+		target.groupIndex = std::clamp(target.groupIndex, 0, static_cast<int>(groups.size() - 1));
+		auto &targetTabs = groups[target.groupIndex].tabs;
+		target.tabIndex = std::clamp(target.tabIndex, 0, static_cast<int>(targetTabs.size()));
+		targetTabs.insert(targetTabs.begin() + target.tabIndex, std::move(moving));
+		return target;
+	}
+
+	/*
+	 * MoveGroup: Move a group in front of the group at targetIndex, which may be one past the
+	 *            end. Returns the group's new index.
+	 */
+	template <typename Group>
+	int MoveGroup(std::vector<Group> &groups, int sourceIndex, int targetIndex)
+	{
+		Group moving = std::move(groups[sourceIndex]);
+		groups.erase(groups.begin() + sourceIndex);
+
+		if (targetIndex > sourceIndex)
+			--targetIndex;
+		targetIndex = std::clamp(targetIndex, 0, static_cast<int>(groups.size()));
+
+		groups.insert(groups.begin() + targetIndex, std::move(moving));
+		return targetIndex;
+	}
+}
+
+#endif // _TAB_ORDER_H
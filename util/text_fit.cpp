@@ -0,0 +1,56 @@
+/*
+ * text_fit.cpp: End-ellipsis fitting over cached prefix advances.
+ *
+ * This replaces repeated DT_END_ELLIPSIS layouts of the same titles: the text is measured
+ * once per font, and every later fit is a binary search over the cumulative widths.
+ */
+
+#include "text_fit.h"
+
+#include <algorithm>
+
+namespace TextFit
+{
+
+/*
+ * FitPrefix: Get the length of the longest prefix whose width does not exceed maxWidth.
+ */
+size_t FitPrefix(const std::vector<int> &advances, int maxWidth)
+{
+	// Advances are non-decreasing, so the first entry wider than maxWidth marks the end of
+	// the prefix.
+	auto it = std::upper_bound(advances.begin(), advances.end(), maxWidth);
+	return static_cast<size_t>(it - advances.begin());
+}
+
+/*
+ * GetDisplayText: Get the text as it should be displayed in maxWidth, which is either the
+ *                 text itself or its longest fitting prefix followed by an ellipsis.
+ *
+ * The result is memoised in the metrics, so repainting at the same width is free.
+ */
+const std::wstring &GetDisplayText(TitleMetrics &metrics, const std::wstring &text, int maxWidth)
+{
+	if (metrics.displayWidth == maxWidth)
+		return metrics.displayText;
+
+	metrics.displayWidth = maxWidth;
+
+	if (metrics.GetWidth() <= maxWidth)
+	{
+		metrics.displayText = text;
+		return metrics.displayText;
+	}
+
+	size_t length = 0;
+	if (maxWidth > metrics.ellipsisWidth)
+	{
+		length = FitPrefix(metrics.advances, maxWidth - metrics.ellipsisWidth);
+	}
+
+	metrics.displayText.assign(text, 0, std::min(length, text.length()));
+	metrics.displayText += L"...";
+	return metrics.displayText;
+}
+
+} // namespace TextFit
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef _TEXT_FIT_H
+#define _TEXT_FIT_H
+
+// This header is deliberately free of Windows dependencies; the caller measures the text.
+
+#include <string>
+#include <vector>
+
+namespace TextFit
+{
+	/*
+	 * TitleMetrics: Cached measurements of a single string in a single font.
+	 *
+	 * advances[i] is the width of the first i + 1 characters, so the width of the whole
+	 * string is the last entry and the longest prefix fitting in a width is a binary search.
+	 */
+	struct TitleMetrics
+	{
+		unsigned long long fontKey = 0;
+		std::vector<int> advances;
+		int ellipsisWidth = 0;
+
+		// Memoised result of the last GetDisplayText call.
+		int displayWidth = -1;
+		std::wstring displayText;
+
+		bool IsValidFor(unsigned long long key, size_t length) const
+		{
+			return fontKey == key && advances.size() == length;
+		}
+
+		int GetWidth() const
+		{
+			return advances.empty() ? 0 : advances.back();
+		}
+
+		void Reset(unsigned long long key)
+		{
+			fontKey = key;
+			advances.clear();
+			ellipsisWidth = 0;
+			displayWidth = -1;
+			displayText.clear();
+		}
+	};
+
+	size_t FitPrefix(const std::vector<int> &advances, int maxWidth);
+	const std::wstring &GetDisplayText(TitleMetrics &metrics, const std::wstring &text, int maxWidth);
+}
+
+#endif // _TEXT_FIT_H
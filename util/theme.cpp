@@ -0,0 +1,165 @@
+/*
+ * theme.cpp: The built-in themes, and the theme packs which can replace them.
+ */
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "theme.h"
+#include "util.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace CEUtil
+{
+
+ThrobberSize Theme::GetThrobberSizeForHeight(int height, int dpi) const
+{
+	if (dpi <= 0)
+		dpi = USER_DEFAULT_SCREEN_DPI;
+
+	if (height >= MulDiv(m_metrics.largeHeight, dpi, USER_DEFAULT_SCREEN_DPI))
+		return ThrobberSize::Large;
+	if (height >= MulDiv(m_metrics.midHeight, dpi, USER_DEFAULT_SCREEN_DPI))
+		return ThrobberSize::Mid;
+	return ThrobberSize::Small;
+}
+
+std::shared_ptr<const DecodedBitmap> ResourceTheme::GetThrobber(ThrobberSize size, int dpi) const
+{
+	return GetThemeBitmapCache().GetThrobber(m_id, size, dpi);
+}
+
+PackTheme::PackTheme(std::unique_ptr<MappedFile> &&file, ThemePack &&pack, const Metrics &metrics)
+	: Theme(metrics)
+	, m_file(std::move(file))
+	, m_pack(std::move(pack))
+{
+}
+
+/*
+ * Open: Map and validate a theme pack. Returns null if the file isn't a valid pack.
+ */
+std::shared_ptr<const Theme> PackTheme::Open(const std::filesystem::path &path, int &replacesThemeOut)
+{
+	std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>(path);
+	if (!file->GetData())
+		return nullptr;
+
+	ThemePack pack;
+	if (!ThemePack::Parse(reinterpret_cast<const unsigned char *>(file->GetData()), file->GetSize(), pack))
+		return nullptr;
+
+	const ThemePack::Metadata &metadata = pack.GetMetadata();
+
+	Metrics metrics;
+	metrics.background = metadata.background == ThemePack::kNoBackground ? CLR_NONE : static_cast<COLORREF>(metadata.background);
+	metrics.midHeight = metadata.midHeight;
+	metrics.largeHeight = metadata.largeHeight;
+	metrics.frameIntervalMs = metadata.frameIntervalMs;
+
+	replacesThemeOut = metadata.replacesTheme;
+	return std::make_shared<PackTheme>(std::move(file), std::move(pack), metrics);
+}
+
+std::shared_ptr<const DecodedBitmap> PackTheme::GetThrobber(ThrobberSize size, int dpi) const
+{
+	int sizeClass = static_cast<int>(size);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_throbbers[sizeClass] && !m_decodeFailed[sizeClass])
+	{
+		CE_TRACE_SCOPE("ThemePack.Decode");
+
+		DecodedImage image;
+		int sprite = m_pack.FindSprite(ThemePack::SpriteRole::Throbber, sizeClass);
+		if (m_pack.DecodeSprite(sprite, image))
+		{
+			int frameCount = m_pack.GetSprites()[sprite].frameCount;
+			m_throbbers[sizeClass] = std::make_shared<DecodedBitmap>(image.width, image.height, std::move(image.pixels), frameCount);
+		}
+		else
+			m_decodeFailed[sizeClass] = true; // Don't try again on every resize.
+	}
+
+	if (!m_throbbers[sizeClass] || dpi <= 0 || dpi == USER_DEFAULT_SCREEN_DPI)
+		return m_throbbers[sizeClass];
+
+	std::shared_ptr<const DecodedBitmap> &scaled = m_scaledThrobbers[{ sizeClass, dpi }];
+	if (!scaled)
+		scaled = m_throbbers[sizeClass]->ScaleForDpi(dpi);
+
+	return scaled;
+}
+
+static const int kThemeCount = CLASSIC_EXPLORER_MEMPHIS + 1;
+
+/*
+ * LoadThemes: Build the built-in themes, then replace any of them for which there is a theme
+ *             pack in the Themes directory next to the DLL.
+ *
+ * Packs are tried in file name order, and the first valid pack for a theme wins.
+ */
+static void LoadThemes(std::shared_ptr<const Theme> (&themes)[kThemeCount])
+{
+	Theme::Metrics dark;
+	dark.background = RGB(0, 0, 0);
+
+	Theme::Metrics light;
+	light.background = RGB(255, 255, 255);
+
+	themes[CLASSIC_EXPLORER_2K] = std::make_shared<ResourceTheme>(CLASSIC_EXPLORER_2K, dark);
+	themes[CLASSIC_EXPLORER_XP] = std::make_shared<ResourceTheme>(CLASSIC_EXPLORER_XP, light);
+	themes[CLASSIC_EXPLORER_10] = std::make_shared<ResourceTheme>(CLASSIC_EXPLORER_10, light);
+	themes[CLASSIC_EXPLORER_MEMPHIS] = std::make_shared<ResourceTheme>(CLASSIC_EXPLORER_MEMPHIS, dark);
+
+	std::filesystem::path moduleDirectory = GetModuleDirectory();
+	if (moduleDirectory.empty())
+		return;
+
+	std::vector<std::filesystem::path> packPaths;
+	std::error_code error;
+	for (std::filesystem::directory_iterator it(moduleDirectory / L"Themes", error), end; !error && it != end; it.increment(error))
+	{
+		if (_wcsicmp(it->path().extension().c_str(), L".cetheme") == 0)
+			packPaths.push_back(it->path());
+	}
+	std::sort(packPaths.begin(), packPaths.end());
+
+	bool replaced[kThemeCount] = {};
+	for (const std::filesystem::path &path : packPaths)
+	{
+		int replacesTheme = -1;
+		std::shared_ptr<const Theme> pack = PackTheme::Open(path, replacesTheme);
+		if (!pack || replacesTheme < 0 || replacesTheme >= kThemeCount || replaced[replacesTheme])
+			continue;
+
+		themes[replacesTheme] = pack;
+		replaced[replacesTheme] = true;
+	}
+}
+
+/*
+ * GetTheme: Get the process-wide description of the given theme. Unknown themes get the
+ *           Windows 10 theme.
+ */
+std::shared_ptr<const Theme> GetTheme(ClassicExplorerTheme theme)
+{
+	static std::once_flag s_loaded;
+	static std::shared_ptr<const Theme> s_themes[kThemeCount];
+
+	std::call_once(s_loaded, []()
+	{
+		LoadThemes(s_themes);
+	});
+
+	if (theme < 0 || theme >= kThemeCount)
+		theme = CLASSIC_EXPLORER_10;
+
+	return s_themes[theme];
+}
+
+} // namespace CEUtil
@@ -0,0 +1,100 @@
+#pragma once
+#ifndef _THEME_H
+#define _THEME_H
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "settings.h"
+#include "bitmap_cache.h"
+#include "mapped_file.h"
+#include "theme_pack.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace CEUtil
+{
+	/*
+	 * Theme: Everything the throbber needs to know to draw one theme.
+	 *
+	 * Themes are built once per process and never change, so switching a window to another
+	 * theme is a matter of swapping the pointer it holds.
+	 */
+	class Theme
+	{
+	public:
+		struct Metrics
+		{
+			COLORREF background = RGB(0, 0, 0);
+			int midHeight = 26;
+			int largeHeight = 38;
+			unsigned int frameIntervalMs = 100;
+		};
+
+		explicit Theme(const Metrics &metrics) : m_metrics(metrics) {}
+		virtual ~Theme() = default;
+
+		Theme(const Theme &) = delete;
+		Theme &operator=(const Theme &) = delete;
+
+		// CLR_NONE if the toolbar behind the band should show through.
+		COLORREF GetBackground() const { return m_metrics.background; }
+		unsigned int GetFrameInterval() const { return m_metrics.frameIntervalMs; }
+
+		// The size thresholds are in 96 DPI pixels, and scale with the DPI like the throbbers.
+		ThrobberSize GetThrobberSizeForHeight(int height, int dpi) const;
+
+		// May decode the bitmap, so it is best called when the bitmap is about to be drawn.
+		virtual std::shared_ptr<const DecodedBitmap> GetThrobber(ThrobberSize size, int dpi) const = 0;
+
+	private:
+		Metrics m_metrics;
+	};
+
+	/*
+	 * ResourceTheme: One of the themes compiled into the DLL. Its bitmaps come from the
+	 *                process-wide ThemeBitmapCache.
+	 */
+	class ResourceTheme : public Theme
+	{
+	public:
+		ResourceTheme(ClassicExplorerTheme id, const Metrics &metrics) : Theme(metrics), m_id(id) {}
+
+		std::shared_ptr<const DecodedBitmap> GetThrobber(ThrobberSize size, int dpi) const override;
+
+	private:
+		ClassicExplorerTheme m_id;
+	};
+
+	/*
+	 * PackTheme: A theme read from a memory-mapped theme pack file.
+	 *
+	 * Each sprite is decoded the first time it is asked for and kept for the life of the
+	 * process, as is each copy resampled for a DPI other than 96; sprites which are never
+	 * drawn are never decoded.
+	 */
+	class PackTheme : public Theme
+	{
+	public:
+		static std::shared_ptr<const Theme> Open(const std::filesystem::path &path, int &replacesThemeOut);
+
+		std::shared_ptr<const DecodedBitmap> GetThrobber(ThrobberSize size, int dpi) const override;
+
+		PackTheme(std::unique_ptr<MappedFile> &&file, ThemePack &&pack, const Metrics &metrics);
+
+	private:
+		std::unique_ptr<MappedFile> m_file;
+		ThemePack m_pack;
+
+		mutable std::mutex m_mutex;
+		mutable std::shared_ptr<const DecodedBitmap> m_throbbers[(int)ThrobberSize::Count];
+		mutable bool m_decodeFailed[(int)ThrobberSize::Count] = {};
+		mutable std::map<std::pair<int, int>, std::shared_ptr<const DecodedBitmap>> m_scaledThrobbers;
+	};
+
+	std::shared_ptr<const Theme> GetTheme(ClassicExplorerTheme theme);
+}
+
+#endif // _THEME_H
@@ -0,0 +1,133 @@
+/*
+ * theme_pack.cpp: Implements the theme pack reader. See theme_pack.h for the file layout.
+ */
+
+#include "theme_pack.h"
+
+#include <algorithm>
+#include <cstring>
+
+static uint32_t ReadUInt32(const unsigned char *data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint16_t ReadUInt16(const unsigned char *data)
+{
+	uint16_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static bool IsRangeInFile(size_t offset, size_t length, size_t size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+bool ThemePack::Parse(const unsigned char *data, size_t size, ThemePack &packOut)
+{
+	if (!data || size < kHeaderSize || memcmp(data, "CETP", 4) != 0)
+		return false;
+
+	if (ReadUInt16(data + 4) != kVersion)
+		return false;
+
+	size_t spriteCount = ReadUInt16(data + 6);
+	if (!IsRangeInFile(kHeaderSize, spriteCount * kSpriteEntrySize, size))
+		return false;
+
+	Metadata metadata;
+	metadata.background = ReadUInt32(data + 8);
+	if (metadata.background != kNoBackground)
+		metadata.background &= 0x00FFFFFF;
+	metadata.midHeight = ReadUInt16(data + 12);
+	metadata.largeHeight = ReadUInt16(data + 14);
+	metadata.frameIntervalMs = ReadUInt16(data + 16);
+	metadata.replacesTheme = ReadUInt16(data + 18);
+
+	if (metadata.midHeight > metadata.largeHeight || metadata.frameIntervalMs == 0)
+		return false;
+
+	size_t nameOffset = ReadUInt32(data + 20);
+	size_t nameLength = ReadUInt32(data + 24);
+	if (!IsRangeInFile(nameOffset, nameLength, size))
+		return false;
+	metadata.name.assign(reinterpret_cast<const char *>(data) + nameOffset, nameLength);
+
+	std::vector<Sprite> sprites;
+	sprites.reserve(spriteCount);
+	for (size_t i = 0; i < spriteCount; i++)
+	{
+		const unsigned char *entry = data + kHeaderSize + i * kSpriteEntrySize;
+
+		Sprite sprite;
+		uint16_t role = ReadUInt16(entry);
+		uint16_t encoding = ReadUInt16(entry + 4);
+		sprite.sizeClass = ReadUInt16(entry + 2);
+		sprite.width = ReadUInt16(entry + 6);
+		sprite.height = ReadUInt16(entry + 8);
+		sprite.frameCount = std::max<int>(1, ReadUInt16(entry + 10));
+		sprite.offset = ReadUInt32(entry + 12);
+		sprite.length = ReadUInt32(entry + 16);
+
+		if (role != static_cast<uint16_t>(SpriteRole::Throbber) || sprite.sizeClass >= kSizeClassCount)
+			return false;
+
+		if (encoding != static_cast<uint16_t>(Encoding::Bmp) && encoding != static_cast<uint16_t>(Encoding::Bgra))
+			return false;
+
+		if (!IsRangeInFile(sprite.offset, sprite.length, size))
+			return false;
+
+		// The size of a .bmp sprite is only known once it is decoded.
+		if (encoding == static_cast<uint16_t>(Encoding::Bgra) && sprite.width % sprite.frameCount != 0)
+			return false;
+
+		sprite.role = static_cast<SpriteRole>(role);
+		sprite.encoding = static_cast<Encoding>(encoding);
+		sprites.push_back(sprite);
+	}
+
+	packOut.m_data = data;
+	packOut.m_size = size;
+	packOut.m_metadata = std::move(metadata);
+	packOut.m_sprites = std::move(sprites);
+	return true;
+}
+
+/*
+ * FindSprite: Get the index of the sprite with the given role and size class, or -1.
+ */
+int ThemePack::FindSprite(SpriteRole role, int sizeClass) const
+{
+	for (size_t i = 0; i < m_sprites.size(); i++)
+	{
+		if (m_sprites[i].role == role && m_sprites[i].sizeClass == sizeClass)
+			return static_cast<int>(i);
+	}
+	return -1;
+}
+
+bool ThemePack::DecodeSprite(int index, DecodedImage &imageOut) const
+{
+	if (index < 0 || static_cast<size_t>(index) >= m_sprites.size())
+		return false;
+
+	const Sprite &sprite = m_sprites[index];
+	const unsigned char *data = m_data + sprite.offset;
+
+	bool decoded = false;
+	switch (sprite.encoding)
+	{
+	case Encoding::Bmp:
+		decoded = ImageDecode::DecodeBmp(data, sprite.length, imageOut);
+		break;
+	case Encoding::Bgra:
+		decoded = ImageDecode::DecodeBgra(data, sprite.length, sprite.width, sprite.height, imageOut);
+		break;
+	}
+
+	return decoded && imageOut.width % sprite.frameCount == 0;
+}
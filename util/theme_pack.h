@@ -0,0 +1,108 @@
+#pragma once
+#ifndef _THEME_PACK_H
+#define _THEME_PACK_H
+
+// This header is deliberately free of Windows dependencies; it works on raw file bytes.
+
+#include "image_decode.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * ThemePack: Reads a theme pack (.cetheme) file: the metadata of a theme and an atlas of its
+ *            sprites, each stored as a .bmp file or as raw BGRA pixels.
+ *
+ * The layout is little-endian:
+ *
+ *   Header, 32 bytes:
+ *     char[4] magic            "CETP"
+ *     u16     version          1
+ *     u16     spriteCount
+ *     u32     background       COLORREF (0x00BBGGRR) painted behind the throbber, or
+ *                              0xFFFFFFFF to let the toolbar show through
+ *     u16     midHeight        band height from which the mid-size throbber is used
+ *     u16     largeHeight      band height from which the large throbber is used
+ *     u16     frameIntervalMs  time between animation frames
+ *     u16     replacesTheme    ClassicExplorerTheme value whose visuals the pack replaces
+ *     u32     nameOffset       UTF-8 display name
+ *     u32     nameLength
+ *     u32     reserved         0
+ *
+ *   Sprite table, spriteCount entries of 20 bytes, right after the header:
+ *     u16     role             0 = throbber
+ *     u16     sizeClass        0 = small, 1 = mid, 2 = large
+ *     u16     encoding         0 = .bmp file, 1 = raw BGRA
+ *     u16     width, height    raw BGRA only, 0 otherwise
+ *     u16     frameCount       animation frames laid side by side, each width / frameCount
+ *                              wide; 0 (which older packs hold) means 1
+ *     u32     offset, length   where the encoded sprite is in the file
+ *
+ * Parse validates the header and the table (every range must lie within the file), but no
+ * sprite is decoded until DecodeSprite asks for it, which fails if the image isn't a whole
+ * number of frames wide. The pack refers to the memory it was
+ * parsed from, which must outlive it.
+ */
+class ThemePack
+{
+public:
+	enum class SpriteRole : uint16_t
+	{
+		Throbber = 0
+	};
+
+	enum class Encoding : uint16_t
+	{
+		Bmp = 0,
+		Bgra = 1
+	};
+
+	struct Sprite
+	{
+		SpriteRole role = SpriteRole::Throbber;
+		int sizeClass = 0;
+		Encoding encoding = Encoding::Bmp;
+		int width = 0;
+		int height = 0;
+		int frameCount = 1;
+		size_t offset = 0;
+		size_t length = 0;
+	};
+
+	struct Metadata
+	{
+		uint32_t background = 0;
+		int midHeight = 0;
+		int largeHeight = 0;
+		unsigned int frameIntervalMs = 0;
+		int replacesTheme = 0;
+		std::string name;
+	};
+
+	// The background value of a pack whose throbber is drawn straight over the toolbar.
+	static const uint32_t kNoBackground = 0xFFFFFFFF;
+
+	static const uint16_t kVersion = 1;
+	static const size_t kHeaderSize = 32;
+	static const size_t kSpriteEntrySize = 20;
+	static const int kSizeClassCount = 3;
+
+	static bool Parse(const unsigned char *data, size_t size, ThemePack &packOut);
+
+	const Metadata &GetMetadata() const { return m_metadata; }
+	const std::vector<Sprite> &GetSprites() const { return m_sprites; }
+
+	int FindSprite(SpriteRole role, int sizeClass) const;
+	bool DecodeSprite(int index, DecodedImage &imageOut) const;
+
+private:
+	const unsigned char *m_data = nullptr;
+	size_t m_size = 0;
+
+	Metadata m_metadata;
+	std::vector<Sprite> m_sprites;
+};
+
+#endif // _THEME_PACK_H
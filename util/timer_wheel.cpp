@@ -0,0 +1,316 @@
+/*
+ * timer_wheel.cpp: Implements the hierarchical timing wheel declared in timer_wheel.h.
+ */
+
+#include "timer_wheel.h"
+
+#include <utility>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static const int kTopLevel = TimerWheel::kLevels - 1;
+static const uint64_t kSlotMask = TimerWheel::kSlots - 1;
+
+// The span of time covered by a whole level.
+static uint64_t GetLevelRange(int level)
+{
+	return 1ULL << (TimerWheel::kSlotBits * (level + 1));
+}
+
+static int GetLevelShift(int level)
+{
+	return TimerWheel::kSlotBits * level;
+}
+
+// The value must not be 0.
+static int CountTrailingZeros(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return static_cast<int>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(value);
+#else
+	int count = 0;
+	while (!(value & 1))
+	{
+		value >>= 1;
+		count++;
+	}
+	return count;
+#endif
+}
+
+static uint64_t RotateRight(uint64_t value, int amount)
+{
+	amount &= 63;
+	if (amount == 0)
+		return value;
+	return (value >> amount) | (value << (64 - amount));
+}
+
+TimerWheel::TimerWheel(uint64_t nowMs)
+	: m_now(nowMs)
+{
+	for (uint32_t &head : m_heads)
+		head = kNil;
+}
+
+/*
+ * Schedule: Call the callback once the clock reaches dueMs. A due time which has already
+ *           passed fires on the next millisecond.
+ *
+ * The callback runs from Advance, and may schedule or cancel other timers.
+ */
+TimerWheel::TimerId TimerWheel::Schedule(uint64_t dueMs, Callback callback)
+{
+	if (dueMs <= m_now)
+		dueMs = m_now + 1;
+
+	uint32_t index;
+	if (!m_free.empty())
+	{
+		index = m_free.back();
+		m_free.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+
+	Node &node = m_nodes[index];
+	node.due = dueMs;
+	node.callback = std::move(callback);
+	File(index);
+	m_count++;
+
+	return MakeId(index);
+}
+
+/*
+ * Cancel: Cancel a timer which hasn't fired yet. Returns false if it has already fired, was
+ *         already cancelled, or is 0.
+ */
+bool TimerWheel::Cancel(TimerId id)
+{
+	uint32_t index;
+	if (!ResolveId(id, index))
+		return false;
+
+	Unlink(index);
+	Release(index);
+	m_count--;
+	return true;
+}
+
+/*
+ * Advance: Move the clock forward to nowMs, firing every timer which is due by then in order
+ *          of due time. Returns the number of timers fired.
+ *
+ * The clock never goes backwards; an earlier time is ignored. Advance must not be called from
+ * a timer callback.
+ */
+size_t TimerWheel::Advance(uint64_t nowMs)
+{
+	size_t fired = 0;
+
+	uint64_t next;
+	while (GetNextSlotTime(next) && next <= nowMs)
+	{
+		m_now = next;
+
+		// Move timers down from every coarser slot which starts now, coarsest first, so that
+		// they land in finer slots before those are looked at.
+		for (int level = kTopLevel; level >= 1; level--)
+		{
+			int shift = GetLevelShift(level);
+			if (m_now & ((1ULL << shift) - 1))
+				continue;
+
+			int slot = static_cast<int>((m_now >> shift) & kSlotMask);
+			if (m_occupied[level] & (1ULL << slot))
+				Cascade(level, slot);
+		}
+
+		uint32_t list = static_cast<uint32_t>(m_now & kSlotMask);
+		while (m_heads[list] != kNil)
+		{
+			uint32_t index = m_heads[list];
+			Unlink(index);
+			Link(index, kFiringList);
+		}
+
+		// Callbacks may cancel timers which are still waiting to fire here, or schedule new
+		// ones (which always land in a later slot), so take one node at a time.
+		while (m_heads[kFiringList] != kNil)
+		{
+			uint32_t index = m_heads[kFiringList];
+			Unlink(index);
+
+			Callback callback = std::move(m_nodes[index].callback);
+			Release(index);
+			m_count--;
+			fired++;
+
+			if (callback)
+				callback();
+		}
+	}
+
+	if (nowMs > m_now)
+		m_now = nowMs;
+
+	return fired;
+}
+
+/*
+ * GetNextWakeup: Get the time at which Advance next has work to do, or false if there are no
+ *                timers.
+ *
+ * This may be earlier than the next due time, when timers have to be moved down a level then.
+ */
+bool TimerWheel::GetNextWakeup(uint64_t &wakeupMsOut) const
+{
+	return GetNextSlotTime(wakeupMsOut);
+}
+
+/*
+ * File: Put a node into the slot for its due time, relative to the current time. A node which
+ *       is due now goes into the current level 0 slot, which is about to fire.
+ */
+void TimerWheel::File(uint32_t index)
+{
+	uint64_t due = m_nodes[index].due;
+	uint64_t delta = due > m_now ? due - m_now : 0;
+
+	for (int level = 0; level < kLevels; level++)
+	{
+		if (delta < GetLevelRange(level))
+		{
+			uint64_t slot = (due >> GetLevelShift(level)) & kSlotMask;
+			Link(index, static_cast<uint32_t>(level * kSlots + slot));
+			return;
+		}
+	}
+
+	// Beyond the range of the wheel: park it in the furthest top level slot, and refile it
+	// from there.
+	uint64_t parkedDue = m_now + GetLevelRange(kTopLevel) - 1;
+	uint64_t slot = (parkedDue >> GetLevelShift(kTopLevel)) & kSlotMask;
+	Link(index, static_cast<uint32_t>(kTopLevel * kSlots + slot));
+}
+
+void TimerWheel::Link(uint32_t index, uint32_t list)
+{
+	Node &node = m_nodes[index];
+	node.list = list;
+	node.prev = kNil;
+	node.next = m_heads[list];
+
+	if (node.next != kNil)
+		m_nodes[node.next].prev = index;
+	m_heads[list] = index;
+
+	if (list < kFiringList)
+		m_occupied[list / kSlots] |= 1ULL << (list % kSlots);
+}
+
+void TimerWheel::Unlink(uint32_t index)
+{
+	Node &node = m_nodes[index];
+	uint32_t list = node.list;
+
+	if (node.prev != kNil)
+		m_nodes[node.prev].next = node.next;
+	else
+		m_heads[list] = node.next;
+
+	if (node.next != kNil)
+		m_nodes[node.next].prev = node.prev;
+
+	node.prev = kNil;
+	node.next = kNil;
+
+	if (list < kFiringList && m_heads[list] == kNil)
+		m_occupied[list / kSlots] &= ~(1ULL << (list % kSlots));
+}
+
+/*
+ * Release: Return an unlinked node to the free list. Bumping the generation makes any
+ *          outstanding id for it stale.
+ */
+void TimerWheel::Release(uint32_t index)
+{
+	Node &node = m_nodes[index];
+	node.list = kNil;
+	node.callback = nullptr;
+	node.generation++;
+	m_free.push_back(index);
+}
+
+void TimerWheel::Cascade(int level, int slot)
+{
+	uint32_t list = static_cast<uint32_t>(level * kSlots + slot);
+	while (m_heads[list] != kNil)
+	{
+		uint32_t index = m_heads[list];
+		Unlink(index);
+		File(index);
+	}
+}
+
+/*
+ * GetNextSlotTime: Get the earliest time at which a non-empty slot starts.
+ *
+ * Slot s of a level starts at the first boundary of that level after the current time whose
+ * index is s; the slots after the current one are found with one rotate and bit scan.
+ */
+bool TimerWheel::GetNextSlotTime(uint64_t &timeOut) const
+{
+	bool found = false;
+
+	for (int level = 0; level < kLevels; level++)
+	{
+		if (!m_occupied[level])
+			continue;
+
+		int shift = GetLevelShift(level);
+		uint64_t block = m_now >> shift;
+		int current = static_cast<int>(block & kSlotMask);
+
+		int offset = CountTrailingZeros(RotateRight(m_occupied[level], current + 1));
+		uint64_t time = (block + 1 + offset) << shift;
+
+		if (!found || time < timeOut)
+		{
+			timeOut = time;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+TimerWheel::TimerId TimerWheel::MakeId(uint32_t index) const
+{
+	return (static_cast<uint64_t>(m_nodes[index].generation) << 32) | (static_cast<uint64_t>(index) + 1);
+}
+
+bool TimerWheel::ResolveId(TimerId id, uint32_t &indexOut) const
+{
+	uint64_t low = id & 0xFFFFFFFFULL;
+	if (low == 0 || low > m_nodes.size())
+		return false;
+
+	uint32_t index = static_cast<uint32_t>(low - 1);
+	const Node &node = m_nodes[index];
+	if (node.list == kNil || node.generation != static_cast<uint32_t>(id >> 32))
+		return false;
+
+	indexOut = index;
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+// This header is deliberately free of Windows dependencies; the caller supplies the clock.
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/*
+ * TimerWheel: A hierarchical timing wheel of one-shot timers with millisecond resolution.
+ *
+ * There are kLevels wheels of kSlots slots; level 0 slots are 1 ms wide and every level above
+ * is kSlots times coarser. A timer is filed into the finest level whose range covers it and is
+ * moved down (cascaded) when the clock reaches its slot, so scheduling and cancelling are
+ * O(1), and advancing costs O(1) per slot which holds something rather than per millisecond.
+ * Timers further out than the top level's range are parked in its last slot and refiled when
+ * they get there.
+ *
+ * The wheel isn't thread-safe; every thread which needs timers owns its own wheel.
+ */
+class TimerWheel
+{
+public:
+	// 0 is never a valid timer, so it can be used as "no timer".
+	using TimerId = uint64_t;
+	using Callback = std::function<void()>;
+
+	static const int kSlotBits = 6;
+	static const int kSlots = 1 << kSlotBits;
+	static const int kLevels = 4;
+
+	explicit TimerWheel(uint64_t nowMs = 0);
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	TimerId Schedule(uint64_t dueMs, Callback callback);
+	bool Cancel(TimerId id);
+	size_t Advance(uint64_t nowMs);
+
+	bool GetNextWakeup(uint64_t &wakeupMsOut) const;
+
+	uint64_t GetNow() const { return m_now; }
+	size_t GetCount() const { return m_count; }
+
+private:
+	static const uint32_t kNil = 0xFFFFFFFF;
+
+	// Lists 0 to kLevels * kSlots - 1 are the slots; the last one holds timers which are
+	// being fired.
+	static const uint32_t kFiringList = kLevels * kSlots;
+	static const uint32_t kListCount = kFiringList + 1;
+
+	struct Node
+	{
+		uint64_t due = 0;
+		uint32_t prev = kNil;
+		uint32_t next = kNil;
+		uint32_t list = kNil; // kNil when the node is free
+		uint32_t generation = 0;
+		Callback callback;
+	};
+
+	void File(uint32_t index);
+	void Link(uint32_t index, uint32_t list);
+	void Unlink(uint32_t index);
+	void Release(uint32_t index);
+	void Cascade(int level, int slot);
+	bool GetNextSlotTime(uint64_t &timeOut) const;
+	TimerId MakeId(uint32_t index) const;
+	bool ResolveId(TimerId id, uint32_t &indexOut) const;
+
+private:
+	uint64_t m_now;
+	size_t m_count = 0;
+
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_free;
+	uint32_t m_heads[kListCount];
+	uint64_t m_occupied[kLevels] = {}; // one bit per non-empty slot
+};
+
+#endif // _TIMER_WHEEL_H
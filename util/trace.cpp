@@ -0,0 +1,188 @@
+/*
+ * trace.cpp: Implements the tracing facade declared in trace.h.
+ */
+
+#include "trace.h"
+
+#ifdef _WIN32
+
+// {7f0348df-1f37-4718-8d8d-688b6d7bb38a}
+TRACELOGGING_DEFINE_PROVIDER(
+	g_ceTraceProvider,
+	"ClassicExplorer",
+	(0x7f0348df, 0x1f37, 0x4718, 0x8d, 0x8d, 0x68, 0x8b, 0x6d, 0x7b, 0xb3, 0x8a)
+);
+
+namespace CETrace
+{
+
+static LARGE_INTEGER s_frequency = { 0 };
+
+void Register()
+{
+	QueryPerformanceFrequency(&s_frequency);
+	TraceLoggingRegister(g_ceTraceProvider);
+}
+
+void Unregister()
+{
+	TraceLoggingUnregister(g_ceTraceProvider);
+}
+
+unsigned long long Now()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	// Split the conversion to avoid overflowing on long uptimes.
+	unsigned long long ticks = static_cast<unsigned long long>(counter.QuadPart);
+	unsigned long long frequency = static_cast<unsigned long long>(s_frequency.QuadPart);
+	if (frequency == 0)
+		return 0;
+
+	return (ticks / frequency) * 1000000000ULL + ((ticks % frequency) * 1000000000ULL) / frequency;
+}
+
+void WriteActivity(const char *name, unsigned long long durationNs)
+{
+	TraceLoggingWrite(
+		g_ceTraceProvider,
+		"Activity",
+		TraceLoggingString(name, "Name"),
+		TraceLoggingUInt64(durationNs / 1000, "DurationUs")
+	);
+}
+
+void WriteValue(const char *name, long long value)
+{
+	TraceLoggingWrite(
+		g_ceTraceProvider,
+		"Value",
+		TraceLoggingString(name, "Name"),
+		TraceLoggingInt64(value, "Value")
+	);
+}
+
+void WriteNavigation(unsigned int tabId, bool requested, bool failed, unsigned long long totalNs,
+	unsigned long long ownNs, unsigned long long shellNs)
+{
+	TraceLoggingWrite(
+		g_ceTraceProvider,
+		"Navigation",
+		TraceLoggingUInt32(tabId, "TabId"),
+		TraceLoggingBool(requested, "Requested"),
+		TraceLoggingBool(failed, "Failed"),
+		TraceLoggingUInt64(totalNs / 1000, "TotalUs"),
+		TraceLoggingUInt64(ownNs / 1000, "OwnUs"),
+		TraceLoggingUInt64(shellNs / 1000, "ShellUs")
+	);
+}
+
+} // namespace CETrace
+
+#else // !_WIN32
+
+#include <chrono>
+#include <mutex>
+
+namespace CETrace
+{
+
+std::atomic<bool> g_ringBufferEnabled(false);
+
+static const size_t kRingBufferCapacity = 4096;
+
+static std::mutex s_ringMutex;
+static std::vector<Record> s_ring;
+static size_t s_ringNext = 0;
+
+static void Append(const Record &record)
+{
+	std::lock_guard<std::mutex> lock(s_ringMutex);
+	if (s_ring.size() < kRingBufferCapacity)
+	{
+		s_ring.push_back(record);
+	}
+	else
+	{
+		s_ring[s_ringNext] = record;
+	}
+	s_ringNext = (s_ringNext + 1) % kRingBufferCapacity;
+}
+
+void Register()
+{
+}
+
+void Unregister()
+{
+	SetRingBufferEnabled(false);
+}
+
+unsigned long long Now()
+{
+	return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void WriteActivity(const char *name, unsigned long long durationNs)
+{
+	Record record;
+	record.name = name;
+	record.durationNs = durationNs;
+	Append(record);
+}
+
+void WriteValue(const char *name, long long value)
+{
+	Record record;
+	record.name = name;
+	record.value = value;
+	Append(record);
+}
+
+void WriteNavigation(unsigned int tabId, bool requested, bool failed, unsigned long long totalNs,
+	unsigned long long ownNs, unsigned long long shellNs)
+{
+	Record record;
+	record.name = "Navigation";
+	record.durationNs = totalNs;
+	record.tabId = tabId;
+	record.requested = requested;
+	record.failed = failed;
+	record.ownNs = ownNs;
+	record.shellNs = shellNs;
+	Append(record);
+}
+
+void SetRingBufferEnabled(bool enabled)
+{
+	g_ringBufferEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+/*
+ * ReadRingBuffer: Get the buffered records, oldest first.
+ */
+std::vector<Record> ReadRingBuffer()
+{
+	std::lock_guard<std::mutex> lock(s_ringMutex);
+	if (s_ring.size() < kRingBufferCapacity)
+		return s_ring;
+
+	std::vector<Record> ordered;
+	ordered.reserve(s_ring.size());
+	ordered.insert(ordered.end(), s_ring.begin() + s_ringNext, s_ring.end());
+	ordered.insert(ordered.end(), s_ring.begin(), s_ring.begin() + s_ringNext);
+	return ordered;
+}
+
+void ClearRingBuffer()
+{
+	std::lock_guard<std::mutex> lock(s_ringMutex);
+	s_ring.clear();
+	s_ringNext = 0;
+}
+
+} // namespace CETrace
+
+#endif // _WIN32
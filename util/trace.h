@@ -0,0 +1,129 @@
+#pragma once
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/*
+ * trace.h: A thin tracing facade for measuring hot paths in the field.
+ *
+ * On Windows, activities are written as TraceLogging events on the "ClassicExplorer" ETW
+ * provider, so they can be collected with the standard tooling, e.g.:
+ *
+ *     wpr -start ClassicExplorer.wprp    (or: tracelog / xperf with the provider GUID)
+ *
+ * Elsewhere, they are written to an in-memory ring buffer which can be read back.
+ *
+ * When nobody is listening, a scope costs a single flag check (plus two clock reads if it
+ * also records into a histogram).
+ */
+
+#include <vector>
+
+#include "latency_histogram.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <TraceLoggingProvider.h>
+
+TRACELOGGING_DECLARE_PROVIDER(g_ceTraceProvider);
+#else
+#include <atomic>
+#endif
+
+namespace CETrace
+{
+	void Register();
+	void Unregister();
+
+	unsigned long long Now();
+
+	void WriteActivity(const char *name, unsigned long long durationNs);
+	void WriteValue(const char *name, long long value);
+
+	// One finished navigation, as a single event; see NavigationTracer.
+	void WriteNavigation(unsigned int tabId, bool requested, bool failed, unsigned long long totalNs,
+		unsigned long long ownNs, unsigned long long shellNs);
+
+#ifdef _WIN32
+	inline bool IsEnabled()
+	{
+		return TraceLoggingProviderEnabled(g_ceTraceProvider, 0, 0);
+	}
+#else
+	struct Record
+	{
+		const char *name = nullptr;
+		unsigned long long durationNs = 0;
+		long long value = 0;
+
+		// Navigation events only; durationNs holds the total time.
+		unsigned int tabId = 0;
+		bool requested = false;
+		bool failed = false;
+		unsigned long long ownNs = 0;
+		unsigned long long shellNs = 0;
+	};
+
+	extern std::atomic<bool> g_ringBufferEnabled;
+
+	inline bool IsEnabled()
+	{
+		return g_ringBufferEnabled.load(std::memory_order_relaxed);
+	}
+
+	void SetRingBufferEnabled(bool enabled);
+	std::vector<Record> ReadRingBuffer();
+	void ClearRingBuffer();
+#endif
+
+	/*
+	 * ScopedActivity: Writes the duration of the enclosing scope as an activity, and records
+	 *                 it into a histogram if one is given.
+	 */
+	class ScopedActivity
+	{
+	public:
+		explicit ScopedActivity(const char *name, LatencyHistogram *histogram = nullptr)
+			: m_name(name), m_histogram(histogram)
+		{
+			if (m_histogram || IsEnabled())
+				m_start = Now();
+		}
+
+		~ScopedActivity()
+		{
+			if (m_start == 0)
+				return;
+
+			unsigned long long duration = Now() - m_start;
+			if (m_histogram)
+				m_histogram->Record(duration);
+			if (IsEnabled())
+				WriteActivity(m_name, duration);
+		}
+
+		ScopedActivity(const ScopedActivity &) = delete;
+		ScopedActivity &operator=(const ScopedActivity &) = delete;
+
+	private:
+		const char *m_name;
+		LatencyHistogram *m_histogram;
+		unsigned long long m_start = 0;
+	};
+}
+
+#define CE_TRACE_CONCAT_INNER(a, b) a##b
+#define CE_TRACE_CONCAT(a, b) CE_TRACE_CONCAT_INNER(a, b)
+
+// Measure the enclosing scope as an activity with the given name (a string literal).
+#define CE_TRACE_SCOPE(name) \
+	CETrace::ScopedActivity CE_TRACE_CONCAT(_ceTraceScope, __LINE__)(name)
+
+// As CE_TRACE_SCOPE, but also always records the duration into the given LatencyHistogram.
+#define CE_TRACE_SCOPE_RECORD(name, histogram) \
+	CETrace::ScopedActivity CE_TRACE_CONCAT(_ceTraceScope, __LINE__)(name, &(histogram))
+
+// Write a single named value, e.g. a counter or a failure code.
+#define CE_TRACE_VALUE(name, value) \
+	do { if (CETrace::IsEnabled()) CETrace::WriteValue((name), static_cast<long long>(value)); } while (0)
+
+#endif // _TRACE_H
@@ -0,0 +1,119 @@
+/*
+ * ui_timers.cpp: Drives a TimerWheel per UI thread from one Win32 thread timer.
+ */
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "ui_timers.h"
+
+namespace CEUtil
+{
+
+/*
+ * ThreadTimers: The timer state of one UI thread.
+ *
+ * The thread timer isn't tied to a window, so nothing is left pointing into the DLL once the
+ * wheel is empty: the timer is killed as soon as the last callback is cancelled or fired.
+ */
+struct ThreadTimers
+{
+	TimerWheel wheel{ GetTickCount64() };
+	UINT_PTR osTimer = 0;
+	unsigned long long armedFor = 0;
+	bool advancing = false;
+
+	~ThreadTimers()
+	{
+		if (osTimer)
+			KillTimer(NULL, osTimer);
+	}
+};
+
+static thread_local ThreadTimers t_timers;
+
+static void CALLBACK OnThreadTimer(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+
+/*
+ * Rearm: Set the thread timer for the wheel's next wakeup, or kill it if the wheel is empty.
+ */
+static void Rearm()
+{
+	ThreadTimers &timers = t_timers;
+
+	uint64_t wakeup;
+	if (!timers.wheel.GetNextWakeup(wakeup))
+	{
+		if (timers.osTimer)
+		{
+			KillTimer(NULL, timers.osTimer);
+			timers.osTimer = 0;
+			timers.armedFor = 0;
+		}
+		return;
+	}
+
+	// Only touch the timer when the wakeup actually moves.
+	if (timers.osTimer && timers.armedFor == wakeup)
+		return;
+
+	unsigned long long now = GetTickCount64();
+	unsigned long long wait = wakeup > now ? wakeup - now : 0;
+
+	UINT delay = USER_TIMER_MINIMUM;
+	if (wait > USER_TIMER_MAXIMUM)
+		delay = USER_TIMER_MAXIMUM;
+	else if (wait > USER_TIMER_MINIMUM)
+		delay = static_cast<UINT>(wait);
+
+	// With no window, SetTimer replaces the timer with the given ID, or makes a new one if it
+	// is 0.
+	UINT_PTR osTimer = SetTimer(NULL, timers.osTimer, delay, OnThreadTimer);
+	if (osTimer)
+	{
+		timers.osTimer = osTimer;
+		timers.armedFor = wakeup;
+	}
+}
+
+static void CALLBACK OnThreadTimer(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
+{
+	ThreadTimers &timers = t_timers;
+
+	// A thread timer keeps firing until it is reset, so it must be reset after every tick.
+	timers.armedFor = 0;
+
+	timers.advancing = true;
+	timers.wheel.Advance(GetTickCount64());
+	timers.advancing = false;
+
+	Rearm();
+}
+
+UiTimerId ScheduleUiTimer(unsigned int delayMs, TimerWheel::Callback callback)
+{
+	ThreadTimers &timers = t_timers;
+
+	UiTimerId timer = timers.wheel.Schedule(GetTickCount64() + delayMs, std::move(callback));
+
+	// Callbacks which schedule more work are rearmed for once the tick is over.
+	if (!timers.advancing)
+		Rearm();
+
+	return timer;
+}
+
+bool CancelUiTimer(UiTimerId timer)
+{
+	ThreadTimers &timers = t_timers;
+
+	if (!timers.wheel.Cancel(timer))
+		return false;
+
+	if (!timers.advancing)
+		Rearm();
+
+	return true;
+}
+
+} // namespace CEUtil
@@ -0,0 +1,26 @@
+#pragma once
+#ifndef _UI_TIMERS_H
+#define _UI_TIMERS_H
+
+#include "stdafx.h"
+#include "framework.h"
+
+#include "timer_wheel.h"
+
+namespace CEUtil
+{
+	using UiTimerId = TimerWheel::TimerId;
+
+	/*
+	 * Deferred work for the calling UI thread: debouncing, animation frames, idle tasks.
+	 *
+	 * Every UI thread has its own TimerWheel, multiplexed onto a single thread timer which is
+	 * only set while the wheel holds something. Callbacks run on the thread which scheduled
+	 * them, from its message loop; a timer must be cancelled on that same thread, before
+	 * whatever its callback touches goes away.
+	 */
+	UiTimerId ScheduleUiTimer(unsigned int delayMs, TimerWheel::Callback callback);
+	bool CancelUiTimer(UiTimerId timer);
+}
+
+#endif // _UI_TIMERS_H
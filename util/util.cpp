@@ -5,155 +5,109 @@
 #include "dllmain.h"
 
 #include "util.h"
+#include "trace.h"
+#include "registry_settings.h"
+#include "file_settings.h"
+#include "rate_governor.h"
+#include "ui_timers.h"
+#include "explorer_topology.h"
+#include "diagnostics.h"
+
+#include <map>
+#include <mutex>
+#include <set>
 
 namespace CEUtil
 {
 
-#define CE_REGISTRY_PATH L"SOFTWARE\\kawapure\\ClassicExplorer"
+/*
+ * GetModuleDirectory: Get the directory ClassicExplorer.dll was loaded from, or an empty path
+ *                     if it can't be found.
+ */
+std::filesystem::path GetModuleDirectory()
+{
+	WCHAR modulePath[MAX_PATH];
+	DWORD length = GetModuleFileNameW(_AtlBaseModule.GetModuleInstance(), modulePath, ARRAYSIZE(modulePath));
+	if (length == 0 || length >= ARRAYSIZE(modulePath))
+		return std::filesystem::path();
 
-CESettings GetCESettings()
+	return std::filesystem::path(modulePath).parent_path();
+}
+
+/*
+ * CreateSettingsBackend: Use ClassicExplorer.ini next to the DLL if there is one, and the
+ *                        registry otherwise. The choice is made once, when the DLL loads the
+ *                        settings for the first time.
+ */
+static std::unique_ptr<SettingsBackend> CreateSettingsBackend()
 {
-        bool fShowGoButton = true;
-        bool fShowAddressLabel = true;
-        bool fShowFullAddress = true;
-        bool fTabAutoSize = true;
-        DWORD dwFixedTabWidth = 180;
-        DWORD dwFixedTabHeight = 32;
-        DWORD dwShowGoButton = 1;
-        DWORD dwShowAddressLabel = 1;
-        DWORD dwShowFullAddress = 1;
-        DWORD dwTabAutoSize = 1;
-
-        ClassicExplorerTheme theme = CLASSIC_EXPLORER_2K;
-	HKEY hKey;
-	LSTATUS ls = RegOpenKeyExW(HKEY_CURRENT_USER, CE_REGISTRY_PATH, 0, KEY_READ, &hKey);
-	if (ls != ERROR_SUCCESS)
-	{
-		// Key doesn't exist, make it
-		ls = RegCreateKeyW(HKEY_CURRENT_USER, CE_REGISTRY_PATH, &hKey);
-		if (ls != ERROR_SUCCESS) // sum ting wong
-			return CESettings(CLASSIC_EXPLORER_NONE, -1, -1,-1);
-
-		// Open the new key with write access
-		RegOpenKeyExW(HKEY_CURRENT_USER, CE_REGISTRY_PATH, 0, KEY_WRITE, &hKey);
-
-		// Write default values and return default settings
-		WCHAR themeDef[] = L"2K";
-		RegSetValueExW(hKey, L"Theme", 0, REG_SZ, (BYTE*)themeDef, 4);
-                RegSetValueExW(hKey, L"ShowGoButton", 0, REG_DWORD, (BYTE*)&dwShowGoButton, sizeof(DWORD));
-                RegSetValueExW(hKey, L"ShowAddressLabel", 0, REG_DWORD, (BYTE*)&dwShowAddressLabel, sizeof(DWORD));
-                RegSetValueExW(hKey, L"ShowFullAddress", 0, REG_DWORD, (BYTE*)&dwShowFullAddress, sizeof(DWORD));
-                RegSetValueExW(hKey, L"TabAutoSize", 0, REG_DWORD, (BYTE*)&dwTabAutoSize, sizeof(DWORD));
-                RegSetValueExW(hKey, L"TabFixedWidth", 0, REG_DWORD, (BYTE*)&dwFixedTabWidth, sizeof(DWORD));
-                RegSetValueExW(hKey, L"TabFixedHeight", 0, REG_DWORD, (BYTE*)&dwFixedTabHeight, sizeof(DWORD));
-                return CESettings(CLASSIC_EXPLORER_2K, 1, 1,1, 1, dwFixedTabWidth, dwFixedTabHeight);
-        }
-	// Read settings
-	//WCHAR themeRead[8];
-	WCHAR themeRead[9];
-	//DWORD size = 8;
-	DWORD size = sizeof(themeRead);
-
-	RegGetValueW(hKey, NULL, L"Theme", RRF_RT_REG_SZ, NULL, themeRead, &size);
-	if (wcscmp(themeRead, L"XP") == 0)
-	{
-		theme = CLASSIC_EXPLORER_XP;
-	}
-	else if (wcscmp(themeRead, L"98") == 0)
+	std::filesystem::path moduleDirectory = GetModuleDirectory();
+	if (!moduleDirectory.empty())
 	{
-		theme = CLASSIC_EXPLORER_MEMPHIS;
-	}
-	else if (wcscmp(themeRead, L"10") == 0)
-	{
-		theme = CLASSIC_EXPLORER_10;
+		std::filesystem::path iniPath = moduleDirectory / L"ClassicExplorer.ini";
+
+		std::error_code error;
+		if (std::filesystem::exists(iniPath, error))
+			return std::make_unique<FileSettingsBackend>(iniPath);
 	}
-	
-        DWORD dwValueSize = sizeof(DWORD);
-        DWORD dwValue = 0;
-        if (RegGetValueW(hKey, NULL, L"ShowGoButton", RRF_RT_REG_DWORD, NULL, &dwValue, &dwValueSize) == ERROR_SUCCESS)
-                fShowGoButton = dwValue != 0;
-        dwValueSize = sizeof(DWORD);
-        if (RegGetValueW(hKey, NULL, L"ShowAddressLabel", RRF_RT_REG_DWORD, NULL, &dwValue, &dwValueSize) == ERROR_SUCCESS)
-                fShowAddressLabel = dwValue != 0;
-        dwValueSize = sizeof(DWORD);
-        if (RegGetValueW(hKey, NULL, L"ShowFullAddress", RRF_RT_REG_DWORD, NULL, &dwValue, &dwValueSize) == ERROR_SUCCESS)
-                fShowFullAddress = dwValue != 0;
-        dwValueSize = sizeof(DWORD);
-        if (RegGetValueW(hKey, NULL, L"TabAutoSize", RRF_RT_REG_DWORD, NULL, &dwValue, &dwValueSize) == ERROR_SUCCESS)
-                fTabAutoSize = dwValue != 0;
-        dwValueSize = sizeof(DWORD);
-        RegGetValueW(hKey, NULL, L"TabFixedWidth", RRF_RT_REG_DWORD, NULL, &dwFixedTabWidth, &dwValueSize);
-        dwValueSize = sizeof(DWORD);
-        RegGetValueW(hKey, NULL, L"TabFixedHeight", RRF_RT_REG_DWORD, NULL, &dwFixedTabHeight, &dwValueSize);
-
-        RegCloseKey(hKey);
-
-        return CESettings(
-                theme,
-                fShowGoButton,
-                fShowAddressLabel,
-                fShowFullAddress,
-                fTabAutoSize,
-                dwFixedTabWidth,
-                dwFixedTabHeight);
+
+	return std::make_unique<RegistrySettingsBackend>();
 }
 
-void WriteCESettings(CESettings& toWrite)
+/*
+ * GetSettingsCache: The process-wide settings cache.
+ *
+ * It is deliberately never destroyed: stopping the backend's watch blocks, which isn't allowed
+ * during DLL_PROCESS_DETACH. ShutdownSettings stops it when the DLL is about to be unloaded.
+ */
+static SettingsCache &GetSettingsCache()
 {
-	HKEY hKey;
-	LSTATUS ls = RegOpenKeyExW(HKEY_CURRENT_USER, CE_REGISTRY_PATH, 0, KEY_WRITE, &hKey);
-	if (ls != ERROR_SUCCESS)
-	{
-		// Key doesn't exist, make it
-		ls = RegCreateKeyW(HKEY_CURRENT_USER, CE_REGISTRY_PATH, &hKey);
-		if (ls != ERROR_SUCCESS)
-			return;
+	static SettingsCache *s_cache = new SettingsCache(CreateSettingsBackend());
+	return *s_cache;
+}
 
-		// Open the new key with write access
-		RegOpenKeyExW(HKEY_CURRENT_USER, CE_REGISTRY_PATH, 0, KEY_WRITE, &hKey);
-	}
-        if (toWrite.theme != CLASSIC_EXPLORER_NONE)
-        {
-                WCHAR theme[] = L"2K";
-                if (toWrite.theme == CLASSIC_EXPLORER_XP)
-			wcscpy_s(theme, L"XP");
-		if (toWrite.theme == CLASSIC_EXPLORER_MEMPHIS)
-			wcscpy_s(theme, L"98");
-		if (toWrite.theme == CLASSIC_EXPLORER_10)
-			wcscpy_s(theme, L"10");
-		RegSetValueExW(hKey, L"Theme", 0, REG_SZ, (BYTE*)theme, 4);
-	}
-        if (toWrite.showGoButton != -1)
-        {
-                DWORD dwValue = static_cast<DWORD>(toWrite.showGoButton);
-                RegSetValueExW(hKey, L"ShowGoButton", 0, REG_DWORD, (BYTE*)&dwValue, sizeof(DWORD));
-        }
-        if (toWrite.showAddressLabel != -1)
-        {
-                DWORD dwValue = static_cast<DWORD>(toWrite.showAddressLabel);
-                RegSetValueExW(hKey, L"ShowAddressLabel", 0, REG_DWORD, (BYTE*)&dwValue, sizeof(DWORD));
-        }
-        if (toWrite.showFullAddress != -1)
-        {
-                DWORD dwValue = static_cast<DWORD>(toWrite.showFullAddress);
-                RegSetValueExW(hKey, L"ShowFullAddress", 0, REG_DWORD, (BYTE*)&dwValue, sizeof(DWORD));
-        }
-        if (toWrite.tabAutoSize != -1)
-        {
-                DWORD dwValue = static_cast<DWORD>(toWrite.tabAutoSize);
-                RegSetValueExW(hKey, L"TabAutoSize", 0, REG_DWORD, (BYTE*)&dwValue, sizeof(DWORD));
-        }
-        if (toWrite.tabFixedWidth != -1)
-        {
-                DWORD dwValue = static_cast<DWORD>(toWrite.tabFixedWidth);
-                RegSetValueExW(hKey, L"TabFixedWidth", 0, REG_DWORD, (BYTE*)&dwValue, sizeof(DWORD));
-        }
-        if (toWrite.tabFixedHeight != -1)
-        {
-                DWORD dwValue = static_cast<DWORD>(toWrite.tabFixedHeight);
-                RegSetValueExW(hKey, L"TabFixedHeight", 0, REG_DWORD, (BYTE*)&dwValue, sizeof(DWORD));
-        }
-        RegCloseKey(hKey);
+/*
+ * GetCESettingsSnapshot: Get the current settings. Only the first call in the process, and the
+ *                        first after they change, reads the registry.
+ */
+std::shared_ptr<const CESettings> GetCESettingsSnapshot()
+{
+	return GetSettingsCache().Get();
+}
+
+CESettings GetCESettings()
+{
+	return *GetCESettingsSnapshot();
+}
+
+bool WriteCESettings(const CESettings& toWrite)
+{
+	return GetSettingsCache().Write(toWrite);
+}
+
+/*
+ * SubscribeToCESettings: Post CE_WM_SETTINGSCHANGED to the given window whenever the settings
+ *                        change, whichever window or process changed them.
+ *
+ * The notification is posted rather than delivered directly as it may come from a thread
+ * pool thread, and so that the window applies it on its own thread.
+ */
+unsigned long long SubscribeToCESettings(HWND notifyWindow)
+{
+	return GetSettingsCache().Subscribe([notifyWindow](const std::shared_ptr<const CESettings> &) {
+		PostMessageW(notifyWindow, CE_WM_SETTINGSCHANGED, 0, 0);
+	});
+}
+
+void UnsubscribeFromCESettings(unsigned long long subscription)
+{
+	if (subscription != 0)
+		GetSettingsCache().Unsubscribe(subscription);
+}
+
+void ShutdownSettings()
+{
+	GetSettingsCache().Shutdown();
 }
 
 /*
@@ -193,6 +147,48 @@ HRESULT GetCurrentFolderPidl(CComPtr<IShellBrowser> pShellBrowser, PIDLIST_ABSOL
 	return E_FAIL;
 }
 
+/*
+ * AllowRelayout: Ask whether code outside of Explorer may resize, relayout or force a redraw of
+ *                the Explorer window which contains the given window right now.
+ *
+ * Every Explorer window has one RateGovernor, shared by all such code, so that a loop between
+ * any of it and Explorer's own layout is throttled rather than left to freeze the window.
+ * Normal operation stays far below the rate at which it engages. The caller is the name the
+ * engagement is traced under.
+ */
+bool AllowRelayout(HWND explorerChild, const char *caller)
+{
+	HWND explorerRoot = GetAncestor(explorerChild, GA_ROOTOWNER);
+	if (!IsWindow(explorerRoot))
+		return true;
+
+	static std::mutex s_mutex;
+	static std::map<HWND, RateGovernor> s_governors;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	auto it = s_governors.find(explorerRoot);
+	if (it == s_governors.end())
+	{
+		// Forget the windows which have closed since the last one opened.
+		for (auto stale = s_governors.begin(); stale != s_governors.end();)
+		{
+			if (IsWindow(stale->first))
+				++stale;
+			else
+				stale = s_governors.erase(stale);
+		}
+
+		it = s_governors.emplace(explorerRoot, RateGovernor()).first;
+	}
+
+	RateGovernor::Decision decision = it->second.Request(GetTickCount64());
+	if (decision == RateGovernor::Decision::Engage)
+		CE_TRACE_VALUE(caller, it->second.GetStats().engagements);
+
+	return decision == RateGovernor::Decision::Allow;
+}
+
 /*
  * FixExplorerSizes: Manually correct the sizes of all children in the explorer
  *                   window.
@@ -202,19 +198,31 @@ HRESULT GetCurrentFolderPidl(CComPtr<IShellBrowser> pShellBrowser, PIDLIST_ABSOL
  * 
  * Make sure to be mindful of redraw loops in calling this. Avoid calling this function
  * from within size handlers, unless you are absolutely sure that the visual needs to be
- * revalidated, or else it will softlock explorer (and probably every other program too).
+ * revalidated. Calls are throttled by AllowRelayout, so a loop slows Explorer down rather
+ * than softlocking it, but it is still a loop.
+ * 
+ * See: FixExplorerSizesIfNecessary, ScheduleFixExplorerSizes
  * 
- * See: FixExplorerSizesIfNecessary
+ * The tab window is nudged by a pixel and back without redrawing, and only the rebar host is
+ * invalidated afterwards, since the rest of the window is laid out exactly as before. The two
+ * resizes can't be batched with DeferWindowPos: a batch holds one position per window, so the
+ * nudge would be folded into the restore and the layout never run.
  * 
  * NOTE: Find a better way of invalidating the explorer visual?
  */
 HRESULT FixExplorerSizes(HWND hWndExplorerChild)
 {
+	CE_TRACE_SCOPE("Util.FixExplorerSizes");
+
 	HWND hWndExplorerRoot = GetAncestor(hWndExplorerChild, GA_ROOTOWNER);
 	if (!IsWindow(hWndExplorerRoot))
 		return E_FAIL;
 
-	HWND hWndTabWindow = FindWindowExW(hWndExplorerRoot, NULL, L"ShellTabWindowClass", NULL);
+	if (!AllowRelayout(hWndExplorerRoot, "RedrawGovernor.FixExplorerSizes"))
+		return S_FALSE;
+
+	ExplorerTopology topology = GetExplorerTopology(hWndExplorerRoot);
+	HWND hWndTabWindow = topology.tabWindow;
 	if (!hWndTabWindow)
 		return E_FAIL;
 
@@ -247,30 +255,46 @@ HRESULT FixExplorerSizes(HWND hWndExplorerChild)
 	 */
 	bool isInitialSizing = cxTabWindow <= 0;
 
-	SetWindowPos(
-		hWndTabWindow,
-		NULL,
-		NULL,
-		NULL,
-		isInitialSizing ? 1300 : cxTabWindow + 1,
-		isInitialSizing ?  900 : cyTabWindow + 1,
-		SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOZORDER | SWP_NOMOVE | SWP_NOOWNERZORDER
-	);
-
-	if (!isInitialSizing)
+	if (isInitialSizing)
 	{
 		SetWindowPos(
 			hWndTabWindow,
 			NULL,
 			NULL,
 			NULL,
-			cxTabWindow,
-			cyTabWindow,
+			1300,
+			900,
 			SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOZORDER | SWP_NOMOVE | SWP_NOOWNERZORDER
 		);
+
+		// Nothing of the window has been drawn at its real size yet.
+		RedrawWindow(hWndExplorerRoot, NULL, NULL, RDW_INVALIDATE);
+		return S_OK;
 	}
 
-	RedrawWindow(hWndExplorerRoot, NULL, NULL, RDW_INVALIDATE);
+	SetWindowPos(
+		hWndTabWindow,
+		NULL,
+		NULL,
+		NULL,
+		cxTabWindow + 1,
+		cyTabWindow + 1,
+		SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOZORDER | SWP_NOMOVE | SWP_NOOWNERZORDER | SWP_NOREDRAW
+	);
+
+	SetWindowPos(
+		hWndTabWindow,
+		NULL,
+		NULL,
+		NULL,
+		cxTabWindow,
+		cyTabWindow,
+		SWP_NOACTIVATE | SWP_NOOWNERZORDER | SWP_NOZORDER | SWP_NOMOVE | SWP_NOOWNERZORDER | SWP_NOREDRAW
+	);
+
+	// Only the toolbars can have moved.
+	HWND hWndRebarHost = topology.rebarHost;
+	RedrawWindow(hWndRebarHost ? hWndRebarHost : hWndExplorerRoot, NULL, NULL, RDW_INVALIDATE | RDW_ALLCHILDREN);
 
 	return S_OK;
 }
@@ -287,12 +311,27 @@ HRESULT FixExplorerSizesIfNecessary(HWND explorerChild)
 	// BEGIN CHECKS
 	//------------------------------------------------------------------------------
 
+	ExplorerTopology topology = GetExplorerTopology(explorerRoot);
+	HWND tab = topology.tabWindow;
+
+	// A manual resize is necessary if Explorer left the tab window at 0x0 (see
+	// FixExplorerSizes):
+	if (tab)
+	{
+		RECT rcTab;
+		GetClientRect(tab, &rcTab);
+
+		if (rcTab.right - rcTab.left <= 0)
+		{
+			shouldResize = true;
+		}
+	}
+
 	// A manual resize is necessary if the height of the ReBar host shell worker is
 	// different from the height of the ReBar:
 	{
-		HWND tab = FindWindowExW(explorerRoot, NULL, L"ShellTabWindowClass", NULL);
-		HWND worker = FindWindowExW(tab, NULL, L"WorkerW", NULL);
-		HWND rebar = FindWindowExW(worker, NULL, L"ReBarWindow32", NULL);
+		HWND worker = topology.rebarHost;
+		HWND rebar = topology.rebar;
 
 		// Worker must exist if this can be true.
 		if (IsWindow(rebar))
@@ -323,4 +362,37 @@ HRESULT FixExplorerSizesIfNecessary(HWND explorerChild)
 	return S_OK;
 }
 
+/*
+ * ScheduleFixExplorerSizes: Run FixExplorerSizesIfNecessary for the Explorer window which
+ *                           contains the given window, once its thread is next idle.
+ *
+ * Timer messages are only generated when the message queue is otherwise empty, so the check
+ * waits for Explorer to finish its own layout, and every request made before then is folded
+ * into the one check.
+ *
+ * The check is counted as our own work on whichever navigation of the window is in flight
+ * when it runs; if that has already finished, it isn't counted.
+ */
+void ScheduleFixExplorerSizes(HWND explorerChild)
+{
+	HWND explorerRoot = GetAncestor(explorerChild, GA_ROOTOWNER);
+	if (!IsWindow(explorerRoot))
+		return;
+
+	thread_local std::set<HWND> t_pendingRoots;
+	if (!t_pendingRoots.insert(explorerRoot).second)
+		return;
+
+	// Navigations are keyed by the top-level window, as the bands and the BHO see it.
+	uintptr_t navigationKey = reinterpret_cast<uintptr_t>(GetAncestor(explorerChild, GA_ROOT));
+
+	ScheduleUiTimer(0, [explorerRoot, navigationKey]()
+	{
+		unsigned long long workStart = CETrace::Now();
+		t_pendingRoots.erase(explorerRoot);
+		FixExplorerSizesIfNecessary(explorerRoot);
+		CEDiagnostics::Navigations().AddOwnWork(navigationKey, CETrace::Now() - workStart);
+	});
+}
+
 } // namespace CEUtil
\ No newline at end of file
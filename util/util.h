@@ -8,52 +8,28 @@
 //#include "ClassicExplorer_i.h"
 #include "dllmain.h"
 
-enum ClassicExplorerTheme
-{
-	CLASSIC_EXPLORER_NONE = -1,
-	CLASSIC_EXPLORER_2K = 0,
-	CLASSIC_EXPLORER_XP = 1,
-	CLASSIC_EXPLORER_10 = 2,
-	CLASSIC_EXPLORER_MEMPHIS = 3
-};
+#include "settings.h"
 
-namespace CEUtil
-{
-        struct CESettings
-        {
-                ClassicExplorerTheme theme = CLASSIC_EXPLORER_NONE;
-                LONG showGoButton = -1;
-                LONG showAddressLabel = -1;
-                LONG showFullAddress = -1;
-                LONG tabAutoSize = -1;
-                LONG tabFixedWidth = -1;
-                LONG tabFixedHeight = -1;
+#include <filesystem>
+#include <memory>
 
-                CESettings() = default;
+// Posted to every window subscribed with SubscribeToCESettings when the settings change.
+#define CE_WM_SETTINGSCHANGED (WM_APP + 1)
 
-                CESettings(
-                        ClassicExplorerTheme t,
-                        LONG showGo,
-                        LONG showLabel,
-                        LONG showFull,
-                        LONG autoSize = -1,
-                        LONG fixedWidth = -1,
-                        LONG fixedHeight = -1)
-                {
-                        theme = t;
-                        showGoButton = showGo;
-                        showAddressLabel = showLabel;
-                        showFullAddress = showFull;
-                        tabAutoSize = autoSize;
-                        tabFixedWidth = fixedWidth;
-                        tabFixedHeight = fixedHeight;
-                }
-        };
+namespace CEUtil
+{
 	CESettings GetCESettings();
-	void WriteCESettings(CESettings& toWrite);
+	std::shared_ptr<const CESettings> GetCESettingsSnapshot();
+	bool WriteCESettings(const CESettings& toWrite);
+	unsigned long long SubscribeToCESettings(HWND notifyWindow);
+	void UnsubscribeFromCESettings(unsigned long long subscription);
+	void ShutdownSettings();
+	std::filesystem::path GetModuleDirectory();
 	HRESULT GetCurrentFolderPidl(CComPtr<IShellBrowser> pShellBrowser, PIDLIST_ABSOLUTE *pidlOut);
+	bool AllowRelayout(HWND explorerChild, const char *caller);
 	HRESULT FixExplorerSizes(HWND explorerChild);
 	HRESULT FixExplorerSizesIfNecessary(HWND explorerChild);
+	void ScheduleFixExplorerSizes(HWND explorerChild);
 }
 
 #endif
\ No newline at end of file